@@ -0,0 +1,870 @@
+"""
+.. module:: archive
+    :platform: Linux
+    :synopsis: module that contains the compressed results archive
+
+.. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
+"""
+import os
+import sys
+import json
+import zlib
+import codecs
+import struct
+import hashlib
+import logging
+import threading
+from collections import Counter
+from .report import format_results
+from .report import format_test
+
+# archive layout is:
+#
+#   MAGIC
+#   dictionary and output chunks, compressed with zlib
+#   index, compressed with zlib
+#   TRAILER, which contains position and size of the index
+#
+# the index contains results and timings of all the tests, so it can be
+# read without decompressing the tests output
+MAGIC = b"LTPARCH\x01"
+TRAILER = struct.Struct(">QQ8s")
+TRAILER_MAGIC = b"LTPAEND\n"
+VERSION = 1
+
+# tests output is split in chunks of about this size at lines boundaries,
+# so identical parts of many outputs are stored only once
+CHUNK_SIZE = 65536
+
+# zlib dictionary made of the most common output lines, which is built
+# once enough output has been collected
+DICT_SIZE = 32768
+DICT_SAMPLE = 1 << 20
+
+# output is stored as UTF-8, keeping invalid characters
+ENCODING = "utf-8"
+ERRORS = "surrogatepass"
+
+
+class ArchiveError(Exception):
+    """
+    Raised when an archive can't be read or written.
+    """
+
+
+def build_dictionary(samples: list, size: int = DICT_SIZE) -> bytes:
+    """
+    Build a zlib dictionary out of the lines which are repeated inside
+    tests output, such as LTP banners and TINFO messages.
+    :param samples: tests output
+    :type samples: list(bytes)
+    :param size: maximum size of the dictionary
+    :type size: int
+    :returns: bytes
+    """
+    counter = Counter()
+    for sample in samples:
+        counter.update(sample.splitlines(keepends=True))
+
+    lines = [
+        (count * len(line), line) for line, count in counter.items()
+        if count > 1
+    ]
+
+    # zlib prefers the most useful strings at the end of the dictionary
+    lines.sort(reverse=True)
+
+    selected = []
+    total = 0
+    for _, line in lines:
+        if total + len(line) > size:
+            continue
+
+        selected.append(line)
+        total += len(line)
+
+    return b"".join(reversed(selected))
+
+
+def is_archive(path: str) -> bool:
+    """
+    True if file is a results archive.
+    :param path: path of the file
+    :type path: str
+    :returns: bool
+    """
+    try:
+        with open(path, "rb") as data:
+            return data.read(len(MAGIC)) == MAGIC
+    except OSError:
+        return False
+
+
+class LTPArchiveWriter:
+    """
+    Writer of a results archive. Tests output is compressed as soon as
+    tests are added, so only results are kept in memory. Archive is
+    written inside a temporary file, which replaces the archive once it's
+    closed.
+    """
+
+    def __init__(self,
+                 path: str,
+                 chunk_size: int = CHUNK_SIZE,
+                 dict_sample: int = DICT_SAMPLE) -> None:
+        """
+        :param path: path of the archive
+        :type path: str
+        :param chunk_size: size of the output chunks
+        :type chunk_size: int
+        :param dict_sample: size of the output collected before building
+            the compression dictionary
+        :type dict_sample: int
+        :raises: ValueError
+        """
+        if not path:
+            raise ValueError("path is empty")
+
+        if not chunk_size or chunk_size < 1:
+            raise ValueError("chunk_size must be greater than 0")
+
+        self._logger = logging.getLogger("ltp.archive")
+        self._path = path
+        self._tmp_path = f"{path}.tmp"
+        self._chunk_size = chunk_size
+        self._dict_sample = dict_sample
+        self._suites = {}
+        self._chunks = []
+        self._hashes = {}
+        self._pending = []
+        self._pending_size = 0
+        self._zdict = None
+        self._dictionary = None
+        self._raw_size = 0
+
+        # pylint: disable=consider-using-with
+        self._file = open(self._tmp_path, "wb")
+        self._file.write(MAGIC)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *_) -> None:
+        # archives which are not closed are not complete
+        self.abort()
+
+    @property
+    def path(self) -> str:
+        """
+        Path of the archive.
+        """
+        return self._path
+
+    def _suite(self, name: str) -> dict:
+        """
+        Index entry of a suite.
+        """
+        suite = self._suites.get(name, None)
+        if suite is None:
+            suite = {"name": name, "tests": []}
+            self._suites[name] = suite
+
+        return suite
+
+    def _write(self, data: bytes) -> list:
+        """
+        Write a blob at the end of the archive.
+        :returns: [offset, length]
+        """
+        offset = self._file.tell()
+        self._file.write(data)
+
+        return [offset, len(data)]
+
+    def _compress(self, data: bytes) -> bytes:
+        """
+        Compress data using the archive dictionary.
+        """
+        if self._zdict:
+            comp = zlib.compressobj(zdict=self._zdict)
+        else:
+            comp = zlib.compressobj()
+
+        return comp.compress(data) + comp.flush()
+
+    def _chunk(self, data: bytes) -> int:
+        """
+        Store a chunk of output, unless it's already stored.
+        :returns: chunk id
+        """
+        digest = hashlib.sha1(data).digest()
+
+        chunk_id = self._hashes.get(digest, None)
+        if chunk_id is None:
+            offset, length = self._write(self._compress(data))
+
+            chunk_id = len(self._chunks)
+            self._chunks.append([offset, length, len(data)])
+            self._hashes[digest] = chunk_id
+
+        return chunk_id
+
+    def _store(self, stdout: dict, data: bytes) -> None:
+        """
+        Store the output of a test.
+        """
+        chunks = []
+
+        pos = 0
+        while pos < len(data):
+            end = pos + self._chunk_size
+            if end < len(data):
+                newline = data.rfind(b"\n", pos, end)
+                if newline >= pos:
+                    end = newline + 1
+
+            chunks.append(self._chunk(data[pos:end]))
+            pos = end
+
+        stdout["chunks"] = chunks
+
+    def _flush_pending(self) -> None:
+        """
+        Build the dictionary and store the output collected so far.
+        """
+        self._zdict = build_dictionary([data for _, data in self._pending])
+        if self._zdict:
+            self._dictionary = self._write(zlib.compress(self._zdict))
+
+        for stdout, data in self._pending:
+            self._store(stdout, data)
+
+        self._pending = []
+        self._pending_size = 0
+
+    def add_test(self, suite: str, test: dict) -> None:
+        """
+        Add a completed test to the archive.
+        :param suite: name of the test suite
+        :type suite: str
+        :param test: test data, as written inside JSON reports
+        :type test: dict
+        """
+        entry = dict(test)
+
+        stdout = entry.get("stdout", None)
+        if stdout is not None:
+            data = stdout.encode(ENCODING, ERRORS)
+            self._raw_size += len(data)
+
+            entry["stdout"] = {"size": len(data), "chunks": []}
+
+            if self._zdict is None:
+                self._pending.append((entry["stdout"], data))
+                self._pending_size += len(data)
+
+                if self._pending_size >= self._dict_sample:
+                    self._flush_pending()
+            else:
+                self._store(entry["stdout"], data)
+
+        self._suite(suite)["tests"].append(entry)
+
+    def set_suite(self, suite: str, results: dict) -> None:
+        """
+        Set the results of a test suite.
+        :param suite: name of the test suite
+        :type suite: str
+        :param results: suite results, as written inside JSON reports
+        :type results: dict
+        """
+        entry = self._suite(suite)
+        entry.update({
+            key: value for key, value in results.items()
+            if key not in ["name", "tests"]
+        })
+
+    def close(self, session: dict) -> None:
+        """
+        Write the index and complete the archive.
+        :param session: session name and results, as written inside JSON
+            reports
+        :type session: dict
+        """
+        if not self._file:
+            return
+
+        if self._zdict is None:
+            self._flush_pending()
+
+        data = {"name": session.get("name", None), "suites": []}
+        data.update({
+            key: value for key, value in session.items()
+            if key not in ["name", "suites"]
+        })
+        data["suites"] = list(self._suites.values())
+
+        index = zlib.compress(json.dumps({
+            "version": VERSION,
+            "dictionary": self._dictionary,
+            "chunks": self._chunks,
+            "session": data,
+        }).encode("utf-8"))
+
+        offset, length = self._write(index)
+        self._file.write(TRAILER.pack(offset, length, TRAILER_MAGIC))
+        self._file.close()
+        self._file = None
+
+        os.replace(self._tmp_path, self._path)
+
+        self._logger.info(
+            "Archive %s written: %d bytes of output stored in %d chunks",
+            self._path,
+            self._raw_size,
+            len(self._chunks))
+
+    def abort(self) -> None:
+        """
+        Discard an archive which has not been closed.
+        """
+        if not self._file:
+            return
+
+        self._file.close()
+        self._file = None
+
+        try:
+            os.remove(self._tmp_path)
+        except OSError:
+            pass
+
+
+class LTPArchive:
+    """
+    Reader of a results archive. The index is read when archive is opened
+    and tests output is decompressed only when it's requested.
+    """
+
+    def __init__(self, path: str) -> None:
+        """
+        :param path: path of the archive
+        :type path: str
+        :raises: ArchiveError
+        """
+        if not path:
+            raise ValueError("path is empty")
+
+        self._path = path
+        self._lock = threading.Lock()
+        self._zdict = None
+
+        try:
+            # pylint: disable=consider-using-with
+            self._file = open(path, "rb")
+        except OSError as err:
+            raise ArchiveError(f"can't open {path}: {err}") from err
+
+        try:
+            self._index = self._read_index()
+        except (OSError, ValueError, zlib.error, struct.error) as err:
+            self._file.close()
+            raise ArchiveError(f"{path} is not a valid archive: {err}") \
+                from err
+
+        version = self._index.get("version", None)
+        if version != VERSION:
+            self._file.close()
+            raise ArchiveError(f"{path} has unsupported version {version}")
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *_) -> None:
+        self.close()
+
+    def _read(self, offset: int, length: int) -> bytes:
+        """
+        Read a blob of the archive.
+        """
+        with self._lock:
+            self._file.seek(offset)
+            data = self._file.read(length)
+
+        if len(data) != length:
+            raise ArchiveError(f"{self._path} is truncated")
+
+        return data
+
+    def _read_index(self) -> dict:
+        """
+        Read the archive index.
+        """
+        if self._file.read(len(MAGIC)) != MAGIC:
+            raise ValueError("bad magic")
+
+        self._file.seek(-TRAILER.size, os.SEEK_END)
+        offset, length, magic = TRAILER.unpack(self._file.read(TRAILER.size))
+        if magic != TRAILER_MAGIC:
+            raise ValueError("bad trailer, archive is not complete")
+
+        self._file.seek(offset)
+        data = zlib.decompress(self._file.read(length))
+
+        return json.loads(data.decode("utf-8"))
+
+    def close(self) -> None:
+        """
+        Close the archive.
+        """
+        self._file.close()
+
+    @property
+    def session(self) -> dict:
+        """
+        Session data of the index, as written inside JSON reports. Tests
+        output is referenced by a "stdout" dictionary containing its size
+        and its chunks.
+        """
+        return self._index["session"]
+
+    @property
+    def suites(self) -> list:
+        """
+        Suites data of the index.
+        """
+        return self._index["session"]["suites"]
+
+    def tests(self, suite: str = None):
+        """
+        Iterate over the tests data of the index. Output is not read.
+        :param suite: name of the suite. If None, tests of all suites are
+            given
+        :type suite: str
+        :returns: iterator over (suite name, test data)
+        """
+        for suite_data in self.suites:
+            if suite is not None and suite_data["name"] != suite:
+                continue
+
+            for test in suite_data["tests"]:
+                yield suite_data["name"], test
+
+    def _dictionary(self) -> bytes:
+        """
+        Compression dictionary of the archive.
+        """
+        if self._zdict is None:
+            self._zdict = b""
+
+            ref = self._index.get("dictionary", None)
+            if ref:
+                self._zdict = zlib.decompress(self._read(*ref))
+
+        return self._zdict
+
+    def _chunk(self, chunk_id: int) -> bytes:
+        """
+        Decompress an output chunk.
+        """
+        offset, length, size = self._index["chunks"][chunk_id]
+
+        zdict = self._dictionary()
+        if zdict:
+            decomp = zlib.decompressobj(zdict=zdict)
+        else:
+            decomp = zlib.decompressobj()
+
+        try:
+            data = decomp.decompress(self._read(offset, length))
+            data += decomp.flush()
+        except zlib.error as err:
+            raise ArchiveError(f"chunk {chunk_id} is corrupted: {err}") \
+                from err
+
+        if len(data) != size:
+            raise ArchiveError(f"chunk {chunk_id} is corrupted")
+
+        return data
+
+    def iter_stdout(self, test: dict):
+        """
+        Iterate over the output of a test, one chunk at time.
+        :param test: test data of the index
+        :type test: dict
+        :returns: iterator over str
+        """
+        stdout = test.get("stdout", None)
+        if stdout is None:
+            return
+
+        decoder = codecs.getincrementaldecoder(ENCODING)(errors=ERRORS)
+        for chunk_id in stdout["chunks"]:
+            yield decoder.decode(self._chunk(chunk_id))
+
+        yield decoder.decode(b"", final=True)
+
+    def stdout(self, test: dict) -> str:
+        """
+        Output of a test.
+        :param test: test data of the index
+        :type test: dict
+        :returns: str or None if output is not stored inside the archive
+        """
+        if test.get("stdout", None) is None:
+            return None
+
+        return "".join(self.iter_stdout(test))
+
+    def test_data(self, test: dict) -> dict:
+        """
+        Test data as written inside JSON reports, including its output.
+        :param test: test data of the index
+        :type test: dict
+        :returns: dict
+        """
+        data = {}
+        for key, value in test.items():
+            if key == "stdout" and isinstance(value, dict):
+                value = self.stdout(test)
+
+            data[key] = value
+
+        return data
+
+
+class ArchiveReporter:
+    """
+    Report writer storing tests inside a results archive as soon as they
+    are completed. Archive is completed when session stops.
+    """
+
+    def __init__(self, output: str, max_stdout: int = None) -> None:
+        """
+        :param output: path of the archive
+        :type output: str
+        :param max_stdout: maximum size of the spooled tests stdout stored
+            inside the archive. Bigger stdout are referenced by their path.
+            If None, all stdout are stored
+        :type max_stdout: int
+        """
+        if not output:
+            raise ValueError("output")
+
+        self._output = output
+        self._max_stdout = max_stdout or sys.maxsize
+        self._lock = threading.Lock()
+        self._session = None
+        self._writer = None
+
+    @property
+    def output(self) -> str:
+        """
+        Path of the archive.
+        :returns: str
+        """
+        return self._output
+
+    def start(self, session) -> None:
+        """
+        Create the archive.
+        :param session: session which is going to run
+        :type session: LTPSession
+        """
+        with self._lock:
+            self._session = session
+            self._writer = LTPArchiveWriter(self._output)
+
+    def test_completed(self, suite, test) -> None:
+        """
+        Store a completed test.
+        :param suite: suite of the test
+        :type suite: LTPSuite
+        :param test: completed test
+        :type test: LTPTest
+        """
+        with self._lock:
+            if not self._writer:
+                return
+
+            self._writer.add_test(
+                suite.name, format_test(test, self._max_stdout))
+
+    def stop(self) -> None:
+        """
+        Complete the archive, writing results of suites and session.
+        """
+        with self._lock:
+            if not self._writer:
+                return
+
+            for suite in self._session.suites:
+                if suite.completed:
+                    self._writer.set_suite(suite.name, format_results(suite))
+
+            data = {"name": self._session.name}
+            data.update(format_results(self._session))
+
+            self._writer.close(data)
+            self._writer = None
+
+
+class _JSONStream:
+    """
+    Reader of a JSON document which decodes one value at time, so big
+    reports can be read without loading them in memory.
+    """
+
+    WHITESPACE = " \t\r\n"
+
+    def __init__(self, data, block: int = 65536) -> None:
+        self._data = data
+        self._block = block
+        self._decoder = json.JSONDecoder()
+        self._buf = ""
+        self._pos = 0
+        self._eof = False
+
+    def _fill(self, size: int = None) -> bool:
+        """
+        Read more data. False is returned at the end of the document.
+        """
+        if self._eof:
+            return False
+
+        data = self._data.read(size or self._block)
+        if not data:
+            self._eof = True
+            return False
+
+        self._buf = self._buf[self._pos:] + data
+        self._pos = 0
+
+        return True
+
+    def peek(self) -> str:
+        """
+        Next character which is not a whitespace.
+        """
+        while True:
+            while self._pos < len(self._buf) and \
+                    self._buf[self._pos] in self.WHITESPACE:
+                self._pos += 1
+
+            if self._pos < len(self._buf):
+                return self._buf[self._pos]
+
+            if not self._fill():
+                raise ArchiveError("unexpected end of JSON document")
+
+    def expect(self, char: str) -> None:
+        """
+        Consume the next character, which must be the given one.
+        """
+        found = self.peek()
+        if found != char:
+            raise ArchiveError(f"expected '{char}' but found '{found}'")
+
+        self._pos += 1
+
+    def value(self):
+        """
+        Decode the next value.
+        """
+        self.peek()
+
+        while True:
+            try:
+                value, end = self._decoder.raw_decode(self._buf, self._pos)
+
+                # numbers can continue inside the next block
+                if end < len(self._buf) or self._eof:
+                    self._pos = end
+                    return value
+            except json.JSONDecodeError as err:
+                if self._eof:
+                    raise ArchiveError(f"bad JSON document: {err}") from err
+
+            # values bigger than the buffer double its size
+            self._fill(max(self._block, len(self._buf)))
+
+    def members(self):
+        """
+        Iterate over the keys of the next object. Value of each key must be
+        consumed before getting the next key.
+        """
+        self.expect("{")
+        if self.peek() == "}":
+            self._pos += 1
+            return
+
+        while True:
+            key = self.value()
+            self.expect(":")
+
+            yield key
+
+            if self.peek() == ",":
+                self._pos += 1
+                continue
+
+            self.expect("}")
+            return
+
+    def items(self):
+        """
+        Iterate over the items of the next array. Each item must be consumed
+        before getting the next one.
+        """
+        self.expect("[")
+        if self.peek() == "]":
+            self._pos += 1
+            return
+
+        while True:
+            yield
+
+            if self.peek() == ",":
+                self._pos += 1
+                continue
+
+            self.expect("]")
+            return
+
+
+def iter_json_report(path: str):
+    """
+    Iterate over the content of a JSON report, reading one test at time.
+    Each suite is given after its tests and the session is given at last:
+
+    - ("test", suite name, test data)
+    - ("suite", suite name, suite data without tests)
+    - ("session", None, session data without suites)
+
+    :param path: path of the JSON report
+    :type path: str
+    :returns: iterator over (kind, suite name, data)
+    :raises: ArchiveError
+    """
+    session = {}
+
+    with open(path, "r", encoding="UTF-8") as data:
+        stream = _JSONStream(data)
+
+        for key in stream.members():
+            if key != "session":
+                stream.value()
+                continue
+
+            for session_key in stream.members():
+                if session_key != "suites":
+                    session[session_key] = stream.value()
+                    continue
+
+                for _ in stream.items():
+                    suite = {}
+                    for suite_key in stream.members():
+                        if suite_key != "tests":
+                            suite[suite_key] = stream.value()
+                            continue
+
+                        if "name" not in suite:
+                            raise ArchiveError(
+                                "suite name must precede its tests")
+
+                        for _ in stream.items():
+                            yield "test", suite["name"], stream.value()
+
+                    if "name" not in suite:
+                        raise ArchiveError("suite has no name")
+
+                    yield "suite", suite["name"], suite
+
+    yield "session", None, session
+
+
+def json_to_archive(src: str, dst: str) -> None:
+    """
+    Convert a JSON report into a results archive. Report is read one test
+    at time.
+    :param src: path of the JSON report
+    :type src: str
+    :param dst: path of the archive
+    :type dst: str
+    :raises: ArchiveError
+    """
+    logger = logging.getLogger("ltp.archive")
+    logger.info("Converting %s into %s", src, dst)
+
+    with LTPArchiveWriter(dst) as writer:
+        for kind, suite, data in iter_json_report(src):
+            if kind == "test":
+                writer.add_test(suite, data)
+            elif kind == "suite":
+                writer.set_suite(suite, data)
+            else:
+                writer.close(data)
+
+    logger.info("Archive has been written")
+
+
+def _indent(level: int) -> str:
+    """
+    Indentation of the JSON reports.
+    """
+    return " " * 4 * level
+
+
+def _write_json(out, value, level: int = 0) -> None:
+    """
+    Write a value using the JSON reports layout. Lists can be given as
+    iterators, so their items are created only when they are written.
+    """
+    if isinstance(value, dict) and value:
+        out.write("{")
+        for i, (key, item) in enumerate(value.items()):
+            out.write("," if i else "")
+            out.write(f"\n{_indent(level + 1)}{json.dumps(key)}: ")
+            _write_json(out, item, level + 1)
+        out.write(f"\n{_indent(level)}}}")
+    elif isinstance(value, list) or hasattr(value, "__next__"):
+        empty = True
+        for item in value:
+            out.write("," if not empty else "[")
+            out.write(f"\n{_indent(level + 1)}")
+            _write_json(out, item, level + 1)
+            empty = False
+
+        out.write("[]" if empty else f"\n{_indent(level)}]")
+    else:
+        text = json.dumps(value, indent=4)
+        out.write(text.replace("\n", f"\n{_indent(level)}"))
+
+
+def archive_to_json(src: str, dst: str) -> None:
+    """
+    Convert a results archive into a JSON report, having the same layout
+    of the reports written by `export_to_json`. Tests output is
+    decompressed one test at time.
+    :param src: path of the archive
+    :type src: str
+    :param dst: path of the JSON report
+    :type dst: str
+    :raises: ArchiveError
+    """
+    logger = logging.getLogger("ltp.archive")
+    logger.info("Converting %s into %s", src, dst)
+
+    with LTPArchive(src) as archive, \
+            open(dst, "w", encoding="UTF-8") as out:
+        session = dict(archive.session)
+        session["suites"] = []
+
+        for suite in archive.suites:
+            data = dict(suite)
+            data["tests"] = map(archive.test_data, suite["tests"])
+            session["suites"].append(data)
+
+        _write_json(out, {"session": session})
+
+    logger.info("JSON report has been written")
@@ -7,12 +7,20 @@
 """
 from .base import Backend
 from .base import BackendError
+from .base import BackendTimeoutError
+from .base import BackendPool
+from .base import BackendLoop
 from .shell import ShellBackend
 from .ssh import SSHBackend
+from .qemu import QemuBackend
 
 __all__ = [
     "Backend",
     "BackendError",
+    "BackendTimeoutError",
+    "BackendPool",
+    "BackendLoop",
     "ShellBackend",
     "SSHBackend",
+    "QemuBackend",
 ]
@@ -5,6 +5,13 @@
 
 .. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
 """
+import time
+import queue
+import asyncio
+import logging
+import threading
+from contextlib import contextmanager
+from concurrent.futures import ThreadPoolExecutor
 
 
 class BackendError(Exception):
@@ -13,6 +20,12 @@ class BackendError(Exception):
     """
 
 
+class BackendTimeoutError(BackendError):
+    """
+    Raised when a command didn't complete before its timeout.
+    """
+
+
 class Backend:
     """
     A generic backend that has to be inherited to implement a new backend.
@@ -26,6 +39,15 @@ class Backend:
         """
         raise NotImplementedError()
 
+    @property
+    def target(self) -> str:
+        """
+        Name of the target where commands are executed. By default, it's the
+        name of the backend.
+        :returns: string naming the target.
+        """
+        return self.name
+
     def start(self) -> None:
         """
         Start backend.
@@ -52,8 +74,8 @@ class Backend:
         Run a command on target. This has to be implemented by the class that
         is inheriting Backend class.
         :param command: command to execute
-        :param timeout: timeout before raising an exception. If 0, no timeout
-            will be applied.
+        :param timeout: seconds before the command is stopped and
+            BackendTimeoutError is raised. If 0, no timeout will be applied.
         :type timeout: int
         :returns: dictionary containing command execution information
             {
@@ -70,8 +92,8 @@ class Backend:
         """
         Run a command on target.
         :param command: command to execute
-        :param timeout: timeout before raising an exception. If 0, no timeout
-            will be applied.
+        :param timeout: seconds before the command is stopped and
+            BackendTimeoutError is raised. If 0, no timeout will be applied.
         :type timeout: int
         :returns: dictionary containing command execution information
             {
@@ -83,6 +105,127 @@ class Backend:
             If None is returned, then callback failed.
         """
         ret = self._run_cmd_impl(command, timeout)
+
+        return self._check_cmd_result(ret)
+
+    async def _run_cmd_async_impl(
+            self,
+            command: str,
+            timeout: int,
+            stdout_callback: callable) -> dict:
+        """
+        Run a command on target without blocking the event loop. By default,
+        `_run_cmd_impl` is executed inside the loop executor and stdout is
+        given to `stdout_callback` once command completed. Backends which can
+        run commands asynchronously should override it.
+        :param command: command to execute
+        :param timeout: seconds before the command is stopped and
+            BackendTimeoutError is raised. If 0, no timeout will be applied.
+        :type timeout: int
+        :param stdout_callback: function called with stdout data as soon as
+            it's read. It can be None
+        :type stdout_callback: callable
+        :returns: dictionary containing command execution information, the
+            same returned by `_run_cmd_impl`
+        """
+        loop = asyncio.get_running_loop()
+        ret = await loop.run_in_executor(
+            None,
+            self._run_cmd_impl,
+            command,
+            timeout)
+
+        if ret and stdout_callback and ret.get("stdout", None):
+            stdout_callback(ret["stdout"])
+
+        return ret
+
+    async def run_cmd_async(
+            self,
+            command: str,
+            timeout: int,
+            stdout_callback: callable = None) -> dict:
+        """
+        Run a command on target without blocking the event loop, so multiple
+        commands can run at the same time:
+
+            results = await asyncio.gather(
+                backend.run_cmd_async("ls", 10, print),
+                backend.run_cmd_async("uname", 10, print))
+
+        :param command: command to execute
+        :param timeout: seconds before the command is stopped and
+            BackendTimeoutError is raised. If 0, no timeout will be applied.
+        :type timeout: int
+        :param stdout_callback: function called with stdout data as soon as
+            it's read
+        :type stdout_callback: callable
+        :returns: dictionary containing command execution information
+            {
+                "command": <mycommand>,
+                "timeout": <timeout>,
+                "returncode": <returncode>,
+                "stdout": <stdout>,
+            }
+            If None is returned, then callback failed.
+        """
+        ret = await self._run_cmd_async_impl(command, timeout, stdout_callback)
+
+        return self._check_cmd_result(ret)
+
+    def _run_cmd_input_impl(
+            self,
+            command: str,
+            stdin,
+            timeout: int) -> dict:
+        """
+        Run a command on target, writing data to its standard input. This
+        has to be implemented by backends which can transfer data.
+        :param command: command to execute
+        :type command: str
+        :param stdin: binary file object which is read until EOF
+        :type stdin: file
+        :param timeout: seconds before the command is stopped and
+            BackendTimeoutError is raised. If 0, no timeout will be applied.
+        :type timeout: int
+        :returns: dictionary containing command execution information, the
+            same returned by `_run_cmd_impl`
+        """
+        raise BackendError(f"{self.name} backend can't write commands input")
+
+    def run_cmd_input(self, command: str, stdin, timeout: int) -> dict:
+        """
+        Run a command on target, writing data to its standard input. Data is
+        streamed, so it can be larger than the available memory:
+
+            with open("ltp.tar.gz", "rb") as data:
+                backend.run_cmd_input("tar xzf - -C /opt/ltp", data, 600)
+
+        :param command: command to execute
+        :type command: str
+        :param stdin: binary file object which is read until EOF
+        :type stdin: file
+        :param timeout: seconds before the command is stopped and
+            BackendTimeoutError is raised. If 0, no timeout will be applied.
+        :type timeout: int
+        :returns: dictionary containing command execution information
+            {
+                "command": <mycommand>,
+                "timeout": <timeout>,
+                "returncode": <returncode>,
+                "stdout": <stdout>,
+            }
+        :raises: BackendError if backend can't write commands input
+        """
+        ret = self._run_cmd_input_impl(command, stdin, timeout)
+
+        return self._check_cmd_result(ret)
+
+    @staticmethod
+    def _check_cmd_result(ret: dict) -> dict:
+        """
+        Verify the data returned by the commands implementation.
+        """
         if not ret:
             return None
 
@@ -96,3 +239,445 @@ class Backend:
                 "Please check documentation")
 
         return ret
+
+
+class BackendPool(Backend):
+    """
+    A pool of backends connected to the same target. Each command is executed
+    by a backend which is checked out from the pool and returned once command
+    has been completed, so up to `size` commands can run at the same time.
+    When recycling is enabled, a backend which failed is replaced in
+    background by a new one, while commands keep running on the others.
+    """
+
+    def __init__(self,
+                 factory: callable,
+                 size: int = 1,
+                 recycle: bool = False,
+                 retries: int = 3) -> None:
+        """
+        :param factory: function creating a new backend, such as
+            `lambda: SSHBackend(host="myhost", ...)`
+        :type factory: callable
+        :param size: number of backends inside the pool
+        :type size: int
+        :param recycle: if True, backends raising BackendError are stopped
+            and replaced by new backends
+        :type recycle: bool
+        :param retries: number of times a new backend is started before
+            giving up on recycling it
+        :type retries: int
+        """
+        if not factory:
+            raise ValueError("factory is empty")
+
+        if not size or size < 1:
+            raise ValueError("size must be greater than 0")
+
+        self._logger = logging.getLogger("ltp.backend.pool")
+        self._factory = factory
+        self._recycle = recycle
+        self._retries = max(retries, 1)
+        self._backends = [factory() for _ in range(size)]
+        # name and target don't change when backends are recycled
+        self._first = self._backends[0]
+        self._idle = queue.Queue()
+        self._lock = threading.Lock()
+        self._threads = []
+        self._started = False
+
+        for backend in self._backends:
+            self._idle.put(backend)
+
+    @property
+    def name(self) -> str:
+        return self._first.name
+
+    @property
+    def target(self) -> str:
+        return self._first.target
+
+    @property
+    def size(self) -> int:
+        """
+        Number of backends inside the pool.
+        :returns: int
+        """
+        return len(self._backends)
+
+    @property
+    def backends(self) -> list:
+        """
+        Backends inside the pool.
+        :returns: list(Backend)
+        """
+        return self._backends
+
+    @property
+    def available(self) -> int:
+        """
+        Number of backends which are running or being recycled.
+        :returns: int
+        """
+        with self._lock:
+            return len(self._backends) + \
+                sum(1 for thread in self._threads if thread.is_alive())
+
+    def start(self) -> None:
+        """
+        Start all the backends of the pool at the same time. If one of them
+        can't be started, the others are stopped.
+        """
+        with self._lock:
+            if self._started:
+                return
+
+            self._logger.info("Starting %d backends", self.size)
+
+            with ThreadPoolExecutor(max_workers=self.size) as executor:
+                futures = [
+                    executor.submit(backend.start)
+                    for backend in self._backends
+                ]
+
+            errors = [future.exception() for future in futures
+                      if future.exception()]
+            if errors:
+                self._stop_all(lambda backend: backend.stop())
+                raise BackendError(errors[0]) from errors[0]
+
+            self._started = True
+
+    def _stop_all(self, func: callable) -> None:
+        """
+        Run `func(backend)` on all backends, ignoring backend errors, such as
+        the ones raised when no command is running.
+        """
+        for backend in self._backends:
+            try:
+                func(backend)
+            except BackendError as err:
+                self._logger.debug("%s: %s", backend.name, err)
+
+    def _join_recycling(self) -> None:
+        """
+        Wait for the backends which are being recycled.
+        """
+        with self._lock:
+            threads = self._threads
+            self._threads = []
+
+        for thread in threads:
+            thread.join()
+
+    def stop(self, timeout: int = 0) -> None:
+        with self._lock:
+            self._started = False
+            self._stop_all(lambda backend: backend.stop(timeout))
+
+        self._join_recycling()
+
+    def force_stop(self) -> None:
+        with self._lock:
+            self._started = False
+            self._stop_all(lambda backend: backend.force_stop())
+
+        self._join_recycling()
+
+    def reset(self) -> None:
+        """
+        Reset all backends of the pool, such as Qemu VMs which are restored
+        from their clean snapshot. Each backend is reset once its running
+        command completed.
+        :raises: BackendError if backends can't be reset
+        """
+        with self._lock:
+            backends = list(self._backends)
+
+        if not all(hasattr(backend, "reset") for backend in backends):
+            raise BackendError(f"{self.name} backends can't be reset")
+
+        idle = []
+        try:
+            for _ in backends:
+                idle.append(self._get_idle(None))
+
+            for backend in idle:
+                backend.reset()
+        finally:
+            for backend in idle:
+                self._idle.put(backend)
+
+    def _replace(self, broken: Backend) -> None:
+        """
+        Stop a broken backend and start a new one, which is added to the
+        idle backends.
+        """
+        try:
+            broken.force_stop()
+        except BackendError as err:
+            self._logger.debug("%s: %s", broken.name, err)
+
+        for retry in range(self._retries):
+            with self._lock:
+                if not self._started:
+                    return
+
+            backend = self._factory()
+            try:
+                backend.start()
+            except BackendError as err:
+                self._logger.warning(
+                    "Can't start a new %s backend (%d/%d): %s",
+                    backend.name, retry + 1, self._retries, err)
+                continue
+
+            with self._lock:
+                if not self._started:
+                    backend.stop()
+                    return
+
+                self._backends.append(backend)
+
+            self._logger.info("%s backend has been recycled", backend.name)
+            self._idle.put(backend)
+            return
+
+        self._logger.error(
+            "%s backend has been removed from the pool", broken.name)
+
+    def _checkin(self, backend: Backend, failed: bool) -> None:
+        """
+        Return a backend to the pool once command completed. A backend which
+        failed is recycled if recycling is enabled.
+        """
+        if not failed or not self._recycle:
+            self._idle.put(backend)
+            return
+
+        with self._lock:
+            if not self._started:
+                self._idle.put(backend)
+                return
+
+            self._logger.warning(
+                "Recycling %s backend in background", backend.name)
+
+            self._backends.remove(backend)
+
+            thread = threading.Thread(
+                target=self._replace,
+                args=(backend,),
+                daemon=True)
+            self._threads.append(thread)
+            thread.start()
+
+    def _get_idle(self, timeout: float) -> Backend:
+        """
+        Wait for an idle backend. A pool which lost all its backends raises
+        BackendError, instead of waiting forever.
+        """
+        deadline = None if timeout is None else time.monotonic() + timeout
+
+        while True:
+            wait = 0.1
+            if deadline is not None:
+                wait = min(wait, max(deadline - time.monotonic(), 0))
+
+            try:
+                return self._idle.get(timeout=wait)
+            except queue.Empty:
+                pass
+
+            if self.available == 0:
+                raise BackendError("No backends left in the pool")
+
+            if deadline is not None and time.monotonic() >= deadline:
+                raise BackendError("No idle backends available")
+
+    @contextmanager
+    def checkout(self, timeout: float = None):
+        """
+        Checkout a backend from the pool and return it once done:
+
+            with pool.checkout() as backend:
+                backend.run_cmd("ls", 10)
+
+        :param timeout: time to wait for an idle backend. If None, it waits
+            until a backend is available
+        :type timeout: float
+        :raises: BackendError if no backends are available in time
+        """
+        backend = self._get_idle(timeout)
+
+        failed = False
+        try:
+            yield backend
+        except BackendTimeoutError:
+            raise
+        except BackendError:
+            failed = True
+            raise
+        finally:
+            self._checkin(backend, failed)
+
+    def _run_cmd_impl(self, command: str, timeout: int) -> dict:
+        with self.checkout() as backend:
+            return backend.run_cmd(command, timeout)
+
+    def _run_cmd_input_impl(
+            self,
+            command: str,
+            stdin,
+            timeout: int) -> dict:
+        with self.checkout() as backend:
+            return backend.run_cmd_input(command, stdin, timeout)
+
+    async def _run_cmd_async_impl(
+            self,
+            command: str,
+            timeout: int,
+            stdout_callback: callable) -> dict:
+        # don't block the event loop while waiting for an idle backend
+        while True:
+            try:
+                backend = self._idle.get_nowait()
+                break
+            except queue.Empty:
+                if self.available == 0:
+                    raise BackendError("No backends left in the pool")
+
+                await asyncio.sleep(0.01)
+
+        failed = False
+        try:
+            return await backend.run_cmd_async(
+                command,
+                timeout,
+                stdout_callback)
+        except BackendTimeoutError:
+            raise
+        except BackendError:
+            failed = True
+            raise
+        finally:
+            self._checkin(backend, failed)
+
+
+class BackendLoop:
+    """
+    Long-lived event loop running inside its own thread, which drives the
+    commands of all the backends. Many threads can submit commands at the
+    same time and wait for their results, while commands run concurrently
+    as tasks of the same loop. Event loops are not created and destroyed
+    for each command, and stdout callbacks are called by the loop thread.
+    """
+
+    def __init__(self, workers: int = None) -> None:
+        """
+        :param workers: number of threads running the commands of backends
+            which can't run them asynchronously. It should be the number of
+            commands which can run at the same time. If None, the asyncio
+            default is used
+        :type workers: int
+        """
+        if workers is not None and workers < 1:
+            raise ValueError("workers must be greater than 0")
+
+        self._logger = logging.getLogger("ltp.backend.loop")
+        self._workers = workers
+        self._loop = None
+        self._executor = None
+        self._thread = None
+
+    @property
+    def is_running(self) -> bool:
+        """
+        True if the event loop is running.
+        :returns: bool
+        """
+        return self._thread is not None
+
+    def start(self) -> None:
+        """
+        Start the event loop thread.
+        """
+        if self._thread:
+            return
+
+        # executor is owned by the loop object, so it can be shut down
+        # from the calling thread on stop
+        self._executor = ThreadPoolExecutor(
+            max_workers=self._workers,
+            thread_name_prefix="backend-loop")
+
+        self._loop = asyncio.new_event_loop()
+        self._loop.set_default_executor(self._executor)
+
+        self._thread = threading.Thread(
+            target=self._loop.run_forever,
+            name="backend-loop",
+            daemon=True)
+        self._thread.start()
+
+        self._logger.debug("event loop started")
+
+    def stop(self) -> None:
+        """
+        Stop the event loop thread. Commands have to be completed before
+        stopping it, while the ones running on the executor are waited.
+        """
+        if not self._thread:
+            return
+
+        self._loop.call_soon_threadsafe(self._loop.stop)
+        self._thread.join()
+
+        # commands running inside the executor complete while loop is
+        # stopped but not closed, so their callbacks can still be scheduled
+        self._executor.shutdown(wait=True)
+        self._loop.close()
+
+        self._thread = None
+        self._executor = None
+        self._loop = None
+
+        self._logger.debug("event loop stopped")
+
+    def run_cmd(self,
+                backend: Backend,
+                command: str,
+                timeout: int,
+                stdout_callback: callable = None) -> dict:
+        """
+        Run a command on a backend inside the event loop and wait for its
+        completion. It can be called by multiple threads at the same time.
+        :param backend: started backend running the command
+        :type backend: Backend
+        :param command: command to execute
+        :type command: str
+        :param timeout: seconds before the command is stopped and
+            BackendTimeoutError is raised. If 0, no timeout will be applied.
+        :type timeout: int
+        :param stdout_callback: function called by the loop thread with
+            stdout data as soon as it's read
+        :type stdout_callback: callable
+        :returns: dictionary containing command execution information, the
+            same returned by `Backend.run_cmd_async`
+        :raises: BackendError
+        """
+        if not self._thread:
+            raise BackendError("event loop is not running")
+
+        future = asyncio.run_coroutine_threadsafe(
+            backend.run_cmd_async(command, timeout, stdout_callback),
+            self._loop)
+
+        return future.result()
+
+    def __enter__(self):
+        self.start()
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback) -> None:
+        self.stop()
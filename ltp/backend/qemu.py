@@ -0,0 +1,271 @@
+"""
+.. module:: qemu
+    :platform: Linux
+    :synopsis: Qemu backend implementation
+
+.. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
+"""
+import asyncio
+import logging
+import threading
+from ltp.qemu import QemuVM, QemuError, QemuTimeoutError
+from .base import Backend
+from .base import BackendError
+from .base import BackendTimeoutError
+
+
+class QemuBackend(Backend):
+    """
+    Qemu backend implementation class. The VM is booted once and its clean
+    state is saved inside a snapshot, which is restored when a command
+    damaged the system. Restoring a snapshot takes a fraction of the time
+    needed by a reboot.
+    """
+
+    # name of the snapshot containing the clean VM state
+    SNAPSHOT = "ltp_clean"
+
+    # supported policies to restore the clean snapshot
+    RESET_POLICIES = ["always", "failure", "taint", "never"]
+
+    def __init__(self, **kwargs) -> None:
+        """
+        :param image: disk image of the VM. It's never modified
+        :type image: str
+        :param qemu: Qemu binary. Default is qemu-system-x86_64
+        :type qemu: str
+        :param memory: VM memory. Default is 2G
+        :type memory: str
+        :param smp: number of CPUs. Default is 2
+        :type smp: int
+        :param kernel: kernel image to boot
+        :type kernel: str
+        :param initrd: initrd image to boot
+        :type initrd: str
+        :param cmdline: kernel command line, used when kernel is given
+        :type cmdline: str
+        :param console: console transport: "serial" (default) or "virtio"
+        :type console: str
+        :param options: additional Qemu command line options
+        :type options: list(str)
+        :param overlay: if True, VM runs on a qcow2 overlay backed by image,
+            so many VMs can share the same image
+        :type overlay: bool
+        :param user: username for logging in. If None, console is supposed
+            to run a shell
+        :type user: str
+        :param password: password for logging in
+        :type password: str
+        :param boot_timeout: time in seconds to wait for the VM to boot
+        :type boot_timeout: int
+        :param reset: when VM is restored from the clean snapshot. "always"
+            after every command, "failure" when command failed or kernel has
+            been tainted, "taint" when kernel has been tainted (default),
+            "never" to keep the VM state. VM is always restored after a
+            timeout
+        :type reset: str
+        """
+        self._logger = logging.getLogger("ltp.qemu")
+        self._user = kwargs.get("user", "root")
+        self._password = kwargs.get("password", None)
+        self._boot_timeout = int(kwargs.get("boot_timeout", None) or 300)
+        self._reset = kwargs.get("reset", None) or "taint"
+        self._tainted = None
+        self._started = False
+        self._lock = threading.Lock()
+
+        if self._reset not in self.RESET_POLICIES:
+            raise ValueError(
+                f"reset must be one of {', '.join(self.RESET_POLICIES)}")
+
+        vm_args = {
+            key: kwargs[key] for key in [
+                "image",
+                "qemu",
+                "memory",
+                "smp",
+                "kernel",
+                "initrd",
+                "cmdline",
+                "console",
+                "options",
+                "overlay",
+            ] if key in kwargs
+        }
+
+        self._image = kwargs.get("image", None)
+        self._vm = QemuVM(**vm_args)
+
+        self._logger.debug(
+            "vm=%s\n"
+            "user=%s\n"
+            "reset=%s\n",
+            vm_args,
+            self._user,
+            self._reset)
+
+    @property
+    def name(self) -> str:
+        return "qemu"
+
+    @property
+    def target(self) -> str:
+        return f"qemu:{self._image}"
+
+    @property
+    def vm(self) -> QemuVM:
+        """
+        Qemu virtual machine.
+        :returns: QemuVM
+        """
+        return self._vm
+
+    def _read_tainted(self) -> str:
+        """
+        Read the kernel tainted flags.
+        """
+        _, stdout = self._vm.execute(
+            "cat /proc/sys/kernel/tainted",
+            timeout=30)
+
+        return stdout.strip()
+
+    def start(self) -> None:
+        try:
+            self._vm.start()
+            self._vm.login(
+                user=self._user,
+                password=self._password,
+                timeout=self._boot_timeout)
+
+            self._tainted = self._read_tainted()
+            self._vm.savevm(self.SNAPSHOT)
+        except QemuError as err:
+            self._vm.force_stop()
+            raise BackendError(err) from err
+
+        self._started = True
+
+    def stop(self, timeout: int = 0) -> None:
+        self._started = False
+        self._vm.stop(timeout=timeout or 60)
+
+    def force_stop(self) -> None:
+        self._started = False
+        self._vm.force_stop()
+
+    def reset(self) -> None:
+        """
+        Restore the VM from the clean snapshot.
+        :raises: BackendError
+        """
+        if not self._started:
+            raise BackendError("VM is not running")
+
+        try:
+            self._vm.loadvm(self.SNAPSHOT)
+        except QemuError as err:
+            raise BackendError(f"Can't restore VM: {err}") from err
+
+    def _need_reset(self, retcode: int, tainted: str) -> bool:
+        """
+        True if VM has to be restored after a command completed. tainted is
+        the kernel tainted flags read once command completed.
+        """
+        if self._reset == "never":
+            return False
+
+        if self._reset == "always":
+            return True
+
+        if self._reset == "failure" and retcode != 0:
+            return True
+
+        if tainted != self._tainted:
+            self._logger.info("Kernel has been tainted (%s)", tainted)
+            return True
+
+        return False
+
+    def _run_cmd_impl(self, command: str, timeout: int) -> dict:
+        return self._execute(command, timeout, None)
+
+    def _execute(
+            self,
+            command: str,
+            timeout: int,
+            stdout_callback: callable) -> dict:
+        """
+        Execute a command on the VM console and restore the VM if needed.
+        """
+        if not command:
+            raise ValueError("command is empty")
+
+        if not self._started:
+            raise BackendError("VM is not running")
+
+        t_secs = max(timeout or 0, 0)
+
+        # the next command must find the VM restored
+        with self._lock:
+            # tainted flags are read together with the command exit status,
+            # saving a console round trip for each command
+            check_taint = self._reset in ["failure", "taint"]
+            tainted = None
+
+            try:
+                ret = self._vm.execute(
+                    command,
+                    timeout=t_secs,
+                    stdout_callback=stdout_callback,
+                    tainted=check_taint)
+            except QemuTimeoutError as err:
+                # console is still busy with the command
+                self.reset()
+                raise BackendTimeoutError(err) from err
+            except QemuError as err:
+                raise BackendError(err) from err
+
+            if check_taint:
+                retcode, stdout, tainted = ret
+            else:
+                retcode, stdout = ret
+
+            self._logger.debug("retcode=%d", retcode)
+            self._logger.debug("stdout=%s", stdout)
+
+            try:
+                if self._need_reset(retcode, tainted):
+                    self.reset()
+            except QemuError as err:
+                raise BackendError(err) from err
+
+        ret = {
+            "command": command,
+            "stdout": stdout,
+            "returncode": retcode,
+            "timeout": timeout,
+        }
+
+        self._logger.debug("return data=%s", ret)
+
+        return ret
+
+    async def _run_cmd_async_impl(
+            self,
+            command: str,
+            timeout: int,
+            stdout_callback: callable) -> dict:
+        loop = asyncio.get_running_loop()
+
+        callback = None
+        if stdout_callback:
+            def callback(data: str) -> None:
+                loop.call_soon_threadsafe(stdout_callback, data)
+
+        return await loop.run_in_executor(
+            None,
+            self._execute,
+            command,
+            timeout,
+            callback)
@@ -5,11 +5,18 @@
 
 .. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
 """
+import io
 import os
+import codecs
+import signal
+import shutil
+import asyncio
+import threading
 import subprocess
 import logging
 from .base import Backend
 from .base import BackendError
+from .base import BackendTimeoutError
 
 
 class ShellBackend(Backend):
@@ -26,6 +33,7 @@ class ShellBackend(Backend):
         """
         self._logger = logging.getLogger("ltp.shell")
         self._process = None
+        self._async_processes = set()
         self._cwd = cwd
         self._env = env
 
@@ -36,17 +44,39 @@ class ShellBackend(Backend):
     def start(self) -> None:
         pass
 
-    def stop(self, _: int = 0) -> None:
-        if not self._process:
+    def _running_processes(self) -> list:
+        """
+        Return the running processes, raising an error if there are none.
+        """
+        procs = list(self._async_processes)
+        if self._process:
+            procs.append(self._process)
+
+        if not procs:
             raise BackendError("No process running")
 
-        self._process.terminate()
+        return procs
+
+    def stop(self, _: int = 0) -> None:
+        for proc in self._running_processes():
+            proc.terminate()
 
     def force_stop(self) -> None:
-        if not self._process:
-            raise BackendError("No process running")
+        for proc in self._running_processes():
+            proc.kill()
+
+    @staticmethod
+    def _kill(proc) -> None:
+        """
+        Kill the process group of a command, so processes spawned by the
+        command are stopped as well.
+        """
+        try:
+            os.killpg(proc.pid, signal.SIGKILL)
+        except ProcessLookupError:
+            pass
 
-        self._process.kill()
+        proc.wait()
 
     def _run_cmd_impl(self, command: str, timeout: int) -> dict:
         if self._process:
@@ -57,7 +87,7 @@ class ShellBackend(Backend):
         if not command:
             raise ValueError("command is empty")
 
-        timeout = max(timeout, 0)
+        timeout = max(timeout or 0, 0)
 
         self._logger.info("Executing '%s' (timeout=%d)", command, timeout)
 
@@ -77,7 +107,7 @@ class ShellBackend(Backend):
 
         ret = None
         try:
-            stdout = self._process.communicate(timeout=timeout)[0]
+            stdout = self._process.communicate(timeout=timeout or None)[0]
             self._logger.debug("stdout=%s", stdout)
 
             ret = {
@@ -88,9 +118,187 @@ class ShellBackend(Backend):
             }
             self._logger.debug("return data=%s", ret)
         except subprocess.TimeoutExpired as err:
-            self._process.kill()
-            raise BackendError from err
+            self._kill(self._process)
+            raise BackendTimeoutError(f"'{command}' timed out") from err
         finally:
             self._process = None
 
         return ret
+
+    def _run_cmd_input_impl(
+            self,
+            command: str,
+            stdin,
+            timeout: int) -> dict:
+        if self._process:
+            raise BackendError("A command is already running")
+
+        if not command:
+            raise ValueError("command is empty")
+
+        timeout = max(timeout or 0, 0)
+
+        self._logger.info(
+            "Executing '%s' with input (timeout=%d)", command, timeout)
+
+        # pylint: disable=subprocess-popen-preexec-fn
+        # pylint: disable=consider-using-with
+        self._process = subprocess.Popen(
+            command,
+            stdin=subprocess.PIPE,
+            stdout=subprocess.PIPE,
+            stderr=subprocess.STDOUT,
+            cwd=self._cwd,
+            env=self._env,
+            shell=True,
+            preexec_fn=os.setsid)
+
+        proc = self._process
+        expired = threading.Event()
+
+        def _expire():
+            expired.set()
+            self._kill(proc)
+
+        # input is written while output is read, so pipes never fill up
+        stdout = []
+        reader = threading.Thread(
+            target=lambda: stdout.append(proc.stdout.read()))
+        reader.start()
+
+        timer = None
+        if timeout:
+            timer = threading.Timer(timeout, _expire)
+            timer.start()
+
+        try:
+            try:
+                shutil.copyfileobj(stdin, proc.stdin)
+            except BrokenPipeError:
+                # command exited without reading the whole input
+                pass
+            finally:
+                try:
+                    proc.stdin.close()
+                except BrokenPipeError:
+                    pass
+
+            reader.join()
+            proc.wait()
+        finally:
+            if timer:
+                timer.cancel()
+            proc.stdout.close()
+            self._process = None
+
+        if expired.is_set():
+            raise BackendTimeoutError(f"'{command}' timed out")
+
+        ret = {
+            "command": command,
+            "stdout": stdout[0].decode("utf-8", errors="replace"),
+            "returncode": proc.returncode,
+            "timeout": timeout,
+        }
+        self._logger.debug("return data=%s", ret)
+
+        return ret
+
+    @staticmethod
+    async def _read_async(proc, stdout_callback: callable) -> str:
+        """
+        Read process stdout until EOF, using the event loop to know when
+        data is available, then wait for process to exit.
+        """
+        loop = asyncio.get_running_loop()
+        eof = loop.create_future()
+        fd = proc.stdout.fileno()
+        os.set_blocking(fd, False)
+
+        # same decoding used by universal_newlines
+        decoder = io.IncrementalNewlineDecoder(
+            codecs.getincrementaldecoder("utf-8")(errors="replace"),
+            translate=True)
+        stdout = []
+
+        def _on_data():
+            try:
+                data = os.read(fd, 65536)
+                text = decoder.decode(data, final=not data)
+                if text:
+                    stdout.append(text)
+                    if stdout_callback:
+                        stdout_callback(text)
+            except BlockingIOError:
+                return
+            # pylint: disable=broad-except
+            except Exception as err:
+                loop.remove_reader(fd)
+                eof.set_exception(err)
+                return
+
+            if not data:
+                loop.remove_reader(fd)
+                eof.set_result(None)
+
+        loop.add_reader(fd, _on_data)
+        try:
+            await eof
+        finally:
+            loop.remove_reader(fd)
+
+        # stdout has been closed, but process could be still running
+        while proc.poll() is None:
+            await asyncio.sleep(0.01)
+
+        return "".join(stdout)
+
+    async def _run_cmd_async_impl(
+            self,
+            command: str,
+            timeout: int,
+            stdout_callback: callable) -> dict:
+        if not command:
+            raise ValueError("command is empty")
+
+        timeout = max(timeout or 0, 0)
+
+        self._logger.info(
+            "Executing '%s' asynchronously (timeout=%d)", command, timeout)
+
+        # keep usage of preexec_fn trivial
+        # see warnings in https://docs.python.org/3/library/subprocess.html
+        # pylint: disable=subprocess-popen-preexec-fn
+        # pylint: disable=consider-using-with
+        proc = subprocess.Popen(
+            command,
+            stdout=subprocess.PIPE,
+            stderr=subprocess.STDOUT,
+            cwd=self._cwd,
+            env=self._env,
+            shell=True,
+            preexec_fn=os.setsid)
+
+        self._async_processes.add(proc)
+
+        ret = None
+        try:
+            stdout = await asyncio.wait_for(
+                self._read_async(proc, stdout_callback),
+                timeout or None)
+
+            ret = {
+                "command": command,
+                "stdout": stdout,
+                "returncode": proc.returncode,
+                "timeout": timeout,
+            }
+            self._logger.debug("return data=%s", ret)
+        except asyncio.TimeoutError as err:
+            self._kill(proc)
+            raise BackendTimeoutError(f"'{command}' timed out") from err
+        finally:
+            self._async_processes.discard(proc)
+            proc.stdout.close()
+
+        return ret
@@ -6,9 +6,10 @@
 .. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
 """
 import logging
-from ltp.libssh.helper import SSHClient, SSHError
+from ltp.libssh.helper import SSHClient, SSHError, SSHTimeoutError
 from .base import Backend
 from .base import BackendError
+from .base import BackendTimeoutError
 
 
 class SSHBackend(Backend):
@@ -34,6 +35,12 @@ class SSHBackend(Backend):
         :type key_passphrase: str
         :param ssh_opts: additional SSH options
         :type ssh_opts: str
+        :param persistent: if True, commands are executed inside a single
+            remote shell which is kept open during the whole session. stderr
+            is redirected to stdout
+        :type persistent: bool
+        :param buffer_size: size of the buffer used to read commands stdout
+        :type buffer_size: int
         """
         self._logger = logging.getLogger("ltp.ssh")
         self._password = kwargs.get("password", None)
@@ -44,26 +51,41 @@ class SSHBackend(Backend):
         user = kwargs.get("user", None)
         host = kwargs.get("host", None)
         port = int(kwargs.get("port", 22))
+        self._target = f"{user}@{host}:{port}"
         timeout = int(kwargs.get("timeout", 10))
+        persistent = bool(kwargs.get("persistent", False))
+        buffer_size = int(kwargs.get("buffer_size", 65536))
 
-        self._ssh = SSHClient(user, host, port, timeout)
+        self._ssh = SSHClient(
+            user,
+            host,
+            port,
+            timeout,
+            persistent,
+            buffer_size)
 
         self._logger.debug(
             "host=%s\n"
             "port=%s\n"
             "user=%s\n"
             "timeout=%s\n"
-            "key_file=%s\n",
+            "key_file=%s\n"
+            "persistent=%s\n",
             host,
             port,
             user,
             timeout,
-            self._key_file)
+            self._key_file,
+            persistent)
 
     @property
     def name(self) -> str:
         return "ssh"
 
+    @property
+    def target(self) -> str:
+        return self._target
+
     def start(self) -> None:
         try:
             self._ssh.connect()
@@ -96,9 +118,79 @@ class SSHBackend(Backend):
         if not command:
             raise ValueError("command is empty")
 
-        t_secs = max(timeout, 0)
+        t_secs = max(timeout or 0, 0)
+
+        try:
+            retcode, stdout = self._ssh.execute(command, t_secs)
+        except SSHTimeoutError as err:
+            raise BackendTimeoutError(err) from err
+        except SSHError as err:
+            raise BackendError(err) from err
+
+        self._logger.debug("retcode=%d", retcode)
+        self._logger.debug("stdout=%s", stdout)
+
+        ret = {
+            "command": command,
+            "stdout": stdout,
+            "returncode": retcode,
+            "timeout": timeout,
+        }
+
+        self._logger.debug("return data=%s", ret)
+
+        return ret
+
+    def _run_cmd_input_impl(
+            self,
+            command: str,
+            stdin,
+            timeout: int) -> dict:
+        if not command:
+            raise ValueError("command is empty")
+
+        t_secs = max(timeout or 0, 0)
 
-        retcode, stdout = self._ssh.execute(command, t_secs)
+        try:
+            retcode, stdout = self._ssh.execute_input(command, stdin, t_secs)
+        except SSHTimeoutError as err:
+            raise BackendTimeoutError(err) from err
+        except SSHError as err:
+            raise BackendError(err) from err
+
+        self._logger.debug("retcode=%d", retcode)
+        self._logger.debug("stdout=%s", stdout)
+
+        ret = {
+            "command": command,
+            "stdout": stdout,
+            "returncode": retcode,
+            "timeout": timeout,
+        }
+
+        self._logger.debug("return data=%s", ret)
+
+        return ret
+
+    async def _run_cmd_async_impl(
+            self,
+            command: str,
+            timeout: int,
+            stdout_callback: callable) -> dict:
+        if not command:
+            raise ValueError("command is empty")
+
+        t_secs = max(timeout or 0, 0)
+
+        try:
+            retcode, stdout = await self._ssh.execute_async(
+                command,
+                t_secs,
+                stdout_callback)
+        except SSHTimeoutError as err:
+            raise BackendTimeoutError(err) from err
+        except SSHError as err:
+            raise BackendError(err) from err
 
         self._logger.debug("retcode=%d", retcode)
         self._logger.debug("stdout=%s", stdout)
@@ -0,0 +1,7 @@
+"""
+.. module:: __init__
+    :platform: Linux
+    :synopsis: benchmarks package initializer
+
+.. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
+"""
@@ -0,0 +1,455 @@
+"""
+.. module:: overhead
+    :platform: Linux
+    :synopsis: benchmark of the time added by the runner to each test
+
+.. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
+"""
+import io
+import os
+import sys
+import json
+import stat
+import time
+import shlex
+import tarfile
+import argparse
+import platform
+import resource
+import tempfile
+import subprocess
+from ltp.session import LTPSession
+from ltp.report import export_to_json
+from ltp.launcher import LTPLauncher
+
+# synthetic tests executables
+SCRIPTS = {
+    "output.sh":
+        '#!/bin/sh\n'
+        'yes "output.c:1: TINFO: a line of output" | head -n "$1"\n',
+    "short.sh":
+        '#!/bin/sh\n'
+        'echo "short.c:1: TPASS: test passed"\n'
+        'echo ""\n'
+        'echo "Summary:"\n'
+        'echo "passed   1"\n'
+        'echo "failed   0"\n'
+        'echo "broken   0"\n'
+        'echo "skipped  0"\n'
+        'echo "warnings 0"\n',
+}
+
+BACKENDS = ["local", "launcher", "shell", "ssh"]
+
+
+def _suites(tests: int, lines: int) -> dict:
+    """
+    Return the runtest declarations of the synthetic suites.
+    """
+    return {
+        # process spawn and results collection
+        "noop": [f"noop{i:05d} true" for i in range(tests)],
+        # output capture and logging
+        "output": [
+            f"output{i:05d} output.sh {lines}"
+            for i in range(max(1, tests // 10))
+        ],
+        # scheduling and parsing of many LTP style tests
+        "short": [f"short{i:05d} short.sh" for i in range(tests * 5)],
+    }
+
+
+def create_ltproot(path: str, tests: int, lines: int) -> dict:
+    """
+    Create a LTPROOT containing the synthetic suites.
+    :param path: LTPROOT directory
+    :type path: str
+    :param tests: number of tests of the no-op suite. Other suites sizes
+        are relative to it
+    :type tests: int
+    :param lines: lines printed by each test of the high output suite
+    :type lines: int
+    :returns: dict(suite name, list(runtest declaration))
+    """
+    bin_dir = os.path.join(path, "testcases", "bin")
+    runtest_dir = os.path.join(path, "runtest")
+    os.makedirs(bin_dir, exist_ok=True)
+    os.makedirs(runtest_dir, exist_ok=True)
+    os.makedirs(os.path.join(path, "scenario_groups"), exist_ok=True)
+
+    for name, script in SCRIPTS.items():
+        script_path = os.path.join(bin_dir, name)
+        with open(script_path, "w", encoding="utf-8") as data:
+            data.write(script)
+
+        os.chmod(script_path, os.stat(script_path).st_mode | stat.S_IEXEC)
+
+    suites = _suites(tests, lines)
+    for name, decls in suites.items():
+        with open(os.path.join(runtest_dir, name), "w",
+                  encoding="utf-8") as data:
+            data.write("\n".join(decls) + "\n")
+
+    return suites
+
+
+def _baseline(ltproot: str, decls: list) -> float:
+    """
+    Time needed to run the tests commands directly, without the runner.
+    """
+    env = dict(os.environ)
+    env["PATH"] += ":" + os.path.join(ltproot, "testcases", "bin")
+
+    start = time.monotonic()
+    for decl in decls:
+        cmd = decl.split(None, 1)[1]
+        subprocess.run(
+            cmd,
+            shell=True,
+            stdout=subprocess.DEVNULL,
+            stderr=subprocess.STDOUT,
+            cwd=ltproot,
+            env=env,
+            check=False)
+
+    return time.monotonic() - start
+
+
+def _rss() -> int:
+    """
+    Current resident set size of the runner in KiB.
+    """
+    try:
+        with open("/proc/self/statm", "r", encoding="utf-8") as data:
+            pages = int(data.read().split()[1])
+    except (OSError, ValueError, IndexError):
+        return 0
+
+    return pages * os.sysconf("SC_PAGE_SIZE") // 1024
+
+
+def _send_ltproot(backend, ltproot: str) -> None:
+    """
+    Copy the synthetic LTPROOT on the backend target, in the same path.
+    """
+    data = io.BytesIO()
+    with tarfile.open(fileobj=data, mode="w:gz") as tar:
+        tar.add(ltproot, arcname=".")
+
+    data.seek(0)
+
+    root = shlex.quote(ltproot)
+    ret = backend.run_cmd_input(
+        f"mkdir -p {root} && tar xzf - -C {root}", data, 600)
+    if ret["returncode"] != 0:
+        raise RuntimeError(
+            f"Can't copy LTPROOT on {backend.target}: {ret['stdout']}")
+
+
+def _create_backend(name: str, ltproot: str, ssh: dict):
+    """
+    Create and start a backend. None is returned for local runs.
+    """
+    # libssh is needed only when running on remote targets
+    # pylint: disable=import-outside-toplevel
+    if name in ["local", "launcher"]:
+        return None
+
+    if name == "shell":
+        from ltp.backend import ShellBackend
+        backend = ShellBackend()
+        backend.start()
+        return backend
+
+    if name == "ssh":
+        from ltp.backend import SSHBackend
+
+        if not ssh or not ssh.get("host", None):
+            raise ValueError("ssh backend needs a target")
+
+        backend = SSHBackend(**ssh)
+        backend.start()
+        _send_ltproot(backend, ltproot)
+        return backend
+
+    raise ValueError(f"'{name}' backend is not supported")
+
+
+def run_case(ltproot: str,
+             suite: str,
+             decls: list,
+             backend_name: str,
+             workers: int = 1,
+             ssh: dict = None) -> dict:
+    """
+    Run a synthetic suite and measure the runner overhead.
+    :param ltproot: LTPROOT created by `create_ltproot`
+    :type ltproot: str
+    :param suite: name of the suite
+    :type suite: str
+    :param decls: runtest declarations of the suite
+    :type decls: list(str)
+    :param backend_name: "local", "launcher", "shell" or "ssh", where
+        "launcher" runs local tests spawned by the launcher process
+    :type backend_name: str
+    :param workers: number of tests running at the same time
+    :type workers: int
+    :param ssh: SSHBackend parameters, used by the "ssh" backend
+    :type ssh: dict
+    :returns: dict
+    """
+    launcher = None
+    if backend_name == "launcher":
+        launcher = LTPLauncher()
+        launcher.start()
+
+    backend = _create_backend(backend_name, ltproot, ssh)
+    try:
+        session = LTPSession(
+            backends=[backend] if backend else None,
+            launcher=launcher)
+
+        start = time.monotonic()
+        suites = session.run(suites=[suite], workers=workers)
+        wall = time.monotonic() - start
+    finally:
+        if backend_name == "ssh":
+            backend.run_cmd(f"rm -rf {shlex.quote(ltproot)}", 60)
+            backend.stop()
+
+        if launcher:
+            launcher.stop()
+
+    completed = sum(1 for test in suites[0].tests if test.completed)
+
+    with tempfile.TemporaryDirectory() as tmpdir:
+        start = time.monotonic()
+        export_to_json(session, os.path.join(tmpdir, "report.json"))
+        export = time.monotonic() - start
+
+    # tests commands don't run on the local host for remote backends
+    baseline = 0.0
+    if backend_name != "ssh":
+        baseline = _baseline(ltproot, decls) / max(1, workers)
+
+    tests = len(decls)
+
+    # overhead is negative when runner is faster than the commands loop,
+    # such as when tests run in parallel
+    return {
+        "suite": suite,
+        "backend": backend_name,
+        "workers": workers,
+        "tests": tests,
+        "completed": completed,
+        "wall_time": wall,
+        "baseline_time": baseline,
+        "time_per_test": wall / tests,
+        "overhead_per_test": (wall - baseline) / tests,
+        "throughput": tests / wall if wall else 0.0,
+        "export_time": export,
+        "rss_kb": _rss(),
+    }
+
+
+def run_benchmarks(backends: list = None,
+                   tests: int = 100,
+                   lines: int = 10000,
+                   workers: int = 1,
+                   ssh: dict = None) -> dict:
+    """
+    Run all the synthetic suites through the given backends.
+    :param backends: names of the backends. If None, "local" and "shell"
+        are used
+    :type backends: list(str)
+    :param tests: number of tests of the no-op suite
+    :type tests: int
+    :param lines: lines printed by each test of the high output suite
+    :type lines: int
+    :param workers: number of tests running at the same time
+    :type workers: int
+    :param ssh: SSHBackend parameters, used by the "ssh" backend
+    :type ssh: dict
+    :returns: dict
+    """
+    if tests < 1:
+        raise ValueError("tests must be at least 1")
+
+    if lines < 0:
+        raise ValueError("lines must be positive")
+
+    if workers < 1:
+        raise ValueError("workers must be at least 1")
+
+    backends = backends or ["local", "shell"]
+    for name in backends:
+        if name not in BACKENDS:
+            raise ValueError(f"'{name}' backend is not supported")
+
+    results = {
+        "python": platform.python_version(),
+        "machine": platform.machine(),
+        "kernel": platform.release(),
+        "cases": [],
+    }
+
+    environ = dict(os.environ)
+
+    with tempfile.TemporaryDirectory() as ltproot:
+        suites = create_ltproot(ltproot, tests, lines)
+
+        os.environ["LTPROOT"] = ltproot
+        os.environ["TMPDIR"] = ltproot
+        try:
+            for backend in backends:
+                for suite, decls in suites.items():
+                    results["cases"].append(run_case(
+                        ltproot,
+                        suite,
+                        decls,
+                        backend,
+                        workers=workers,
+                        ssh=ssh))
+        finally:
+            os.environ.clear()
+            os.environ.update(environ)
+
+    # peak memory can't be reset, so it's measured once for all the cases
+    results["max_rss_kb"] = \
+        resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+
+    return results
+
+
+def compare(results: dict, baseline: dict, threshold: float) -> list:
+    """
+    Compare the wall time per test of each case with a baseline run. The
+    overhead can't be compared, since it can be close to zero or negative.
+    :param results: results of `run_benchmarks`
+    :type results: dict
+    :param baseline: results of a previous `run_benchmarks`
+    :type baseline: dict
+    :param threshold: relative time increase which is a regression
+    :type threshold: float
+    :returns: list of strings describing the regressions
+    """
+    previous = {
+        (case["suite"], case["backend"], case["workers"]): case
+        for case in baseline.get("cases", [])
+    }
+
+    regressions = []
+    for case in results["cases"]:
+        key = (case["suite"], case["backend"], case["workers"])
+        old = previous.get(key, None)
+        if not old or not old.get("time_per_test", None):
+            continue
+
+        ratio = case["time_per_test"] / old["time_per_test"]
+        if ratio > 1 + threshold:
+            regressions.append(
+                f"{case['suite']} on {case['backend']}: time per test "
+                f"{old['time_per_test'] * 1000:.2f}ms -> "
+                f"{case['time_per_test'] * 1000:.2f}ms")
+
+    return regressions
+
+
+def main() -> None:
+    """
+    Main point for the benchmark script.
+    """
+    parser = argparse.ArgumentParser(description='runltp-ng benchmark')
+    parser.add_argument(
+        "--backends",
+        "-b",
+        type=str,
+        nargs="*",
+        default=["local", "shell"],
+        choices=BACKENDS,
+        help="backends used to run the suites (default: local shell)")
+    parser.add_argument(
+        "--tests",
+        "-n",
+        type=int,
+        default=100,
+        help="number of tests of the no-op suite (default: 100)")
+    parser.add_argument(
+        "--lines",
+        "-l",
+        type=int,
+        default=10000,
+        help="lines printed by each high output test (default: 10000)")
+    parser.add_argument(
+        "--workers",
+        "-w",
+        type=int,
+        default=1,
+        help="number of tests running at the same time (default: 1)")
+    parser.add_argument(
+        "--ssh-target",
+        type=str,
+        dest="ssh_target",
+        help="target of the ssh backend, in the user@host[:port] form")
+    parser.add_argument(
+        "--ssh-key-file",
+        type=str,
+        dest="ssh_key_file",
+        help="private key used to authenticate on the ssh target")
+    parser.add_argument(
+        "--output",
+        "-o",
+        type=str,
+        help="JSON file where results are written (default: stdout)")
+    parser.add_argument(
+        "--baseline",
+        type=str,
+        help="JSON results of a previous run. Exit status is 1 if time per "
+        "test increased more than the threshold")
+    parser.add_argument(
+        "--threshold",
+        type=float,
+        default=0.2,
+        help="relative time per test increase which is a regression "
+        "(default: 0.2)")
+
+    args = parser.parse_args()
+
+    ssh = None
+    if args.ssh_target:
+        user, _, address = args.ssh_target.rpartition("@")
+        host, _, port = address.partition(":")
+        ssh = dict(
+            user=user,
+            host=host,
+            port=int(port or 22),
+            key_file=args.ssh_key_file)
+
+    results = run_benchmarks(
+        backends=args.backends,
+        tests=args.tests,
+        lines=args.lines,
+        workers=args.workers,
+        ssh=ssh)
+
+    if args.output:
+        with open(args.output, "w", encoding="utf-8") as data:
+            json.dump(results, data, indent=4)
+    else:
+        json.dump(results, sys.stdout, indent=4)
+        print()
+
+    if args.baseline:
+        with open(args.baseline, "r", encoding="utf-8") as data:
+            baseline = json.load(data)
+
+        regressions = compare(results, baseline, args.threshold)
+        for regression in regressions:
+            print(f"Regression: {regression}", file=sys.stderr)
+
+        if regressions:
+            sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
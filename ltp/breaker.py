@@ -0,0 +1,254 @@
+"""
+.. module:: breaker
+    :platform: Linux
+    :synopsis: module that contains the targets circuit breaker
+
+.. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
+"""
+import logging
+import threading
+import subprocess
+
+
+class TargetAbortedError(Exception):
+    """
+    Raised when a test can't run because its target has been aborted.
+    """
+
+
+class _TargetState:
+    """
+    Health of a single target.
+    """
+
+    def __init__(self) -> None:
+        # health checks and resets of a target don't block other targets
+        self.lock = threading.Lock()
+        self.broken = 0
+        self.errors = 0
+        self.tests = 0
+        self.aborted = None
+
+
+class CircuitBreaker:
+    """
+    Circuit breaker stopping tests on targets which are badly broken, such
+    as targets whose root filesystem became read-only. A target trips when
+    too many consecutive tests are broken, when too many consecutive tests
+    can't be executed because of backend errors or when its health check
+    command fails. A target which tripped is reset, if its backend supports
+    it and its health check passes after reset. Otherwise, it's aborted and
+    its tests are not executed anymore.
+    """
+
+    ACTIONS = ["abort", "reset"]
+
+    def __init__(self,
+                 max_broken: int = 0,
+                 max_errors: int = 0,
+                 health_cmd: str = None,
+                 health_interval: int = 1,
+                 health_timeout: int = 60,
+                 action: str = "abort") -> None:
+        """
+        :param max_broken: number of consecutive broken tests tripping a
+            target. If 0, broken tests are not counted
+        :type max_broken: int
+        :param max_errors: number of consecutive backend errors tripping a
+            target. If 0, backend errors are not counted
+        :type max_errors: int
+        :param health_cmd: command checking the target health, which fails
+            when target is broken. If None, health is not checked
+        :type health_cmd: str
+        :param health_interval: number of tests completed on a target
+            between two health checks
+        :type health_interval: int
+        :param health_timeout: seconds before health check is considered
+            failed
+        :type health_timeout: int
+        :param action: "abort" to stop running tests on a target which
+            tripped, "reset" to reset it first
+        :type action: str
+        """
+        if max_broken is None or max_broken < 0:
+            raise ValueError("max_broken must be positive")
+
+        if max_errors is None or max_errors < 0:
+            raise ValueError("max_errors must be positive")
+
+        if not health_interval or health_interval < 1:
+            raise ValueError("health_interval must be greater than 0")
+
+        if not health_timeout or health_timeout < 1:
+            raise ValueError("health_timeout must be greater than 0")
+
+        if action not in self.ACTIONS:
+            raise ValueError(f"action must be one of {self.ACTIONS}")
+
+        self._logger = logging.getLogger("ltp.breaker")
+        self._max_broken = max_broken
+        self._max_errors = max_errors
+        self._health_cmd = health_cmd
+        self._health_interval = health_interval
+        self._health_timeout = health_timeout
+        self._action = action
+        self._lock = threading.Lock()
+        self._targets = {}
+
+    def __bool__(self) -> bool:
+        return bool(self._max_broken or self._max_errors or self._health_cmd)
+
+    @staticmethod
+    def _name(backend) -> str:
+        """
+        Name of the target used inside messages.
+        """
+        return backend.target if backend else "local"
+
+    def _state(self, backend) -> _TargetState:
+        """
+        State of the target of a backend. None is the local host.
+        """
+        with self._lock:
+            state = self._targets.get(backend, None)
+            if not state:
+                state = _TargetState()
+                self._targets[backend] = state
+
+            return state
+
+    def aborted(self, backend=None) -> str:
+        """
+        Reason why a target has been aborted. None if it's still running
+        tests.
+        :param backend: backend of the target. None for the local host
+        :type backend: Backend
+        :returns: str
+        """
+        state = self._state(backend)
+        with state.lock:
+            return state.aborted
+
+    def check(self, backend=None) -> None:
+        """
+        Check that a test can run on the target.
+        :param backend: backend of the target. None for the local host
+        :type backend: Backend
+        :raises: TargetAbortedError
+        """
+        reason = self.aborted(backend)
+        if reason:
+            raise TargetAbortedError(
+                f"{self._name(backend)} has been aborted: {reason}")
+
+    def _health_check(self, backend) -> str:
+        """
+        Run the health check command on the target.
+        :returns: reason of the failure or None if check passed
+        """
+        # pylint: disable=import-outside-toplevel
+        if backend:
+            from .backend import BackendError
+
+            try:
+                ret = backend.run_cmd(self._health_cmd, self._health_timeout)
+            except BackendError as err:
+                return f"health check error: {err}"
+
+            returncode = ret["returncode"]
+        else:
+            try:
+                returncode = subprocess.run(
+                    self._health_cmd,
+                    shell=True,
+                    stdout=subprocess.DEVNULL,
+                    stderr=subprocess.DEVNULL,
+                    timeout=self._health_timeout,
+                    check=False).returncode
+            except subprocess.TimeoutExpired:
+                return "health check timed out"
+
+        if returncode != 0:
+            return f"health check failed with {returncode}"
+
+        return None
+
+    def _reset(self, backend) -> bool:
+        """
+        Reset the target, checking its health once done.
+        :returns: True if target has been reset
+        """
+        # pylint: disable=import-outside-toplevel
+        if self._action != "reset" or not hasattr(backend, "reset"):
+            return False
+
+        from .backend import BackendError
+
+        self._logger.warning("Resetting %s", self._name(backend))
+
+        try:
+            backend.reset()
+        except BackendError as err:
+            self._logger.error("Can't reset %s: %s", self._name(backend), err)
+            return False
+
+        if self._health_cmd:
+            reason = self._health_check(backend)
+            if reason:
+                self._logger.error(
+                    "%s is broken after reset: %s",
+                    self._name(backend),
+                    reason)
+                return False
+
+        return True
+
+    def _trip(self, backend, state: _TargetState, reason: str) -> None:
+        """
+        Reset or abort a target which tripped.
+        """
+        self._logger.error("%s tripped: %s", self._name(backend), reason)
+
+        if self._reset(backend):
+            state.broken = 0
+            state.errors = 0
+            return
+
+        state.aborted = reason
+
+        self._logger.error(
+            "Tests won't run on %s anymore", self._name(backend))
+
+    def test_completed(self, test, backend=None) -> None:
+        """
+        Update the target health once a test has been executed. Tests which
+        didn't complete are counted as backend errors.
+        :param test: executed test
+        :type test: LTPTest
+        :param backend: backend of the target. None for the local host
+        :type backend: Backend
+        """
+        state = self._state(backend)
+        with state.lock:
+            if state.aborted:
+                return
+
+            if test.completed:
+                state.errors = 0
+                state.broken = state.broken + 1 if test.broken else 0
+            else:
+                state.errors += 1
+
+            state.tests += 1
+
+            reason = None
+            if self._max_errors and state.errors >= self._max_errors:
+                reason = f"{state.errors} consecutive backend errors"
+            elif self._max_broken and state.broken >= self._max_broken:
+                reason = f"{state.broken} consecutive broken tests"
+            elif self._health_cmd and \
+                    state.tests % self._health_interval == 0:
+                reason = self._health_check(backend)
+
+            if reason:
+                self._trip(backend, state, reason)
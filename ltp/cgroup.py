@@ -0,0 +1,631 @@
+"""
+.. module:: cgroup
+    :platform: Linux
+    :synopsis: module handling cgroup v2 accounting of the tests
+
+.. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
+"""
+import os
+import time
+import signal
+import logging
+import threading
+
+
+class CgroupError(Exception):
+    """
+    Raised when a cgroup can't be handled.
+    """
+
+
+def _cgroup2_mount() -> str:
+    """
+    Return the mount point of the cgroup v2 hierarchy. None if it's not
+    mounted.
+    """
+    try:
+        with open("/proc/self/mountinfo", "r", encoding='UTF-8') as data:
+            for line in data:
+                fields, _, fstype = line.partition(" - ")
+                if fstype.split(" ", 1)[0] == "cgroup2":
+                    return fields.split()[4]
+    except OSError:
+        pass
+
+    return None
+
+
+def _own_cgroup() -> str:
+    """
+    Return the cgroup v2 path of the current process.
+    """
+    try:
+        with open("/proc/self/cgroup", "r", encoding='UTF-8') as data:
+            for line in data:
+                if line.startswith("0::"):
+                    return line[3:].strip()
+    except OSError:
+        pass
+
+    return None
+
+
+def _read_keys(path: str) -> dict:
+    """
+    Read a flat keyed cgroup file, such as cpu.stat.
+    """
+    values = {}
+
+    with open(path, "r", encoding='UTF-8') as data:
+        for line in data:
+            key, _, value = line.partition(" ")
+            try:
+                values[key] = int(value)
+            except ValueError:
+                pass
+
+    return values
+
+
+class Cgroup:
+    """
+    A cgroup v2 where a single test runs.
+    """
+
+    def __init__(self, path: str, limits: dict = None) -> None:
+        """
+        :param path: path of the cgroup directory, which already exists
+        :type path: str
+        :param limits: resources limits of the cgroup, which are applied by
+            `apply_limits`. See CgroupTree
+        :type limits: dict
+        """
+        self._logger = logging.getLogger("ltp.cgroup")
+        self._path = path
+        self._limits = limits or {}
+
+    @property
+    def path(self) -> str:
+        """
+        Path of the cgroup directory.
+        :returns: str
+        """
+        return self._path
+
+    def _write(self, name: str, value: str) -> None:
+        """
+        Write a value inside a cgroup file.
+        """
+        try:
+            with open(os.path.join(self._path, name),
+                      "w", encoding='UTF-8') as data:
+                data.write(value)
+        except OSError as err:
+            raise CgroupError(
+                f"Can't write {name} of {self._path}: {err}") from err
+
+    def apply_limits(self) -> None:
+        """
+        Apply the resources limits to the cgroup.
+        :raises: CgroupError
+        """
+        memory = self._limits.get("memory", None)
+        if memory:
+            self._write("memory.max", str(memory))
+
+            # limit can't be bypassed by swapping memory out
+            if os.path.isfile(os.path.join(self._path, "memory.swap.max")):
+                self._write("memory.swap.max", "0")
+
+        cpu = self._limits.get("cpu", None)
+        if cpu:
+            period = 100000
+            self._write("cpu.max", f"{int(cpu * period)} {period}")
+
+        pids = self._limits.get("pids", None)
+        if pids:
+            self._write("pids.max", str(pids))
+
+    def open_procs(self) -> int:
+        """
+        Open the cgroup.procs file, so a spawned process can be moved
+        inside the cgroup by writing its pid, or "0" from the process.
+        :returns: file descriptor
+        """
+        return os.open(
+            os.path.join(self._path, "cgroup.procs"),
+            os.O_WRONLY | os.O_CLOEXEC)
+
+    def _populated(self) -> bool:
+        """
+        True if some process is still inside the cgroup.
+        """
+        try:
+            events = _read_keys(os.path.join(self._path, "cgroup.events"))
+        except OSError:
+            return False
+
+        return events.get("populated", 0) == 1
+
+    def kill(self) -> None:
+        """
+        Kill all the processes inside the cgroup, including the ones which
+        left the test process group.
+        """
+        try:
+            with open(os.path.join(self._path, "cgroup.kill"),
+                      "w", encoding='UTF-8') as data:
+                data.write("1")
+            return
+        except FileNotFoundError:
+            pass
+        except OSError as err:
+            self._logger.debug("%s: %s", self._path, err)
+
+        # kernels older than 5.14 don't have cgroup.kill
+        try:
+            with open(os.path.join(self._path, "cgroup.procs"),
+                      "r", encoding='UTF-8') as data:
+                pids = [int(pid) for pid in data.read().split()]
+        except OSError:
+            return
+
+        for pid in pids:
+            try:
+                os.kill(pid, signal.SIGKILL)
+            except ProcessLookupError:
+                pass
+
+    def stats(self) -> dict:
+        """
+        Read the resources used by the processes which ran inside the
+        cgroup. Only statistics of the available controllers are read.
+        :returns: dict
+        """
+        stats = {}
+
+        try:
+            cpu = _read_keys(os.path.join(self._path, "cpu.stat"))
+            stats["cpu_usage"] = cpu.get("usage_usec", 0) / 1000000
+            stats["cpu_user"] = cpu.get("user_usec", 0) / 1000000
+            stats["cpu_system"] = cpu.get("system_usec", 0) / 1000000
+        except OSError:
+            pass
+
+        try:
+            with open(os.path.join(self._path, "memory.peak"),
+                      "r", encoding='UTF-8') as data:
+                stats["memory_peak"] = int(data.read())
+        except (OSError, ValueError):
+            pass
+
+        try:
+            with open(os.path.join(self._path, "io.stat"),
+                      "r", encoding='UTF-8') as data:
+                io_stats = dict.fromkeys(
+                    ["rbytes", "wbytes", "rios", "wios"], 0)
+
+                # one line for each device: "8:0 rbytes=1 wbytes=2 ..."
+                for line in data:
+                    for field in line.split()[1:]:
+                        key, _, value = field.partition("=")
+                        if key in io_stats:
+                            io_stats[key] += int(value)
+
+                for key, value in io_stats.items():
+                    stats[f"io_{key}"] = value
+        except (OSError, ValueError):
+            pass
+
+        return stats
+
+    def violations(self) -> dict:
+        """
+        Limits which have been hit by the processes inside the cgroup:
+        "memory" counts processes killed by the OOM killer, "pids" counts
+        forks which failed and "cpu" counts periods where processes have
+        been throttled. Only limits which have been defined are checked.
+        :returns: dict
+        """
+        files = {
+            "memory": ("memory.events", "oom_kill"),
+            "pids": ("pids.events", "max"),
+            "cpu": ("cpu.stat", "nr_throttled"),
+        }
+
+        violations = {}
+        for limit, (fname, key) in files.items():
+            if not self._limits.get(limit, None):
+                continue
+
+            try:
+                count = _read_keys(os.path.join(self._path, fname)).get(key, 0)
+            except OSError:
+                continue
+
+            if count:
+                violations[limit] = count
+
+        return violations
+
+    def wait(self, timeout: float = 1) -> bool:
+        """
+        Wait for the processes inside the cgroup to exit, such as the ones
+        which have been killed.
+        :param timeout: time in seconds to wait for processes
+        :type timeout: float
+        :returns: True if cgroup is empty
+        """
+        deadline = time.monotonic() + timeout
+
+        while self._populated():
+            if time.monotonic() >= deadline:
+                return False
+
+            time.sleep(0.01)
+
+        return True
+
+    def remove(self) -> None:
+        """
+        Remove the cgroup, once its processes exited.
+        """
+        try:
+            os.rmdir(self._path)
+        except FileNotFoundError:
+            pass
+        except OSError as err:
+            self._logger.warning("Can't remove %s: %s", self._path, err)
+
+
+class CgroupTree:
+    """
+    The cgroup v2 subtree where tests cgroups are created. Each test runs
+    inside its own cgroup, so resources it used can be read once it
+    completed.
+    """
+
+    # controllers enabled for the tests cgroups, if available
+    CONTROLLERS = ["cpu", "memory", "io", "pids"]
+
+    def __init__(self,
+                 root: str,
+                 limits: dict = None,
+                 manage_root: bool = True) -> None:
+        """
+        :param root: cgroup directory where tests cgroups are created. It
+            must be writable and, to enable controllers, it must not
+            contain processes
+        :type root: str
+        :param limits: resources limits of each test: "memory" in bytes,
+            "cpu" as number of CPUs and "pids" as number of processes.
+            Missing limits are not applied
+        :type limits: dict
+        :param manage_root: if True, runner moves itself into a leaf cgroup
+            of root and it enables the controllers of root. Otherwise, only
+            the controllers which are already enabled inside root are used
+        :type manage_root: bool
+        """
+        if not root or not os.path.isdir(root):
+            raise ValueError("root must be a cgroup directory")
+
+        limits = {
+            key: value for key, value in (limits or {}).items() if value
+        }
+
+        for key, value in limits.items():
+            if key not in ["memory", "cpu", "pids"]:
+                raise ValueError(f"'{key}' limit is not supported")
+
+            if value < 0:
+                raise ValueError(f"'{key}' limit must be positive")
+
+        self._logger = logging.getLogger("ltp.cgroup")
+        self._root = root
+        self._limits = limits
+        self._manage_root = manage_root
+        self._path = None
+        self._runner = None
+        self._enabled = []
+        self._count = 0
+        self._lock = threading.Lock()
+
+    @staticmethod
+    def _delegated(path: str) -> bool:
+        """
+        True if cgroup has been delegated to the runner, so it can be
+        managed by the runner. Cgroups are delegated by systemd setting
+        their "delegate" extended attribute, or by giving them to the user.
+        """
+        for attr in ["trusted.delegate", "user.delegate"]:
+            try:
+                if os.getxattr(path, attr).strip() == b"1":
+                    return True
+            except OSError:
+                pass
+
+        try:
+            owner = os.stat(os.path.join(path, "cgroup.procs")).st_uid
+        except OSError:
+            return False
+
+        return os.geteuid() != 0 and owner == os.geteuid()
+
+    @classmethod
+    def discover(cls, limits: dict = None):
+        """
+        Return the tree of the current process cgroup, if cgroup v2 is
+        available and it can be written. Cgroup may belong to the service
+        manager or to a container, so runner moves itself into a leaf
+        cgroup, enabling controllers, only when cgroup has been delegated.
+        :param limits: resources limits of each test
+        :type limits: dict
+        :returns: CgroupTree or None
+        """
+        mount = _cgroup2_mount()
+        own = _own_cgroup()
+
+        if not mount or own is None:
+            return None
+
+        root = os.path.join(mount, own.lstrip("/"))
+        if not os.access(root, os.W_OK):
+            return None
+
+        return cls(root, limits=limits, manage_root=cls._delegated(root))
+
+    @property
+    def path(self) -> str:
+        """
+        Directory containing the tests cgroups. None if tree has not been
+        created.
+        :returns: str
+        """
+        return self._path
+
+    @property
+    def limits(self) -> dict:
+        """
+        Resources limits of each test.
+        :returns: dict
+        """
+        return self._limits
+
+    @property
+    def controllers(self) -> list:
+        """
+        Controllers enabled for the tests cgroups.
+        :returns: list(str)
+        """
+        if not self._path:
+            return []
+
+        try:
+            with open(os.path.join(self._path, "cgroup.subtree_control"),
+                      "r", encoding='UTF-8') as data:
+                return data.read().split()
+        except OSError:
+            return []
+
+    def _enable_controllers(self, path: str) -> list:
+        """
+        Enable the available controllers inside the subtree of path.
+        :returns: controllers which have been enabled
+        """
+        try:
+            with open(os.path.join(path, "cgroup.controllers"),
+                      "r", encoding='UTF-8') as data:
+                available = data.read().split()
+        except OSError:
+            return []
+
+        try:
+            with open(os.path.join(path, "cgroup.subtree_control"),
+                      "r", encoding='UTF-8') as data:
+                current = data.read().split()
+        except OSError:
+            current = []
+
+        enabled = []
+        for ctrl in self.CONTROLLERS:
+            if ctrl not in available or ctrl in current:
+                continue
+
+            try:
+                with open(os.path.join(path, "cgroup.subtree_control"),
+                          "w", encoding='UTF-8') as data:
+                    data.write(f"+{ctrl}")
+
+                enabled.append(ctrl)
+            except OSError as err:
+                self._logger.warning(
+                    "Can't enable %s controller inside %s: %s",
+                    ctrl, path, err)
+
+        return enabled
+
+    @staticmethod
+    def _runner_pids(procs: list) -> list:
+        """
+        Return the runner process and its children, such as the launcher,
+        among the given processes.
+        """
+        pids = [os.getpid()]
+
+        for pid in procs:
+            try:
+                with open(f"/proc/{pid}/stat", "r", encoding='UTF-8') as data:
+                    ppid = int(data.read().rpartition(")")[2].split()[1])
+            except (OSError, ValueError, IndexError):
+                continue
+
+            if ppid in pids:
+                pids.append(pid)
+
+        return [pid for pid in pids if pid in procs]
+
+    @staticmethod
+    def _move(pids: list, path: str) -> None:
+        """
+        Move processes inside the cgroup of path.
+        """
+        for pid in pids:
+            with open(os.path.join(path, "cgroup.procs"),
+                      "w", encoding='UTF-8') as data:
+                data.write(str(pid))
+
+    def _move_runner(self) -> None:
+        """
+        Move the runner into a leaf cgroup of root, when it's inside root.
+        Controllers can't be enabled inside non root cgroups containing
+        processes.
+        """
+        # the hierarchy root is the only cgroup without a type and it can
+        # contain processes
+        if not os.path.isfile(os.path.join(self._root, "cgroup.type")):
+            return
+
+        try:
+            with open(os.path.join(self._root, "cgroup.procs"),
+                      "r", encoding='UTF-8') as data:
+                procs = [int(pid) for pid in data.read().split()]
+        except (OSError, ValueError):
+            return
+
+        pids = self._runner_pids(procs)
+        if not pids:
+            return
+
+        path = os.path.join(self._root, f"runner.{os.getpid()}")
+
+        try:
+            os.makedirs(path, exist_ok=True)
+            self._move(pids, path)
+        except OSError as err:
+            self._logger.warning(
+                "Can't move runner inside %s: %s", path, err)
+            return
+
+        self._runner = path
+        self._logger.info("Runner moved inside %s", path)
+
+        if len(pids) < len(procs):
+            self._logger.warning(
+                "%s contains other processes, so controllers can't be "
+                "enabled. See --cgroup-root", self._root)
+
+    def _restore_runner(self) -> None:
+        """
+        Disable the controllers which have been enabled inside root and move
+        the runner back to root.
+        """
+        for ctrl in reversed(self._enabled):
+            try:
+                with open(os.path.join(self._root, "cgroup.subtree_control"),
+                          "w", encoding='UTF-8') as data:
+                    data.write(f"-{ctrl}")
+            except OSError as err:
+                self._logger.warning("Can't disable %s: %s", ctrl, err)
+
+        self._enabled = []
+
+        if not self._runner:
+            return
+
+        try:
+            with open(os.path.join(self._runner, "cgroup.procs"),
+                      "r", encoding='UTF-8') as data:
+                pids = [int(pid) for pid in data.read().split()]
+
+            self._move(pids, self._root)
+            os.rmdir(self._runner)
+        except (OSError, ValueError) as err:
+            self._logger.warning(
+                "Can't move runner back to %s: %s", self._root, err)
+
+        self._runner = None
+
+    def setup(self) -> None:
+        """
+        Create the cgroup containing the tests cgroups. If root is managed
+        and the runner is inside root, it's moved into a leaf cgroup of
+        root, so controllers can be enabled for the tests.
+        :raises: CgroupError
+        """
+        path = os.path.join(self._root, f"runltp-ng.{os.getpid()}")
+
+        if self._manage_root:
+            self._move_runner()
+
+        try:
+            os.makedirs(path, exist_ok=True)
+        except OSError as err:
+            self._restore_runner()
+            raise CgroupError(f"Can't create {path}: {err}") from err
+
+        if self._manage_root:
+            self._enabled = self._enable_controllers(self._root)
+
+        self._path = path
+        self._enable_controllers(self._path)
+
+        controllers = self.controllers
+
+        self._logger.info(
+            "Tests run inside %s (controllers: %s)",
+            self._path,
+            " ".join(controllers) or "none")
+
+        missing = [ctrl for ctrl in self._limits if ctrl not in controllers]
+        if missing:
+            self.cleanup()
+            raise CgroupError(
+                f"{' '.join(missing)} controllers are needed by limits, but "
+                f"they can't be enabled inside {path}")
+
+    def cleanup(self) -> None:
+        """
+        Remove the cgroup containing the tests cgroups.
+        """
+        if not self._path:
+            return
+
+        try:
+            os.rmdir(self._path)
+        except OSError as err:
+            self._logger.warning("Can't remove %s: %s", self._path, err)
+
+        self._path = None
+        self._restore_runner()
+
+    def create(self, name: str) -> Cgroup:
+        """
+        Create the cgroup of a test.
+        :param name: name of the test
+        :type name: str
+        :returns: Cgroup
+        :raises: CgroupError
+        """
+        if not self._path:
+            raise CgroupError("cgroup tree has not been created")
+
+        with self._lock:
+            self._count += 1
+            count = self._count
+
+        # tests can run more than once at the same time
+        path = os.path.join(self._path, f"{name}.{count}")
+
+        try:
+            os.mkdir(path)
+        except OSError as err:
+            raise CgroupError(f"Can't create {path}: {err}") from err
+
+        cgroup = Cgroup(path, limits=self._limits)
+        try:
+            cgroup.apply_limits()
+        except CgroupError:
+            cgroup.remove()
+            raise
+
+        return cgroup
@@ -0,0 +1,337 @@
+"""
+.. module:: compare
+    :platform: Linux
+    :synopsis: module that contains the sessions comparison
+
+.. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
+"""
+import sys
+import json
+import logging
+from .archive import LTPArchive
+from .archive import ArchiveError
+from .archive import is_archive
+from .archive import iter_json_report
+
+# statuses of a test across many runs are stored as a bitmask
+STATUSES = ["passed", "failed", "broken", "skipped"]
+_BITS = {status: 1 << i for i, status in enumerate(STATUSES)}
+
+# statuses of the tests which didn't pass
+FAILING = _BITS["failed"] | _BITS["broken"]
+PASSED = _BITS["passed"]
+
+# characters read to detect JSON lines reports
+SNIFF_SIZE = 65536
+
+
+def _statuses(mask: int) -> list:
+    """
+    Statuses of a bitmask.
+    """
+    return [status for status in STATUSES if mask & _BITS[status]]
+
+
+def _status(test: dict) -> str:
+    """
+    Status of a reported test: "broken", "failed", "passed" or "skipped".
+    """
+    if test.get("broken", 0):
+        return "broken"
+
+    if test.get("failed", 0):
+        return "failed"
+
+    if test.get("skipped", 0) and not test.get("passed", 0):
+        return "skipped"
+
+    return "passed"
+
+
+def _is_jsonl(path: str) -> bool:
+    """
+    True if file is a JSON lines report, which has a test on each line.
+    Only the beginning of the file is read, since JSON reports written on
+    a single line can be huge.
+    """
+    with open(path, "r", encoding="UTF-8") as data:
+        line = data.readline(SNIFF_SIZE)
+
+    # sessions without tests write empty JSON lines reports
+    if not line.strip():
+        return True
+
+    if len(line) == SNIFF_SIZE and not line.endswith("\n"):
+        # tests are written by JSONLReporter starting from their suite
+        return line.lstrip().startswith('{"suite"')
+
+    try:
+        test = json.loads(line)
+    except json.JSONDecodeError:
+        return False
+
+    return isinstance(test, dict) and "suite" in test
+
+
+def iter_results(path: str):
+    """
+    Iterate over the tests results of a JSON report, a JSON lines report or
+    a results archive. Reports are read one test at time and tests output
+    is never read.
+    :param path: path of the report
+    :type path: str
+    :returns: iterator over (suite name, test name, status, duration)
+    :raises: ValueError
+    """
+    try:
+        if is_archive(path):
+            with LTPArchive(path) as archive:
+                for suite, test in archive.tests():
+                    yield suite, test["name"], _status(test), \
+                        test.get("duration", None)
+        elif _is_jsonl(path):
+            with open(path, "r", encoding="UTF-8") as data:
+                for line in data:
+                    if not line.strip():
+                        continue
+
+                    test = json.loads(line)
+                    yield test["suite"], test["name"], _status(test), \
+                        test.get("duration", None)
+        else:
+            for kind, suite, test in iter_json_report(path):
+                if kind == "test":
+                    yield suite, test["name"], _status(test), \
+                        test.get("duration", None)
+    except (OSError, KeyError, json.JSONDecodeError, ArchiveError) as err:
+        raise ValueError(f"can't read results from {path}: {err}") from err
+
+
+class _Runs:
+    """
+    Statuses and durations of a test inside the baseline and the new
+    reports.
+    """
+
+    __slots__ = ["statuses", "durations", "counts"]
+
+    def __init__(self) -> None:
+        self.statuses = [0, 0]
+        self.durations = [0.0, 0.0]
+        self.counts = [0, 0]
+
+    def add(self, side: int, status: str, duration: float) -> None:
+        """
+        Add a run of the test.
+        """
+        self.statuses[side] |= _BITS[status]
+
+        if duration is not None:
+            self.durations[side] += duration
+            self.counts[side] += 1
+
+    def duration(self, side: int) -> float:
+        """
+        Average duration of the test. None if it's unknown.
+        """
+        if not self.counts[side]:
+            return None
+
+        return self.durations[side] / self.counts[side]
+
+
+class LTPComparison:
+    """
+    Comparison between the baseline reports and the new reports, such as
+    reports of the same tests running on two kernels. Many reports of both
+    sides are reruns of the same session, which are used to detect flaky
+    tests. Tests output is never read, so only a few bytes are kept for
+    each test, whatever is the size of the reports.
+    """
+
+    def __init__(self,
+                 threshold: float = 0.5,
+                 min_delta: float = 1.0) -> None:
+        """
+        :param threshold: relative increase of a test duration which is
+            reported as runtime regression, such as 0.5 for 50%
+        :type threshold: float
+        :param min_delta: seconds which must be added to a test duration
+            to report it as runtime regression, so short tests don't add
+            noise
+        :type min_delta: float
+        :raises: ValueError
+        """
+        if threshold is None or threshold < 0:
+            raise ValueError("threshold must be positive")
+
+        if min_delta is None or min_delta < 0:
+            raise ValueError("min_delta must be positive")
+
+        self._logger = logging.getLogger("ltp.compare")
+        self._threshold = threshold
+        self._min_delta = min_delta
+        self._tests = {}
+        self._reports = [0, 0]
+
+    def _add(self, path: str, side: int) -> None:
+        """
+        Add the results of a report to one side of the comparison.
+        """
+        self._logger.info("Reading results from %s", path)
+
+        for suite, name, status, duration in iter_results(path):
+            key = (sys.intern(suite), sys.intern(name))
+
+            runs = self._tests.get(key, None)
+            if runs is None:
+                runs = _Runs()
+                self._tests[key] = runs
+
+            runs.add(side, status, duration)
+
+        self._reports[side] += 1
+
+    def add_baseline(self, path: str) -> None:
+        """
+        Add a baseline report.
+        :param path: path of the JSON report, JSON lines report or archive
+        :type path: str
+        :raises: ValueError
+        """
+        self._add(path, 0)
+
+    def add_new(self, path: str) -> None:
+        """
+        Add a new report, which is compared with the baseline.
+        :param path: path of the JSON report, JSON lines report or archive
+        :type path: str
+        :raises: ValueError
+        """
+        self._add(path, 1)
+
+    @staticmethod
+    def _name(key: tuple) -> str:
+        """
+        Name of a test inside the results.
+        """
+        return f"{key[0]}:{key[1]}"
+
+    def results(self) -> dict:
+        """
+        Results of the comparison. Tests are sorted by suite and name:
+
+        - "new_failures": tests which always passed inside the baseline and
+          always failed inside the new reports
+        - "fixes": tests which always failed inside the baseline and always
+          passed inside the new reports
+        - "changed": tests which changed status in other ways, such as
+          passed tests which are now skipped
+        - "flaky": tests having different statuses across reruns
+        - "runtime_regressions": tests which became slower than threshold
+        - "added" and "removed": tests which are only inside the new
+          reports or only inside the baseline
+
+        :returns: dict
+        """
+        data = {
+            "reports": {
+                "baseline": self._reports[0],
+                "new": self._reports[1],
+            },
+            "tests": len(self._tests),
+            "new_failures": [],
+            "fixes": [],
+            "changed": [],
+            "flaky": [],
+            "runtime_regressions": [],
+            "added": [],
+            "removed": [],
+        }
+
+        for key in sorted(self._tests):
+            runs = self._tests[key]
+            name = self._name(key)
+            base, new = runs.statuses
+
+            if not base:
+                data["added"].append(name)
+                continue
+
+            if not new:
+                data["removed"].append(name)
+                continue
+
+            base_statuses = _statuses(base)
+            new_statuses = _statuses(new)
+
+            if len(base_statuses) > 1 or len(new_statuses) > 1:
+                data["flaky"].append({
+                    "test": name,
+                    "baseline": base_statuses,
+                    "new": new_statuses,
+                })
+            elif base != new:
+                change = {
+                    "test": name,
+                    "baseline": base_statuses[0],
+                    "new": new_statuses[0],
+                }
+
+                if base == PASSED and new & FAILING:
+                    data["new_failures"].append(change)
+                elif base & FAILING and new == PASSED:
+                    data["fixes"].append(change)
+                else:
+                    data["changed"].append(change)
+
+            base_time = runs.duration(0)
+            new_time = runs.duration(1)
+            if base_time is None or new_time is None:
+                continue
+
+            if new_time - base_time >= self._min_delta and \
+                    new_time > base_time * (1 + self._threshold):
+                data["runtime_regressions"].append({
+                    "test": name,
+                    "baseline": base_time,
+                    "new": new_time,
+                })
+
+        return data
+
+
+def compare_reports(baseline: list,
+                    new: list,
+                    threshold: float = 0.5,
+                    min_delta: float = 1.0) -> dict:
+    """
+    Compare the baseline reports with the new reports.
+    :param baseline: paths of the baseline reports
+    :type baseline: list(str)
+    :param new: paths of the new reports
+    :type new: list(str)
+    :param threshold: relative increase of a test duration which is
+        reported as runtime regression
+    :type threshold: float
+    :param min_delta: seconds which must be added to a test duration to
+        report it as runtime regression
+    :type min_delta: float
+    :returns: dict, see `LTPComparison.results`
+    :raises: ValueError
+    """
+    if not baseline:
+        raise ValueError("baseline reports are empty")
+
+    if not new:
+        raise ValueError("new reports are empty")
+
+    comparison = LTPComparison(threshold=threshold, min_delta=min_delta)
+
+    for path in baseline:
+        comparison.add_baseline(path)
+
+    for path in new:
+        comparison.add_new(path)
+
+    return comparison.results()
@@ -0,0 +1,162 @@
+"""
+.. module:: context
+    :platform: Linux
+    :synopsis: module that contains the tests execution context
+
+.. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
+"""
+import os
+import types
+import shutil
+import threading
+
+# characters which need a shell in order to be interpreted
+SHELL_CHARS = frozenset("|&;<>()$`\\\"' \t\n*?[]#~=%{}!^")
+
+# reserved words and builtins which exist inside the shell only, or behave
+# differently than the binaries having the same name
+SHELL_WORDS = frozenset([
+    "!", "{", "}", ".", ":", "alias", "break", "case", "cd", "command",
+    "continue", "do", "done", "elif", "else", "esac", "eval", "exec",
+    "exit", "export", "fi", "for", "if", "readonly", "return", "set",
+    "shift", "source", "then", "time", "times", "trap", "ulimit", "umask",
+    "unset", "until", "wait", "while",
+])
+
+
+class LTPContext:
+    """
+    Execution context shared by the tests of a session. LTPROOT, TMPDIR,
+    PATH and the environment of the tests are read only once, when context
+    is created, so they don't change while session is running. Paths of the
+    tests binaries are resolved the first time they are used.
+    """
+
+    def __init__(self, environ: dict = None) -> None:
+        """
+        :param environ: environment where context is read from. If None,
+            os.environ is used
+        :type environ: dict
+        """
+        if environ is None:
+            environ = os.environ
+
+        self._root_dir = environ.get(
+            "LTPROOT", os.path.dirname(os.path.abspath(__file__)))
+        self._testcases_dir = os.path.join(
+            self._root_dir, "testcases", "bin")
+        self._tmp_dir = environ.get("TMPDIR", None)
+
+        # PATH must be set in order to run bash scripts
+        self._path = \
+            f'{environ.get("PATH", os.defpath)}:{self._testcases_dir}'
+
+        env = {}
+        env["LTPROOT"] = self._root_dir
+        if self._tmp_dir:
+            env["TMPDIR"] = self._tmp_dir
+
+        # enable colors
+        env["LTP_COLORIZE_OUTPUT"] = environ.get("LTP_COLORIZE_OUTPUT", "y")
+        env["PATH"] = self._path
+
+        self._env = types.MappingProxyType(env)
+        self._lock = threading.Lock()
+        self._binaries = {}
+
+    @property
+    def root_dir(self) -> str:
+        """
+        LTPROOT directory, where tests run.
+        """
+        return self._root_dir
+
+    @property
+    def testcases_dir(self) -> str:
+        """
+        Directory containing the tests binaries.
+        """
+        return self._testcases_dir
+
+    @property
+    def tmp_dir(self) -> str:
+        """
+        Temporary directory of the tests. None if it's not defined.
+        """
+        return self._tmp_dir
+
+    @property
+    def path(self) -> str:
+        """
+        PATH of the tests.
+        """
+        return self._path
+
+    @property
+    def env(self) -> types.MappingProxyType:
+        """
+        Read-only environment of the tests.
+        """
+        return self._env
+
+    def _resolve(self, command: str) -> str:
+        """
+        Resolve the path of a command the same way the shell does.
+        """
+        if "/" in command:
+            path = os.path.normpath(os.path.join(self._root_dir, command))
+            if os.path.isfile(path) and os.access(path, os.X_OK):
+                return path
+
+            return None
+
+        return shutil.which(command, path=self._path)
+
+    def binary(self, command: str) -> str:
+        """
+        Path of the binary executing a command. Paths are resolved once and
+        cached, so they can be used by many tests.
+        :param command: command name or path relative to LTPROOT
+        :type command: str
+        :returns: binary path or None if command can't be executed without
+            a shell
+        """
+        with self._lock:
+            if command in self._binaries:
+                return self._binaries[command]
+
+        path = None
+        if command not in SHELL_WORDS:
+            path = self._resolve(command)
+
+        with self._lock:
+            return self._binaries.setdefault(command, path)
+
+    def argv(self, command: str, args: list) -> list:
+        """
+        Arguments vector executing a command without a shell.
+        :param command: command name or path relative to LTPROOT
+        :type command: str
+        :param args: command arguments
+        :type args: list(str)
+        :returns: list(str) or None if command needs a shell
+        """
+        if any(SHELL_CHARS.intersection(arg) for arg in args) or \
+                SHELL_CHARS.intersection(command):
+            return None
+
+        path = self.binary(command)
+        if not path:
+            return None
+
+        return [path] + list(args)
+
+    def needs_shell(self, command: str) -> None:
+        """
+        Mark a command which can't be executed directly, such as a script
+        without interpreter line, so it's executed by the shell from now on.
+        :param command: command name or path relative to LTPROOT
+        :type command: str
+        """
+        with self._lock:
+            self._binaries[command] = None
@@ -0,0 +1,174 @@
+"""
+.. module:: history
+    :platform: Linux
+    :synopsis: module that contains tests durations history
+
+.. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
+"""
+import json
+import logging
+
+
+class LTPHistory:
+    """
+    Durations of the tests which ran in previous sessions, read from JSON
+    reports. It's used to run longest tests first and to split tests in
+    shards which take about the same time to complete.
+    """
+
+    def __init__(self, default: float = 1.0) -> None:
+        """
+        :param default: duration in seconds of the tests which never ran,
+            used when history is empty
+        :type default: float
+        """
+        if default is None or default < 0:
+            raise ValueError("default must be a positive number")
+
+        self._logger = logging.getLogger("ltp.history")
+        self._durations = {}
+        self._default = default
+        self._average = default
+
+    def __len__(self) -> int:
+        return len(self._durations)
+
+    def load(self, path: str) -> None:
+        """
+        Load tests durations from a JSON report or a results archive.
+        Durations which are already loaded are replaced by the ones inside
+        the report. Tests output of archives is not read.
+        :param path: path of the JSON report or of the archive
+        :type path: str
+        :raises: ValueError
+        """
+        # archive imports the session, which imports the history
+        # pylint: disable=import-outside-toplevel
+        from .archive import LTPArchive
+        from .archive import ArchiveError
+        from .archive import is_archive
+
+        if not path:
+            raise ValueError("path is empty")
+
+        self._logger.info("Loading tests history from %s", path)
+
+        try:
+            if is_archive(path):
+                with LTPArchive(path) as archive:
+                    report = {"session": archive.session}
+            else:
+                with open(path, "r", encoding="UTF-8") as data:
+                    report = json.load(data)
+        except (OSError, json.JSONDecodeError, ArchiveError) as err:
+            raise ValueError(f"can't read history from {path}: {err}") \
+                from err
+
+        for suite in report.get("session", {}).get("suites", []):
+            for test in suite.get("tests", []):
+                duration = test.get("duration", None)
+                if duration is None:
+                    continue
+
+                self._durations[(suite["name"], test["name"])] = duration
+
+        # tests which never ran are given the average duration, which is
+        # computed once instead of each time it's requested
+        if self._durations:
+            self._average = \
+                sum(self._durations.values()) / len(self._durations)
+
+        self._logger.debug("loaded %d tests durations", len(self._durations))
+
+    def duration(self, suite: str, test: str) -> float:
+        """
+        Duration of a test. If test never ran, the average duration of the
+        known tests is returned.
+        :param suite: name of the testing suite
+        :type suite: str
+        :param test: name of the test
+        :type test: str
+        :returns: float
+        """
+        return self._durations.get((suite, test), self._average)
+
+    def sort(self, suite: str, tests: list) -> list:
+        """
+        Sort tests of a testing suite from the longest to the shortest one.
+        Tests having the same duration keep their order.
+        :param suite: name of the testing suite
+        :type suite: str
+        :param tests: tests of the suite
+        :type tests: list(LTPTest)
+        :returns: list(LTPTest)
+        """
+        return sorted(
+            tests,
+            key=lambda test: self.duration(suite, test.name),
+            reverse=True)
+
+    def shard(self,
+              suites: list,
+              index: int,
+              count: int,
+              select: callable = None) -> dict:
+        """
+        Split tests of the given suites in `count` shards taking about the
+        same time, assigning the longest tests first to the shard having the
+        lowest load. The result only depends on the history and the suites,
+        so every shard can be computed on a different host.
+        :param suites: testing suites to split
+        :type suites: list(LTPSuite)
+        :param index: index of the shard to return, starting from 0
+        :type index: int
+        :param count: number of shards
+        :type count: int
+        :param select: function called as select(suite name, test name),
+            returning False for the tests which are not split. If None, all
+            tests are split
+        :type select: callable
+        :returns: dict(suite name, list(LTPTest)) of the tests in the shard,
+            keeping suites order
+        """
+        if not count or count < 1:
+            raise ValueError("count must be greater than 0")
+
+        if index is None or index < 0 or index >= count:
+            raise ValueError(f"index must be between 0 and {count - 1}")
+
+        items = []
+        for suite in suites:
+            for test in suite.tests:
+                if select and not select(suite.name, test.name):
+                    continue
+
+                items.append((
+                    self.duration(suite.name, test.name),
+                    suite.name,
+                    test.name,
+                    test))
+
+        items.sort(key=lambda item: (-item[0], item[1], item[2]))
+
+        loads = [0.0] * count
+        selected = set()
+
+        for duration, _, _, test in items:
+            shard = loads.index(min(loads))
+            loads[shard] += duration
+
+            if shard == index:
+                selected.add(id(test))
+
+        self._logger.debug(
+            "shard %d/%d expected duration: %.2fs",
+            index + 1,
+            count,
+            loads[index])
+
+        shards = {}
+        for suite in suites:
+            shards[suite.name] = [
+                test for test in suite.tests if id(test) in selected]
+
+        return shards
@@ -5,10 +5,22 @@
 
 .. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
 """
+import os
+import re
+import time
+import shlex
+import hashlib
 import logging
+import tarfile
+import tempfile
+import platform
 import subprocess
+import urllib.error
+import urllib.request
 import argparse
 from argparse import Namespace
+from concurrent.futures import ThreadPoolExecutor
+from concurrent.futures import as_completed
 
 
 class InstallerError(Exception):
@@ -17,16 +29,206 @@ class InstallerError(Exception):
     """
 
 
+class ArtifactCache:
+    """
+    Cache of prebuilt LTP installations, stored as tarballs inside a shared
+    directory or served by a HTTP server. Tarballs are keyed by the LTP
+    revision and by the machine they have been built for.
+    """
+
+    def __init__(self, location: str) -> None:
+        """
+        :param location: directory or URL of the cache. Tarballs are stored
+            only inside directories
+        :type location: str
+        """
+        if not location:
+            raise ValueError("location is empty")
+
+        self._logger = logging.getLogger("ltp.installer.cache")
+        self._location = location
+        self._remote = "://" in location
+
+    @property
+    def location(self) -> str:
+        """
+        Directory or URL of the cache.
+        :returns: str
+        """
+        return self._location
+
+    @property
+    def remote(self) -> bool:
+        """
+        True if cache is served by a remote server and it's read only.
+        :returns: bool
+        """
+        return self._remote
+
+    @staticmethod
+    def key(revision: str, arch: str, m32: bool, install_dir: str) -> str:
+        """
+        Name of the tarball containing a prebuilt LTP. Installation
+        directory is part of the key, since it's the configure prefix.
+        :param revision: LTP commit
+        :type revision: str
+        :param arch: machine architecture
+        :type arch: str
+        :param m32: True if LTP has been built with 32bit support
+        :type m32: bool
+        :param install_dir: LTP installation directory
+        :type install_dir: str
+        :returns: str
+        """
+        prefix = hashlib.sha1(
+            os.path.abspath(install_dir).encode()).hexdigest()[:8]
+        m32_suffix = "-m32" if m32 else ""
+
+        return f"ltp-{revision}-{arch}{m32_suffix}-{prefix}.tar.gz"
+
+    @staticmethod
+    def _extract(tar: tarfile.TarFile, install_dir: str) -> None:
+        """
+        Extract the tarball inside the installation directory.
+        """
+        os.makedirs(install_dir, exist_ok=True)
+
+        # pylint: disable=unexpected-keyword-arg
+        if hasattr(tarfile, "tar_filter"):
+            tar.extractall(install_dir, filter="tar")
+        else:
+            tar.extractall(install_dir)
+
+    def open(self, key: str):
+        """
+        Open a tarball for reading. Remote tarballs are read while they are
+        downloaded.
+        :param key: tarball name returned by `key`
+        :type key: str
+        :returns: binary file object or None if tarball is not available
+        :raises: InstallerError
+        """
+        try:
+            if self._remote:
+                url = f"{self._location.rstrip('/')}/{key}"
+                return urllib.request.urlopen(url)
+
+            path = os.path.join(self._location, key)
+            if not os.path.isfile(path):
+                return None
+
+            return open(path, "rb")
+        except urllib.error.HTTPError as err:
+            if err.code == 404:
+                return None
+
+            raise InstallerError(f"Can't download {key}: {err}") from err
+        except OSError as err:
+            raise InstallerError(f"Can't open {key}: {err}") from err
+
+    def fetch(self, key: str, install_dir: str) -> bool:
+        """
+        Extract a prebuilt LTP inside the installation directory.
+        :param key: tarball name returned by `key`
+        :type key: str
+        :param install_dir: LTP installation directory
+        :type install_dir: str
+        :returns: False if tarball is not available
+        :raises: InstallerError
+        """
+        data = self.open(key)
+        if not data:
+            self._logger.info("%s is not cached", key)
+            return False
+
+        try:
+            with data:
+                with tarfile.open(fileobj=data, mode="r|gz") as tar:
+                    self._extract(tar, install_dir)
+        except (OSError, tarfile.TarError) as err:
+            raise InstallerError(f"Can't extract {key}: {err}") from err
+
+        self._logger.info("%s extracted inside %s", key, install_dir)
+
+        return True
+
+    def store(self, key: str, install_dir: str) -> bool:
+        """
+        Store the LTP installation inside the cache.
+        :param key: tarball name returned by `key`
+        :type key: str
+        :param install_dir: LTP installation directory
+        :type install_dir: str
+        :returns: True if tarball has been stored
+        """
+        if self._remote:
+            self._logger.info("Remote caches are read only")
+            return False
+
+        path = os.path.join(self._location, key)
+
+        try:
+            os.makedirs(self._location, exist_ok=True)
+
+            # other hosts can read the cache while tarball is written
+            fd, tmp_path = tempfile.mkstemp(dir=self._location)
+            try:
+                with os.fdopen(fd, "wb") as data:
+                    with tarfile.open(fileobj=data, mode="w:gz") as tar:
+                        tar.add(install_dir, arcname=".")
+
+                os.chmod(tmp_path, 0o644)
+                os.replace(tmp_path, path)
+            except BaseException:
+                os.remove(tmp_path)
+                raise
+        except (OSError, tarfile.TarError) as err:
+            self._logger.warning("Can't store %s: %s", key, err)
+            return False
+
+        self._logger.info("%s stored inside the cache", key)
+
+        return True
+
+
 class Installer:
     """
     A generic LTP installer that should be inherited to create a specific
     distro LTP installer.
     """
 
-    def __init__(self) -> None:
+    # packages metadata younger than this (in seconds) are not refreshed
+    METADATA_MAX_AGE = 3600
+
+    def __init__(self, backend=None) -> None:
+        """
+        :param backend: backend where commands are executed. If None,
+            commands are executed on the local host
+        :type backend: Backend
+        """
         self._logger = logging.getLogger("ltp.installer")
+        self._backend = backend
         self._logger.debug("initialized installer for %s", self.distro_id)
 
+    @property
+    def backend(self):
+        """
+        Backend where commands are executed. None for the local host.
+        :returns: Backend
+        """
+        return self._backend
+
+    @property
+    def machine(self) -> str:
+        """
+        Architecture of the machine where LTP is installed.
+        :returns: str
+        """
+        if not self._backend:
+            return platform.machine()
+
+        return self._get_output("uname -m")
+
     @property
     def distro_id(self) -> str:
         """
@@ -78,12 +280,58 @@ class Installer:
         """
         raise NotImplementedError()
 
+    @property
+    def query_cmd(self) -> str:
+        """
+        Command exiting with zero when the package inside the "$pkg" shell
+        variable is installed.
+        """
+        raise NotImplementedError()
+
+    @property
+    def metadata_dir(self) -> str:
+        """
+        Directory updated by the cache refresh command. If None, cache is
+        always refreshed.
+        """
+        return None
+
+    def _run_backend_cmd(self, cmd: str, cwd: str = None) -> set:
+        """
+        Run a command on the backend.
+        :returns: couple of (int, str) defining exit status and stdout
+        """
+        # libssh is needed only when installing on remote targets
+        # pylint: disable=import-outside-toplevel
+        from ltp.backend import BackendError
+
+        if cwd:
+            cmd = f"cd {shlex.quote(cwd)} && {cmd}"
+
+        try:
+            ret = self._backend.run_cmd(cmd, 0)
+        except BackendError as err:
+            raise InstallerError(
+                f"'{cmd}' failed on {self._backend.target}: {err}") from err
+
+        return ret["returncode"], ret["stdout"]
+
     def _run_cmd(self, cmd: str, cwd: str = None, raise_err=True) -> None:
         """
         Run a command inside the shell
         """
         self._logger.info("Running command '%s'", cmd)
 
+        if self._backend:
+            returncode, stdout = self._run_backend_cmd(cmd, cwd)
+            for line in stdout.splitlines():
+                self._logger.info(line)
+
+            if raise_err and returncode != 0:
+                raise InstallerError(f"'{cmd}' return code: {returncode}")
+
+            return
+
         with subprocess.Popen(
                 cmd,
                 stdout=subprocess.PIPE,
@@ -103,33 +351,213 @@ class Installer:
         if raise_err and proc.returncode != 0:
             raise InstallerError(f"'{cmd}' return code: {proc.returncode}")
 
-    def _clone_repo(self, url: str, repo_dir: str) -> None:
+    def _get_output(self, cmd: str, cwd: str = None) -> str:
         """
-        Run LTP installation from Git repository.
+        Run a command inside the shell and return its stdout. None is
+        returned if command failed.
+        """
+        self._logger.info("Running command '%s'", cmd)
+
+        if self._backend:
+            returncode, stdout = self._run_backend_cmd(cmd, cwd)
+            if returncode != 0:
+                return None
+
+            return stdout.strip()
+
+        proc = subprocess.run(
+            cmd,
+            stdout=subprocess.PIPE,
+            stderr=subprocess.DEVNULL,
+            cwd=cwd,
+            shell=True,
+            check=False,
+            universal_newlines=True)
+
+        if proc.returncode != 0:
+            return None
+
+        return proc.stdout.strip()
+
+    def _missing_pkgs(self, pkgs: list) -> list:
+        """
+        Return the packages which are not installed, using a single query
+        for all of them. If query fails, all packages are returned.
         """
-        self._logger.info("Cloning repository..")
-        self._run_cmd(f"git clone --depth=1 {url} {repo_dir}")
-        self._logger.info("Cloning completed")
+        names = " ".join(shlex.quote(pkg) for pkg in pkgs)
+        output = self._get_output(
+            f"for pkg in {names}; do "
+            f"{{ {self.query_cmd}; }} >/dev/null 2>&1 || echo \"$pkg\"; "
+            "done")
+
+        if output is None:
+            return pkgs
 
-    def _install_from_src(self, repo_dir: str, install_dir: str) -> None:
+        missing = output.splitlines()
+
+        return [pkg for pkg in pkgs if pkg in missing]
+
+    def _metadata_fresh(self) -> bool:
         """
-        Run LTP installation from Git repository.
+        True if packages metadata have been refreshed recently.
+        """
+        if not self.metadata_dir:
+            return False
+
+        if self._backend:
+            return self._backend_metadata_fresh()
+
+        try:
+            # refresh replaces the repositories entries inside the directory
+            mtime = max([os.path.getmtime(self.metadata_dir)] + [
+                entry.stat().st_mtime
+                for entry in os.scandir(self.metadata_dir)
+            ])
+        except (OSError, ValueError):
+            return False
+
+        return time.time() - mtime < self.METADATA_MAX_AGE
+
+    def _backend_metadata_fresh(self) -> bool:
+        """
+        True if packages metadata of the backend have been refreshed
+        recently. Target clock is read together with the metadata times,
+        since it can differ from the host one.
+        """
+        path = shlex.quote(self.metadata_dir)
+        output = self._get_output(
+            f"date +%s; stat -c %Y {path} {path}/* 2>/dev/null; true")
+        if not output:
+            return False
+
+        try:
+            now, *mtimes = [int(value) for value in output.split()]
+            mtime = max(mtimes)
+        except ValueError:
+            return False
+
+        return now - mtime < self.METADATA_MAX_AGE
+
+    def _install_git(self) -> None:
+        """
+        Install git alone, so revisions can be resolved before installing
+        the other requirements.
+        """
+        if not self._missing_pkgs(["git"]):
+            return
+
+        if not self._metadata_fresh():
+            self._run_cmd(self.refresh_cmd, raise_err=False)
+
+        self._run_cmd(f"{self.install_cmd} git", raise_err=False)
+
+    def _resolve_revision(self, url: str, revision: str = None) -> str:
+        """
+        Return the full commit of a remote repository revision, such as a
+        branch, a tag or a commit, without cloning it. If revision is None,
+        the commit of the repository HEAD is returned. None is returned if
+        revision can't be resolved, such as abbreviated commits.
+        """
+        if revision and re.fullmatch(r"[0-9a-f]{40}|[0-9a-f]{64}", revision):
+            return revision
+
+        output = self._get_output(
+            f"git ls-remote {shlex.quote(url)} "
+            f"{shlex.quote(revision or 'HEAD')}")
+        if not output:
+            return None
+
+        refs = {}
+        for line in output.splitlines():
+            fields = line.split()
+            if fields:
+                refs.setdefault(fields[1] if len(fields) > 1 else None,
+                                fields[0])
+
+        name = revision or "HEAD"
+
+        # same order used by git to resolve the fetched revision, where
+        # annotated tags are resolved into the commit they point to
+        for ref in [name, f"refs/tags/{name}^{{}}", f"refs/tags/{name}",
+                    f"refs/heads/{name}"]:
+            if ref in refs:
+                return refs[ref]
+
+        if len(refs) == 1:
+            return next(iter(refs.values()))
+
+        return None
+
+    def _clone_repo(self,
+                    url: str,
+                    repo_dir: str,
+                    revision: str = None) -> None:
+        """
+        Clone the LTP repository, fetching the given revision only. If
+        repository has been already cloned, it's updated, so objects of
+        the previous builds can be reused.
+        """
+        git_dir = os.path.join(repo_dir, ".git")
+        repo = shlex.quote(repo_dir)
+
+        if not revision and not os.path.isdir(git_dir):
+            self._logger.info("Cloning repository..")
+            self._run_cmd(
+                "git clone --depth=1 --single-branch --no-tags "
+                f"{shlex.quote(url)} {repo}")
+            self._logger.info("Cloning completed")
+            return
+
+        self._logger.info("Fetching repository..")
+
+        if not os.path.isdir(git_dir):
+            self._run_cmd(f"git init -q {repo}")
+
+        self._run_cmd(
+            f"git -C {repo} fetch --depth=1 --no-tags {shlex.quote(url)} "
+            f"{shlex.quote(revision or 'HEAD')}")
+        self._run_cmd(f"git -C {repo} checkout -q --force FETCH_HEAD")
+
+        self._logger.info("Fetching completed")
+
+    def _install_from_src(self,
+                          repo_dir: str,
+                          install_dir: str,
+                          ccache: bool = False,
+                          destdir: str = None) -> None:
+        """
+        Run LTP installation from Git repository. If destdir is given, LTP
+        is installed inside destdir, but it runs from install_dir.
         """
         self._logger.info("Compiling sources")
 
-        cpus = subprocess.check_output(
-            ['getconf', '_NPROCESSORS_ONLN']).rstrip().decode("utf-8")
+        # CPUs which can be used by the current process
+        cpus = len(os.sched_getaffinity(0))
+
+        configure = f"./configure --prefix={shlex.quote(install_dir)}"
+        if ccache:
+            configure += " CC='ccache gcc'"
 
         self._run_cmd("make autotools", repo_dir)
-        self._run_cmd("./configure --prefix=" + install_dir, repo_dir)
+        self._run_cmd(configure, repo_dir)
         self._run_cmd(f"make -j{cpus}", repo_dir)
-        self._run_cmd("make install", repo_dir)
+        if destdir:
+            self._run_cmd(
+                f"make install DESTDIR={shlex.quote(destdir)}", repo_dir)
+        else:
+            self._run_cmd("make install", repo_dir)
 
         self._logger.info("Compiling completed")
 
-    def _install_requirements(self, m32_support: bool) -> None:
+    def _install_requirements(self,
+                              m32_support: bool,
+                              build: bool = True,
+                              ccache: bool = False) -> None:
         """
         Install requirements for LTP installation according with Linux distro.
+        If build is False, only packages needed to run LTP are installed.
+        Packages which are already installed are skipped and the missing ones
+        are installed with a single transaction.
         """
         self._logger.info("Installing requirements")
 
@@ -138,12 +566,26 @@ class Installer:
 
         pkgs = []
 
-        pkgs.extend(self.get_build_pkgs(m32_support))
+        if build:
+            pkgs.extend(self.get_build_pkgs(m32_support))
+            pkgs.extend(self.get_libs_pkgs(m32_support))
+            if ccache:
+                pkgs.append("ccache")
+
         pkgs.extend(self.get_runtime_pkgs(m32_support))
-        pkgs.extend(self.get_libs_pkgs(m32_support))
         pkgs.extend(self.get_tools_pkgs())
 
-        self._run_cmd(self.refresh_cmd, raise_err=False)
+        pkgs = self._missing_pkgs(list(dict.fromkeys(pkgs)))
+        if not pkgs:
+            self._logger.info("Requirements are already installed")
+            return
+
+        # 32bit setup might have added repositories
+        if m32_support or not self._metadata_fresh():
+            self._run_cmd(self.refresh_cmd, raise_err=False)
+        else:
+            self._logger.info("Packages metadata are up to date")
+
         self._run_cmd(f"{self.install_cmd} {' '.join(pkgs)}")
 
         self._logger.info("Installation completed")
@@ -152,7 +594,10 @@ class Installer:
                 m32_support: bool,
                 url: str,
                 repo_dir: str,
-                install_dir: str) -> None:
+                install_dir: str,
+                revision: str = None,
+                artifacts: str = None,
+                ccache: bool = False) -> None:
         """
         Run LTP installation from Git repository.
         :param m32_support: If True, 32bit support will be installed.
@@ -163,6 +608,15 @@ class Installer:
         :type repo_dir: str
         :param install_dir: LTP installation directory.
         :type install_dir: str
+        :param revision: commit to install. If None, repository HEAD is
+            installed
+        :type revision: str
+        :param artifacts: directory or URL of the prebuilt LTP cache. If
+            the revision has been already built, it's extracted instead of
+            being compiled. New builds are stored inside cache directories
+        :type artifacts: str
+        :param ccache: if True, LTP is compiled using ccache
+        :type ccache: bool
         :raises: InstallerError
         """
         if not url:
@@ -174,9 +628,169 @@ class Installer:
         if not install_dir:
             raise ValueError("install_dir is empty")
 
-        self._install_requirements(m32_support)
-        self._clone_repo(url, repo_dir)
-        self._install_from_src(repo_dir, install_dir)
+        cache = ArtifactCache(artifacts) if artifacts else None
+        arch = platform.machine()
+
+        if cache:
+            # builds are stored using their full commit, so revision is
+            # resolved the same way before looking for it. git is installed
+            # first, since it's not available on fresh systems
+            self._install_git()
+
+            commit = self._resolve_revision(url, revision)
+            if commit:
+                key = cache.key(commit, arch, m32_support, install_dir)
+                if cache.fetch(key, install_dir):
+                    self._install_requirements(m32_support, build=False)
+                    return
+
+        self._install_requirements(m32_support, ccache=ccache)
+        self._clone_repo(url, repo_dir, revision)
+        self._install_from_src(repo_dir, install_dir, ccache)
+
+        if cache:
+            revision = self._get_output(
+                f"git -C {shlex.quote(repo_dir)} rev-parse HEAD")
+            if revision:
+                cache.store(
+                    cache.key(revision, arch, m32_support, install_dir),
+                    install_dir)
+
+    def build(self,
+              m32_support: bool,
+              url: str,
+              repo_dir: str,
+              install_dir: str,
+              cache: ArtifactCache,
+              revision: str = None,
+              ccache: bool = False) -> str:
+        """
+        Build LTP on the local host and store it inside the cache, without
+        installing it. If revision has been already built, nothing is done.
+        :param m32_support: If True, 32bit support will be installed.
+        :type m32_support: bool
+        :param url: url of the git repository.
+        :type url: str
+        :param repo_dir: repository output directory.
+        :type repo_dir: str
+        :param install_dir: directory where LTP will be installed.
+        :type install_dir: str
+        :param cache: cache where LTP is stored
+        :type cache: ArtifactCache
+        :param revision: commit to build. If None, repository HEAD is built
+        :type revision: str
+        :param ccache: if True, LTP is compiled using ccache
+        :type ccache: bool
+        :returns: key of the tarball inside the cache
+        :raises: InstallerError
+        """
+        if not url:
+            raise ValueError("URL is empty")
+
+        if not repo_dir:
+            raise ValueError("Repository directory is empty")
+
+        if not install_dir:
+            raise ValueError("Install directory is empty")
+
+        if self._backend:
+            raise InstallerError("LTP can be built on the local host only")
+
+        arch = platform.machine()
+
+        # revision can't be resolved before git is installed, so in that
+        # case it's built as a new one
+        commit = self._resolve_revision(url, revision)
+        if commit:
+            key = cache.key(commit, arch, m32_support, install_dir)
+            data = cache.open(key)
+            if data:
+                data.close()
+                self._logger.info("%s has been already built", key)
+                return key
+
+        if cache.remote:
+            raise InstallerError(
+                f"LTP {revision or 'HEAD'} is not available inside "
+                f"{cache.location}")
+
+        self._install_requirements(m32_support, ccache=ccache)
+        self._clone_repo(url, repo_dir, revision)
+
+        revision = self._get_output(
+            f"git -C {shlex.quote(repo_dir)} rev-parse HEAD")
+        if not revision:
+            raise InstallerError("Can't read the LTP revision")
+
+        key = cache.key(revision, arch, m32_support, install_dir)
+
+        with tempfile.TemporaryDirectory() as destdir:
+            self._install_from_src(repo_dir, install_dir, ccache, destdir)
+
+            tree = os.path.join(
+                destdir,
+                os.path.abspath(install_dir).lstrip("/"))
+
+            if not cache.store(key, tree):
+                raise InstallerError(
+                    f"Can't store {key} inside {cache.location}")
+
+        return key
+
+    def install_prebuilt(self,
+                         m32_support: bool,
+                         cache: ArtifactCache,
+                         key: str,
+                         install_dir: str) -> None:
+        """
+        Install the runtime requirements and a LTP tarball built by `build`.
+        On a backend, the tarball is streamed to the target over a single
+        compressed channel, so target doesn't need the build toolchain.
+        :param m32_support: If True, 32bit support will be installed.
+        :type m32_support: bool
+        :param cache: cache where LTP is stored
+        :type cache: ArtifactCache
+        :param key: key of the tarball inside the cache
+        :type key: str
+        :param install_dir: LTP installation directory.
+        :type install_dir: str
+        :raises: InstallerError
+        """
+        self._install_requirements(m32_support, build=False)
+
+        if not self._backend:
+            if not cache.fetch(key, install_dir):
+                raise InstallerError(f"{key} is not available")
+            return
+
+        # libssh is needed only when installing on remote targets
+        # pylint: disable=import-outside-toplevel
+        from ltp.backend import BackendError
+
+        data = cache.open(key)
+        if not data:
+            raise InstallerError(f"{key} is not available")
+
+        target = self._backend.target
+        inst_dir = shlex.quote(install_dir)
+
+        self._logger.info("Sending %s to %s", key, target)
+
+        try:
+            with data:
+                ret = self._backend.run_cmd_input(
+                    f"mkdir -p {inst_dir} && tar xzf - -C {inst_dir}",
+                    data,
+                    0)
+        except (OSError, BackendError) as err:
+            raise InstallerError(
+                f"Can't send {key} to {target}: {err}") from err
+
+        if ret["returncode"] != 0:
+            raise InstallerError(
+                f"Can't extract {key} on {target}: {ret['stdout']}")
+
+        self._logger.info("%s extracted on %s", key, target)
 
 
 class OpenSUSEInstaller(Installer):
@@ -243,6 +857,14 @@ class OpenSUSEInstaller(Installer):
     def install_cmd(self) -> str:
         return "zypper --non-interactive --ignore-unknown install"
 
+    @property
+    def query_cmd(self) -> str:
+        return 'rpm -q --whatprovides "$pkg"'
+
+    @property
+    def metadata_dir(self) -> str:
+        return "/var/cache/zypp/raw"
+
 
 class SLESInstaller(OpenSUSEInstaller):
     """
@@ -266,10 +888,10 @@ class DebianInstaller(Installer):
     def setup_32bit(self) -> None:
         self._logger.info("adding i386 architecture support")
 
-        proc = subprocess.run(
-            ['dpkg', '--add-architecture', 'i386'], check=True)
-        if proc.returncode != 0:
-            raise InstallerError("Can't add i386 support on debian")
+        try:
+            self._run_cmd("dpkg --add-architecture i386")
+        except InstallerError as err:
+            raise InstallerError("Can't add i386 support on debian") from err
 
     def get_build_pkgs(self, m32: bool) -> list:
         pkgs = [
@@ -299,8 +921,10 @@ class DebianInstaller(Installer):
             "xfsprogs",
         ]
 
-        arch = subprocess.check_output(
-            ['dpkg', '--print-architecture']).rstrip().decode("utf-8")
+        arch = self._get_output("dpkg --print-architecture")
+        if not arch:
+            raise InstallerError("Can't read debian architecture")
+
         pkgs.append(f"linux-headers-{arch}")
 
         return pkgs
@@ -334,6 +958,15 @@ class DebianInstaller(Installer):
         cmd += "apt-get -y --no-install-recommends install"
         return cmd
 
+    @property
+    def query_cmd(self) -> str:
+        return "dpkg-query -W -f='${db:Status-Status}' \"$pkg\" | " \
+            "grep -qx installed"
+
+    @property
+    def metadata_dir(self) -> str:
+        return "/var/lib/apt/lists"
+
 
 class UbuntuInstaller(DebianInstaller):
     """
@@ -414,6 +1047,14 @@ class AlpineInstaller(Installer):
     def install_cmd(self) -> str:
         return "apk add"
 
+    @property
+    def query_cmd(self) -> str:
+        return 'apk info -e "$pkg"'
+
+    @property
+    def metadata_dir(self) -> str:
+        return "/var/cache/apk"
+
 
 class FedoraInstaller(Installer):
     """
@@ -468,12 +1109,20 @@ class FedoraInstaller(Installer):
 
     @property
     def refresh_cmd(self) -> str:
-        return "yum update -y"
+        return "yum makecache -y"
 
     @property
     def install_cmd(self) -> str:
         return "yum install -y"
 
+    @property
+    def query_cmd(self) -> str:
+        return 'rpm -q --whatprovides "$pkg"'
+
+    @property
+    def metadata_dir(self) -> str:
+        return "/var/cache/dnf"
+
 
 INSTALLERS = [
     OpenSUSEInstaller(),
@@ -485,18 +1134,30 @@ INSTALLERS = [
 ]
 
 
-def get_distro() -> str:
+def get_distro(backend=None) -> str:
     """
     Return the current distro name.
+    :param backend: if given, distro of the backend target is returned
+    :type backend: Backend
     :returns: str
     """
     distro_id = ""
 
-    with open("/etc/os-release", "r", encoding='UTF-8') as data:
-        for line in data:
-            if line.startswith("ID="):
-                distro_id = line
-                break
+    if backend:
+        ret = backend.run_cmd("cat /etc/os-release", 60)
+        if ret["returncode"] != 0:
+            raise InstallerError(
+                f"Can't read os-release on {backend.target}")
+
+        lines = ret["stdout"].splitlines()
+    else:
+        with open("/etc/os-release", "r", encoding='UTF-8') as data:
+            lines = data.readlines()
+
+    for line in lines:
+        if line.startswith("ID="):
+            distro_id = line
+            break
 
     name = ""
     if distro_id:
@@ -505,18 +1166,20 @@ def get_distro() -> str:
     return name
 
 
-def get_installer(distro_id: str = None) -> Installer:
+def get_installer(distro_id: str = None, backend=None) -> Installer:
     """
     Return the proper installer according with distro ID. If distro ID is None,
     the installer for current distro will be returned.
     :param distro_id: name of the distro
     :type distro_id: str
+    :param backend: if given, installer runs commands on the backend
+    :type backend: Backend
     """
     handler = None
     distro = distro_id
 
     if not distro:
-        distro = get_distro()
+        distro = get_distro(backend)
 
     for item in INSTALLERS:
         if item.distro_id in distro:
@@ -526,9 +1189,103 @@ def get_installer(distro_id: str = None) -> Installer:
     if not handler:
         raise InstallerError(f"{distro} is not supported")
 
+    if backend:
+        return handler.__class__(backend=backend)
+
     return handler
 
 
+def install_targets(backends: list,
+                    m32_support: bool,
+                    url: str,
+                    repo_dir: str,
+                    install_dir: str,
+                    revision: str = None,
+                    artifacts: str = None,
+                    ccache: bool = False) -> None:
+    """
+    Install LTP on many targets at the same time. LTP is built once on the
+    local host, unless it's already inside the artifacts cache, then it's
+    installed on targets together with the runtime requirements. Targets
+    must run the same distro and architecture of the local host.
+    :param backends: backends of the targets. They are started and stopped
+        by the installation
+    :type backends: list(Backend)
+    :param m32_support: If True, 32bit support will be installed.
+    :type m32_support: bool
+    :param url: url of the git repository.
+    :type url: str
+    :param repo_dir: local repository directory.
+    :type repo_dir: str
+    :param install_dir: LTP installation directory on targets.
+    :type install_dir: str
+    :param revision: commit to install. If None, repository HEAD is
+        installed
+    :type revision: str
+    :param artifacts: directory or URL of the prebuilt LTP cache
+    :type artifacts: str
+    :param ccache: if True, LTP is compiled using ccache
+    :type ccache: bool
+    :raises: InstallerError
+    """
+    if not backends:
+        raise ValueError("backends list is empty")
+
+    if not install_dir or not os.path.isabs(install_dir):
+        raise ValueError("Install directory must be an absolute path")
+
+    logger = logging.getLogger("ltp.installer")
+    machine = platform.machine()
+
+    def _install(backend) -> None:
+        backend.start()
+        try:
+            installer = get_installer(backend=backend)
+
+            arch = installer.machine
+            if arch != machine:
+                raise InstallerError(
+                    f"{backend.target} is {arch}, but LTP has been built "
+                    f"for {machine}")
+
+            installer.install_prebuilt(m32_support, cache, key, install_dir)
+        finally:
+            backend.stop()
+
+    with tempfile.TemporaryDirectory() as tmpdir:
+        cache = ArtifactCache(artifacts or tmpdir)
+        key = get_installer().build(
+            m32_support,
+            url,
+            repo_dir,
+            install_dir,
+            cache,
+            revision=revision,
+            ccache=ccache)
+
+        errors = []
+
+        with ThreadPoolExecutor(max_workers=len(backends)) as executor:
+            futures = {
+                executor.submit(_install, backend): backend
+                for backend in backends
+            }
+
+            for future in as_completed(futures):
+                target = futures[future].target
+
+                err = future.exception()
+                if err:
+                    logger.error("Installation failed on %s: %s", target, err)
+                    errors.append(target)
+                else:
+                    logger.info("LTP installed on %s", target)
+
+    if errors:
+        raise InstallerError(
+            f"Installation failed on {', '.join(sorted(errors))}")
+
+
 def install_run(args: Namespace) -> None:
     """
     Run the installer main command.
@@ -0,0 +1,99 @@
+"""
+.. module:: journal
+    :platform: Linux
+    :synopsis: module that contains the completed tests journal
+
+.. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
+"""
+import os
+import json
+from .report import JSONLReporter
+
+
+class LTPJournal(JSONLReporter):
+    """
+    Durable journal of the completed tests. Every completed test is synced
+    on disk, so an interrupted session can be resumed skipping the tests
+    which already have results. Journal is append-only: tests restored
+    from it are not written again when resuming.
+    """
+
+    def __init__(self, output: str, resume: bool = False, **kwargs) -> None:
+        """
+        :param output: path of the journal file
+        :type output: str
+        :param resume: if True, results of an existing journal are loaded
+            and new tests are appended to it. Otherwise, journal is
+            overwritten
+        :type resume: bool
+        """
+        super().__init__(output, **kwargs)
+
+        self._resume = resume
+        self._results = {}
+        self._size = 0
+
+        if resume:
+            self._results = self._load()
+
+    @property
+    def results(self) -> dict:
+        """
+        Results of the tests loaded from the journal when resuming.
+        :returns: dict((suite name, test name), dict)
+        """
+        return self._results
+
+    def _load(self) -> dict:
+        """
+        Load the results of the completed tests. Reading stops at the first
+        line which has been partially written.
+        """
+        results = {}
+
+        if not os.path.isfile(self._output):
+            return results
+
+        self._logger.info("Resuming from %s", self._output)
+
+        with open(self._output, "rb") as data:
+            for line in data:
+                if not line.endswith(b"\n"):
+                    break
+
+                try:
+                    test = json.loads(line)
+                except ValueError:
+                    break
+
+                results[(test["suite"], test["name"])] = test
+                self._size += len(line)
+
+        self._logger.info("%d tests already completed", len(results))
+
+        return results
+
+    def _append(self, data: str) -> None:
+        super()._append(data)
+        os.fsync(self._file.fileno())
+
+    def test_completed(self, suite, test) -> None:
+        # journal is append-only: tests restored from it are already there
+        if (suite.name, test.name) in self._results:
+            return
+
+        super().test_completed(suite, test)
+
+    def start(self, session) -> None:
+        if not self._resume or not os.path.isfile(self._output):
+            super().start(session)
+            return
+
+        with self._lock:
+            # pylint: disable=consider-using-with
+            self._file = open(self._output, "r+b")
+
+            # drop partially written lines which have not been loaded
+            self._pos = self._size
+            self._file.seek(self._pos)
+            self._file.truncate()
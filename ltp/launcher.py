@@ -0,0 +1,461 @@
+"""
+.. module:: launcher
+    :platform: Linux
+    :synopsis: module that contains the tests launcher process
+
+.. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
+"""
+import os
+import sys
+import json
+import array
+import socket
+import logging
+import threading
+import subprocess
+
+# maximum size of a launch request, including the tests environment
+MAX_REQUEST = 1 << 20
+
+
+class LauncherError(Exception):
+    """
+    Raised when the launcher can't be used to spawn tests.
+    """
+
+
+def _send(channel, data: dict) -> None:
+    """
+    Send a message over a launcher channel.
+    """
+    channel.send(json.dumps(data).encode("utf-8"))
+
+
+def _recv(channel) -> dict:
+    """
+    Receive a message from a launcher channel. None is returned when the
+    other side closed the channel.
+    """
+    data = channel.recv(MAX_REQUEST)
+    if not data:
+        return None
+
+    return json.loads(data.decode("utf-8"))
+
+
+def _send_fds(channel, data: bytes, fds: list) -> None:
+    """
+    Send a message and file descriptors over a launcher channel.
+    """
+    channel.sendmsg(
+        [data],
+        [(socket.SOL_SOCKET, socket.SCM_RIGHTS, array.array("i", fds))])
+
+
+def _recv_fds(channel, size: int, maxfds: int) -> tuple:
+    """
+    Receive a message and its file descriptors from a launcher channel.
+    :returns: (message, list of file descriptors)
+    """
+    fds = array.array("i")
+
+    msg, ancdata, _, _ = channel.recvmsg(
+        size, socket.CMSG_LEN(maxfds * fds.itemsize))
+
+    for level, kind, data in ancdata:
+        if level == socket.SOL_SOCKET and kind == socket.SCM_RIGHTS:
+            data = data[:len(data) - (len(data) % fds.itemsize)]
+            fds.frombytes(data)
+
+    return msg, list(fds)
+
+
+def decode_status(status: int) -> int:
+    """
+    Convert the status given by wait() into a return code, which is
+    negative when process has been killed by a signal, as done by
+    subprocess.
+    :param status: status of the terminated process
+    :type status: int
+    :returns: int
+    """
+    if os.WIFSIGNALED(status):
+        return -os.WTERMSIG(status)
+
+    return os.WEXITSTATUS(status)
+
+
+class LTPLaunchedProcess:
+    """
+    Test process spawned by the launcher. The process is a child of the
+    launcher, so it's waited and reaped by the launcher on request. Until
+    it's reaped, its pid can't be reused and the test processes group can
+    be safely killed.
+    """
+
+    def __init__(self, pid: int, channel, stdout) -> None:
+        self._pid = pid
+        self._channel = channel
+        self._returncode = None
+        self.stdout = stdout
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *_) -> None:
+        self.close()
+
+    @property
+    def pid(self) -> int:
+        """
+        Pid of the process.
+        """
+        return self._pid
+
+    @property
+    def returncode(self) -> int:
+        """
+        Return code of the process. None if it has not been reaped yet.
+        """
+        return self._returncode
+
+    def _recv(self) -> dict:
+        """
+        Receive a message of the process channel.
+        """
+        try:
+            data = _recv(self._channel)
+        except OSError as err:
+            raise LauncherError(f"launcher channel error: {err}") from err
+
+        if data is None:
+            raise LauncherError("launcher is not running")
+
+        return data
+
+    def wait(self) -> None:
+        """
+        Wait for the process to terminate without reaping it.
+        :raises: LauncherError
+        """
+        self._recv()
+
+    def reap(self) -> tuple:
+        """
+        Reap the terminated process.
+        :returns: (return code, rusage dictionary)
+        :raises: LauncherError
+        """
+        try:
+            _send(self._channel, {"reap": True})
+        except OSError as err:
+            raise LauncherError(f"launcher channel error: {err}") from err
+
+        data = self._recv()
+        self._returncode = data["returncode"]
+
+        return self._returncode, data["rusage"]
+
+    def close(self) -> None:
+        """
+        Release the process. Launcher reaps processes which are released
+        before being reaped.
+        """
+        self.stdout.close()
+        self._channel.close()
+
+
+class LTPLauncher:
+    """
+    Small resident process spawning the tests for the runner. Runner memory
+    grows while tests are running, which makes every fork slower, so tests
+    are spawned by a separate interpreter which never grows. Tests are
+    spawned using posix_spawn(), unless they must be moved inside a cgroup
+    before running.
+    """
+
+    def __init__(self) -> None:
+        self._logger = logging.getLogger("ltp.launcher")
+        self._lock = threading.Lock()
+        self._proc = None
+        self._control = None
+
+    @property
+    def is_running(self) -> bool:
+        """
+        True if launcher is running.
+        """
+        return self._proc is not None and self._proc.poll() is None
+
+    def start(self) -> None:
+        """
+        Start the launcher process. It should be started as soon as
+        possible, when runner is still small.
+        :raises: LauncherError
+        """
+        if self.is_running:
+            return
+
+        control, child = socket.socketpair(
+            socket.AF_UNIX, socket.SOCK_SEQPACKET)
+
+        try:
+            # launcher runs this file as a script, so it doesn't import the
+            # runner modules
+            # pylint: disable=consider-using-with
+            self._proc = subprocess.Popen(
+                [sys.executable, "-s", os.path.abspath(__file__),
+                 str(child.fileno())],
+                stdin=subprocess.DEVNULL,
+                pass_fds=[child.fileno()])
+        except OSError as err:
+            control.close()
+            raise LauncherError(f"can't start launcher: {err}") from err
+        finally:
+            child.close()
+
+        self._control = control
+        self._logger.info("Launcher started (pid %d)", self._proc.pid)
+
+    def stop(self, timeout: float = 10) -> None:
+        """
+        Stop the launcher process. Tests which are still running are not
+        stopped.
+        :param timeout: seconds to wait for launcher to exit before it's
+            killed
+        :type timeout: float
+        """
+        if not self._proc:
+            return
+
+        # launcher exits when the control channel is closed
+        self._control.close()
+
+        try:
+            self._proc.wait(timeout=timeout)
+        except subprocess.TimeoutExpired:
+            self._proc.kill()
+            self._proc.wait()
+
+        self._logger.info("Launcher stopped")
+        self._proc = None
+        self._control = None
+
+    def spawn(self,
+              argv: list,
+              cwd: str,
+              env: dict,
+              procs_fd: int = None) -> LTPLaunchedProcess:
+        """
+        Spawn a process inside a new session, which has stdout and stderr
+        redirected to a pipe.
+        :param argv: arguments of the process, where argv[0] is the path of
+            its binary
+        :type argv: list(str)
+        :param cwd: working directory of the process
+        :type cwd: str
+        :param env: environment of the process
+        :type env: dict
+        :param procs_fd: cgroup.procs file where process is moved before
+            being executed. If None, process runs inside the launcher cgroup
+        :type procs_fd: int
+        :returns: LTPLaunchedProcess
+        :raises: LauncherError, OSError
+        """
+        if not self.is_running:
+            raise LauncherError("launcher is not running")
+
+        request = json.dumps({
+            "argv": list(argv),
+            "cwd": cwd,
+            "env": dict(env),
+        }).encode("utf-8")
+
+        if len(request) > MAX_REQUEST:
+            raise LauncherError("launch request is too big")
+
+        channel, remote = socket.socketpair(
+            socket.AF_UNIX, socket.SOCK_SEQPACKET)
+        read_fd, write_fd = os.pipe()
+
+        fds = [remote.fileno(), write_fd]
+        if procs_fd is not None:
+            fds.append(procs_fd)
+
+        try:
+            with self._lock:
+                _send_fds(self._control, request, fds)
+        except OSError as err:
+            channel.close()
+            os.close(read_fd)
+            raise LauncherError(f"can't send launch request: {err}") from err
+        finally:
+            remote.close()
+            os.close(write_fd)
+
+        stdout = os.fdopen(read_fd, "r")
+
+        try:
+            data = _recv(channel)
+        except OSError:
+            data = None
+
+        if data is None:
+            stdout.close()
+            channel.close()
+            raise LauncherError("launcher didn't spawn the process")
+
+        if "errno" in data:
+            stdout.close()
+            channel.close()
+            raise OSError(data["errno"], data["error"], argv[0])
+
+        return LTPLaunchedProcess(data["pid"], channel, stdout)
+
+
+def _rusage(rusage) -> dict:
+    """
+    Convert the rusage of a process into a dictionary.
+    """
+    return {
+        "utime": rusage.ru_utime,
+        "stime": rusage.ru_stime,
+        "maxrss": rusage.ru_maxrss,
+        "inblock": rusage.ru_inblock,
+        "oublock": rusage.ru_oublock,
+        "nvcsw": rusage.ru_nvcsw,
+        "nivcsw": rusage.ru_nivcsw,
+    }
+
+
+# working directory of the launcher is changed by the spawns
+_SPAWN_LOCK = threading.Lock()
+
+
+def _spawn(request: dict, stdout: int, procs_fd: int) -> int:
+    """
+    Spawn the process of a launch request.
+    :returns: pid of the process
+    """
+    argv = request["argv"]
+    env = request["env"]
+
+    # posix_spawn() is available since python 3.8
+    if procs_fd is None and hasattr(os, "posix_spawn"):
+        with _SPAWN_LOCK:
+            if os.getcwd() != request["cwd"]:
+                os.chdir(request["cwd"])
+
+            return os.posix_spawn(
+                argv[0],
+                argv,
+                env,
+                file_actions=[
+                    (os.POSIX_SPAWN_DUP2, stdout, 1),
+                    (os.POSIX_SPAWN_DUP2, stdout, 2),
+                ],
+                setsid=True)
+
+    # process is moved inside its cgroup before running, which can't be
+    # done by posix_spawn(), or posix_spawn() is not available. Forking the
+    # launcher is cheap anyway
+    read_fd, write_fd = os.pipe()
+
+    pid = os.fork()
+    if pid == 0:
+        try:
+            os.close(read_fd)
+            os.setsid()
+            if procs_fd is not None:
+                os.write(procs_fd, b"0")
+            os.dup2(stdout, 1)
+            os.dup2(stdout, 2)
+            os.chdir(request["cwd"])
+            os.execve(argv[0], argv, env)
+        except OSError as err:
+            os.write(write_fd, str(err.errno).encode("utf-8"))
+        finally:
+            os._exit(127)
+
+    os.close(write_fd)
+    with os.fdopen(read_fd, "rb") as data:
+        error = data.read()
+
+    if error:
+        os.waitpid(pid, 0)
+        errno = int(error)
+        raise OSError(errno, os.strerror(errno))
+
+    return pid
+
+
+def _handle(request: dict, fds: list) -> None:
+    """
+    Spawn a process, then wait and reap it when runner asks for it.
+    """
+    channel = socket.socket(fileno=fds[0])
+    stdout = fds[1]
+    procs_fd = fds[2] if len(fds) > 2 else None
+
+    with channel:
+        try:
+            pid = _spawn(request, stdout, procs_fd)
+        except OSError as err:
+            _send(channel, {"errno": err.errno, "error": err.strerror})
+            return
+        finally:
+            os.close(stdout)
+            if procs_fd is not None:
+                os.close(procs_fd)
+
+        try:
+            _send(channel, {"pid": pid})
+
+            os.waitid(os.P_PID, pid, os.WEXITED | os.WNOWAIT)
+            _send(channel, {"exited": True})
+
+            _recv(channel)
+        except OSError:
+            pass
+        finally:
+            # process is always reaped, even if runner went away
+            _, status, rusage = os.wait4(pid, 0)
+
+        try:
+            _send(channel, {
+                "returncode": decode_status(status),
+                "rusage": _rusage(rusage),
+            })
+        except OSError:
+            pass
+
+
+def main() -> None:
+    """
+    Launcher process entry point. Launch requests are received from the
+    control channel until runner closes it.
+    """
+    control = socket.socket(fileno=int(sys.argv[1]))
+
+    while True:
+        try:
+            msg, fds = _recv_fds(control, MAX_REQUEST, 3)
+        except OSError:
+            break
+
+        if not msg:
+            break
+
+        # received descriptors are not inherited by the spawned processes
+        for fd in fds:
+            os.set_inheritable(fd, False)
+
+        thread = threading.Thread(
+            target=_handle,
+            args=(json.loads(msg.decode("utf-8")), fds),
+            daemon=True)
+        thread.start()
+
+
+if __name__ == "__main__":
+    main()
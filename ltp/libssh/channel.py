@@ -45,7 +45,12 @@ ssh_channel_open_session.restype = c_int
 #   int is_stderr,
 #   int timeout_ms)
 ssh_channel_read_timeout = libssh.ssh_channel_read_timeout
-ssh_channel_read_timeout.argtypes = [c_ssh_channel, c_void_p, c_uint32, c_int]
+ssh_channel_read_timeout.argtypes = [
+    c_ssh_channel,
+    c_void_p,
+    c_uint32,
+    c_int,
+    c_int]
 ssh_channel_read_timeout.restype = c_int
 
 # int ssh_channel_request_exec(ssh_channel channel, const char *cmd)
@@ -57,3 +62,31 @@ ssh_channel_request_exec.restype = c_int
 ssh_channel_get_exit_status = libssh.ssh_channel_get_exit_status
 ssh_channel_get_exit_status.argtypes = [c_ssh_channel]
 ssh_channel_get_exit_status.restype = c_int
+
+# int ssh_channel_request_shell(ssh_channel channel)
+ssh_channel_request_shell = libssh.ssh_channel_request_shell
+ssh_channel_request_shell.argtypes = [c_ssh_channel]
+ssh_channel_request_shell.restype = c_int
+
+# int ssh_channel_write(ssh_channel channel, const void *data, uint32_t len)
+ssh_channel_write = libssh.ssh_channel_write
+ssh_channel_write.argtypes = [c_ssh_channel, c_void_p, c_uint32]
+ssh_channel_write.restype = c_int
+
+# int ssh_channel_read_nonblocking(
+#   ssh_channel channel,
+#   void *dest,
+#   uint32_t count,
+#   int is_stderr)
+ssh_channel_read_nonblocking = libssh.ssh_channel_read_nonblocking
+ssh_channel_read_nonblocking.argtypes = [
+    c_ssh_channel,
+    c_void_p,
+    c_uint32,
+    c_int]
+ssh_channel_read_nonblocking.restype = c_int
+
+# int ssh_channel_is_eof(ssh_channel channel)
+ssh_channel_is_eof = libssh.ssh_channel_is_eof
+ssh_channel_is_eof.argtypes = [c_ssh_channel]
+ssh_channel_is_eof.restype = c_int
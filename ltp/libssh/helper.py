@@ -5,7 +5,13 @@
 
 .. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
 """
+import re
+import time
+import uuid
+import shlex
+import codecs
 import ctypes
+import asyncio
 import logging
 from typing import Any
 from ltp.libssh.constants import (
@@ -38,7 +44,12 @@ from ltp.libssh.channel import (
     ssh_channel_free,
     ssh_channel_open_session,
     ssh_channel_request_exec,
+    ssh_channel_request_shell,
     ssh_channel_read_timeout,
+    ssh_channel_read_nonblocking,
+    ssh_channel_is_eof,
+    ssh_channel_send_eof,
+    ssh_channel_write,
     ssh_channel_get_exit_status
 )
 
@@ -49,6 +60,12 @@ class SSHError(Exception):
     """
 
 
+class SSHTimeoutError(SSHError):
+    """
+    Raised when a command didn't complete before its timeout.
+    """
+
+
 class SSHClient:
     """
     SSH client handler.
@@ -59,7 +76,9 @@ class SSHClient:
             user: str,
             host: str,
             port: int = 22,
-            timeout: int = 10) -> None:
+            timeout: int = 10,
+            persistent: bool = False,
+            buffer_size: int = 65536) -> None:
         """
         :param user: username for logging in
         :type user: str
@@ -69,13 +88,30 @@ class SSHClient:
         :type port: int
         :param timeout: SSH timeout
         :type timeout: int
+        :param persistent: if True, commands are executed inside a single
+            remote shell which is kept open, instead of opening a new channel
+            for each command. In this case, stderr is redirected to stdout
+        :type persistent: bool
+        :param buffer_size: size of the buffer used to read commands stdout
+        :type buffer_size: int
         """
+        if buffer_size <= 0:
+            raise ValueError("buffer_size must be greater than 0")
+
         self._logger = logging.getLogger("ltp.libssh")
         self._user = user
         self._host = host
         self._port = port
         self._timeout = timeout
+        self._persistent = persistent
         self._session = None
+        self._shell = None
+
+        # read buffer is allocated once and shared by libssh and python
+        self._buffer = bytearray(buffer_size)
+        self._c_buffer = (ctypes.c_char * buffer_size).from_buffer(
+            self._buffer)
+        self._view = memoryview(self._buffer)
 
     def _raise_session_error(self, msg: str = None):
         """
@@ -153,6 +189,8 @@ class SSHClient:
 
         self._logger.info("Closing connection")
 
+        self._close_shell()
+
         ssh_disconnect(self._session)
         ssh_free(self._session)
         self._session = None
@@ -234,14 +272,289 @@ class SSHClient:
         if ret != SSH_AUTH_SUCCESS:
             self._raise_session_error()
 
+    def _open_shell(self) -> None:
+        """
+        Open the channel running the persistent remote shell.
+        """
+        self._logger.info("Opening remote shell")
+
+        c_channel = ssh_channel_new(self._session)
+        if not c_channel:
+            raise SSHError("Can't create communication channel")
+
+        ret = ssh_channel_open_session(c_channel)
+        if ret == SSH_OK:
+            ret = ssh_channel_request_shell(c_channel)
+            if ret != SSH_OK:
+                ssh_channel_close(c_channel)
+
+        if ret != SSH_OK:
+            msg = ssh_get_error(self._session).decode()
+            ssh_channel_free(c_channel)
+            raise SSHError(msg)
+
+        self._shell = c_channel
+
+    def _close_shell(self) -> None:
+        """
+        Close the channel running the persistent remote shell.
+        """
+        if not self._shell:
+            return
+
+        self._logger.info("Closing remote shell")
+
+        ssh_channel_send_eof(self._shell)
+        ssh_channel_close(self._shell)
+        ssh_channel_free(self._shell)
+        self._shell = None
+
+    def _raise_channel_error(self, c_channel, close: bool) -> None:
+        """
+        Release channel and raises a SSHError using libssh error message.
+        """
+        c_msg = ssh_get_error(self._session)
+        msg = c_msg.decode()
+
+        if close:
+            ssh_channel_close(c_channel)
+
+        ssh_channel_free(c_channel)
+        raise SSHError(msg)
+
+    def _open_exec_channel(self, command: str):
+        """
+        Open a new channel executing the given command.
+        :returns: ssh_channel
+        """
+        c_channel = ssh_channel_new(self._session)
+        if not c_channel:
+            raise SSHError("Can't create communication channel")
+
+        ret = ssh_channel_open_session(c_channel)
+        if ret != SSH_OK:
+            self._raise_channel_error(c_channel, False)
+
+        c_command = ctypes.c_char_p(command.encode())
+        ret = ssh_channel_request_exec(c_channel, c_command)
+        if ret != SSH_OK:
+            self._raise_channel_error(c_channel, True)
+
+        return c_channel
+
+    @staticmethod
+    def _pgid_marker() -> bytes:
+        """
+        New marker printed before the session id of a command.
+        """
+        return f"__ltp_{uuid.uuid4().hex}_pgid__".encode()
+
+    @staticmethod
+    def _group_script(command: str, marker: bytes, redirect: str) -> str:
+        """
+        Script running command inside a new session, so all its processes
+        can be killed on timeout. Session id is printed on stdout after
+        marker, before command output, and command exit status is stored in
+        $__ltp_ret. If setsid is not available, command runs inside its own
+        shell process. Nothing is written on the target filesystem, which
+        can be read-only or full.
+        """
+        # setsid doesn't fork, since background jobs aren't process group
+        # leaders, so $$ is the session id
+        inner = f'echo {marker.decode()}$$; exec sh -c "$1"'
+        return f"$(command -v setsid) sh -c {shlex.quote(inner)} sh " \
+            f"{shlex.quote(command)} {redirect} & wait $!; __ltp_ret=$?"
+
+    def _exec_script(self, command: str, marker: bytes) -> str:
+        """
+        Script executing command on a new channel. Input of the channel is
+        given to command.
+        """
+        # asynchronous commands read /dev/null if input isn't redirected
+        script = self._group_script(command, marker, "<&3 3<&-")
+        return f"exec 3<&0; {script}; exit $__ltp_ret"
+
+    @staticmethod
+    def _take_pgid(stdout: bytearray, marker: bytes) -> int:
+        """
+        Remove the session id printed after marker from stdout.
+        :returns: session id or None if it has not been read yet
+        """
+        start = stdout.find(marker)
+        if start < 0:
+            return None
+
+        end = stdout.find(b"\n", start)
+        if end < 0:
+            return None
+
+        pgid = int(stdout[start + len(marker):end])
+        del stdout[start:end + 1]
+
+        return pgid
+
+    def _kill_script(self, pgid: int) -> str:
+        """
+        Script killing the processes of a command which timed out. Closing
+        the channel of a command doesn't stop it, since it has no terminal.
+        :returns: script or None if session id is unknown
+        """
+        if pgid is None:
+            self._logger.warning(
+                "Can't kill remote command: session id has not been read")
+            return None
+
+        self._logger.info("Killing remote command")
+
+        return f"kill -KILL -{pgid} 2>/dev/null || kill -KILL {pgid}"
+
+    def _kill_group(self, pgid: int) -> None:
+        """
+        Kill the processes of a command which timed out, using a new
+        channel.
+        """
+        kill = self._kill_script(pgid)
+        if not kill:
+            return
+
+        try:
+            c_channel = self._open_exec_channel(kill)
+            self._read_exec(c_channel, kill, self._deadline(self._timeout))
+        except SSHError as err:
+            self._logger.warning("Can't kill remote command: %s", err)
+
+    async def _kill_group_async(self, pgid: int) -> None:
+        """
+        Kill the processes of a command which timed out, using a new
+        channel polled without blocking the event loop.
+        """
+        kill = self._kill_script(pgid)
+        if not kill:
+            return
+
+        loop = asyncio.get_running_loop()
+
+        deadline = None
+        if self._timeout and self._timeout > 0:
+            deadline = loop.time() + self._timeout
+
+        try:
+            c_channel = self._open_exec_channel(kill)
+            await self._read_async(c_channel, kill, deadline)
+        except SSHError as err:
+            self._logger.warning("Can't kill remote command: %s", err)
+
+    @staticmethod
+    def _deadline(timeout: int) -> float:
+        """
+        Return the time when a command with the given timeout expires. If
+        timeout is 0, None is returned.
+        """
+        if not timeout or timeout <= 0:
+            return None
+
+        return time.monotonic() + timeout
+
+    @staticmethod
+    def _expired(deadline: float) -> bool:
+        """
+        True if deadline has been reached.
+        """
+        return deadline is not None and time.monotonic() >= deadline
+
+    def _read(self, c_channel, deadline: float) -> int:
+        """
+        Read channel stdout into the read buffer, waiting for data until
+        deadline. If deadline is None, it waits forever.
+        :returns: number of bytes which have been read or libssh error code.
+            0 is returned on EOF or when deadline has been reached
+        """
+        timeout_ms = -1
+        if deadline is not None:
+            timeout_ms = max(0, int((deadline - time.monotonic()) * 1000))
+
+        return ssh_channel_read_timeout(
+            c_channel,
+            self._c_buffer,
+            len(self._buffer),
+            0,
+            timeout_ms)
+
+    def _execute_shell(self, command: str, deadline: float) -> set:
+        """
+        Execute a command inside the persistent remote shell. Command runs
+        inside a sub shell and its exit status is printed after a random
+        sentinel, which is used to find the end of the command output.
+        """
+        if not self._shell:
+            self._open_shell()
+
+        sentinel = f"__ltp_{uuid.uuid4().hex}__"
+        matcher = re.compile(
+            b"\n" + sentinel.encode() + b"(?P<status>-?\\d+)\n")
+
+        marker = self._pgid_marker()
+        script = self._group_script(command, marker, "< /dev/null 2>&1")
+        script += f"\nprintf '\\n{sentinel}%d\\n' $__ltp_ret\n"
+        c_script = script.encode()
+
+        ret = ssh_channel_write(
+            self._shell,
+            ctypes.c_char_p(c_script),
+            len(c_script))
+        if ret < 0:
+            msg = ssh_get_error(self._session).decode()
+            self._close_shell()
+            raise SSHError(msg)
+
+        stdout = bytearray()
+        match = None
+        pgid = None
+
+        while not match:
+            nbytes = self._read(self._shell, deadline)
+            if nbytes == 0 and self._expired(deadline):
+                # shell is still busy with the command, so it can't be used
+                # anymore. Closing it doesn't stop the command, which is
+                # killed using its session id
+                self._kill_group(pgid)
+                self._close_shell()
+                raise SSHTimeoutError(f"'{command}' timed out")
+
+            if nbytes < 0 or (nbytes == 0 and
+                              ssh_channel_is_eof(self._shell)):
+                msg = ssh_get_error(self._session).decode()
+                self._close_shell()
+                raise SSHError(msg or "Remote shell has been closed")
+
+            if nbytes == 0:
+                continue
+
+            # sentinel can't start before the data which has been read
+            start = max(0, len(stdout) - len(sentinel) - 16)
+            stdout += self._view[:nbytes]
+
+            if pgid is None:
+                pgid = self._take_pgid(stdout, marker)
+                start = 0
+
+            match = matcher.search(stdout, start)
+
+        exit_status = int(match.group("status"))
+        del stdout[match.start():]
+
+        return exit_status, stdout.decode("utf-8", errors="replace")
+
     def execute(self, command: str, timeout: int = 60) -> set:
         """
         Execute a command on remote server.
         :param command: command to execute.
         :type command: str
-        :param timeout: command response timeout in seconds (default is 60)
+        :param timeout: command timeout in seconds (default is 60). If 0, no
+            timeout is applied
         :type timeout: int
         :returns: couple of (int, str) defining exit_status and stdout
+        :raises: SSHTimeoutError if command didn't complete in time
         """
         self._logger.info(
             "Executing remote command '%s' (timeout=%ds)",
@@ -250,55 +563,273 @@ class SSHClient:
         if not command:
             raise ValueError("Command is empty")
 
-        c_channel = ssh_channel_new(self._session)
-        if not c_channel:
-            raise SSHError("Can't create communication channel")
+        deadline = self._deadline(timeout)
 
-        def raise_error(close: bool) -> None:
-            """
-            Release channel and raises a SSHError using libssh error message.
-            """
-            c_msg = ssh_get_error(self._session)
-            msg = c_msg.decode()
+        if self._persistent:
+            exit_status, stdout = self._execute_shell(command, deadline)
+            self._logger.info("Command executed")
+            return exit_status, stdout
 
-            if close:
-                ssh_channel_close(c_channel)
+        marker = self._pgid_marker()
+        c_channel = self._open_exec_channel(
+            self._exec_script(command, marker))
 
-            ssh_channel_free(c_channel)
-            raise SSHError(msg)
+        exit_status, stdout = self._read_exec(
+            c_channel, command, deadline, marker)
 
-        ret = ssh_channel_open_session(c_channel)
-        if ret != SSH_OK:
-            raise_error(False)
+        self._logger.info("Command executed")
 
-        c_command = ctypes.c_char_p(command.encode())
-        ret = ssh_channel_request_exec(c_channel, c_command)
-        if ret != SSH_OK:
-            raise_error(True)
+        return exit_status, stdout
 
-        stdout = ""
-        nbytes = 1
-        buffsize = 1024
-        data = ctypes.create_string_buffer(buffsize)
+    def _read_pgid(self, c_channel, deadline: float, marker: bytes) -> set:
+        """
+        Read the stdout of a command channel until the session id of the
+        command has been printed.
+        :returns: couple of (int, bytearray) defining session id, which is
+            None if it has not been printed, and stdout read so far
+        """
+        stdout = bytearray()
 
-        while nbytes > 0:
-            nbytes = ssh_channel_read_timeout(
-                c_channel,
-                data,
-                buffsize,
-                0,
-                timeout * 1000)
+        while True:
+            nbytes = self._read(c_channel, deadline)
+            if nbytes < 0:
+                self._raise_channel_error(c_channel, True)
+
+            if nbytes > 0:
+                stdout += self._view[:nbytes]
+
+                pgid = self._take_pgid(stdout, marker)
+                if pgid is not None:
+                    return pgid, stdout
 
+                continue
+
+            if ssh_channel_is_eof(c_channel) or self._expired(deadline):
+                return None, stdout
+
+    def _read_exec(self,
+                   c_channel,
+                   command: str,
+                   deadline: float,
+                   marker: bytes = None,
+                   pgid: int = None,
+                   stdout: bytearray = None) -> set:
+        """
+        Read the stdout of a command channel until EOF, then release it. If
+        deadline is reached, processes of the command are killed using the
+        session id printed after marker, or the given one.
+        :returns: couple of (int, str) defining exit_status and stdout
+        """
+        if stdout is None:
+            stdout = bytearray()
+
+        while True:
+            nbytes = self._read(c_channel, deadline)
             if nbytes < 0:
-                raise_error(True)
+                self._raise_channel_error(c_channel, True)
+
+            if nbytes > 0:
+                stdout += self._view[:nbytes]
+
+                if marker and pgid is None:
+                    pgid = self._take_pgid(stdout, marker)
+
+                continue
+
+            if ssh_channel_is_eof(c_channel):
+                break
+
+            if self._expired(deadline):
+                ssh_channel_close(c_channel)
+                ssh_channel_free(c_channel)
+
+                if marker:
+                    self._kill_group(pgid)
 
-            stdout += data.value[:nbytes].decode("utf-8")
+                raise SSHTimeoutError(f"'{command}' timed out")
 
         exit_status = ssh_channel_get_exit_status(c_channel)
 
         ssh_channel_close(c_channel)
         ssh_channel_free(c_channel)
 
+        # decode only once, so multibyte characters split between two reads
+        # are handled correctly
+        return exit_status, stdout.decode("utf-8", errors="replace")
+
+    def execute_input(self, command: str, stdin, timeout: int = 60) -> set:
+        """
+        Execute a command on remote server, writing data to its standard
+        input. Data is sent before reading the command stdout, so command
+        should not print much until its input has been read.
+        :param command: command to execute.
+        :type command: str
+        :param stdin: binary file object which is read until EOF
+        :type stdin: file
+        :param timeout: command timeout in seconds (default is 60). If 0, no
+            timeout is applied
+        :type timeout: int
+        :returns: couple of (int, str) defining exit_status and stdout
+        :raises: SSHTimeoutError if command didn't complete in time
+        """
+        self._logger.info(
+            "Executing remote command '%s' with input (timeout=%ds)",
+            command, timeout)
+
+        if not command:
+            raise ValueError("Command is empty")
+
+        deadline = self._deadline(timeout)
+
+        # persistent shell can't tell input from the next commands
+        marker = self._pgid_marker()
+        c_channel = self._open_exec_channel(
+            self._exec_script(command, marker))
+
+        # session id is printed before command reads its input, so command
+        # can be killed if input can't be sent in time
+        pgid, stdout = self._read_pgid(c_channel, deadline, marker)
+
+        while True:
+            data = stdin.read(len(self._buffer))
+            if not data:
+                break
+
+            if self._expired(deadline):
+                ssh_channel_close(c_channel)
+                ssh_channel_free(c_channel)
+                self._kill_group(pgid)
+                raise SSHTimeoutError(f"'{command}' timed out")
+
+            ret = ssh_channel_write(
+                c_channel,
+                ctypes.c_char_p(bytes(data)),
+                len(data))
+            if ret < 0:
+                self._raise_channel_error(c_channel, True)
+
+        ssh_channel_send_eof(c_channel)
+
+        exit_status, stdout = self._read_exec(
+            c_channel, command, deadline, marker, pgid, stdout)
+
         self._logger.info("Command executed")
 
         return exit_status, stdout
+
+    async def execute_async(
+            self,
+            command: str,
+            timeout: int = 60,
+            stdout_callback: callable = None) -> set:
+        """
+        Execute a command on remote server without blocking the event loop.
+        Channel is polled using non-blocking reads, so multiple commands can
+        run at the same time on the same SSH session. Commands never use the
+        persistent shell.
+        :param command: command to execute.
+        :type command: str
+        :param timeout: command timeout in seconds (default is 60). If 0, no
+            timeout is applied
+        :type timeout: int
+        :param stdout_callback: function called with stdout data as soon as
+            it's read
+        :type stdout_callback: callable
+        :returns: couple of (int, str) defining exit_status and stdout
+        :raises: SSHTimeoutError if command didn't complete in time
+        """
+        self._logger.info(
+            "Executing remote command '%s' asynchronously (timeout=%ds)",
+            command, timeout)
+
+        if not command:
+            raise ValueError("Command is empty")
+
+        loop = asyncio.get_running_loop()
+        deadline = loop.time() + timeout if timeout and timeout > 0 else None
+
+        marker = self._pgid_marker()
+        c_channel = self._open_exec_channel(
+            self._exec_script(command, marker))
+
+        exit_status, stdout = await self._read_async(
+            c_channel, command, deadline, marker, stdout_callback)
+
+        self._logger.info("Command executed")
+
+        return exit_status, stdout
+
+    async def _read_async(self,
+                          c_channel,
+                          command: str,
+                          deadline: float,
+                          marker: bytes = None,
+                          stdout_callback: callable = None) -> set:
+        """
+        Poll the stdout of a command channel until EOF, then release it. If
+        deadline, in event loop time, is reached, processes of the command
+        are killed using the session id printed after marker.
+        :returns: couple of (int, str) defining exit_status and stdout
+        """
+        loop = asyncio.get_running_loop()
+        decoder = codecs.getincrementaldecoder("utf-8")(errors="replace")
+        stdout = []
+
+        # output is held back until session id has been removed from it
+        pending = bytearray()
+        pgid = None
+
+        def _on_data(data: bytes, final: bool = False) -> None:
+            text = decoder.decode(data, final=final)
+            if text:
+                stdout.append(text)
+                if stdout_callback:
+                    stdout_callback(text)
+
+        while True:
+            nbytes = ssh_channel_read_nonblocking(
+                c_channel,
+                self._c_buffer,
+                len(self._buffer),
+                0)
+
+            if nbytes < 0:
+                self._raise_channel_error(c_channel, True)
+
+            if nbytes > 0:
+                # buffer is shared with other commands, so it must be
+                # consumed before giving control back to the event loop
+                if marker and pgid is None:
+                    pending += self._view[:nbytes]
+                    pgid = self._take_pgid(pending, marker)
+                    if pgid is not None:
+                        _on_data(bytes(pending))
+                        pending = None
+                else:
+                    _on_data(self._view[:nbytes])
+
+                await asyncio.sleep(0)
+                continue
+
+            if ssh_channel_is_eof(c_channel):
+                break
+
+            if deadline and loop.time() >= deadline:
+                ssh_channel_close(c_channel)
+                ssh_channel_free(c_channel)
+
+                if marker:
+                    await self._kill_group_async(pgid)
+
+                raise SSHTimeoutError(f"'{command}' timed out")
+
+            await asyncio.sleep(0.01)
+
+        _on_data(bytes(pending or b""), final=True)
+
+        exit_status = ssh_channel_get_exit_status(c_channel)
+
+        ssh_channel_close(c_channel)
+        ssh_channel_free(c_channel)
+
+        return exit_status, "".join(stdout)
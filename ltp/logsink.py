@@ -0,0 +1,413 @@
+"""
+.. module:: logsink
+    :platform: Linux
+    :synopsis: module moving logging handlers behind a queue
+
+.. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
+"""
+import queue
+import fnmatch
+import threading
+import logging
+import logging.handlers
+
+# logger receiving the tests stdout, one record for each line
+OUTPUT_LOGGER = "ltp.test.stdout"
+
+# records kept inside the queue before dropping the new ones
+MAX_RECORDS = 100000
+
+
+class BulkFileHandler(logging.FileHandler):
+    """
+    File handler which doesn't flush every record. Records are kept inside
+    the file buffer until `sync` is called, so many records are written
+    with a single system call.
+    """
+
+    def flush(self) -> None:
+        # records are flushed by sync()
+        pass
+
+    def sync(self) -> None:
+        """
+        Write buffered records into the file.
+        """
+        super().flush()
+
+    def close(self) -> None:
+        self.sync()
+        super().close()
+
+
+class OutputFilter(logging.Filter):
+    """
+    Filter of the tests stdout shown on console. Other records are never
+    filtered. Filter is also a session reporter, showing the lines which
+    have been dropped by rate as soon as tests complete.
+    """
+
+    def __init__(self) -> None:
+        super().__init__()
+        self._enabled = True
+        self._patterns = []
+        self._rate = 0
+        self._windows = {}
+        self._lock = threading.Lock()
+
+    def configure(self,
+                  enabled: bool = True,
+                  patterns: list = None,
+                  rate: int = 0) -> None:
+        """
+        Configure the tests stdout shown on console.
+        :param enabled: if False, tests stdout is never shown
+        :type enabled: bool
+        :param patterns: if given, only stdout of tests matching one of the
+            glob patterns is shown
+        :type patterns: list(str)
+        :param rate: maximum number of lines per second shown for each test.
+            If 0, all lines are shown
+        :type rate: int
+        """
+        if rate < 0:
+            raise ValueError("rate must be positive")
+
+        self._enabled = enabled
+        self._patterns = patterns or []
+        self._rate = rate
+
+        with self._lock:
+            self._windows.clear()
+
+    @staticmethod
+    def _show_dropped(test: str, dropped: int) -> None:
+        """
+        Show the number of lines of a test which have not been shown.
+        """
+        if dropped:
+            logging.getLogger("ltp.test").info(
+                "%d lines of %s have not been shown", dropped, test)
+
+    def _rate_limit(self, record: logging.LogRecord, test: str) -> bool:
+        """
+        True if record can be shown without exceeding the test rate.
+        """
+        now = int(record.created)
+
+        with self._lock:
+            second, count, dropped = self._windows.get(test, (now, 0, 0))
+
+            if second != now:
+                # record is shared with the other handlers, so it can't be
+                # modified
+                self._show_dropped(test, dropped)
+                second, count, dropped = now, 0, 0
+
+            if count >= self._rate:
+                self._windows[test] = (second, count, dropped + 1)
+                return False
+
+            self._windows[test] = (second, count + 1, dropped)
+
+        return True
+
+    def flush(self, test: str = None) -> None:
+        """
+        Show the lines which have been dropped by rate and reset the rate
+        of the tests.
+        :param test: name of the test. If None, all tests are flushed
+        :type test: str
+        """
+        with self._lock:
+            if test is None:
+                windows = self._windows
+                self._windows = {}
+            else:
+                windows = {}
+                if test in self._windows:
+                    windows[test] = self._windows.pop(test)
+
+        for name, (_, _, dropped) in windows.items():
+            self._show_dropped(name, dropped)
+
+    def start(self, session) -> None:
+        """
+        Session reporter interface. Nothing is done on start.
+        """
+
+    def test_completed(self, suite, test) -> None:
+        """
+        Show the lines of a completed test which have been dropped.
+        :param suite: suite of the test
+        :type suite: LTPSuite
+        :param test: completed test
+        :type test: LTPTest
+        """
+        # pylint: disable=unused-argument
+        self.flush(test.name)
+
+    def stop(self) -> None:
+        """
+        Show the lines of all tests which have been dropped.
+        """
+        self.flush()
+
+    def filter(self, record: logging.LogRecord) -> bool:
+        if record.name != OUTPUT_LOGGER:
+            return True
+
+        if not self._enabled:
+            return False
+
+        test = getattr(record, "test", "")
+
+        if self._patterns and not any(
+                fnmatch.fnmatchcase(test, pattern)
+                for pattern in self._patterns):
+            return False
+
+        if self._rate:
+            return self._rate_limit(record, test)
+
+        return True
+
+
+class _NameFilter(logging.Filter):
+    """
+    Filter accepting the records of many loggers and of their children.
+    """
+
+    def __init__(self, names: list) -> None:
+        super().__init__()
+        self._names = names
+
+    def filter(self, record: logging.LogRecord) -> bool:
+        return any(
+            record.name == name or record.name.startswith(name + ".")
+            for name in self._names)
+
+
+class _QueueHandler(logging.handlers.QueueHandler):
+    """
+    Queue handler which never blocks. Records are dropped when queue is
+    full and they are counted, so drops are reported once queue has room
+    again.
+    """
+
+    def __init__(self, records: queue.Queue) -> None:
+        super().__init__(records)
+        self._lock = threading.Lock()
+        self._dropped = 0
+        self._reported = 0
+
+    @property
+    def dropped(self) -> int:
+        """
+        Number of records which have been dropped.
+        """
+        return self._dropped
+
+    def pending(self) -> int:
+        """
+        Return the number of dropped records which have not been reported
+        and mark them as reported.
+        """
+        with self._lock:
+            count = self._dropped - self._reported
+            self._reported = self._dropped
+
+        return count
+
+    def _put(self, record: logging.LogRecord) -> bool:
+        """
+        Put a record inside the queue. False if queue is full.
+        """
+        try:
+            self.queue.put_nowait(record)
+        except queue.Full:
+            with self._lock:
+                self._dropped += 1
+            return False
+
+        return True
+
+    def enqueue(self, record: logging.LogRecord) -> None:
+        # records are also logged by the listener thread, so queue is never
+        # waited
+        if self._dropped > self._reported:
+            count = self.pending()
+
+            report = logging.LogRecord(
+                "ltp.main",
+                logging.WARNING,
+                __file__,
+                0,
+                "%d log records have been dropped",
+                (count,),
+                None)
+
+            if not self._put(self.prepare(report)):
+                with self._lock:
+                    self._reported -= count
+
+        self._put(record)
+
+
+class _Listener(logging.handlers.QueueListener):
+    """
+    Queue listener which syncs bulk handlers once the queue is empty.
+    """
+
+    def enqueue_sentinel(self) -> None:
+        # listener is stopped by the sink only, so the full queue can be
+        # waited
+        self.queue.put(self._sentinel)
+
+    def dequeue(self, block: bool):
+        try:
+            return self.queue.get_nowait()
+        except queue.Empty:
+            pass
+
+        for handler in self.handlers:
+            if isinstance(handler, BulkFileHandler):
+                handler.sync()
+
+        return self.queue.get(block)
+
+
+class LogSink:
+    """
+    Logging sink which moves the configured handlers behind a queue, so
+    logging never blocks on slow consoles or files. Records are written by
+    a single thread, preserving the loggers routing of the configuration.
+    Queue is bounded, so records are dropped and counted when handlers
+    can't keep up with them.
+    Handlers are moved on `start` and restored on `stop`:
+
+        logging.config.dictConfig(config)
+
+        sink = LogSink()
+        sink.start()
+        try:
+            ...
+        finally:
+            sink.stop()
+    """
+
+    def __init__(self, max_records: int = MAX_RECORDS) -> None:
+        """
+        :param max_records: maximum number of records inside the queue.
+            New records are dropped and counted when queue is full
+        :type max_records: int
+        """
+        if not max_records or max_records < 0:
+            raise ValueError("max_records must be positive")
+
+        self._queue = queue.Queue(maxsize=max_records)
+        self._queue_handler = _QueueHandler(self._queue)
+        self._listener = None
+        self._loggers = {}
+        self._filters = []
+        self._output_filter = OutputFilter()
+
+    @property
+    def output_filter(self) -> OutputFilter:
+        """
+        Filter of the tests stdout shown on console.
+        :returns: OutputFilter
+        """
+        return self._output_filter
+
+    @property
+    def dropped(self) -> int:
+        """
+        Number of records which have been dropped because queue was full.
+        :returns: int
+        """
+        return self._queue_handler.dropped
+
+    @staticmethod
+    def _configured_loggers() -> list:
+        """
+        Return the loggers which have handlers.
+        """
+        loggers = [logging.getLogger()]
+        loggers.extend(
+            logger for logger in logging.root.manager.loggerDict.values()
+            if isinstance(logger, logging.Logger) and logger.handlers)
+
+        return [logger for logger in loggers if logger.handlers]
+
+    def start(self) -> None:
+        """
+        Move the loggers handlers behind the queue and start writing
+        records.
+        """
+        if self._listener:
+            return
+
+        names = {}
+        for logger in self._configured_loggers():
+            self._loggers[logger] = list(logger.handlers)
+
+            for handler in self._loggers[logger]:
+                names.setdefault(handler, []).append(logger.name)
+                logger.removeHandler(handler)
+
+        # records propagate to the root logger, which puts them inside the
+        # queue. Listener sends them to the handlers of their loggers
+        for handler, loggers in names.items():
+            if logging.getLogger().name not in loggers:
+                name_filter = _NameFilter(loggers)
+                handler.addFilter(name_filter)
+                self._filters.append((handler, name_filter))
+
+            if not isinstance(handler, logging.FileHandler):
+                handler.addFilter(self._output_filter)
+                self._filters.append((handler, self._output_filter))
+
+        logging.getLogger().addHandler(self._queue_handler)
+
+        self._listener = _Listener(
+            self._queue,
+            *names.keys(),
+            respect_handler_level=True)
+        self._listener.start()
+
+    def stop(self) -> None:
+        """
+        Write the queued records and restore the loggers handlers.
+        """
+        if not self._listener:
+            return
+
+        logging.getLogger().removeHandler(self._queue_handler)
+
+        self._listener.stop()
+
+        for handler in self._listener.handlers:
+            if isinstance(handler, BulkFileHandler):
+                handler.sync()
+
+        self._listener = None
+
+        for handler, handler_filter in self._filters:
+            handler.removeFilter(handler_filter)
+
+        self._filters.clear()
+
+        for logger, handlers in self._loggers.items():
+            for handler in handlers:
+                logger.addHandler(handler)
+
+        self._loggers.clear()
+
+        # drops are shown by the restored handlers
+        self._output_filter.flush()
+
+        dropped = self._queue_handler.pending()
+        if dropped:
+            logging.getLogger("ltp.main").warning(
+                "%d log records have been dropped", dropped)
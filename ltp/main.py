@@ -9,12 +9,31 @@ import os
 import logging
 import logging.config
 import json
+import hashlib
 import argparse
 import platform
+import tempfile
 from argparse import Namespace
 
 import ltp.install
 from ltp.report import export_to_json
+from ltp.report import JSONLReporter
+from ltp.report import JUnitReporter
+from ltp.archive import ArchiveReporter
+from ltp.archive import archive_to_json
+from ltp.archive import json_to_archive
+from ltp.archive import is_archive
+from ltp.compare import compare_reports
+from ltp.cgroup import CgroupTree
+from ltp.launcher import LTPLauncher
+from ltp.history import LTPHistory
+from ltp.journal import LTPJournal
+from ltp.logsink import LogSink
+from ltp.metrics import MetricsServer
+from ltp.resultcache import LTPResultCache
+from ltp.resultcache import affected_suites
+from ltp.selection import LTPSelection
+from ltp.breaker import CircuitBreaker
 from ltp.session import LTPSession
 
 
@@ -25,11 +44,14 @@ def _print_results(session: LTPSession) -> None:
     logger = logging.getLogger("ltp.main")
 
     tests = 0
+    violations = 0
     for suite in session.suites:
         if suite.completed:
             for test in suite.tests:
                 if test.completed:
                     tests += 1
+                    if test.violations:
+                        violations += 1
 
     kernver = platform.uname().release
     arch = platform.architecture()[0]
@@ -42,15 +64,24 @@ def _print_results(session: LTPSession) -> None:
     logger.info("Total Skipped Tests: %d", session.skipped)
     logger.info("Total Broken Tests: %d", session.broken)
     logger.info("Total Warnings: %d", session.warnings)
+    if violations:
+        logger.info("Total Tests Hitting Limits: %d", violations)
     logger.info("Kernel Version:: %s", kernver)
     logger.info("Machine Architecture: %s", arch)
     logger.info("Hostname: %s", hostname)
+
+    targets = sorted(set(
+        test.target for suite in session.suites
+        for test in suite.tests if test.target))
+    if targets:
+        logger.info("Targets: %s", " ".join(targets))
     logger.info("")
 
 
-def _init_logging() -> None:
+def _init_logging() -> LogSink:
     """
-    Initialize logging objects.
+    Initialize logging objects. Handlers are moved behind a queue, so tests
+    printing fast are never blocked by the console or the log file.
     """
     current_dir = os.path.dirname(os.path.realpath(__file__))
     logging_file = os.path.join(current_dir, "logger.json")
@@ -59,18 +90,40 @@ def _init_logging() -> None:
         data = json.load(jsonfile)
         logging.config.dictConfig(data)
 
+    sink = LogSink()
+    sink.start()
+
+    return sink
+
+
+def _cache_file() -> str:
+    """
+    Return the file where runtest metadata of the current LTPROOT are
+    cached.
+    """
+    cache_dir = os.environ.get(
+        "XDG_CACHE_HOME", os.path.expanduser(os.path.join("~", ".cache")))
+
+    ltproot = os.environ.get(
+        "LTPROOT", os.path.dirname(os.path.abspath(__file__)))
+    digest = hashlib.sha1(ltproot.encode("utf-8")).hexdigest()[:16]
+
+    return os.path.join(cache_dir, "runltp-ng", f"runtest-{digest}.json")
+
 
 def _ltp_list(args: Namespace) -> None:
     """
     Handle "list" subcommand.
     """
-    session = LTPSession()
+    session = LTPSession(cache_file=_cache_file())
     suites = []
 
     if args.default:
         suites = session.suites_from_scenario(scenario="default")
     elif args.network:
         suites = session.suites_from_scenario(scenario="network")
+    elif args.scenario:
+        suites = session.suites_from_scenario(scenario=args.scenario)
     else:
         suites = session.suites_from_scenario()
 
@@ -81,20 +134,278 @@ def _ltp_list(args: Namespace) -> None:
     logger.info("")
 
 
+def _parse_target(target: str) -> tuple:
+    """
+    Convert a "user@host[:port]" target into a (user, host, port) tuple.
+    """
+    user, _, address = target.rpartition("@")
+    host, _, port = address.partition(":")
+
+    if not user or not host:
+        raise ValueError(
+            f"'{target}' must be in the user@host[:port] form")
+
+    return user, host, int(port or 22)
+
+
+def _create_backends(args: Namespace) -> list:
+    """
+    Create a pool of SSH sessions for each one of the given targets in the
+    form of "user@host[:port]" and a pool of Qemu VMs, if image is given.
+    """
+    # libssh is needed only when running on remote targets
+    # pylint: disable=import-outside-toplevel
+    from ltp.backend import BackendPool
+    from ltp.backend import SSHBackend
+    from ltp.backend import QemuBackend
+
+    backends = []
+
+    if args.qemu_image:
+        # VM console runs one command at time, so every worker has its own
+        # VM. VMs which crashed are replaced while the others keep running
+        def _qemu_factory():
+            return QemuBackend(
+                image=args.qemu_image,
+                kernel=args.qemu_kernel,
+                password=args.qemu_password,
+                reset=args.qemu_reset,
+                overlay=True)
+
+        backends.append(BackendPool(
+            _qemu_factory,
+            size=args.workers,
+            recycle=True))
+
+    for target in args.targets or []:
+        user, host, port = _parse_target(target)
+
+        def _factory(user=user, host=host, port=port):
+            return SSHBackend(
+                user=user,
+                host=host,
+                port=port,
+                key_file=args.ssh_key_file,
+                password=args.ssh_password)
+
+        backends.append(BackendPool(_factory, size=args.workers))
+
+    return backends
+
+
+def _shard(value: str) -> tuple:
+    """
+    Convert a "i/N" shard definition, where i starts from 1, into a
+    (index, count) tuple.
+    """
+    index, _, count = value.partition("/")
+
+    try:
+        index = int(index) - 1
+        count = int(count)
+    except ValueError as err:
+        raise argparse.ArgumentTypeError(
+            f"'{value}' must be in the i/N form") from err
+
+    if count < 1 or index < 0 or index >= count:
+        raise argparse.ArgumentTypeError(
+            f"'{value}' must be in the i/N form, with 1 <= i <= N")
+
+    return index, count
+
+
+def _positive(value: str) -> int:
+    """
+    Convert a number which must be greater than 0.
+    """
+    try:
+        number = int(value)
+    except ValueError as err:
+        raise argparse.ArgumentTypeError(
+            f"'{value}' is not a valid number") from err
+
+    if number < 1:
+        raise argparse.ArgumentTypeError(
+            f"'{value}' must be greater than 0")
+
+    return number
+
+
+def _size(value: str) -> int:
+    """
+    Convert a size with an optional K, M or G suffix into bytes.
+    """
+    units = {"K": 1 << 10, "M": 1 << 20, "G": 1 << 30}
+
+    multiplier = units.get(value[-1:].upper(), None)
+    if multiplier:
+        value = value[:-1]
+
+    try:
+        size = int(value) * (multiplier or 1)
+    except ValueError as err:
+        raise argparse.ArgumentTypeError(
+            f"'{value}' is not a valid size") from err
+
+    if size <= 0:
+        raise argparse.ArgumentTypeError("size must be greater than 0")
+
+    return size
+
+
 def _ltp_run(args: Namespace) -> None:
     """
     Handle "run" subcommand.
     """
-    session = LTPSession()
+    # launcher is started first, while runner is still small
+    launcher = None
+    if args.launcher:
+        launcher = LTPLauncher()
+        launcher.start()
 
-    if args.default:
-        session.run_scenario(scenario="default")
-    elif args.network:
-        session.run_scenario(scenario="network")
-    elif args.all:
-        session.run()
-    elif args.suites:
-        session.run(args.suites)
+    try:
+        _run_session(args, launcher)
+    finally:
+        if launcher:
+            launcher.stop()
+
+
+def _run_session(args: Namespace, launcher: LTPLauncher) -> None:
+    """
+    Run the session of the "run" subcommand.
+    """
+    history = None
+    if args.history:
+        history = LTPHistory()
+        for path in args.history:
+            history.load(path)
+
+    # console shows the lines dropped by rate as soon as tests complete
+    reporters = [args.output_filter]
+    if args.jsonl_report:
+        reporters.append(JSONLReporter(args.jsonl_report))
+    if args.junit_report:
+        reporters.append(JUnitReporter(args.junit_report))
+    if args.archive_report:
+        reporters.append(ArchiveReporter(args.archive_report))
+
+    journal = None
+    if args.resume:
+        journal = LTPJournal(args.resume, resume=True)
+    elif args.journal:
+        journal = LTPJournal(args.journal)
+
+    limits = {
+        "memory": args.memory_limit,
+        "cpu": args.cpu_limit,
+        "pids": args.pids_limit,
+    }
+    has_limits = any(limits.values())
+
+    if has_limits and args.no_cgroups:
+        raise ValueError("limits can't be applied without cgroups")
+
+    remote = args.targets or args.qemu_image
+    if has_limits and remote:
+        raise ValueError("limits can be applied on the local host only")
+
+    # tests resources are read from their cgroups, when available. Tests
+    # running on targets don't use the local host cgroups
+    cgroups = None
+    if args.cgroup_root and not remote:
+        cgroups = CgroupTree(args.cgroup_root, limits=limits)
+    elif not args.no_cgroups and not remote:
+        cgroups = CgroupTree.discover(limits=limits)
+        if not cgroups and has_limits:
+            raise ValueError(
+                "limits need a writable cgroup v2, see --cgroup-root")
+
+    result_cache = None
+    if args.changed and not args.change_map:
+        raise ValueError("--changed needs --change-map")
+
+    if args.result_cache:
+        if remote:
+            raise ValueError(
+                "results cache can be used on the local host only")
+
+        affected = None
+        if args.change_map:
+            with open(args.change_map, "r", encoding="utf-8") as data:
+                affected = affected_suites(json.load(data), args.changed)
+
+        result_cache = LTPResultCache(
+            args.result_cache,
+            config=args.kernel_config,
+            affected=affected)
+
+    selection = LTPSelection(
+        include=args.include,
+        exclude=args.skip_tests,
+        skip_file=args.skip_file)
+
+    breaker = CircuitBreaker(
+        max_broken=args.max_broken,
+        max_errors=args.max_errors,
+        health_cmd=args.health_check,
+        health_interval=args.health_interval,
+        health_timeout=args.health_timeout,
+        action=args.on_trip)
+
+    backends = None
+    if remote:
+        backends = _create_backends(args)
+
+    session = LTPSession(
+        exclusive=args.exclusive,
+        spool_dir=args.spool_dir or tempfile.gettempdir(),
+        backends=backends,
+        history=history,
+        shard=args.shard,
+        cache_file=_cache_file(),
+        reporters=reporters,
+        journal=journal,
+        test_timeout=args.test_timeout,
+        session_timeout=args.session_timeout,
+        cgroups=cgroups,
+        result_cache=result_cache,
+        selection=selection,
+        breaker=breaker,
+        launcher=launcher)
+
+    metrics = None
+    started = []
+
+    try:
+        if args.metrics_port is not None or args.metrics_socket:
+            metrics = MetricsServer(
+                session.progress,
+                port=args.metrics_port,
+                address=args.metrics_address,
+                socket_path=args.metrics_socket)
+            metrics.start()
+
+        # only the started backends are stopped, if one of them fails
+        for backend in backends or []:
+            backend.start()
+            started.append(backend)
+
+        if args.default:
+            session.run_scenario(scenario="default", workers=args.workers)
+        elif args.network:
+            session.run_scenario(scenario="network", workers=args.workers)
+        elif args.scenario:
+            session.run_scenario(scenario=args.scenario, workers=args.workers)
+        elif args.all:
+            session.run(workers=args.workers)
+        elif args.suites:
+            session.run(args.suites, workers=args.workers)
+    finally:
+        for backend in started:
+            backend.stop()
+
+        if metrics:
+            metrics.stop()
 
     _print_results(session)
 
@@ -102,30 +413,146 @@ def _ltp_run(args: Namespace) -> None:
         export_to_json(session, args.json_report)
 
 
+def _ltp_convert(args: Namespace) -> None:
+    """
+    Handle "convert" subcommand.
+    """
+    if is_archive(args.source):
+        archive_to_json(args.source, args.destination)
+    else:
+        json_to_archive(args.source, args.destination)
+
+
+def _print_comparison(results: dict) -> None:
+    """
+    Print comparison results.
+    """
+    logger = logging.getLogger("ltp.main")
+
+    logger.info("")
+    logger.info(
+        "Compared %d baseline and %d new reports: %d tests",
+        results["reports"]["baseline"],
+        results["reports"]["new"],
+        results["tests"])
+
+    sections = [
+        ("New failures", "new_failures"),
+        ("Fixes", "fixes"),
+        ("Changed", "changed"),
+    ]
+    for title, key in sections:
+        logger.info("%s: %d", title, len(results[key]))
+        for change in results[key]:
+            logger.info(
+                "    %s (%s -> %s)",
+                change["test"],
+                change["baseline"],
+                change["new"])
+
+    logger.info("Flaky: %d", len(results["flaky"]))
+    for flaky in results["flaky"]:
+        logger.info(
+            "    %s (%s -> %s)",
+            flaky["test"],
+            "/".join(flaky["baseline"]),
+            "/".join(flaky["new"]))
+
+    logger.info("Runtime regressions: %d", len(results["runtime_regressions"]))
+    for slow in results["runtime_regressions"]:
+        logger.info(
+            "    %s (%.1fs -> %.1fs)",
+            slow["test"],
+            slow["baseline"],
+            slow["new"])
+
+    logger.info("Added: %d", len(results["added"]))
+    logger.info("Removed: %d", len(results["removed"]))
+    logger.info("")
+
+
+def _ltp_compare(args: Namespace) -> None:
+    """
+    Handle "compare" subcommand.
+    """
+    baseline = list(args.baseline or [])
+    new = list(args.new or [])
+
+    # the first report is the baseline, when it's not given apart
+    reports = list(args.reports or [])
+    if reports and not baseline:
+        baseline.append(reports.pop(0))
+    new.extend(reports)
+
+    if not baseline or not new:
+        raise ValueError("compare needs baseline and new reports")
+
+    results = compare_reports(
+        baseline,
+        new,
+        threshold=args.threshold,
+        min_delta=args.min_delta)
+
+    _print_comparison(results)
+
+    if args.json_output:
+        with open(args.json_output, "w", encoding="UTF-8") as outfile:
+            json.dump(results, outfile, indent=4)
+
+
 def _ltp_install(args: Namespace) -> None:
     """
     Handle "install" subcommand.
     """
+    if args.targets:
+        # libssh is needed only when installing on remote targets
+        # pylint: disable=import-outside-toplevel
+        from ltp.backend import SSHBackend
+
+        backends = []
+        for target in args.targets:
+            user, host, port = _parse_target(target)
+            backends.append(SSHBackend(
+                user=user,
+                host=host,
+                port=port,
+                key_file=args.ssh_key_file,
+                password=args.ssh_password))
+
+        ltp.install.install_targets(
+            backends,
+            args.m32,
+            args.repo_url,
+            args.repo_dir,
+            args.install_dir,
+            revision=args.revision,
+            artifacts=args.artifacts,
+            ccache=args.ccache)
+        return
+
     installer = ltp.install.get_installer()
     installer.install(
         args.m32,
         args.repo_url,
         args.repo_dir,
-        args.install_dir)
+        args.install_dir,
+        revision=args.revision,
+        artifacts=args.artifacts,
+        ccache=args.ccache)
 
 
 def run() -> None:
     """
     Entry point of the application.
     """
-    _init_logging()
+    sink = _init_logging()
 
     parser = argparse.ArgumentParser(description='LTP next-gen runner')
     subparsers = parser.add_subparsers()
 
     # run subcommand parsing
     run_parser = subparsers.add_parser("run")
-    run_parser.set_defaults(func=_ltp_run)
+    run_parser.set_defaults(func=_ltp_run, output_filter=sink.output_filter)
     run_parser.add_argument(
         "--all",
         "-a",
@@ -141,17 +568,286 @@ def run() -> None:
         "-n",
         action="store_true",
         help="run network testing scenario")
+    run_parser.add_argument(
+        "--scenario",
+        type=str,
+        help="run the suites of a scenario file inside scenario_groups")
     run_parser.add_argument(
         "--suites",
         "-s",
         type=str,
         nargs="*",
         help="testing suites to run")
+    run_parser.add_argument(
+        "--include",
+        "-i",
+        type=str,
+        nargs="*",
+        help="run only the tests matching one of the patterns. Patterns are "
+        "test names, globs such as 'mmap*', suite qualified globs such as "
+        "'syscalls:mmap*' or regexes prefixed by 're:'")
+    run_parser.add_argument(
+        "--skip-tests",
+        "-e",
+        type=str,
+        nargs="*",
+        dest="skip_tests",
+        help="don't run the tests matching one of the patterns")
+    run_parser.add_argument(
+        "--skip-file",
+        type=str,
+        dest="skip_file",
+        help="file containing the patterns of the tests which don't run, "
+        "one per line")
     run_parser.add_argument(
         "--json-report",
         "-j",
         type=str,
         help="JSON output report")
+    run_parser.add_argument(
+        "--jsonl-report",
+        type=str,
+        dest="jsonl_report",
+        help="JSON lines output report, written while tests are running")
+    run_parser.add_argument(
+        "--junit-report",
+        type=str,
+        dest="junit_report",
+        help="JUnit XML output report, written while tests are running")
+    run_parser.add_argument(
+        "--archive-report",
+        type=str,
+        dest="archive_report",
+        help="compressed results archive, written while tests are running")
+    run_parser.add_argument(
+        "--workers",
+        "-w",
+        type=_positive,
+        default=1,
+        help="number of tests which can run at the same time")
+    run_parser.add_argument(
+        "--exclusive",
+        "-x",
+        type=str,
+        nargs="*",
+        help="tests or testing suites which can't run together "
+        "with other tests")
+    run_parser.add_argument(
+        "--test-timeout",
+        type=int,
+        dest="test_timeout",
+        help="seconds before a test is killed and reported as broken")
+    run_parser.add_argument(
+        "--session-timeout",
+        type=int,
+        dest="session_timeout",
+        help="seconds before the whole session is stopped")
+    run_parser.add_argument(
+        "--cgroup-root",
+        type=str,
+        dest="cgroup_root",
+        help="delegated cgroup v2 directory where tests cgroups are "
+        "created (default: runner cgroup)")
+    run_parser.add_argument(
+        "--no-cgroups",
+        action="store_true",
+        dest="no_cgroups",
+        help="don't run tests inside their own cgroups")
+    run_parser.add_argument(
+        "--launcher",
+        action="store_true",
+        dest="launcher",
+        help="spawn local tests from a small resident process, so spawn "
+        "time doesn't grow with the runner memory")
+    run_parser.add_argument(
+        "--memory-limit",
+        type=_size,
+        dest="memory_limit",
+        help="memory which can be used by each test, such as 512M. Tests "
+        "killed by the OOM killer are reported apart")
+    run_parser.add_argument(
+        "--cpu-limit",
+        type=float,
+        dest="cpu_limit",
+        help="number of CPUs which can be used by each test, such as 1.5")
+    run_parser.add_argument(
+        "--pids-limit",
+        type=int,
+        dest="pids_limit",
+        help="number of processes which can be spawned by each test")
+    run_parser.add_argument(
+        "--console-output",
+        type=str,
+        default="all",
+        choices=["all", "none"],
+        dest="console_output",
+        help="tests stdout shown on console. It's always written inside "
+        "the debug log (default: all)")
+    run_parser.add_argument(
+        "--console-tests",
+        type=str,
+        nargs="*",
+        dest="console_tests",
+        help="show on console the stdout of the tests matching these glob "
+        "patterns only")
+    run_parser.add_argument(
+        "--console-rate",
+        type=int,
+        default=0,
+        dest="console_rate",
+        help="maximum number of stdout lines per second shown on console "
+        "for each test. If 0, all lines are shown (default: 0)")
+    run_parser.add_argument(
+        "--spool-dir",
+        type=str,
+        dest="spool_dir",
+        help="directory where tests output is stored (default: TMPDIR)")
+    run_parser.add_argument(
+        "--targets",
+        "-t",
+        type=str,
+        nargs="*",
+        help="run tests on remote targets via SSH, in the "
+        "user@host[:port] form. LTP must be installed in the same LTPROOT")
+    run_parser.add_argument(
+        "--ssh-key-file",
+        type=str,
+        dest="ssh_key_file",
+        help="private key used to authenticate on targets")
+    run_parser.add_argument(
+        "--ssh-password",
+        type=str,
+        dest="ssh_password",
+        help="password used to authenticate on targets")
+    run_parser.add_argument(
+        "--qemu-image",
+        type=str,
+        dest="qemu_image",
+        help="run tests inside a Qemu VM booted from this image, which is "
+        "never modified. LTP must be installed in the same LTPROOT")
+    run_parser.add_argument(
+        "--qemu-kernel",
+        type=str,
+        dest="qemu_kernel",
+        help="kernel booted by the Qemu VM")
+    run_parser.add_argument(
+        "--qemu-password",
+        type=str,
+        dest="qemu_password",
+        help="root password of the Qemu VM")
+    run_parser.add_argument(
+        "--qemu-reset",
+        type=str,
+        dest="qemu_reset",
+        default="taint",
+        choices=["always", "failure", "taint", "never"],
+        help="when the Qemu VM is restored from its clean snapshot "
+        "(default: taint)")
+    run_parser.add_argument(
+        "--history",
+        type=str,
+        nargs="*",
+        help="JSON reports of previous runs, used to run longest tests "
+        "first and to balance shards")
+    run_parser.add_argument(
+        "--journal",
+        type=str,
+        help="journal where completed tests are stored, which can be used "
+        "to resume an interrupted session")
+    run_parser.add_argument(
+        "--resume",
+        type=str,
+        help="resume a session from its journal, skipping tests which "
+        "already have results. New results are appended to the journal")
+    run_parser.add_argument(
+        "--shard",
+        type=_shard,
+        help="run only the i-th of N shards of tests, in the i/N form")
+    run_parser.add_argument(
+        "--max-broken",
+        type=int,
+        dest="max_broken",
+        default=0,
+        help="consecutive broken tests after which a target stops running "
+        "tests (default: 0, never stop)")
+    run_parser.add_argument(
+        "--max-errors",
+        type=int,
+        dest="max_errors",
+        default=0,
+        help="consecutive backend errors after which a target stops "
+        "running tests (default: 0, never stop)")
+    run_parser.add_argument(
+        "--health-check",
+        type=str,
+        dest="health_check",
+        help="command checking the target health between tests, such as "
+        "'touch /tmp/.health'. A target failing it stops running tests")
+    run_parser.add_argument(
+        "--health-interval",
+        type=int,
+        dest="health_interval",
+        default=1,
+        help="tests executed between two health checks (default: 1)")
+    run_parser.add_argument(
+        "--health-timeout",
+        type=int,
+        dest="health_timeout",
+        default=60,
+        help="seconds before health check fails (default: 60)")
+    run_parser.add_argument(
+        "--on-trip",
+        type=str,
+        dest="on_trip",
+        default="abort",
+        choices=CircuitBreaker.ACTIONS,
+        help="what happens to a target which hit --max-broken, --max-errors "
+        "or failed its health check. 'reset' restores Qemu VMs from their "
+        "clean snapshot before giving up (default: abort)")
+    run_parser.add_argument(
+        "--result-cache",
+        type=str,
+        dest="result_cache",
+        help="cache of the tests results. Tests whose kernel, binary and "
+        "arguments didn't change reuse their cached results")
+    run_parser.add_argument(
+        "--kernel-config",
+        type=str,
+        dest="kernel_config",
+        help="kernel configuration used by --result-cache (default: "
+        "/proc/config.gz or /boot/config-<release>)")
+    run_parser.add_argument(
+        "--change-map",
+        type=str,
+        dest="change_map",
+        help="JSON file mapping glob patterns of the changed paths to the "
+        "suites testing them, used by --result-cache")
+    run_parser.add_argument(
+        "--changed",
+        type=str,
+        nargs="*",
+        help="paths changed since the cached results, such as the output of "
+        "'git diff --name-only'. Only suites mapped by --change-map rerun "
+        "because of the kernel change")
+    run_parser.add_argument(
+        "--metrics-port",
+        type=int,
+        dest="metrics_port",
+        help="TCP port where session progress is served in Prometheus "
+        "format on /metrics and in JSON format on /progress")
+    run_parser.add_argument(
+        "--metrics-address",
+        type=str,
+        dest="metrics_address",
+        default="127.0.0.1",
+        help="address where session progress is served (default: "
+        "127.0.0.1)")
+    run_parser.add_argument(
+        "--metrics-socket",
+        type=str,
+        dest="metrics_socket",
+        help="Unix socket where session progress is served, when "
+        "--metrics-port is not given")
 
     # list subcommand parsing
     list_parser = subparsers.add_parser("list")
@@ -166,6 +862,10 @@ def run() -> None:
         "-n",
         action="store_true",
         help="list network testing scenario")
+    list_parser.add_argument(
+        "--scenario",
+        type=str,
+        help="list the suites of a scenario file inside scenario_groups")
 
     # install subcommand parsing
     ins_parser = subparsers.add_parser("install")
@@ -189,14 +889,118 @@ def run() -> None:
         default="/opt/ltp",
         dest="install_dir",
         help="directory where LTP will be installed")
+    ins_parser.add_argument(
+        "--m32",
+        action="store_true",
+        help="Install LTP with 32bit support")
+    ins_parser.add_argument(
+        "--revision",
+        type=str,
+        default=None,
+        help="LTP commit to install. Default is the repository HEAD")
+    ins_parser.add_argument(
+        "--artifacts",
+        type=str,
+        default=None,
+        help="Directory or URL of prebuilt LTP tarballs. Already built "
+        "revisions are extracted instead of being compiled")
+    ins_parser.add_argument(
+        "--ccache",
+        action="store_true",
+        help="Compile LTP using ccache")
+    ins_parser.add_argument(
+        "--targets",
+        "-t",
+        type=str,
+        nargs="*",
+        help="install LTP on remote targets via SSH, in the "
+        "user@host[:port] form. LTP is built on the local host, which must "
+        "run the same distro")
+    ins_parser.add_argument(
+        "--ssh-key-file",
+        type=str,
+        dest="ssh_key_file",
+        help="private key used to authenticate on targets")
+    ins_parser.add_argument(
+        "--ssh-password",
+        type=str,
+        dest="ssh_password",
+        help="password used to authenticate on targets")
+
+    # convert subcommand parsing
+    conv_parser = subparsers.add_parser("convert")
+    conv_parser.set_defaults(func=_ltp_convert)
+    conv_parser.add_argument(
+        "source",
+        metavar="SOURCE",
+        type=str,
+        help="JSON report converted into a results archive, or results "
+        "archive converted into a JSON report")
+    conv_parser.add_argument(
+        "destination",
+        metavar="DESTINATION",
+        type=str,
+        help="converted file")
+
+    # compare subcommand parsing
+    cmp_parser = subparsers.add_parser("compare")
+    cmp_parser.set_defaults(func=_ltp_compare)
+    cmp_parser.add_argument(
+        "reports",
+        metavar="REPORT",
+        type=str,
+        nargs="*",
+        help="JSON reports, JSON lines reports or results archives. The "
+        "first one is the baseline, unless --baseline is given")
+    cmp_parser.add_argument(
+        "--baseline",
+        "-b",
+        type=str,
+        nargs="+",
+        help="baseline reports, which are reruns of the same session")
+    cmp_parser.add_argument(
+        "--new",
+        "-n",
+        type=str,
+        nargs="+",
+        help="new reports compared with the baseline, which are reruns of "
+        "the same session")
+    cmp_parser.add_argument(
+        "--threshold",
+        type=float,
+        default=0.5,
+        help="relative increase of a test duration reported as runtime "
+        "regression (default: 0.5)")
+    cmp_parser.add_argument(
+        "--min-delta",
+        type=float,
+        default=1.0,
+        dest="min_delta",
+        help="seconds added to a test duration before it's reported as "
+        "runtime regression (default: 1.0)")
+    cmp_parser.add_argument(
+        "--json-output",
+        "-j",
+        type=str,
+        dest="json_output",
+        help="JSON file where comparison results are written")
 
     # show-deps subcommand parsing
     deps_parser = subparsers.add_parser("show-deps")
     ltp.install.init_cmdline(deps_parser)
 
-    args = parser.parse_args()
+    try:
+        args = parser.parse_args()
 
-    if hasattr(args, "func"):
-        args.func(args)
-    else:
-        parser.print_help()
+        if hasattr(args, "console_output"):
+            sink.output_filter.configure(
+                enabled=args.console_output == "all",
+                patterns=args.console_tests,
+                rate=args.console_rate)
+
+        if hasattr(args, "func"):
+            args.func(args)
+        else:
+            parser.print_help()
+    finally:
+        sink.stop()
@@ -6,53 +6,123 @@
 .. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
 """
 import os
+import json
 import logging
+import tempfile
 from .base import Metadata
 from .base import MetadataError
 
 
 class RuntestMetadata(Metadata):
     """
-    Metadata implementation to handle a LTP runtest file.
+    Metadata implementation to handle a LTP runtest file. Suites and tests
+    are indexed by name, so they can be read without scanning all runtest
+    files. The index can be stored inside a cache file, which is used until
+    runtest files are modified.
     """
 
-    def __init__(self, folder: str) -> None:
+    # version of the cache file format
+    CACHE_VERSION = 1
+
+    def __init__(self, folder: str, cache_file: str = None) -> None:
         """
         :param folder: runtest LTP folder
         :type folder: str
+        :param cache_file: file where the index is cached. If None, runtest
+            files are always parsed
+        :type cache_file: str
         """
         self._logger = logging.getLogger("ltp.metadata.runtest")
-        self._suites = []
-        self._avail_tests = []
-        self._avail_suites = []
+        self._folder = folder
+        self._cache_file = cache_file
+        self._suites = {}
+        self._tests = {}
         self._collect(folder)
 
-    def _collect(self, folder: str) -> dict:
+    @staticmethod
+    def _stats(folder: str) -> dict:
         """
-        Collect all the available testing suites.
+        Return modification time and size of the runtest files.
         """
-        self._logger.info("Collecting testing suites")
+        stats = {}
 
-        suite_paths = [os.path.join(folder, fname)
-                       for fname in os.listdir(folder)
-                       if os.path.isfile(os.path.join(folder, fname))]
+        for fname in sorted(os.listdir(folder)):
+            fpath = os.path.join(folder, fname)
+            if not os.path.isfile(fpath):
+                continue
 
-        self._logger.debug("suites paths: %s", suite_paths)
+            stat = os.stat(fpath)
+            stats[fname] = [stat.st_mtime_ns, stat.st_size]
 
-        # collect all testing suites
-        self._suites.clear()
+        return stats
 
-        for suite_path in suite_paths:
-            suite_name = os.path.basename(suite_path)
-            tests = []
+    def _read_cache(self, stats: dict) -> list:
+        """
+        Read the suites from the cache file. If cache is missing or runtest
+        files have been modified, None is returned.
+        """
+        if not self._cache_file or not os.path.isfile(self._cache_file):
+            return None
+
+        try:
+            with open(self._cache_file, "r", encoding='UTF-8') as data:
+                cache = json.load(data)
+        except (OSError, ValueError) as err:
+            self._logger.warning("Can't read metadata cache: %s", err)
+            return None
 
-            self._logger.info("Collecting '%s' suite tests", suite_name)
+        if cache.get("version", None) != self.CACHE_VERSION or \
+                cache.get("folder", None) != self._folder or \
+                cache.get("stats", None) != stats:
+            self._logger.debug("metadata cache is outdated")
+            return None
 
-            lines = []
-            with open(suite_path, "r", encoding='UTF-8') as data:
-                lines = data.readlines()
+        return cache.get("suites", None)
 
-            for line in lines:
+    def _write_cache(self, stats: dict, suites: list) -> None:
+        """
+        Write the suites inside the cache file.
+        """
+        if not self._cache_file:
+            return
+
+        cache = {
+            "version": self.CACHE_VERSION,
+            "folder": self._folder,
+            "stats": stats,
+            "suites": suites,
+        }
+
+        cache_dir = os.path.dirname(os.path.abspath(self._cache_file))
+
+        try:
+            os.makedirs(cache_dir, exist_ok=True)
+
+            # replace cache atomically, so concurrent sessions never read
+            # an incomplete file
+            fd, tmp_path = tempfile.mkstemp(dir=cache_dir)
+            try:
+                with os.fdopen(fd, "w", encoding='UTF-8') as data:
+                    json.dump(cache, data)
+
+                os.replace(tmp_path, self._cache_file)
+            except BaseException:
+                os.remove(tmp_path)
+                raise
+        except OSError as err:
+            self._logger.warning("Can't write metadata cache: %s", err)
+
+    def _parse_suite(self, suite_path: str) -> dict:
+        """
+        Parse a runtest file.
+        """
+        suite_name = os.path.basename(suite_path)
+        tests = []
+
+        self._logger.info("Collecting '%s' suite tests", suite_name)
+
+        with open(suite_path, "r", encoding='UTF-8') as data:
+            for line in data:
                 if not line.strip() or line.strip().startswith("#"):
                     continue
 
@@ -66,66 +136,86 @@ class RuntestMetadata(Metadata):
                 test_data = dict(
                     name=parts[0],
                     command=parts[1],
-                    arguments=[]
+                    arguments=parts[2:]
                 )
 
                 self._logger.debug("test data: %s", test_data)
 
-                if len(parts) >= 3:
-                    test_data["arguments"] = parts[2:]
-
                 tests.append(test_data)
 
-            self._logger.debug("Collected %d tests", len(tests))
+        self._logger.debug("Collected %d tests", len(tests))
+
+        return {
+            "name": suite_name,
+            "tests": tests
+        }
+
+    def _collect(self, folder: str) -> None:
+        """
+        Collect all the available testing suites.
+        """
+        self._logger.info("Collecting testing suites")
+
+        stats = self._stats(folder)
 
-            suite_data = {
-                "name": suite_name,
-                "tests": tests
-            }
-            self._suites.append(suite_data)
+        suites = self._read_cache(stats)
+        if suites is None:
+            suites = [
+                self._parse_suite(os.path.join(folder, fname))
+                for fname in stats
+            ]
+            self._write_cache(stats, suites)
+        else:
+            self._logger.debug("suites read from %s", self._cache_file)
 
-        # populate available suites and tests
-        self._avail_suites = [suite["name"] for suite in self._suites]
-        self._avail_tests.clear()
+        self._suites.clear()
+        self._tests.clear()
 
-        for suite in self._suites:
-            tests = [test["name"] for test in suite["tests"]]
-            self._avail_tests.extend(tests)
+        for suite in suites:
+            self._suites[suite["name"]] = suite
+
+            # the first declaration of a test is the one which is read
+            for test in suite["tests"]:
+                self._tests.setdefault(test["name"], test)
 
         self._logger.info("Collected %d testing suites", len(self._suites))
 
     @property
     def available_suites(self):
-        return self._avail_suites
+        return list(self._suites)
 
     @property
     def available_tests(self):
-        return self._avail_tests
+        return list(self._tests)
 
-    def _read_test_impl(self, name: str):
-        if name not in self._avail_tests:
-            raise ValueError(f"'{name}' test is not available")
+    def has_suite(self, name: str) -> bool:
+        """
+        True if the testing suite is available.
+        :param name: name of the testing suite
+        :type name: str
+        :returns: bool
+        """
+        return name in self._suites
 
-        mytest = None
-        for suite in self._suites:
-            for test in suite["tests"]:
-                if name == test["name"]:
-                    mytest = test
-                    break
+    def has_test(self, name: str) -> bool:
+        """
+        True if the test is available.
+        :param name: name of the test
+        :type name: str
+        :returns: bool
+        """
+        return name in self._tests
 
-            if mytest:
-                break
+    def _read_test_impl(self, name: str):
+        test = self._tests.get(name, None)
+        if not test:
+            raise ValueError(f"'{name}' test is not available")
 
-        return mytest
+        return test
 
     def _read_suite_impl(self, name: str):
-        if name not in self._avail_suites:
+        suite = self._suites.get(name, None)
+        if not suite:
             raise ValueError(f"'{name}' suite is not available")
 
-        mysuite = None
-        for suite in self._suites:
-            if name == suite["name"]:
-                mysuite = suite
-                break
-
-        return mysuite
+        return suite
@@ -0,0 +1,493 @@
+"""
+.. module:: metrics
+    :platform: Linux
+    :synopsis: module publishing live progress of a session
+
+.. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
+"""
+import os
+import json
+import time
+import math
+import logging
+import threading
+import socketserver
+from http.server import HTTPServer
+from http.server import BaseHTTPRequestHandler
+
+
+def _status(test) -> str:
+    """
+    Status of a completed test: "broken", "failed", "passed" or "skipped".
+    """
+    if test.broken or test.timed_out:
+        return "broken"
+
+    if test.failed:
+        return "failed"
+
+    if test.skipped and not test.passed:
+        return "skipped"
+
+    return "passed"
+
+
+class LTPProgress:
+    """
+    Live counters of a running session. They are updated by the session
+    workers and they can be read at any time by `snapshot`, without
+    waiting for the session to complete.
+    """
+
+    STATUSES = ["passed", "failed", "broken", "skipped"]
+
+    def __init__(self) -> None:
+        self._lock = threading.Lock()
+        self._running = False
+        self._start = None
+        self._stop = None
+        self._slots = 1
+        self._history = None
+        self._pending = {}
+        self._total = 0
+        self._done = 0
+        self._restored = 0
+        self._statuses = dict.fromkeys(self.STATUSES, 0)
+        self._targets = {}
+        self._workers = {}
+        self._durations = 0.0
+        self._last_completed = None
+
+    def _expected(self, suite: str, test: str) -> float:
+        """
+        Expected duration of a test according with history. None if it's
+        not known.
+        """
+        if not self._history or not len(self._history):
+            return None
+
+        return self._history.duration(suite, test)
+
+    def start(self,
+              tests: list,
+              slots: int = 1,
+              history=None) -> None:
+        """
+        Reset counters for a session which is going to run.
+        :param tests: (suite name, test name) of the tests which are going
+            to run
+        :type tests: list(tuple)
+        :param slots: number of tests which can run at the same time
+        :type slots: int
+        :param history: durations of the previous runs, used to estimate
+            when session will complete. If None, durations of the tests
+            which already completed are used
+        :type history: LTPHistory
+        """
+        with self._lock:
+            self._running = True
+            self._start = time.monotonic()
+            self._stop = None
+            self._slots = max(1, slots)
+            self._history = history
+            self._pending = {
+                key: self._expected(*key) for key in tests
+            }
+            self._total = len(self._pending)
+            self._done = 0
+            self._restored = 0
+            self._statuses = dict.fromkeys(self.STATUSES, 0)
+            self._targets.clear()
+            self._workers.clear()
+            self._durations = 0.0
+            self._last_completed = None
+
+    def stop(self) -> None:
+        """
+        Mark the session as completed. Tests which didn't run are still
+        reported as remaining.
+        """
+        with self._lock:
+            self._running = False
+            self._stop = time.monotonic()
+
+            for worker in self._workers.values():
+                worker["test"] = None
+
+    @staticmethod
+    def _worker() -> str:
+        """
+        Name of the worker calling the progress.
+        """
+        return threading.current_thread().name
+
+    def test_started(self, suite, test, backend=None) -> None:
+        """
+        Register a test which started on the current worker.
+        :param suite: suite of the test
+        :type suite: LTPSuite
+        :param test: test which is going to run
+        :type test: LTPTest
+        :param backend: backend where test runs. None for the local host
+        :type backend: Backend
+        """
+        with self._lock:
+            self._workers[self._worker()] = {
+                "target": backend.target if backend else "local",
+                "suite": suite.name,
+                "test": test.name,
+                "since": time.monotonic(),
+            }
+
+    def test_restored(self, suite, test) -> None:
+        """
+        Register a test which has been restored from the journal or from
+        the results cache, instead of running.
+        :param suite: suite of the test
+        :type suite: LTPSuite
+        :param test: restored test
+        :type test: LTPTest
+        """
+        # pylint: disable=unused-argument
+        target = test.target or "local"
+
+        with self._lock:
+            self._restored += 1
+            self._statuses[_status(test)] += 1
+            self._targets[target] = self._targets.get(target, 0) + 1
+
+    def test_completed(self, suite, test) -> None:
+        """
+        Register a test which completed on the current worker.
+        :param suite: suite of the test
+        :type suite: LTPSuite
+        :param test: completed test
+        :type test: LTPTest
+        """
+        target = test.target or "local"
+
+        with self._lock:
+            worker = self._workers.get(self._worker(), None)
+            if worker:
+                worker["test"] = None
+
+            key = (suite.name, test.name)
+            if key not in self._pending:
+                return
+
+            self._pending.pop(key)
+            self._done += 1
+            self._statuses[_status(test)] += 1
+            self._targets[target] = self._targets.get(target, 0) + 1
+            self._durations += test.duration
+            self._last_completed = time.time()
+
+    def _eta(self, now: float) -> float:
+        """
+        Seconds before the remaining tests complete. None if it can't be
+        estimated yet.
+        """
+        if not self._pending:
+            return 0.0
+
+        average = None
+        if self._done:
+            average = self._durations / self._done
+
+        running = {
+            (worker["suite"], worker["test"]): now - worker["since"]
+            for worker in self._workers.values() if worker["test"]
+        }
+
+        remaining = 0.0
+        for key, expected in self._pending.items():
+            if expected is None:
+                expected = average
+
+            if expected is None:
+                return None
+
+            remaining += max(0.0, expected - running.get(key, 0.0))
+
+        return remaining / self._slots
+
+    def snapshot(self) -> dict:
+        """
+        Current state of the session.
+        :returns: dict
+        """
+        with self._lock:
+            now = time.monotonic()
+
+            elapsed = 0.0
+            if self._start is not None:
+                elapsed = (self._stop or now) - self._start
+
+            workers = {}
+            for name, worker in self._workers.items():
+                busy = bool(worker["test"])
+                workers[name] = {
+                    "target": worker["target"],
+                    "suite": worker["suite"] if busy else None,
+                    "test": worker["test"],
+                    "elapsed": now - worker["since"] if busy else 0.0,
+                }
+
+            return {
+                "running": self._running,
+                "elapsed": elapsed,
+                "total": self._total,
+                "done": self._done,
+                "remaining": len(self._pending),
+                "restored": self._restored,
+                "statuses": dict(self._statuses),
+                "targets": dict(self._targets),
+                "workers": workers,
+                "eta": self._eta(now) if self._running else None,
+                "last_completed": self._last_completed,
+            }
+
+
+def _label(value: str) -> str:
+    """
+    Escape a Prometheus label value.
+    """
+    return str(value) \
+        .replace("\\", "\\\\") \
+        .replace("\"", "\\\"") \
+        .replace("\n", "\\n")
+
+
+def _value(value: float) -> str:
+    """
+    Format a Prometheus sample value.
+    """
+    if value is None or (isinstance(value, float) and math.isnan(value)):
+        return "NaN"
+
+    return repr(value)
+
+
+def to_prometheus(snapshot: dict) -> str:
+    """
+    Format a progress snapshot using Prometheus text exposition format.
+    :param snapshot: snapshot of LTPProgress
+    :type snapshot: dict
+    :returns: str
+    """
+    lines = []
+
+    def _metric(name, mtype, helptext, samples):
+        lines.append(f"# HELP {name} {helptext}")
+        lines.append(f"# TYPE {name} {mtype}")
+        for labels, value in samples:
+            text = ""
+            if labels:
+                text = ",".join(
+                    f'{key}="{_label(val)}"' for key, val in labels.items())
+                text = "{" + text + "}"
+
+            lines.append(f"{name}{text} {_value(value)}")
+
+    _metric("ltp_session_running", "gauge",
+            "1 if session is running",
+            [(None, int(snapshot["running"]))])
+    _metric("ltp_session_elapsed_seconds", "gauge",
+            "Seconds since session started",
+            [(None, snapshot["elapsed"])])
+    _metric("ltp_session_eta_seconds", "gauge",
+            "Estimated seconds before session completes",
+            [(None, snapshot["eta"])])
+    _metric("ltp_tests_total", "gauge",
+            "Tests scheduled in the session",
+            [(None, snapshot["total"])])
+    _metric("ltp_tests_remaining", "gauge",
+            "Tests which did not complete yet",
+            [(None, snapshot["remaining"])])
+    _metric("ltp_tests_restored_total", "counter",
+            "Tests restored from the journal or the results cache",
+            [(None, snapshot["restored"])])
+    _metric("ltp_tests_completed_total", "counter",
+            "Completed tests by status",
+            [({"status": status}, count)
+             for status, count in snapshot["statuses"].items()])
+    _metric("ltp_target_tests_completed_total", "counter",
+            "Completed tests by target",
+            [({"target": target}, count)
+             for target, count in sorted(snapshot["targets"].items())])
+    _metric("ltp_last_completed_timestamp_seconds", "gauge",
+            "Time when the last test completed",
+            [(None, snapshot["last_completed"] or 0)])
+
+    workers = sorted(snapshot["workers"].items())
+
+    _metric("ltp_worker_busy", "gauge",
+            "1 if worker is running a test",
+            [({"worker": name, "target": worker["target"]},
+              int(bool(worker["test"])))
+             for name, worker in workers])
+    _metric("ltp_worker_test_seconds", "gauge",
+            "Seconds since worker started its running test",
+            [({"worker": name,
+               "target": worker["target"],
+               "suite": worker["suite"],
+               "test": worker["test"]},
+              worker["elapsed"])
+             for name, worker in workers if worker["test"]])
+
+    return "\n".join(lines) + "\n"
+
+
+class _MetricsHandler(BaseHTTPRequestHandler):
+    """
+    Handler serving the progress of the server session.
+    """
+
+    def do_GET(self) -> None:
+        # pylint: disable=invalid-name
+        path = self.path.split("?", 1)[0]
+
+        if path in ["/", "/metrics"]:
+            body = to_prometheus(self.server.progress.snapshot())
+            ctype = "text/plain; version=0.0.4; charset=utf-8"
+        elif path == "/progress":
+            body = json.dumps(self.server.progress.snapshot())
+            ctype = "application/json"
+        else:
+            self.send_error(404)
+            return
+
+        data = body.encode("utf-8")
+
+        self.send_response(200)
+        self.send_header("Content-Type", ctype)
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+    def log_message(self, format: str, *args) -> None:
+        # pylint: disable=redefined-builtin
+        logging.getLogger("ltp.metrics").debug(format, *args)
+
+
+class _TCPServer(socketserver.ThreadingMixIn, HTTPServer):
+    """
+    HTTP server on a TCP port. ThreadingHTTPServer is not available before
+    python 3.7.
+    """
+    daemon_threads = True
+
+
+class _UnixServer(socketserver.ThreadingUnixStreamServer):
+    """
+    HTTP server on a Unix socket.
+    """
+    daemon_threads = True
+
+
+class MetricsServer:
+    """
+    Local HTTP endpoint publishing the progress of a session. Prometheus
+    metrics are served on "/metrics" and the progress snapshot as JSON on
+    "/progress". Endpoint can be a TCP port or a Unix socket:
+
+        curl http://localhost:9100/metrics
+        curl --unix-socket /run/ltp.sock http://localhost/progress
+    """
+
+    def __init__(self,
+                 progress: LTPProgress,
+                 port: int = None,
+                 address: str = "127.0.0.1",
+                 socket_path: str = None) -> None:
+        """
+        :param progress: progress of the session
+        :type progress: LTPProgress
+        :param port: TCP port where endpoint listens. If 0, a free port is
+            used
+        :type port: int
+        :param address: address where endpoint listens on TCP
+        :type address: str
+        :param socket_path: Unix socket where endpoint listens, if port is
+            not given
+        :type socket_path: str
+        """
+        if not progress:
+            raise ValueError("progress is empty")
+
+        if port is None and not socket_path:
+            raise ValueError("port or socket_path must be given")
+
+        if port is not None and (port < 0 or port > 65535):
+            raise ValueError("port must be between 0 and 65535")
+
+        self._logger = logging.getLogger("ltp.metrics")
+        self._progress = progress
+        self._port = port
+        self._address = address
+        self._socket_path = socket_path
+        self._server = None
+        self._thread = None
+
+    @property
+    def endpoint(self) -> str:
+        """
+        URL of the TCP endpoint or path of the Unix socket. None if server
+        is not running.
+        :returns: str
+        """
+        if not self._server:
+            return None
+
+        if self._port is None:
+            return self._socket_path
+
+        host, port = self._server.server_address[:2]
+        return f"http://{host}:{port}"
+
+    def start(self) -> None:
+        """
+        Start serving the session progress.
+        :raises: OSError
+        """
+        if self._server:
+            return
+
+        if self._port is None:
+            if os.path.exists(self._socket_path):
+                os.unlink(self._socket_path)
+
+            self._server = _UnixServer(self._socket_path, _MetricsHandler)
+        else:
+            self._server = _TCPServer(
+                (self._address, self._port), _MetricsHandler)
+
+        self._server.progress = self._progress
+
+        self._thread = threading.Thread(
+            target=self._server.serve_forever,
+            name="ltp-metrics",
+            daemon=True)
+        self._thread.start()
+
+        self._logger.info("Serving metrics on %s", self.endpoint)
+
+    def stop(self) -> None:
+        """
+        Stop serving the session progress.
+        """
+        if not self._server:
+            return
+
+        self._server.shutdown()
+        self._server.server_close()
+        self._thread.join()
+
+        if self._port is None:
+            try:
+                os.unlink(self._socket_path)
+            except FileNotFoundError:
+                pass
+
+        self._server = None
+        self._thread = None
@@ -0,0 +1,124 @@
+"""
+.. module:: output
+    :platform: Linux
+    :synopsis: module that contains tests output storage definition
+
+.. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
+"""
+import os
+from collections import deque
+
+
+class LTPOutput:
+    """
+    Storage for a test output. When a spool file is given, output is
+    streamed into it and only a bounded tail is kept in memory. Otherwise,
+    the whole output is kept in memory.
+    """
+
+    def __init__(self, path: str = None, tail_size: int = 65536) -> None:
+        """
+        :param path: spool file path. If None, output is kept in memory
+        :type path: str
+        :param tail_size: maximum number of characters kept in memory when
+            output is spooled into a file
+        :type tail_size: int
+        """
+        if tail_size <= 0:
+            raise ValueError("tail_size must be greater than 0")
+
+        self._path = path
+        self._tail_size = tail_size
+        self._tail = deque()
+        self._tail_len = 0
+        self._lines = []
+        self._file = None
+        self._size = 0
+
+    @property
+    def path(self) -> str:
+        """
+        Spool file path. None if output is kept in memory.
+        :returns: str
+        """
+        return self._path
+
+    @property
+    def size(self) -> int:
+        """
+        Number of characters which have been written. If nothing has been
+        written and the spool file already exists, its size is returned.
+        :returns: int
+        """
+        if not self._size and self._path and os.path.isfile(self._path):
+            return os.path.getsize(self._path)
+
+        return self._size
+
+    @property
+    def tail(self) -> str:
+        """
+        Last characters of the output. The whole output is returned when
+        no spool file is used.
+        :returns: str
+        """
+        if not self._path:
+            return "".join(self._lines)
+
+        return "".join(self._tail)
+
+    def write(self, data: str) -> None:
+        """
+        Append data to the output.
+        :param data: data to append
+        :type data: str
+        """
+        if not data:
+            return
+
+        self._size += len(data)
+
+        if not self._path:
+            self._lines.append(data)
+            return
+
+        if not self._file:
+            os.makedirs(os.path.dirname(self._path), exist_ok=True)
+
+            # pylint: disable=consider-using-with
+            self._file = open(self._path, "w", encoding="UTF-8")
+
+        self._file.write(data)
+
+        self._tail.append(data)
+        self._tail_len += len(data)
+
+        # always keep the last chunk, even if it's bigger than tail size
+        while len(self._tail) > 1 and \
+                self._tail_len - len(self._tail[0]) >= self._tail_size:
+            self._tail_len -= len(self._tail.popleft())
+
+    def close(self) -> None:
+        """
+        Flush and close the spool file.
+        """
+        if self._file:
+            self._file.close()
+            self._file = None
+
+    def read(self) -> str:
+        """
+        Read the whole output.
+        :returns: str
+        """
+        if not self._path:
+            return "".join(self._lines)
+
+        if self._file:
+            self._file.flush()
+
+        if not os.path.isfile(self._path):
+            return ""
+
+        with open(self._path, "r", encoding="UTF-8") as data:
+            return data.read()
@@ -0,0 +1,112 @@
+"""
+.. module:: parser
+    :platform: Linux
+    :synopsis: module that contains the LTP tests output parser
+
+.. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
+"""
+import re
+
+
+class LTPParser:
+    """
+    Line oriented parser of the LTP tests output. Results are updated every
+    time a TPASS, TFAIL, TBROK, TCONF or TWARN line is given, until the
+    "Summary:" block is completed. Then, summary results replace the ones
+    which have been counted.
+    """
+
+    # ANSI escape sequences used when LTP_COLORIZE_OUTPUT is enabled
+    _ANSI = re.compile(r"\x1b\[[0-9;]*m")
+
+    # the first tag of the line is the one reporting the result
+    _TAG = re.compile(r"\b(TPASS|TFAIL|TBROK|TCONF|TWARN|TINFO|TDEBUG)\b")
+
+    _SUMMARY_LINE = re.compile(
+        r"^(?P<key>passed|failed|broken|skipped|warnings)\s+(?P<value>\d+)$")
+
+    _TAGS = {
+        "TPASS": "passed",
+        "TFAIL": "failed",
+        "TBROK": "broken",
+        "TCONF": "skipped",
+        "TWARN": "warnings",
+    }
+
+    _KEYS = ["passed", "failed", "broken", "skipped", "warnings"]
+
+    def __init__(self) -> None:
+        self._results = dict.fromkeys(self._KEYS, 0)
+        self._summary = None
+        self._partial = None
+
+    @property
+    def summary(self) -> bool:
+        """
+        True if the "Summary:" block has been parsed.
+        :returns: bool
+        """
+        return self._summary is not None
+
+    @property
+    def results(self) -> dict:
+        """
+        Current results. Summary results are returned once the "Summary:"
+        block has been parsed.
+        :returns: dict
+            {
+                "passed": <int>,
+                "failed": <int>,
+                "broken": <int>,
+                "skipped": <int>,
+                "warnings": <int>,
+            }
+        """
+        if self._summary is not None:
+            return dict(self._summary)
+
+        return dict(self._results)
+
+    def feed(self, line: str) -> bool:
+        """
+        Parse a single line of the test output.
+        :param line: line of the test output
+        :type line: str
+        :returns: True if results have changed
+        """
+        if self._summary is not None:
+            return False
+
+        line = self._ANSI.sub("", line).strip()
+
+        if self._partial is not None:
+            match = self._SUMMARY_LINE.match(line)
+            if match:
+                self._partial[match.group("key")] = \
+                    int(match.group("value"))
+
+                if len(self._partial) == len(self._KEYS):
+                    self._summary = self._partial
+                    self._partial = None
+                    return True
+
+                return False
+
+            # that wasn't a summary block
+            self._partial = None
+
+        if line == "Summary:":
+            self._partial = {}
+            return False
+
+        match = self._TAG.search(line)
+        if not match:
+            return False
+
+        key = self._TAGS.get(match.group(1), None)
+        if not key:
+            return False
+
+        self._results[key] += 1
+
+        return True
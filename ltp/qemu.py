@@ -5,3 +5,808 @@
 
 .. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
 """
+import os
+import re
+import json
+import time
+import uuid
+import codecs
+import shutil
+import socket
+import select
+import logging
+import tempfile
+import threading
+import subprocess
+from collections import deque
+
+
+class QemuError(Exception):
+    """
+    Raised when an error occurs during Qemu VM handling.
+    """
+
+
+class QemuTimeoutError(QemuError):
+    """
+    Raised when a command didn't complete before its timeout.
+    """
+
+
+def _deadline(timeout: float) -> float:
+    """
+    Return the time when the timeout expires. If timeout is 0, None is
+    returned.
+    """
+    if not timeout or timeout <= 0:
+        return None
+
+    return time.monotonic() + timeout
+
+
+def _remaining(deadline: float) -> float:
+    """
+    Return the seconds left before deadline. None if there's no deadline.
+    """
+    if deadline is None:
+        return None
+
+    return max(0, deadline - time.monotonic())
+
+
+class QMPClient:
+    """
+    Client of the Qemu Machine Protocol, used to control the VM.
+    """
+
+    def __init__(self, path: str, timeout: int = 60) -> None:
+        """
+        :param path: path of the QMP unix socket
+        :type path: str
+        :param timeout: timeout of the QMP commands in seconds
+        :type timeout: int
+        """
+        self._logger = logging.getLogger("ltp.qemu.qmp")
+        self._path = path
+        self._timeout = timeout
+        self._sock = None
+        self._file = None
+        self._lock = threading.Lock()
+
+    def _read(self) -> dict:
+        """
+        Read the next QMP message, skipping asynchronous events.
+        """
+        while True:
+            try:
+                line = self._file.readline()
+            except socket.timeout as err:
+                raise QemuError("QMP command timed out") from err
+
+            if not line:
+                raise QemuError("QMP connection closed")
+
+            data = json.loads(line)
+            if "event" in data:
+                self._logger.debug("event: %s", data)
+                continue
+
+            return data
+
+    def connect(self) -> None:
+        """
+        Connect to the QMP socket and enable commands.
+        """
+        self._sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self._sock.settimeout(self._timeout)
+
+        try:
+            self._sock.connect(self._path)
+        except OSError as err:
+            self.close()
+            raise QemuError(f"Can't connect to {self._path}: {err}") \
+                from err
+
+        self._file = self._sock.makefile("rb")
+
+        greeting = self._read()
+        if "QMP" not in greeting:
+            self.close()
+            raise QemuError(f"Unexpected QMP greeting: {greeting}")
+
+        self.execute("qmp_capabilities")
+
+    def close(self) -> None:
+        """
+        Close QMP connection.
+        """
+        if self._file:
+            self._file.close()
+            self._file = None
+
+        if self._sock:
+            self._sock.close()
+            self._sock = None
+
+    def execute(self, command: str, arguments: dict = None):
+        """
+        Execute a QMP command.
+        :param command: name of the command
+        :type command: str
+        :param arguments: arguments of the command
+        :type arguments: dict
+        :returns: the command return value
+        :raises: QemuError
+        """
+        if not self._sock:
+            raise QemuError("QMP is not connected")
+
+        request = {"execute": command}
+        if arguments:
+            request["arguments"] = arguments
+
+        self._logger.debug("request: %s", request)
+
+        with self._lock:
+            self._sock.sendall(json.dumps(request).encode() + b"\n")
+            reply = self._read()
+
+        self._logger.debug("reply: %s", reply)
+
+        if "error" in reply:
+            raise QemuError(f"{command}: {reply['error'].get('desc', '')}")
+
+        return reply.get("return", None)
+
+    def human_monitor_command(self, command: str) -> str:
+        """
+        Execute a command of the human monitor, such as savevm and loadvm.
+        :param command: monitor command line
+        :type command: str
+        :returns: command output
+        :raises: QemuError if command printed an error
+        """
+        output = self.execute(
+            "human-monitor-command",
+            {"command-line": command})
+
+        if output and "error" in output.lower():
+            raise QemuError(f"{command}: {output.strip()}")
+
+        return output
+
+
+class QemuConsole:
+    """
+    Shell running on the VM console. Commands run one after the other and
+    their exit status is printed after a random sentinel, which is used to
+    find the end of their output.
+    """
+
+    def __init__(self, sock: socket.socket, buffer_size: int = 65536) -> None:
+        """
+        :param sock: socket connected to the console
+        :type sock: socket.socket
+        :param buffer_size: size of the buffer used to read from console
+        :type buffer_size: int
+        """
+        self._logger = logging.getLogger("ltp.qemu.console")
+        self._sock = sock
+        self._buffer_size = buffer_size
+        self._data = bytearray()
+        self._lock = threading.Lock()
+
+    def close(self) -> None:
+        """
+        Close the console connection.
+        """
+        self._sock.close()
+
+    def write(self, data: str) -> None:
+        """
+        Write data on console.
+        :param data: data to write
+        :type data: str
+        """
+        self._sock.sendall(data.encode())
+
+    def flush(self) -> None:
+        """
+        Drop data which has been received but not read.
+        """
+        self._data.clear()
+
+        while select.select([self._sock], [], [], 0)[0]:
+            if not self._sock.recv(self._buffer_size):
+                break
+
+    def read_until(
+            self,
+            matcher: re.Pattern,
+            deadline: float,
+            callback: callable = None) -> re.Match:
+        """
+        Read from console until matcher finds a match in the received data.
+        Data before the match can be given to callback as soon as it's read.
+        :param matcher: compiled bytes regular expression
+        :type matcher: re.Pattern
+        :param deadline: time.monotonic() value when reading stops. If None,
+            it waits forever
+        :type deadline: float
+        :param callback: function called with chunks of data which can't be
+            part of the match
+        :type callback: callable
+        :returns: match object. Data up to the end of the match is consumed
+        :raises: QemuTimeoutError, QemuError
+        """
+        # matches can't be longer than this, so older data can be given to
+        # the callback and dropped before the match is found
+        keep = 256
+
+        while True:
+            match = matcher.search(bytes(self._data))
+            if match:
+                if callback and match.start() > 0:
+                    callback(match.string[:match.start()])
+
+                del self._data[:match.end()]
+                return match
+
+            if callback and len(self._data) > keep:
+                callback(bytes(self._data[:-keep]))
+                del self._data[:-keep]
+
+            timeout = _remaining(deadline)
+            if timeout == 0:
+                raise QemuTimeoutError("Console read timed out")
+
+            ready = select.select([self._sock], [], [], timeout)[0]
+            if not ready:
+                continue
+
+            data = self._sock.recv(self._buffer_size)
+            if not data:
+                raise QemuError("Console has been closed")
+
+            self._data += data.replace(b"\r\n", b"\n")
+
+    def sync(self, timeout: float = 10) -> None:
+        """
+        Wait until console shell is ready to execute commands, dropping any
+        pending output.
+        :param timeout: time in seconds to wait for the shell
+        :type timeout: float
+        """
+        sentinel = f"__ltp_sync_{uuid.uuid4().hex}__"
+        matcher = re.compile(sentinel.encode() + b"ok")
+
+        # ask shell to print the sentinel in two parts, so the echo of the
+        # command doesn't match
+        self.write(f"\necho {sentinel}'ok'\n")
+        self.read_until(matcher, _deadline(timeout))
+        self.flush()
+
+    def execute(
+            self,
+            command: str,
+            timeout: float = 0,
+            stdout_callback: callable = None,
+            tainted: bool = False) -> set:
+        """
+        Execute a command inside the console shell. stderr is redirected to
+        stdout and stdin is not available.
+        :param command: command to execute
+        :type command: str
+        :param timeout: command timeout in seconds. If 0, no timeout is
+            applied
+        :type timeout: float
+        :param stdout_callback: function called with stdout data as soon as
+            it's read
+        :type stdout_callback: callable
+        :param tainted: if True, kernel tainted flags are read after command
+            completed, together with its exit status
+        :type tainted: bool
+        :returns: couple of (int, str) defining exit_status and stdout. If
+            tainted is True, kernel tainted flags follow as str
+        :raises: QemuTimeoutError, QemuError
+        """
+        if not command:
+            raise ValueError("Command is empty")
+
+        sentinel = f"__ltp_{uuid.uuid4().hex}__"
+        matcher = re.compile(
+            b"\r?\n?" + sentinel.encode() +
+            b"(?P<status>-?\\d+) ?(?P<tainted>\\d*)\r?\n")
+
+        status = "$?"
+        if tainted:
+            status = "$? \"$(cat /proc/sys/kernel/tainted)\""
+
+        stdout = bytearray()
+
+        # chunks can split multibyte characters
+        decoder = codecs.getincrementaldecoder("utf-8")(errors="replace")
+
+        def _on_data(data: bytes, final: bool = False) -> None:
+            stdout.extend(data)
+            if stdout_callback:
+                text = decoder.decode(data, final=final)
+                if text:
+                    stdout_callback(text)
+
+        with self._lock:
+            # exit status is expanded before reading the tainted flags
+            self.write(
+                f"( {command}\n) < /dev/null 2>&1\n"
+                f"printf '\\n{sentinel}%d %s\\n' {status}\n")
+
+            match = self.read_until(matcher, _deadline(timeout), _on_data)
+
+        _on_data(b"", final=True)
+
+        ret = int(match.group("status")), \
+            stdout.decode("utf-8", errors="replace")
+
+        if tainted:
+            ret += (match.group("tainted").decode(),)
+
+        return ret
+
+
+class QemuVM:
+    """
+    Qemu virtual machine, controlled via QMP and accessed via its serial or
+    virtio console. Disk changes are kept in a temporary overlay, so the
+    image is never modified, it can be shared by many VMs and VM state can
+    be saved and restored using snapshots.
+    """
+
+    def __init__(self, **kwargs) -> None:
+        """
+        :param image: disk image of the VM
+        :type image: str
+        :param qemu: Qemu binary. Default is qemu-system-x86_64
+        :type qemu: str
+        :param memory: VM memory. Default is 2G
+        :type memory: str
+        :param smp: number of CPUs. Default is 2
+        :type smp: int
+        :param kernel: kernel image to boot
+        :type kernel: str
+        :param initrd: initrd image to boot
+        :type initrd: str
+        :param cmdline: kernel command line, used when kernel is given
+        :type cmdline: str
+        :param console: console transport: "serial" (default) or "virtio"
+        :type console: str
+        :param options: additional Qemu command line options
+        :type options: list(str)
+        :param overlay: if True, VM runs on a qcow2 overlay backed by image,
+            so many VMs can share the same image. Otherwise, changes are
+            kept inside a temporary file created by Qemu
+        :type overlay: bool
+        :param qemu_img: qemu-img binary, used to create overlays. Default
+            is qemu-img
+        :type qemu_img: str
+        """
+        self._logger = logging.getLogger("ltp.qemu")
+        self._image = kwargs.get("image", None)
+        self._qemu = kwargs.get("qemu", None) or "qemu-system-x86_64"
+        self._memory = kwargs.get("memory", None) or "2G"
+        self._smp = int(kwargs.get("smp", None) or 2)
+        self._kernel = kwargs.get("kernel", None)
+        self._initrd = kwargs.get("initrd", None)
+        self._cmdline = kwargs.get("cmdline", None)
+        self._console_type = kwargs.get("console", None) or "serial"
+        self._options = kwargs.get("options", None) or []
+        self._overlay = bool(kwargs.get("overlay", False))
+        self._qemu_img = kwargs.get("qemu_img", None) or "qemu-img"
+
+        if not self._image:
+            raise ValueError("image is empty")
+
+        if self._console_type not in ["serial", "virtio"]:
+            raise ValueError("console must be 'serial' or 'virtio'")
+
+        self._proc = None
+        self._tmpdir = None
+        self._qmp = None
+        self._console = None
+        self._stderr = deque(maxlen=20)
+        self._stderr_thread = None
+
+    @property
+    def running(self) -> bool:
+        """
+        True if VM process is running.
+        :returns: bool
+        """
+        return self._proc is not None and self._proc.poll() is None
+
+    @property
+    def qmp(self) -> QMPClient:
+        """
+        QMP client of the running VM.
+        :returns: QMPClient
+        """
+        return self._qmp
+
+    @property
+    def console(self) -> QemuConsole:
+        """
+        Console of the running VM.
+        :returns: QemuConsole
+        """
+        return self._console
+
+    def command(self,
+                qmp_path: str,
+                console_path: str,
+                overlay_path: str = None) -> list:
+        """
+        Qemu command line.
+        :param qmp_path: path of the QMP unix socket
+        :type qmp_path: str
+        :param console_path: path of the console unix socket
+        :type console_path: str
+        :param overlay_path: path of the qcow2 overlay. If None, image is
+            used in snapshot mode
+        :type overlay_path: str
+        :returns: list(str)
+        """
+        cmd = [
+            self._qemu,
+            "-display", "none",
+            "-monitor", "none",
+            "-machine", "accel=kvm:tcg",
+            "-m", self._memory,
+            "-smp", str(self._smp),
+        ]
+
+        if overlay_path:
+            cmd.extend([
+                "-drive",
+                f"file={overlay_path},format=qcow2,if=virtio,cache=unsafe"])
+        else:
+            cmd.extend([
+                "-drive", f"file={self._image},if=virtio,cache=unsafe",
+                "-snapshot"])
+
+        cmd.extend([
+            "-qmp", f"unix:{qmp_path},server=on,wait=off",
+            "-chardev", f"socket,id=ltpcon,path={console_path},"
+            "server=on,wait=off",
+        ])
+
+        if self._console_type == "serial":
+            cmd.extend(["-serial", "chardev:ltpcon"])
+            tty = "ttyS0"
+        else:
+            cmd.extend([
+                "-serial", "none",
+                "-device", "virtio-serial",
+                "-device", "virtconsole,chardev=ltpcon"])
+            tty = "hvc0"
+
+        if self._kernel:
+            cmd.extend(["-kernel", self._kernel])
+            cmd.extend([
+                "-append",
+                self._cmdline or f"console={tty} root=/dev/vda rw"])
+
+        if self._initrd:
+            cmd.extend(["-initrd", self._initrd])
+
+        cmd.extend(self._options)
+
+        return cmd
+
+    def _create_overlay(self, path: str) -> None:
+        """
+        Create a qcow2 overlay backed by the VM image.
+        """
+        image = os.path.abspath(self._image)
+
+        try:
+            info = subprocess.run(
+                [self._qemu_img, "info", "--output=json", image],
+                capture_output=True,
+                check=True)
+            image_format = json.loads(info.stdout)["format"]
+
+            subprocess.run(
+                [self._qemu_img, "create", "-q", "-f", "qcow2",
+                 "-b", image, "-F", image_format, path],
+                capture_output=True,
+                check=True)
+        except subprocess.CalledProcessError as err:
+            raise QemuError(
+                f"Can't create overlay of {image}: "
+                f"{err.stderr.decode(errors='replace').strip()}") from err
+        except (OSError, ValueError, KeyError) as err:
+            raise QemuError(
+                f"Can't create overlay of {image}: {err}") from err
+
+    def _read_stderr(self, stderr) -> None:
+        """
+        Read Qemu stderr until it's closed, keeping its last lines.
+        """
+        for line in stderr:
+            line = line.decode(errors="replace").rstrip()
+            self._logger.debug("qemu: %s", line)
+            self._stderr.append(line)
+
+    def _stderr_tail(self) -> str:
+        """
+        Last lines written by Qemu on stderr.
+        """
+        # stderr is read until EOF once Qemu exited
+        if self._stderr_thread and not self.running:
+            self._stderr_thread.join(timeout=1)
+
+        return "\n".join(self._stderr)
+
+    def _wait_socket(self, path: str, deadline: float) -> socket.socket:
+        """
+        Connect to a unix socket created by Qemu.
+        """
+        while True:
+            if not self.running:
+                tail = self._stderr_tail()
+                raise QemuError(
+                    "Qemu exited during boot" + (f":\n{tail}" if tail else ""))
+
+            if os.path.exists(path):
+                sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+                try:
+                    sock.connect(path)
+                    return sock
+                except OSError:
+                    sock.close()
+
+            if _remaining(deadline) == 0:
+                raise QemuTimeoutError(f"{path} has not been created")
+
+            time.sleep(0.05)
+
+    def start(self, timeout: int = 60) -> None:
+        """
+        Start the VM and connect to its QMP socket and console.
+        :param timeout: time in seconds to wait for Qemu sockets
+        :type timeout: int
+        :raises: QemuError
+        """
+        if self.running:
+            raise QemuError("VM is already running")
+
+        self._tmpdir = tempfile.mkdtemp(prefix="ltp-qemu-")
+        qmp_path = os.path.join(self._tmpdir, "qmp.sock")
+        console_path = os.path.join(self._tmpdir, "console.sock")
+
+        overlay_path = None
+        if self._overlay:
+            overlay_path = os.path.join(self._tmpdir, "overlay.qcow2")
+            try:
+                self._create_overlay(overlay_path)
+            except QemuError:
+                self._cleanup()
+                raise
+
+        cmd = self.command(qmp_path, console_path, overlay_path)
+        self._logger.info("Starting VM: %s", " ".join(cmd))
+
+        try:
+            # pylint: disable=consider-using-with
+            self._proc = subprocess.Popen(
+                cmd,
+                stdin=subprocess.DEVNULL,
+                stdout=subprocess.DEVNULL,
+                stderr=subprocess.PIPE)
+        except OSError as err:
+            self._cleanup()
+            raise QemuError(f"Can't run {self._qemu}: {err}") from err
+
+        # stderr is always read, so Qemu never blocks on a full pipe
+        self._stderr.clear()
+        self._stderr_thread = threading.Thread(
+            target=self._read_stderr,
+            args=(self._proc.stderr,),
+            name="qemu-stderr",
+            daemon=True)
+        self._stderr_thread.start()
+
+        try:
+            deadline = _deadline(timeout)
+
+            # connect to the console first, so boot messages are not lost
+            self._console = QemuConsole(
+                self._wait_socket(console_path, deadline))
+
+            self._wait_socket(qmp_path, deadline).close()
+            self._qmp = QMPClient(qmp_path)
+            self._qmp.connect()
+        except QemuError:
+            self.force_stop()
+            raise
+
+    def login(self,
+              user: str = "root",
+              password: str = None,
+              timeout: int = 300) -> None:
+        """
+        Wait for the VM to boot and login on the console. If user is None,
+        console is supposed to run a shell.
+        :param user: username for logging in
+        :type user: str
+        :param password: password for logging in
+        :type password: str
+        :param timeout: time in seconds to wait for boot
+        :type timeout: int
+        :raises: QemuError
+        """
+        deadline = _deadline(timeout)
+
+        if user:
+            self._logger.info("Waiting for login prompt")
+
+            login = re.compile(rb"login:\s*$")
+            while True:
+                # prompt could have been printed before we connected
+                self._console.write("\n")
+
+                retry = time.monotonic() + 5
+                if deadline is not None:
+                    retry = min(deadline, retry)
+
+                try:
+                    self._console.read_until(login, retry)
+                    break
+                except QemuTimeoutError:
+                    if _remaining(deadline) == 0:
+                        raise
+
+            self._console.write(f"{user}\n")
+
+            if password:
+                self._console.read_until(
+                    re.compile(rb"[Pp]assword:\s*$"),
+                    deadline)
+                self._console.write(f"{password}\n")
+
+        self._console.sync(_remaining(deadline))
+
+        # don't echo commands and don't print prompts
+        self._console.write("stty -echo; export PS1='' PS2=''\n")
+        self._console.sync(_remaining(deadline))
+
+        self._logger.info("Logged in")
+
+    def execute(
+            self,
+            command: str,
+            timeout: float = 0,
+            stdout_callback: callable = None,
+            tainted: bool = False) -> set:
+        """
+        Execute a command on the VM console.
+        :param command: command to execute
+        :type command: str
+        :param timeout: command timeout in seconds. If 0, no timeout is
+            applied
+        :type timeout: float
+        :param stdout_callback: function called with stdout data as soon as
+            it's read
+        :type stdout_callback: callable
+        :param tainted: if True, kernel tainted flags are read after command
+            completed, together with its exit status
+        :type tainted: bool
+        :returns: couple of (int, str) defining exit_status and stdout. If
+            tainted is True, kernel tainted flags follow as str
+        :raises: QemuTimeoutError, QemuError
+        """
+        if not self._console:
+            raise QemuError("VM is not running")
+
+        self._logger.info(
+            "Executing '%s' (timeout=%ds)", command, timeout or 0)
+
+        return self._console.execute(
+            command, timeout, stdout_callback, tainted)
+
+    def savevm(self, name: str) -> None:
+        """
+        Save the VM state inside a snapshot.
+        :param name: name of the snapshot
+        :type name: str
+        :raises: QemuError
+        """
+        self._logger.info("Saving '%s' snapshot", name)
+        self._qmp.human_monitor_command(f"savevm {name}")
+
+    def loadvm(self, name: str, timeout: int = 60) -> None:
+        """
+        Restore the VM state from a snapshot, waiting for its console to be
+        ready again.
+        :param name: name of the snapshot
+        :type name: str
+        :param timeout: time in seconds to wait for the console
+        :type timeout: int
+        :raises: QemuError
+        """
+        self._logger.info("Restoring '%s' snapshot", name)
+
+        start = time.monotonic()
+        self._qmp.human_monitor_command(f"loadvm {name}")
+
+        # output of the commands which ran after the snapshot is not valid
+        # anymore
+        self._console.flush()
+        self._console.sync(timeout)
+
+        self._logger.info(
+            "'%s' restored in %.3fs", name, time.monotonic() - start)
+
+    def _cleanup(self) -> None:
+        """
+        Release VM resources.
+        """
+        if self._qmp:
+            self._qmp.close()
+            self._qmp = None
+
+        if self._console:
+            self._console.close()
+            self._console = None
+
+        if self._stderr_thread:
+            self._stderr_thread.join(timeout=1)
+            self._stderr_thread = None
+
+        if self._proc:
+            if self._proc.stderr:
+                self._proc.stderr.close()
+            self._proc = None
+
+        if self._tmpdir:
+            shutil.rmtree(self._tmpdir, ignore_errors=True)
+            self._tmpdir = None
+
+    def stop(self, timeout: int = 60) -> None:
+        """
+        Stop the VM. If timeout is reached, VM is killed.
+        :param timeout: time in seconds to wait for VM to stop
+        :type timeout: int
+        """
+        if not self._proc:
+            return
+
+        self._logger.info("Stopping VM")
+
+        if self.running and self._qmp:
+            try:
+                self._qmp.execute("quit")
+            except (QemuError, OSError):
+                pass
+
+        try:
+            self._proc.wait(timeout=timeout or None)
+        except subprocess.TimeoutExpired:
+            self._proc.kill()
+            self._proc.wait()
+
+        self._cleanup()
+
+    def force_stop(self) -> None:
+        """
+        Kill the VM.
+        """
+        if not self._proc:
+            return
+
+        self._logger.info("Killing VM")
+
+        if self.running:
+            self._proc.kill()
+
+        self._proc.wait()
+        self._cleanup()
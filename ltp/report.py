@@ -5,18 +5,86 @@
 
 .. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
 """
+import re
 import json
 import logging
+import threading
+from xml.sax.saxutils import escape
+from xml.sax.saxutils import quoteattr
 from .session import LTPSession
 
+# tests stdout bigger than this size is referenced by its spool file path,
+# instead of being written inside reports
+MAX_STDOUT = 65536
 
-def export_to_json(session: LTPSession, output: str) -> None:
+
+def format_results(obj) -> dict:
+    """
+    Return the results of a session or a suite, as written inside reports.
+    :param obj: session or suite
+    :type obj: LTPSession | LTPSuite
+    :returns: dict
+    """
+    return {
+        "passed": obj.passed,
+        "failed": obj.failed,
+        "warnings": obj.warnings,
+        "skipped": obj.skipped,
+        "broken": obj.broken,
+    }
+
+
+def format_test(test, max_stdout: int = MAX_STDOUT) -> dict:
+    """
+    Return the report data of a completed test.
+    :param test: completed test
+    :type test: LTPTest
+    :param max_stdout: maximum size of the spooled stdout written inside
+        data. Bigger stdout is referenced by "stdout_path"
+    :type max_stdout: int
+    :returns: dict
+    """
+    data = {
+        "name": test.name,
+        "passed": test.passed,
+        "failed": test.failed,
+        "warnings": test.warnings,
+        "skipped": test.skipped,
+        "broken": test.broken,
+        "duration": test.duration,
+    }
+
+    if test.stdout_path and test.stdout_size > max_stdout:
+        data["stdout_path"] = test.stdout_path
+    else:
+        data["stdout"] = test.stdout
+
+    # tests which ran on remote targets report where they ran
+    if test.target:
+        data["target"] = test.target
+
+    if test.resources:
+        data["resources"] = test.resources
+
+    # tests which hit their limits are reported apart from their results
+    if test.violations:
+        data["violations"] = test.violations
+
+    return data
+
+
+def export_to_json(session: LTPSession,
+                   output: str,
+                   max_stdout: int = MAX_STDOUT) -> None:
     """
     Export a list of testing suites into a JSON file.
     :param session: LTP session object
     :type session: LTPSession
     :param output: path of the file to export
     :type output: str
+    :param max_stdout: maximum size of the spooled tests stdout written
+        inside the report. Bigger stdout are referenced by "stdout_path"
+    :type max_stdout: int
     """
     if not session:
         raise ValueError("session")
@@ -31,12 +99,8 @@ def export_to_json(session: LTPSession, output: str) -> None:
     data['session'] = {
         "name": session.name,
         "suites": [],
-        "passed": session.passed,
-        "failed": session.failed,
-        "warnings": session.warnings,
-        "skipped": session.skipped,
-        "broken": session.broken,
     }
+    data['session'].update(format_results(session))
 
     suites = []
     for suite in session.suites:
@@ -46,26 +110,14 @@ def export_to_json(session: LTPSession, output: str) -> None:
         suite_data = {
             "name": suite.name,
             "tests": [],
-            "passed": suite.passed,
-            "failed": suite.failed,
-            "warnings": suite.warnings,
-            "skipped": suite.skipped,
-            "broken": suite.broken,
         }
+        suite_data.update(format_results(suite))
 
         for test in suite.tests:
             if not test.completed:
                 continue
 
-            suite_data['tests'].append({
-                "name": test.name,
-                "stdout": test.stdout,
-                "passed": test.passed,
-                "failed": test.failed,
-                "warnings": test.warnings,
-                "skipped": test.skipped,
-                "broken": test.broken,
-            })
+            suite_data['tests'].append(format_test(test, max_stdout))
 
         suites.append(suite_data)
 
@@ -75,3 +127,213 @@ def export_to_json(session: LTPSession, output: str) -> None:
         json.dump(data, outfile, indent=4)
 
     logger.info("JSON report has been exported")
+
+
+class LTPReporter:
+    """
+    Report writer which appends tests to the report file as soon as they
+    are completed. The file is flushed after each test and it's always
+    well formed, so results are not lost if the runner is killed.
+    """
+
+    def __init__(self, output: str, max_stdout: int = MAX_STDOUT) -> None:
+        """
+        :param output: path of the report file
+        :type output: str
+        :param max_stdout: maximum size of the spooled tests stdout written
+            inside the report. Bigger stdout are referenced by their path
+        :type max_stdout: int
+        """
+        if not output:
+            raise ValueError("output")
+
+        self._logger = logging.getLogger("ltp.report")
+        self._output = output
+        self._max_stdout = max_stdout
+        self._lock = threading.Lock()
+        self._file = None
+        self._pos = 0
+
+    @property
+    def output(self) -> str:
+        """
+        Path of the report file.
+        :returns: str
+        """
+        return self._output
+
+    def _header(self, session: LTPSession) -> str:
+        """
+        Text written at the beginning of the report.
+        """
+        raise NotImplementedError()
+
+    def _footer(self) -> str:
+        """
+        Text closing the report. It's overwritten by the next test.
+        """
+        raise NotImplementedError()
+
+    def _format(self, suite, test) -> str:
+        """
+        Text of a single completed test.
+        """
+        raise NotImplementedError()
+
+    def _append(self, data: str) -> None:
+        """
+        Append data to the report, followed by the footer.
+        """
+        data = data.encode("UTF-8")
+
+        self._file.seek(self._pos)
+        self._file.write(data)
+        self._file.write(self._footer().encode("UTF-8"))
+        self._file.truncate()
+        self._file.flush()
+
+        self._pos += len(data)
+
+    def start(self, session: LTPSession) -> None:
+        """
+        Create the report file.
+        :param session: session which is going to run
+        :type session: LTPSession
+        """
+        with self._lock:
+            self._logger.info("Streaming report into %s", self._output)
+
+            # pylint: disable=consider-using-with
+            self._file = open(self._output, "wb")
+            self._pos = 0
+            self._append(self._header(session))
+
+    def test_completed(self, suite, test) -> None:
+        """
+        Append a completed test to the report.
+        :param suite: suite of the test
+        :type suite: LTPSuite
+        :param test: completed test
+        :type test: LTPTest
+        """
+        with self._lock:
+            if not self._file:
+                return
+
+            self._append(self._format(suite, test))
+
+    def stop(self) -> None:
+        """
+        Close the report file.
+        """
+        with self._lock:
+            if not self._file:
+                return
+
+            self._file.close()
+            self._file = None
+
+            self._logger.info("Report has been streamed")
+
+
+class JSONLReporter(LTPReporter):
+    """
+    Report writer appending a JSON object per line for each test.
+    """
+
+    def _header(self, session: LTPSession) -> str:
+        return ""
+
+    def _footer(self) -> str:
+        return ""
+
+    def _format(self, suite, test) -> str:
+        data = {"suite": suite.name}
+        data.update(format_test(test, self._max_stdout))
+
+        return json.dumps(data) + "\n"
+
+
+class JUnitReporter(LTPReporter):
+    """
+    Report writer appending tests in the JUnit XML format. Every suite is
+    a <testsuite> element containing a <testcase> element for each test.
+    """
+
+    # characters which are not allowed inside XML documents
+    _INVALID_XML = re.compile(
+        "[\x00-\x08\x0b\x0c\x0e-\x1f\ufffe\uffff]")
+
+    def __init__(self, output: str, max_stdout: int = MAX_STDOUT) -> None:
+        super().__init__(output, max_stdout=max_stdout)
+        self._suite = None
+
+    @classmethod
+    def _text(cls, data: str) -> str:
+        """
+        Escape text written inside XML elements.
+        """
+        return escape(cls._INVALID_XML.sub("", data))
+
+    def _header(self, session: LTPSession) -> str:
+        self._suite = None
+
+        return '<?xml version="1.0" encoding="UTF-8"?>\n' \
+            f'<testsuites name={quoteattr(session.name)}>\n'
+
+    def _footer(self) -> str:
+        footer = "</testsuites>\n"
+        if self._suite:
+            footer = "</testsuite>\n" + footer
+
+        return footer
+
+    def _format(self, suite, test) -> str:
+        text = ""
+
+        # tests of many suites can run at the same time, so a new suite
+        # closes the previous one and a suite can appear more than once
+        if suite.name != self._suite:
+            if self._suite:
+                text += "</testsuite>\n"
+
+            text += f"<testsuite name={quoteattr(suite.name)}>\n"
+            self._suite = suite.name
+
+        data = format_test(test, self._max_stdout)
+
+        attrs = f'classname={quoteattr(suite.name)} ' \
+            f'name={quoteattr(test.name)} ' \
+            f'time="{test.duration:.3f}"'
+
+        text += f"<testcase {attrs}>\n"
+
+        if test.failed:
+            text += f'<failure message="{test.failed} failures"/>\n'
+
+        if test.broken:
+            text += f'<error message="{test.broken} broken"/>\n'
+
+        if test.skipped and not (test.passed or test.failed or test.broken):
+            text += "<skipped/>\n"
+
+        props = {
+            key: data[key] for key in ["stdout_path", "target"]
+            if key in data
+        }
+        if test.violations:
+            props["violations"] = " ".join(
+                f"{key}={value}" for key, value in test.violations.items())
+
+        if props:
+            text += "<properties>\n"
+            for key, value in props.items():
+                text += f'<property name="{key}" value={quoteattr(value)}/>\n'
+            text += "</properties>\n"
+
+        if "stdout" in data:
+            text += f'<system-out>{self._text(data["stdout"])}</system-out>\n'
+
+        text += "</testcase>\n"
+
+        return text
@@ -0,0 +1,310 @@
+"""
+.. module:: resultcache
+    :platform: Linux
+    :synopsis: module that contains the tests results cache
+
+.. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
+"""
+import os
+import gzip
+import json
+import shutil
+import fnmatch
+import hashlib
+import logging
+import platform
+import tempfile
+import threading
+from .report import format_test
+from .report import MAX_STDOUT
+
+
+def kernel_config_hash(release: str = None, path: str = None) -> str:
+    """
+    Hash of the kernel configuration, read from `path`, /proc/config.gz or
+    /boot/config-<release>. Empty if configuration is not available.
+    :param release: kernel release. If None, running kernel is used
+    :type release: str
+    :param path: path of the kernel configuration, which can be gzipped
+    :type path: str
+    :returns: str
+    """
+    release = release or platform.uname().release
+
+    paths = [path] if path else [
+        "/proc/config.gz",
+        f"/boot/config-{release}",
+    ]
+
+    for config in paths:
+        try:
+            with open(config, "rb") as data:
+                content = data.read()
+        except OSError:
+            continue
+
+        if content[:2] == b"\x1f\x8b":
+            content = gzip.decompress(content)
+
+        return hashlib.sha256(content).hexdigest()
+
+    return ""
+
+
+def affected_suites(mapping: dict, changed: list) -> list:
+    """
+    Suites affected by the changed paths, according with a mapping from
+    glob patterns of the paths to the names of the suites testing them.
+    A changed path which is not mapped could affect any test, so None is
+    returned in that case.
+    :param mapping: dict(glob pattern, list(suite name))
+    :type mapping: dict
+    :param changed: changed paths, such as the ones of `git diff --name-only`
+    :type changed: list(str)
+    :returns: list(str) or None
+    """
+    if mapping is None:
+        raise ValueError("mapping is empty")
+
+    suites = set()
+    for path in changed or []:
+        matched = False
+        for pattern, names in mapping.items():
+            if fnmatch.fnmatchcase(path, pattern):
+                suites.update(names)
+                matched = True
+
+        if not matched:
+            return None
+
+    return sorted(suites)
+
+
+class LTPResultCache:
+    """
+    Cache of the tests results, so tests which don't need to run again can
+    reuse their previous results. The key of a test is made of the kernel
+    release and configuration, the hash of the test binary and the test
+    arguments.
+
+    When the suites affected by a change are known, kernel is not part of
+    the key for the other suites: their tests run again only when their
+    binary or arguments changed.
+    """
+
+    def __init__(self,
+                 path: str,
+                 release: str = None,
+                 config: str = None,
+                 affected: list = None,
+                 max_stdout: int = MAX_STDOUT) -> None:
+        """
+        :param path: path of the cache file. It's created if it doesn't
+            exist
+        :type path: str
+        :param release: kernel release where tests run. If None, running
+            kernel is used
+        :type release: str
+        :param config: path of the kernel configuration. If None, it's
+            searched inside /proc and /boot
+        :type config: str
+        :param affected: names of the suites affected by the kernel changes.
+            If None, all suites are affected
+        :type affected: list(str)
+        :param max_stdout: maximum size of the spooled tests stdout stored
+            inside the cache. Bigger stdout are truncated to their last
+            characters
+        :type max_stdout: int
+        """
+        if not path:
+            raise ValueError("path is empty")
+
+        self._logger = logging.getLogger("ltp.resultcache")
+        self._path = path
+        self._release = release or platform.uname().release
+        self._kernel = hashlib.sha256(
+            f"{self._release}\n{kernel_config_hash(self._release, config)}"
+            .encode("utf-8")).hexdigest()
+        self._affected = None if affected is None else set(affected)
+        self._max_stdout = max_stdout
+        self._lock = threading.Lock()
+        self._binaries = {}
+        self._entries = self._load()
+        self._hits = 0
+
+    @property
+    def path(self) -> str:
+        """
+        Path of the cache file.
+        :returns: str
+        """
+        return self._path
+
+    @property
+    def kernel(self) -> str:
+        """
+        Hash of the kernel release and configuration.
+        :returns: str
+        """
+        return self._kernel
+
+    def __len__(self) -> int:
+        return sum(len(tests) for tests in self._entries.values())
+
+    def _load(self) -> dict:
+        """
+        Load the cache entries. A cache which can't be read is empty.
+        """
+        if not os.path.isfile(self._path):
+            return {}
+
+        try:
+            with open(self._path, "r", encoding="UTF-8") as data:
+                entries = json.load(data).get("suites", {})
+        except (OSError, ValueError, AttributeError) as err:
+            self._logger.warning("Can't read %s: %s", self._path, err)
+            return {}
+
+        self._logger.info("Loaded results cache from %s", self._path)
+
+        return entries
+
+    def _binary_hash(self, command: str) -> str:
+        """
+        Hash of the test binary, searched inside testcases/bin and PATH.
+        Empty if binary can't be found.
+        """
+        root = os.environ.get(
+            "LTPROOT", os.path.dirname(os.path.abspath(__file__)))
+        testcases = os.path.join(root, "testcases", "bin")
+
+        path = os.path.join(testcases, command)
+        if not os.path.isfile(path):
+            path = shutil.which(command)
+
+        if not path:
+            return ""
+
+        try:
+            stat = os.stat(path)
+        except OSError:
+            return ""
+
+        # binaries are hashed once, unless they are replaced
+        signature = (stat.st_mtime_ns, stat.st_size)
+        cached = self._binaries.get(path, None)
+        if cached and cached[0] == signature:
+            return cached[1]
+
+        digest = hashlib.sha256()
+        try:
+            with open(path, "rb") as data:
+                for chunk in iter(lambda: data.read(1 << 20), b""):
+                    digest.update(chunk)
+        except OSError:
+            return ""
+
+        self._binaries[path] = (signature, digest.hexdigest())
+
+        return digest.hexdigest()
+
+    def _test_key(self, test) -> str:
+        """
+        Hash of the test binary and arguments.
+        """
+        args = json.dumps([test.command] + list(test.args))
+        binary = self._binary_hash(test.command)
+
+        return hashlib.sha256(f"{binary}\n{args}".encode("utf-8")).hexdigest()
+
+    def _kernel_matters(self, suite: str) -> bool:
+        """
+        True if the results of the suite depend on the kernel.
+        """
+        return self._affected is None or suite in self._affected
+
+    def lookup(self, suite: str, test) -> dict:
+        """
+        Return the cached results of a test, if its key didn't change.
+        :param suite: name of the suite of the test
+        :type suite: str
+        :param test: test to look for
+        :type test: LTPTest
+        :returns: test data, as reported inside the journal, or None
+        """
+        with self._lock:
+            entry = self._entries.get(suite, {}).get(test.name, None)
+            if not entry:
+                return None
+
+            if entry.get("test", None) != self._test_key(test):
+                return None
+
+            if self._kernel_matters(suite) and \
+                    entry.get("kernel", None) != self._kernel:
+                return None
+
+            self._hits += 1
+
+            return entry.get("result", None)
+
+    def start(self, session) -> None:
+        """
+        Start caching the results of the session.
+        :param session: session which is going to run
+        :type session: LTPSession
+        """
+        # pylint: disable=unused-argument
+        self._hits = 0
+
+    def test_completed(self, suite, test) -> None:
+        """
+        Store the results of a completed test.
+        :param suite: suite of the test
+        :type suite: LTPSuite
+        :param test: completed test
+        :type test: LTPTest
+        """
+        # results of tests which didn't complete in time are not reliable,
+        # while kernel of remote targets is not known
+        if test.timed_out or test.target:
+            return
+
+        # spool files are overwritten by the next sessions, so big stdout
+        # is stored truncated to its last characters
+        result = format_test(test, self._max_stdout)
+        if result.pop("stdout_path", None):
+            result["stdout"] = test.stdout_tail[-self._max_stdout:]
+
+        entry = {
+            "kernel": self._kernel,
+            "release": self._release,
+            "test": self._test_key(test),
+            "result": result,
+        }
+
+        with self._lock:
+            self._entries.setdefault(suite.name, {})[test.name] = entry
+
+    def stop(self) -> None:
+        """
+        Write the cache file.
+        """
+        with self._lock:
+            directory = os.path.dirname(os.path.abspath(self._path))
+            os.makedirs(directory, exist_ok=True)
+
+            fdesc, tmp = tempfile.mkstemp(dir=directory, suffix=".tmp")
+            try:
+                with os.fdopen(fdesc, "w", encoding="UTF-8") as data:
+                    json.dump({"suites": self._entries}, data)
+
+                os.replace(tmp, self._path)
+            except OSError as err:
+                self._logger.warning("Can't write %s: %s", self._path, err)
+                if os.path.exists(tmp):
+                    os.unlink(tmp)
+                return
+
+        self._logger.info(
+            "%d tests results reused from cache", self._hits)
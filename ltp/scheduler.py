@@ -0,0 +1,271 @@
+"""
+.. module:: scheduler
+    :platform: Linux
+    :synopsis: module that contains the tests scheduler definition
+
+.. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
+"""
+import logging
+import threading
+from collections import deque
+from contextlib import contextmanager
+from concurrent.futures import wait
+from concurrent.futures import ThreadPoolExecutor
+from concurrent.futures import ALL_COMPLETED
+from concurrent.futures import FIRST_COMPLETED
+from .breaker import TargetAbortedError
+
+
+class _TargetLock:
+    """
+    Lock shared by the workers of a target. Tests hold it in shared mode,
+    while exclusive tests hold it alone. Exclusive tests have the priority,
+    so they don't wait forever for a busy target.
+    """
+
+    def __init__(self) -> None:
+        self._cond = threading.Condition()
+        self._shared = 0
+        self._exclusive = False
+        self._waiting = 0
+
+    @contextmanager
+    def hold(self, exclusive: bool):
+        """
+        Hold the lock in shared or exclusive mode.
+        """
+        with self._cond:
+            if exclusive:
+                self._waiting += 1
+                self._cond.wait_for(
+                    lambda: not self._exclusive and self._shared == 0)
+                self._waiting -= 1
+                self._exclusive = True
+            else:
+                self._cond.wait_for(
+                    lambda: not self._exclusive and self._waiting == 0)
+                self._shared += 1
+
+        try:
+            yield
+        finally:
+            with self._cond:
+                if exclusive:
+                    self._exclusive = False
+                else:
+                    self._shared -= 1
+
+                self._cond.notify_all()
+
+
+class LTPScheduler:
+    """
+    Scheduler running tests on a pool of workers. Tests which are marked as
+    exclusive are executed alone, once all the other running tests are
+    completed.
+
+    When backends are given, tests are sharded across them and each backend
+    runs its tests on its own pool of workers. A backend which completed its
+    tests steals the remaining ones from the busiest backend. In this case,
+    exclusive tests only exclude tests running on the same backend.
+    """
+
+    def __init__(self, workers: int = 1, backends: list = None) -> None:
+        """
+        :param workers: number of tests which can run at the same time on
+            each target
+        :type workers: int
+        :param backends: list of started backends where tests will run. If
+            None, tests run on the local host. Backends running more than one
+            worker should be able to execute multiple commands at the same
+            time, such as BackendPool
+        :type backends: list(Backend)
+        """
+        if not workers or workers < 1:
+            raise ValueError("workers must be greater than 0")
+
+        self._logger = logging.getLogger("ltp.scheduler")
+        self._workers = workers
+        self._backends = backends or []
+        self._lock = threading.Lock()
+        self._queues = []
+        self._aborted = set()
+        self._error = None
+
+    @property
+    def workers(self) -> int:
+        """
+        Number of tests which can run at the same time on each target.
+        :returns: int
+        """
+        return self._workers
+
+    @property
+    def backends(self) -> list:
+        """
+        Backends where tests run. Empty if tests run on the local host.
+        :returns: list(Backend)
+        """
+        return self._backends
+
+    @staticmethod
+    def _wait(futures: set, return_when: str) -> set:
+        """
+        Wait for futures according with `return_when` and raise the first
+        error which occured inside the completed ones.
+        :returns: set of futures which are still pending
+        """
+        done, pending = wait(futures, return_when=return_when)
+        for future in done:
+            future.result()
+
+        return pending
+
+    def run(self, tests: list, func: callable) -> None:
+        """
+        Run tests on the workers pool and wait until all of them completed.
+        :param tests: list of tests exposing `name` and `exclusive`
+        :type tests: list
+        :param func: function running a single test, called as
+            func(test, backend). backend is None for the local host
+        :type func: callable
+        """
+        if self._backends:
+            self._run_targets(tests, func)
+            return
+
+        if self._workers == 1:
+            for test in tests:
+                func(test, None)
+            return
+
+        self._logger.debug("running %d tests on %d workers",
+                           len(tests), self._workers)
+
+        with ThreadPoolExecutor(
+                max_workers=self._workers,
+                thread_name_prefix="worker") as executor:
+            pending = set()
+
+            for test in tests:
+                if test.exclusive:
+                    self._logger.debug(
+                        "waiting workers before running '%s'", test.name)
+
+                    pending = self._wait(pending, ALL_COMPLETED)
+                    func(test, None)
+                    continue
+
+                if len(pending) >= self._workers:
+                    pending = self._wait(pending, FIRST_COMPLETED)
+
+                pending.add(executor.submit(func, test, None))
+
+            self._wait(pending, ALL_COMPLETED)
+
+    def _next_test(self, index: int):
+        """
+        Pop the next test of a target. If target has no tests left, steal the
+        last test of the busiest target.
+        """
+        with self._lock:
+            if self._error:
+                return None
+
+            tests = self._queues[index]
+            if tests:
+                return tests.popleft()
+
+            busiest = max(self._queues, key=len)
+            if not busiest:
+                return None
+
+            test = busiest.pop()
+            self._logger.debug(
+                "'%s' stolen by %s",
+                test.name,
+                self._backends[index].name)
+
+            return test
+
+    def _run_worker(self, index: int, lock: _TargetLock, func: callable):
+        """
+        Run tests on a target until there are tests left.
+        """
+        backend = self._backends[index]
+
+        while True:
+            test = self._next_test(index)
+            if not test:
+                break
+
+            try:
+                with lock.hold(test.exclusive):
+                    func(test, backend)
+            except TargetAbortedError as err:
+                # test didn't run, so it's left to the other targets
+                with self._lock:
+                    self._queues[index].appendleft(test)
+
+                    if index not in self._aborted:
+                        self._aborted.add(index)
+                        self._logger.warning(str(err))
+                break
+            # pylint: disable=broad-except
+            except BaseException as err:
+                with self._lock:
+                    if not self._error:
+                        self._error = err
+                break
+
+    def _run_targets(self, tests: list, func: callable) -> None:
+        """
+        Shard tests across backends and run them, stealing tests between
+        backends when they have no tests left.
+        """
+        self._logger.debug(
+            "running %d tests on %d targets using %d workers each",
+            len(tests),
+            len(self._backends),
+            self._workers)
+
+        count = len(self._backends)
+        self._error = None
+
+        # tests are not sharded on targets which have been aborted
+        alive = [i for i in range(count) if i not in self._aborted]
+        if not alive:
+            raise TargetAbortedError("all targets have been aborted")
+
+        self._queues = [deque() for _ in range(count)]
+        for i, test in enumerate(tests):
+            self._queues[alive[i % len(alive)]].append(test)
+
+        while True:
+            threads = []
+            for index in range(count):
+                if index in self._aborted:
+                    continue
+
+                lock = _TargetLock()
+                for worker in range(self._workers):
+                    thread = threading.Thread(
+                        target=self._run_worker,
+                        args=(index, lock, func),
+                        name=f"target{index}-worker_{worker}",
+                        daemon=True)
+                    thread.start()
+                    threads.append(thread)
+
+            for thread in threads:
+                thread.join()
+
+            if self._error:
+                raise self._error
+
+            if not any(self._queues):
+                break
+
+            # tests left by aborted targets run on the remaining ones
+            if len(self._aborted) == count:
+                raise TargetAbortedError("all targets have been aborted")
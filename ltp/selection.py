@@ -0,0 +1,166 @@
+"""
+.. module:: selection
+    :platform: Linux
+    :synopsis: module that contains the tests selection
+
+.. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
+"""
+import re
+import fnmatch
+
+
+class _Matcher:
+    """
+    Matcher of many tests patterns. Patterns are grouped by kind, so a test
+    is checked with a couple of set lookups and a few regular expressions,
+    whatever is the number of patterns:
+
+    - "name" matches a test name
+    - "mmap*" matches test names using glob syntax
+    - "syscalls:mmap*" matches suite and test names using glob syntax
+    - "re:mmap\\d+" matches test names using a regular expression
+    """
+
+    def __init__(self, patterns: list) -> None:
+        self._names = set()
+        self._qualified = set()
+
+        globs = []
+        qualified_globs = []
+        regexes = []
+
+        for pattern in patterns:
+            if pattern.startswith("re:"):
+                regex = pattern[3:]
+                try:
+                    re.compile(regex)
+                except re.error as err:
+                    raise ValueError(
+                        f"'{regex}' is not a valid regex: {err}") from err
+
+                regexes.append(f"(?:{regex})")
+                continue
+
+            suite, sep, test = pattern.rpartition(":")
+            is_glob = any(char in pattern for char in "*?[")
+
+            if sep and is_glob:
+                qualified_globs.append(fnmatch.translate(pattern))
+            elif sep:
+                self._qualified.add((suite, test))
+            elif is_glob:
+                globs.append(fnmatch.translate(pattern))
+            else:
+                self._names.add(pattern)
+
+        self._glob = self._compile(globs + regexes)
+        self._qualified_glob = self._compile(qualified_globs)
+
+    @staticmethod
+    def _compile(regexes: list):
+        """
+        Compile many regular expressions into a single one.
+        """
+        if not regexes:
+            return None
+
+        return re.compile("|".join(f"(?:{regex})" for regex in regexes))
+
+    def __bool__(self) -> bool:
+        return bool(self._names or self._qualified or self._glob or
+                    self._qualified_glob)
+
+    def match(self, suite: str, test: str) -> bool:
+        """
+        True if the test matches one of the patterns.
+        """
+        if test in self._names or (suite, test) in self._qualified:
+            return True
+
+        if self._glob and self._glob.fullmatch(test):
+            return True
+
+        if self._qualified_glob and \
+                self._qualified_glob.fullmatch(f"{suite}:{test}"):
+            return True
+
+        return False
+
+
+class LTPSelection:
+    """
+    Selection of the tests which run inside the testing suites. Tests are
+    selected by patterns matching their names, which can be:
+
+    - a test name, such as "mmap01"
+    - a glob pattern, such as "mmap*"
+    - a suite qualified pattern, such as "syscalls:mmap*"
+    - a regular expression prefixed by "re:", such as "re:mmap\\d+"
+
+    A test is selected when it matches one of the include patterns, if any,
+    and it doesn't match any exclude pattern.
+    """
+
+    def __init__(self,
+                 include: list = None,
+                 exclude: list = None,
+                 skip_file: str = None) -> None:
+        """
+        :param include: patterns of the tests to run. If None, all tests
+            run
+        :type include: list(str)
+        :param exclude: patterns of the tests which don't run
+        :type exclude: list(str)
+        :param skip_file: file containing patterns of the tests which don't
+            run, one per line. Empty lines and lines starting with "#" are
+            ignored
+        :type skip_file: str
+        :raises: ValueError
+        """
+        exclude = list(exclude or [])
+        if skip_file:
+            exclude.extend(self._read_skip_file(skip_file))
+
+        self._include = _Matcher(include or [])
+        self._exclude = _Matcher(exclude)
+
+    @staticmethod
+    def _read_skip_file(path: str) -> list:
+        """
+        Read the patterns of a skip file.
+        """
+        try:
+            with open(path, "r", encoding="UTF-8") as data:
+                lines = [line.strip() for line in data]
+        except OSError as err:
+            raise ValueError(f"can't read {path}: {err}") from err
+
+        return [line for line in lines if line and not line.startswith("#")]
+
+    def __bool__(self) -> bool:
+        return bool(self._include or self._exclude)
+
+    def match(self, suite: str, test: str) -> bool:
+        """
+        True if test is selected.
+        :param suite: name of the suite of the test
+        :type suite: str
+        :param test: name of the test
+        :type test: str
+        :returns: bool
+        """
+        if self._include and not self._include.match(suite, test):
+            return False
+
+        return not self._exclude.match(suite, test)
+
+    def filter(self, suite: str, tests: list) -> list:
+        """
+        Return the selected tests of a suite, keeping their order.
+        :param suite: name of the suite
+        :type suite: str
+        :param tests: tests of the suite
+        :type tests: list(LTPTest)
+        :returns: list(LTPTest)
+        """
+        return [test for test in tests if self.match(suite, test.name)]
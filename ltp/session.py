@@ -6,10 +6,27 @@
 .. moduleauthor:: Andrea Cervesato <andrea.cervesato@suse.com>
 """
 import os
-import re
+import time
+import shlex
+import signal
 import logging
+import threading
 import subprocess
 from datetime import datetime
+from .output import LTPOutput
+from .parser import LTPParser
+from .cgroup import CgroupError
+from .context import LTPContext
+from .launcher import LTPLauncher
+from .launcher import LauncherError
+from .launcher import LTPLaunchedProcess
+from .launcher import decode_status
+from .breaker import TargetAbortedError
+from .history import LTPHistory
+from .logsink import OUTPUT_LOGGER
+from .metrics import LTPProgress
+from .metadata import RuntestMetadata
+from .scheduler import LTPScheduler
 
 
 class LTPTestError(Exception):
@@ -93,17 +110,210 @@ class LTPObject:
         raise NotImplementedError()
 
 
+class _PlannedTest:
+    """
+    Test planned to run inside a session, together with its suite.
+    """
+
+    __slots__ = ["index", "suite", "test"]
+
+    def __init__(self, index: int, suite, test) -> None:
+        self.index = index
+        self.suite = suite
+        self.test = test
+
+    @property
+    def name(self) -> str:
+        """
+        Name of the test.
+        """
+        return self.test.name
+
+    @property
+    def exclusive(self) -> bool:
+        """
+        True if test can't run together with other tests.
+        """
+        return self.test.exclusive
+
+
+def _run_plan(scheduler,
+              plan: list,
+              callback: callable = None,
+              deadline: float = None,
+              cgroups=None,
+              started: callable = None,
+              breaker=None,
+              context=None,
+              launcher=None) -> None:
+    """
+    Run the planned tests of many suites inside a single scheduler run, so
+    workers don't wait for the slowest test of a suite before starting the
+    tests of the next one. A suite is completed once all its tests have
+    been handled, unless deadline passed before any of them started. When
+    tests run on backends, their commands are driven by one event loop
+    shared by all the workers.
+    :param plan: (suite, tests) of the suites to run
+    :type plan: list(tuple)
+    """
+    lock = threading.Lock()
+    remaining = [len(tests) for _, tests in plan]
+    ran = [False] * len(plan)
+
+    for suite, tests in plan:
+        if not tests:
+            suite.complete()
+
+    loop = None
+    if scheduler.backends:
+        # pylint: disable=import-outside-toplevel
+        from .backend import BackendLoop
+
+        loop = BackendLoop(
+            workers=scheduler.workers * len(scheduler.backends))
+        loop.start()
+
+    def _run(item, backend):
+        done = item.suite.run_test(
+            item.test,
+            backend,
+            callback,
+            deadline=deadline,
+            cgroups=cgroups,
+            started=started,
+            breaker=breaker,
+            context=context,
+            launcher=launcher,
+            loop=loop)
+
+        with lock:
+            remaining[item.index] -= 1
+            ran[item.index] = ran[item.index] or done
+            completed = ran[item.index] and not remaining[item.index]
+
+        if completed:
+            item.suite.complete()
+
+    try:
+        scheduler.run(
+            [
+                _PlannedTest(index, suite, test)
+                for index, (suite, tests) in enumerate(plan)
+                for test in tests
+            ],
+            _run)
+    finally:
+        if loop:
+            loop.stop()
+
+
 class LTPSession(LTPObject):
     """
     LTP session abstraction class.
     """
 
-    def __init__(self) -> None:
+    def __init__(self,
+                 exclusive: list = None,
+                 spool_dir: str = None,
+                 backends: list = None,
+                 history: LTPHistory = None,
+                 shard: tuple = None,
+                 cache_file: str = None,
+                 reporters: list = None,
+                 journal=None,
+                 test_timeout: int = None,
+                 session_timeout: int = None,
+                 cgroups=None,
+                 result_cache=None,
+                 selection=None,
+                 breaker=None,
+                 launcher=None) -> None:
+        """
+        :param exclusive: names of tests or testing suites which can't run
+            together with other tests
+        :type exclusive: list(str)
+        :param spool_dir: directory where tests output is spooled. A sub
+            directory named as the session is created inside it. If None,
+            tests output is kept in memory
+        :type spool_dir: str
+        :param backends: started backends where tests are sharded. If None,
+            tests run on the local host
+        :type backends: list(Backend)
+        :param history: durations of the previous runs. If given, longest
+            tests of each suite run first
+        :type history: LTPHistory
+        :param shard: (index, count) of the tests shard to run, where index
+            starts from 0. Shards are balanced using history, if given
+        :type shard: tuple(int, int)
+        :param cache_file: file where runtest metadata are cached. If None,
+            runtest files are parsed every time
+        :type cache_file: str
+        :param reporters: reports writers receiving tests as soon as they
+            are completed
+        :type reporters: list(LTPReporter)
+        :param journal: journal where completed tests are stored. Tests
+            which have results inside the journal are not executed
+        :type journal: LTPJournal
+        :param test_timeout: seconds before a test is stopped and reported
+            as broken, when test metadata don't define its timeout. If None,
+            tests have no timeout
+        :type test_timeout: int
+        :param session_timeout: seconds before the session is stopped. Tests
+            which are running are reported as broken and the remaining ones
+            are not executed. If None, session has no timeout
+        :type session_timeout: int
+        :param cgroups: cgroup v2 tree where every local test runs inside its
+            own cgroup, which is used to read the resources it used. If
+            None, only rusage of the tests is read
+        :type cgroups: CgroupTree
+        :param result_cache: cache of the results of previous sessions.
+            Tests which have results inside the cache are not executed and
+            new results are stored inside it
+        :type result_cache: LTPResultCache
+        :param selection: selection of the tests which run inside the
+            testing suites. If None, all tests run
+        :type selection: LTPSelection
+        :param breaker: circuit breaker stopping tests on targets which are
+            badly broken. If None, tests run on every target until the end
+        :type breaker: CircuitBreaker
+        :param launcher: started launcher process spawning the tests which
+            run on the local host. If None, tests are spawned by the runner
+        :type launcher: LTPLauncher
+        """
+        if shard:
+            index, count = shard
+            if count < 1 or index < 0 or index >= count:
+                raise ValueError(f"{shard} is not a valid shard")
+
         super().__init__()
 
         self._logger = logging.getLogger("ltp.session")
+        self._exclusive = exclusive
+        self._backends = backends
+        self._history = history
+        self._shard = shard
+        self._test_timeout = test_timeout
+        self._session_timeout = session_timeout
+        self._cgroups = cgroups
+        self._reporters = list(reporters or [])
+        self._journal = journal
+        if journal:
+            self._reporters.append(journal)
+        self._result_cache = result_cache
+        self._selection = selection
+        self._breaker = breaker
+        self._launcher = launcher
+        if result_cache is not None:
+            self._reporters.append(result_cache)
         self._name = datetime.now().strftime("LTP_%Y_%m_%d-%Hh_%Mm_%Ss")
-        self._suites = self._collect_suites()
+        self._spool_dir = None
+        if spool_dir:
+            self._spool_dir = os.path.join(spool_dir, self._name)
+        self._metadata = RuntestMetadata(
+            self._runtest_dir,
+            cache_file=cache_file)
+        self._suites = {}
+        self._progress = LTPProgress()
 
         self._logger.debug(
             "name=%s, ltproot=%s, runtest=%s, testcases=%s",
@@ -112,24 +322,35 @@ class LTPSession(LTPObject):
             self._runtest_dir,
             self._testcases_dir)
 
-    def _collect_suites(self) -> list:
+    def _get_suites(self, names: list = None) -> list:
         """
-        Collect all the available testing suites.
+        Return the testing suites having the given names, in the runtest
+        files order. Suites are created only the first time they are used.
+        If names is None, all suites are returned.
         """
-        suites = []
-
-        self._logger.debug("collecting suites")
+        if names is None:
+            names = self._metadata.available_suites
+        else:
+            names = set(names)
+            names = [
+                name for name in self._metadata.available_suites
+                if name in names
+            ]
 
-        files = [os.path.join(self._runtest_dir, fname)
-                 for fname in os.listdir(self._runtest_dir)
-                 if os.path.isfile(os.path.join(self._runtest_dir, fname))]
+        suites = []
+        for name in names:
+            suite = self._suites.get(name, None)
+            if not suite:
+                suite = LTPSuite(
+                    os.path.join(self._runtest_dir, name),
+                    exclusive=self._exclusive,
+                    spool_dir=self._spool_dir,
+                    metadata=self._metadata.read_suite(name),
+                    timeout=self._test_timeout)
+                self._suites[name] = suite
 
-        for fpath in files:
-            suite = LTPSuite(fpath)
             suites.append(suite)
 
-        self._logger.debug("collected %d suites", len(suites))
-
         return suites
 
     @property
@@ -141,20 +362,28 @@ class LTPSession(LTPObject):
         """
         return self._name
 
+    @property
+    def progress(self) -> LTPProgress:
+        """
+        Live progress of the running session.
+        :returns: LTPProgress
+        """
+        return self._progress
+
     @property
     def suites(self) -> list:
         """
         List  of suites for this session.
         :returns: list(Suite)
         """
-        return self._suites
+        return self._get_suites()
 
     def _get_result(self, attr: str) -> int:
         """
         Return the total number of results.
         """
         res = 0
-        for suite in self._suites:
+        for suite in self._suites.values():
             res += getattr(suite, attr)
 
         return res
@@ -199,82 +428,245 @@ class LTPSession(LTPObject):
         """
         return self._get_result("warnings")
 
+    @property
+    def scenarios(self) -> list:
+        """
+        Names of the scenarios inside the scenario_groups directory.
+        :returns: list(str)
+        """
+        if not os.path.isdir(self._scenario_dir):
+            return []
+
+        return sorted(
+            name for name in os.listdir(self._scenario_dir)
+            if os.path.isfile(os.path.join(self._scenario_dir, name)))
+
     def suites_from_scenario(self, scenario: str = "all") -> list:
         """
         List  of suites names inside a specific scenario.
-        :param scenario: name of the scenario ["all", "default", "network"]
+        :param scenario: name of a scenario file inside scenario_groups,
+            such as "default" or "network". If "all", all suites are listed
         :type scenario: str
         :returns: list(str)
         """
-        suites = []
+        if not scenario or scenario == "all":
+            return self._get_suites()
 
-        if scenario in ["default", "network"]:
-            suites_file = os.path.join(
-                self._root_dir,
-                "scenario_groups",
-                scenario)
+        if os.path.basename(scenario) != scenario:
+            raise ValueError(
+                f"'{scenario}' must be the name of a file inside "
+                f"{self._scenario_dir}")
 
-            if not os.path.isfile(suites_file):
-                raise ValueError(f"{suites_file} doesn't exist")
+        suites_file = os.path.join(self._scenario_dir, scenario)
+        if not os.path.isfile(suites_file):
+            raise ValueError(f"{suites_file} doesn't exist")
 
-            names = []
-            with open(suites_file, "r", encoding='UTF-8') as data:
-                for line in data:
-                    names.append(line.rstrip())
-
-            suites = [suite for suite in self._suites if suite.name in names]
-        else:
-            suites = self._suites
+        names = []
+        with open(suites_file, "r", encoding='UTF-8') as data:
+            for line in data:
+                line = line.strip()
+                if line and not line.startswith("#"):
+                    names.append(line)
 
-        return suites
+        return self._get_suites(names)
 
-    def run_scenario(self, scenario: str = "all") -> list:
+    def run_scenario(self, scenario: str = "all", workers: int = 1) -> list:
         """
         Run a specific scenario.
-        :param scenario: name of the scenario ["all", "default", "network"]
+        :param scenario: name of a scenario file inside scenario_groups,
+            such as "default" or "network". If "all", all suites run
         :type scenario: str
+        :param workers: number of tests which can run at the same time
+        :type workers: int
         :returns: list of suites which have been run as list(LTPSuite)
         :raises: LTPTestError
         """
-        if scenario and scenario not in ["all", "default", "network"]:
-            raise ValueError("scenario must be 'default', 'network' or 'all'")
-
         self._logger.debug("collecting suites from '%s' scenario", scenario)
 
-        try:
-            suites = self.suites_from_scenario(scenario)
-            for suite in suites:
-                suite.run()
-        finally:
-            self._completed = True
+        suites = self.suites_from_scenario(scenario)
+        self._run_suites(suites, workers)
 
         return suites
 
-    def run(self, suites: list = None) -> list:
+    def run(self, suites: list = None, workers: int = 1) -> list:
         """
         Run given test suites. If suites is None, "default" scenario will run.
         :param suites: list of testing suites to execute
         :type suites: list
+        :param workers: number of tests which can run at the same time
+        :type workers: int
         :returns: list of suites which have been run as list(LTPSuite)
         :raises: LTPTestError
         """
         self._logger.debug("running suites=%s", suites)
 
-        suites2run = None
-        if not suites:
-            suites2run = self._suites
-        else:
-            suites2run = [
-                suite for suite in self._suites
-                if suite.name in suites]
+        suites2run = self._get_suites(suites or None)
+
+        self._run_suites(suites2run, workers)
+
+        return suites2run
+
+    def _run_suites(self, suites: list, workers: int) -> None:
+        """
+        Run the tests of the given suites which belong to the session shard,
+        sorted according with the history.
+        """
+        scheduler = LTPScheduler(workers, self._backends)
+
+        shards = None
+        if self._shard:
+            history = self._history or LTPHistory()
+            shards = history.shard(
+                suites,
+                *self._shard,
+                select=self._selection.match if self._selection else None)
+
+        deadline = None
+        if self._session_timeout:
+            deadline = time.monotonic() + self._session_timeout
+
+        cgroups = self._cgroups
+        if cgroups:
+            try:
+                cgroups.setup()
+            except CgroupError as err:
+                # tests can't run without the limits they have been given
+                if cgroups.limits:
+                    raise LTPTestError(str(err)) from err
+
+                self._logger.warning("cgroups are not used: %s", err)
+                cgroups = None
+
+        # environment is read once, so it doesn't change while tests run
+        context = LTPContext()
+
+        # tests are planned before running, so progress knows about all
+        # the tests which are going to run
+        plan = []
+        restored = []
+        for suite in suites:
+            tests = suite.tests
+            if shards is not None:
+                tests = shards[suite.name]
+                if not tests:
+                    continue
+            elif self._selection:
+                tests = self._selection.filter(suite.name, tests)
+                if not tests:
+                    continue
+
+            if self._journal:
+                tests = self._restore_tests(suite, tests, restored)
+
+            if self._result_cache is not None:
+                tests = self._cached_tests(suite, tests, restored)
+
+            if self._history:
+                tests = self._history.sort(suite.name, tests)
+
+            plan.append((suite, tests))
+
+        self._progress.start(
+            [(suite.name, test.name) for suite, tests in plan
+             for test in tests],
+            slots=scheduler.workers * max(1, len(scheduler.backends)),
+            history=self._history)
+
+        for reporter in self._reporters:
+            reporter.start(self)
+
+        # restored tests are reported as the completed ones, so streaming
+        # reports contain all the tests of the planned suites
+        for suite, test in restored:
+            self._progress.test_restored(suite, test)
+
+            for reporter in self._reporters:
+                reporter.test_completed(suite, test)
 
         try:
-            for suite in suites2run:
-                suite.run()
+            _run_plan(
+                scheduler,
+                plan,
+                callback=self._test_completed,
+                deadline=deadline,
+                cgroups=cgroups,
+                started=self._progress.test_started,
+                breaker=self._breaker,
+                context=context,
+                launcher=self._launcher)
+        except TargetAbortedError as err:
+            self._logger.error("Session aborted: %s", err)
         finally:
+            if deadline and time.monotonic() >= deadline:
+                self._logger.error(
+                    "Session timed out after %d seconds",
+                    self._session_timeout)
+
             self._completed = True
+            self._progress.stop()
 
-        return suites2run
+            for reporter in self._reporters:
+                reporter.stop()
+
+            if cgroups:
+                cgroups.cleanup()
+
+    def _restore_tests(self, suite, tests: list, restored: list) -> list:
+        """
+        Restore results of the tests which are completed inside the journal
+        and return the tests which still have to run. Restored tests are
+        appended to restored as (suite, test).
+        """
+        results = self._journal.results
+
+        torun = []
+        for test in tests:
+            data = results.get((suite.name, test.name), None)
+            if data:
+                test.restore(data)
+                restored.append((suite, test))
+            else:
+                torun.append(test)
+
+        if len(torun) < len(tests):
+            self._logger.info(
+                "%s: %d tests restored from journal",
+                suite.name,
+                len(tests) - len(torun))
+
+        return torun
+
+    def _cached_tests(self, suite, tests: list, restored: list) -> list:
+        """
+        Restore results of the tests which are inside the results cache and
+        return the tests which still have to run. Restored tests are
+        appended to restored as (suite, test).
+        """
+        torun = []
+        for test in tests:
+            data = self._result_cache.lookup(suite.name, test)
+            if data:
+                test.restore(data)
+                restored.append((suite, test))
+            else:
+                torun.append(test)
+
+        if len(torun) < len(tests):
+            self._logger.info(
+                "%s: %d tests results reused from cache",
+                suite.name,
+                len(tests) - len(torun))
+
+        return torun
+
+    def _test_completed(self, suite, test) -> None:
+        """
+        Send a completed test to the reports writers.
+        """
+        self._progress.test_completed(suite, test)
+
+        for reporter in self._reporters:
+            reporter.test_completed(suite, test)
 
 
 class LTPSuite(LTPObject):
@@ -282,10 +674,29 @@ class LTPSuite(LTPObject):
     LTP testing suite abstraction class.
     """
 
-    def __init__(self, path: str) -> None:
+    def __init__(self,
+                 path: str,
+                 exclusive: list = None,
+                 spool_dir: str = None,
+                 metadata: dict = None,
+                 timeout: int = None) -> None:
         """
         :param path: abs path of the testing suite file declaration
         :type path: str
+        :param exclusive: names of tests which can't run together with other
+            tests. If it contains the suite name, all tests are exclusive
+        :type exclusive: list(str)
+        :param spool_dir: directory where tests output is spooled. A sub
+            directory named as the suite is created inside it. If None,
+            tests output is kept in memory
+        :type spool_dir: str
+        :param metadata: suite definition given by Metadata.read_suite. If
+            given, tests are created from it instead of parsing `path`
+        :type metadata: dict
+        :param timeout: default timeout of the tests in seconds. Tests
+            defining "timeout" inside their metadata use their own one. If
+            None, tests have no timeout
+        :type timeout: int
         """
         if not path:
             raise ValueError("path is empty")
@@ -297,7 +708,29 @@ class LTPSuite(LTPObject):
 
         self._logger = logging.getLogger("ltp.suite")
         self._name = os.path.basename(path)
-        self._tests = self._tests_from_path(path)
+        self._exclusive = exclusive or []
+        self._timeout = timeout
+        self._spool_dir = None
+        if spool_dir:
+            self._spool_dir = os.path.join(spool_dir, self._name)
+
+        if metadata:
+            self._tests = self._tests_from_metadata(metadata)
+        else:
+            self._tests = self._tests_from_path(path)
+
+    def _create_test(self, decl: str, timeout: int = None):
+        """
+        Create a test of the suite from its declaration.
+        """
+        test = LTPTest(
+            decl,
+            spool_dir=self._spool_dir,
+            timeout=timeout or self._timeout)
+        if self._name in self._exclusive or test.name in self._exclusive:
+            test.exclusive = True
+
+        return test
 
     def _tests_from_path(self, path: str) -> list:
         """
@@ -311,13 +744,24 @@ class LTPSuite(LTPObject):
                 if not line.strip() or line.strip().startswith("#"):
                     continue
 
-                test = LTPTest(line)
-                tests.append(test)
+                tests.append(self._create_test(line))
 
         self._logger.debug("collected %d tests", len(tests))
 
         return tests
 
+    def _tests_from_metadata(self, metadata: dict) -> list:
+        """
+        Return a list of LTPTests from a testing suite metadata.
+        """
+        tests = []
+        for data in metadata["tests"]:
+            decl = " ".join([data["name"], data["command"]] +
+                            data["arguments"])
+            tests.append(self._create_test(decl, data.get("timeout", None)))
+
+        return tests
+
     @property
     def name(self) -> str:
         """
@@ -384,19 +828,128 @@ class LTPSuite(LTPObject):
         """
         return self._get_result("warnings")
 
-    def run(self) -> None:
+    def complete(self) -> None:
         """
-        Run all tests inside the suite.
-        :raises: LTPTestError
+        Mark the suite as completed, once its scheduled tests have run.
+        """
+        self._completed = True
+
+    def run_test(self,
+                 test,
+                 backend=None,
+                 callback: callable = None,
+                 deadline: float = None,
+                 cgroups=None,
+                 started: callable = None,
+                 breaker=None,
+                 context: LTPContext = None,
+                 launcher: LTPLauncher = None,
+                 loop=None) -> bool:
+        """
+        Run a single test of the suite, logging its errors. Arguments are
+        the same given to `run`, where `loop` is the started BackendLoop
+        driving the commands of the backends.
+        :returns: False if test didn't run because deadline has been reached
+        :raises: TargetAbortedError
         """
+        timeout = test.timeout
+        if deadline:
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                self._logger.warning(
+                    "'%s' not executed: session timed out", test.name)
+                return False
+
+            timeout = min(timeout or remaining, remaining)
+
+        if breaker:
+            breaker.check(backend)
+
+        if started:
+            started(self, test, backend)
+
         try:
-            for test in self._tests:
-                try:
-                    test.run()
-                except LTPTestError as err:
-                    self._logger.error(str(err))
-        finally:
-            self._completed = True
+            test.run(
+                backend,
+                timeout=timeout,
+                cgroups=cgroups,
+                context=context,
+                launcher=launcher,
+                loop=loop)
+        except LTPTestError as err:
+            self._logger.error(str(err))
+
+        if callback and test.completed:
+            callback(self, test)
+
+        if breaker:
+            breaker.test_completed(test, backend)
+
+        return True
+
+    def run(self,
+            scheduler: LTPScheduler = None,
+            tests: list = None,
+            callback: callable = None,
+            deadline: float = None,
+            cgroups=None,
+            started: callable = None,
+            breaker=None,
+            context: LTPContext = None,
+            launcher: LTPLauncher = None) -> None:
+        """
+        Run tests inside the suite, as a session with a single suite does.
+        When tests run on backends, their commands are driven by an event
+        loop shared by all the workers.
+        :param scheduler: scheduler used to run tests. If None, tests will
+            run one after the other
+        :type scheduler: LTPScheduler
+        :param tests: tests of the suite to run, in the order they are
+            scheduled. If None, all tests run in declaration order
+        :type tests: list(LTPTest)
+        :param callback: function called as callback(suite, test) every time
+            a test is completed. It can be called by multiple workers at the
+            same time
+        :type callback: callable
+        :param deadline: time.monotonic() value after which tests are not
+            executed anymore and running tests are stopped
+        :type deadline: float
+        :param cgroups: cgroup v2 tree where local tests run
+        :type cgroups: CgroupTree
+        :param started: function called as started(suite, test, backend)
+            by the worker which is going to run a test. backend is None for
+            the local host
+        :type started: callable
+        :param breaker: circuit breaker checking the targets health. Tests
+            don't run on targets which have been aborted
+        :type breaker: CircuitBreaker
+        :param context: execution context shared by the tests. If None, it's
+            read from the environment once for all the tests
+        :type context: LTPContext
+        :param launcher: started launcher process spawning local tests. If
+            None, tests are spawned by the runner
+        :type launcher: LTPLauncher
+        :raises: LTPTestError, TargetAbortedError
+        """
+        if not scheduler:
+            scheduler = LTPScheduler()
+
+        if context is None:
+            context = LTPContext()
+
+        if tests is None:
+            tests = self._tests
+
+        _run_plan(
+            scheduler,
+            [(self, tests)],
+            callback=callback,
+            deadline=deadline,
+            cgroups=cgroups,
+            started=started,
+            breaker=breaker,
+            context=context,
+            launcher=launcher)
 
 
 class LTPTest(LTPObject):
@@ -404,10 +957,19 @@ class LTPTest(LTPObject):
     LTP test abstraction class.
     """
 
-    def __init__(self, decl: str) -> None:
+    def __init__(self,
+                 decl: str,
+                 spool_dir: str = None,
+                 timeout: int = None) -> None:
         """
         :param decl: declaration line from test suite file
         :type decl: str
+        :param spool_dir: directory where test output is spooled. If None,
+            test output is kept in memory
+        :type spool_dir: str
+        :param timeout: seconds before the test is stopped and reported as
+            broken. If None, test has no timeout
+        :type timeout: int
         """
         if not decl:
             raise ValueError("empty test declaration")
@@ -424,9 +986,22 @@ class LTPTest(LTPObject):
         self._brok = 0
         self._skip = 0
         self._warn = 0
-        self._stdout = ""
+        self._duration = 0.0
+        self._resources = {}
+        self._violations = {}
+        self._timeout = timeout
+        self._timed_out = False
+        self._exclusive = False
+        self._spool_path = None
+        if spool_dir:
+            self._spool_path = os.path.join(spool_dir, f"{self._name}.log")
+
+        self._output = LTPOutput(self._spool_path)
+        self._parser = LTPParser()
+        self._target = None
 
         self._logger = logging.getLogger("ltp.test")
+        self._stdout_logger = logging.getLogger(OUTPUT_LOGGER)
         self._logger.debug(
             "name: %s, command: %s, args: %s",
             self._name,
@@ -477,6 +1052,37 @@ class LTPTest(LTPObject):
         """
         return self._args
 
+    @property
+    def timeout(self) -> int:
+        """
+        Seconds before the test is stopped. None if test has no timeout.
+        :returns: int
+        """
+        return self._timeout
+
+    @property
+    def timed_out(self) -> bool:
+        """
+        True if test has been stopped because of its timeout.
+        :returns: bool
+        """
+        return self._timed_out
+
+    @property
+    def exclusive(self) -> bool:
+        """
+        True if test can't run together with other tests.
+        :returns: bool
+        """
+        return self._exclusive
+
+    @exclusive.setter
+    def exclusive(self, value: bool) -> None:
+        """
+        Set test as exclusive.
+        """
+        self._exclusive = value
+
     @property
     def failed(self) -> int:
         """
@@ -517,86 +1123,517 @@ class LTPTest(LTPObject):
         """
         return self._warn
 
+    @property
+    def duration(self) -> float:
+        """
+        Time in seconds spent running the test.
+        :returns: float
+        """
+        return self._duration
+
+    @property
+    def resources(self) -> dict:
+        """
+        Resources used by the test which ran on the local host: rusage of
+        the test processes and, when cgroups are used, the statistics of
+        the test cgroup inside "cgroup". Empty if test ran on a backend.
+        :returns: dict
+        """
+        return self._resources
+
+    @property
+    def violations(self) -> dict:
+        """
+        Resources limits which have been hit by the test, such as "memory"
+        when its processes have been killed by the OOM killer. See
+        Cgroup.violations.
+        :returns: dict
+        """
+        return self._violations
+
     @property
     def stdout(self) -> str:
         """
-        Test stdout.
+        Test stdout. When output is spooled, it's read back from the spool
+        file.
         :returns: str
         """
-        return self._stdout
+        return self._output.read()
 
-    def run(self) -> None:
+    @property
+    def target(self) -> str:
+        """
+        Target where test ran. None if test ran on the local host.
+        :returns: str
+        """
+        return self._target
+
+    @property
+    def stdout_size(self) -> int:
+        """
+        Number of characters written by the test on stdout.
+        :returns: int
+        """
+        return self._output.size
+
+    @property
+    def stdout_path(self) -> str:
+        """
+        Path of the file where test stdout is spooled. None if stdout is kept
+        in memory.
+        :returns: str
+        """
+        return self._output.path
+
+    @property
+    def stdout_tail(self) -> str:
+        """
+        Last characters written by the test on stdout, which are kept in
+        memory. The whole stdout is given when it's not spooled.
+        :returns: str
+        """
+        return self._output.tail
+
+    def _set_results(self, results: dict) -> None:
+        """
+        Update test results using the ones given by LTPParser.
         """
-        Run the test.
+        self._pass = results["passed"]
+        self._fail = results["failed"]
+        self._brok = results["broken"]
+        self._skip = results["skipped"]
+        self._warn = results["warnings"]
+
+    def restore(self, data: dict) -> None:
+        """
+        Restore the results of a test which has been completed in a
+        previous session.
+        :param data: test data reported inside the journal
+        :type data: dict
+        """
+        self._pass = data.get("passed", 0)
+        self._fail = data.get("failed", 0)
+        self._brok = data.get("broken", 0)
+        self._skip = data.get("skipped", 0)
+        self._warn = data.get("warnings", 0)
+        self._duration = data.get("duration", 0.0)
+        self._resources = data.get("resources", {})
+        self._violations = data.get("violations", {})
+        self._target = data.get("target", None)
+
+        self._output = LTPOutput(data.get("stdout_path", None))
+        if "stdout" in data:
+            self._output.write(data["stdout"])
+            self._output.close()
+
+        self._completed = True
+
+    def _read_line(self, line: str) -> None:
+        """
+        Handle a single line of the test stdout.
+        """
+        self._stdout_logger.info(line.rstrip(), extra={"test": self._name})
+        self._output.write(line)
+
+        if self._parser.feed(line):
+            self._set_results(self._parser.results)
+
+    def _kill_group(self, proc) -> None:
+        """
+        Kill the process group of the test, so processes spawned by the test
+        are stopped as well.
+        """
+        try:
+            os.killpg(proc.pid, signal.SIGKILL)
+        except (ProcessLookupError, PermissionError):
+            pass
+
+    def _on_timeout(self, proc) -> None:
+        """
+        Stop a test which didn't complete in time.
+        """
+        self._timed_out = True
+        self._kill_group(proc)
+
+    @staticmethod
+    def _rusage(rusage) -> dict:
+        """
+        Convert the rusage of the test processes into a dictionary.
+        """
+        return {
+            "utime": rusage.ru_utime,
+            "stime": rusage.ru_stime,
+            "maxrss": rusage.ru_maxrss,
+            "inblock": rusage.ru_inblock,
+            "oublock": rusage.ru_oublock,
+            "nvcsw": rusage.ru_nvcsw,
+            "nivcsw": rusage.ru_nivcsw,
+        }
+
+    def _create_cgroup(self, cgroups):
+        """
+        Create the cgroup of the test. None is returned if it can't be
+        created, so test runs without it, unless limits have to be applied.
+        """
+        try:
+            return cgroups.create(self._name)
+        except CgroupError as err:
+            if cgroups.limits:
+                raise LTPTestError(
+                    f"'{self._name}' limits can't be applied: {err}") from err
+
+            self._logger.warning("cgroup is not used: %s", err)
+
+        return None
+
+    def _spawn(self,
+               cmd: str,
+               context: LTPContext,
+               launcher=None,
+               procs_fd: int = None):
+        """
+        Spawn the test command. Commands without shell syntax are executed
+        directly, saving the shell startup, while the others are executed
+        by /bin/sh. If launcher is given, command is spawned by the launcher
+        process and it's spawned by the runner only if launcher fails.
+        :returns: subprocess.Popen or LTPLaunchedProcess
+        """
+        if launcher:
+            try:
+                return self._launch(cmd, context, launcher, procs_fd)
+            except LauncherError as err:
+                self._logger.warning(
+                    "'%s' spawned without launcher: %s", self._name, err)
+
+        # tests run inside their own session, so their process group can be
+        # killed on timeout
+        kwargs = dict(
+            stdout=subprocess.PIPE,
+            stderr=subprocess.STDOUT,
+            cwd=context.root_dir,
+            env=context.env,
+            universal_newlines=True,
+            start_new_session=True)
+
+        # runner is multithreaded, so code can't be safely executed between
+        # fork and exec: test waits for the runner to move it inside its
+        # cgroup, reading the end of its standard input
+        wait = ""
+        if procs_fd is not None:
+            kwargs["stdin"] = subprocess.PIPE
+            wait = "read -r _; "
+
+        proc = None
+
+        argv = context.argv(self._command, self._args)
+        if argv and wait:
+            argv = ["/bin/sh", "-c", wait + 'exec "$@"', "sh"] + argv
+
+        if argv:
+            try:
+                # pylint: disable=consider-using-with
+                proc = subprocess.Popen(argv, shell=False, **kwargs)
+            except OSError as err:
+                # scripts without interpreter line are executed by the shell
+                self._logger.debug(
+                    "can't execute '%s' directly: %s", self._command, err)
+                context.needs_shell(self._command)
+
+        if not proc:
+            # pylint: disable=consider-using-with
+            proc = subprocess.Popen(wait + cmd, shell=True, **kwargs)
+
+        if procs_fd is not None:
+            self._move_process(proc, procs_fd)
+
+        return proc
+
+    def _move_process(self, proc, procs_fd: int) -> None:
+        """
+        Move the spawned test inside its cgroup, then let it run closing its
+        standard input.
         :raises: LTPTestError
         """
-        self.refresh_env()
+        try:
+            os.write(procs_fd, str(proc.pid).encode())
+        except OSError as err:
+            proc.kill()
+            proc.communicate()
+
+            raise LTPTestError(
+                f"'{self._name}' can't be moved inside its cgroup: {err}") \
+                from err
+
+        proc.stdin.close()
+
+    def _launch(self,
+                cmd: str,
+                context: LTPContext,
+                launcher,
+                procs_fd: int = None):
+        """
+        Spawn the test command using the launcher process.
+        :returns: LTPLaunchedProcess
+        :raises: LauncherError
+        """
+        argv = context.argv(self._command, self._args)
+        if argv:
+            try:
+                return launcher.spawn(
+                    argv, context.root_dir, context.env, procs_fd)
+            except OSError as err:
+                # scripts without interpreter line are executed by the shell
+                self._logger.debug(
+                    "can't execute '%s' directly: %s", self._command, err)
+                context.needs_shell(self._command)
 
-        env = {}
-        env["LTPROOT"] = self._root_dir
-        if self._tmp_dir:
-            env["TMPDIR"] = self._tmp_dir
+        try:
+            return launcher.spawn(
+                ["/bin/sh", "-c", cmd], context.root_dir, context.env,
+                procs_fd)
+        except OSError as err:
+            raise LauncherError(f"can't spawn /bin/sh: {err}") from err
+
+    def _run_local(self,
+                   cmd: str,
+                   context: LTPContext,
+                   timeout: float,
+                   cgroups=None,
+                   launcher=None) -> int:
+        """
+        Run the test command on the local host.
+        :returns: command return code
+        """
+        cgroup = self._create_cgroup(cgroups) if cgroups else None
+        procs_fd = None
+        if cgroup:
+            procs_fd = cgroup.open_procs()
 
-        # enable colors
-        env["LTP_COLORIZE_OUTPUT"] = os.environ.get("LTP_COLORIZE_OUTPUT", "y")
+        try:
+            return self._run_process(
+                cmd, context, timeout, cgroup, procs_fd, launcher)
+        except LauncherError as err:
+            raise LTPTestError(f"'{self._name}' launcher error: {err}") \
+                from err
+        finally:
+            if procs_fd is not None:
+                os.close(procs_fd)
+
+            if cgroup:
+                cgroup.remove()
+
+    def _run_process(self,
+                     cmd: str,
+                     context: LTPContext,
+                     timeout: float,
+                     cgroup,
+                     procs_fd: int,
+                     launcher=None) -> int:
+        """
+        Spawn the test command and wait for its processes to complete.
+        :returns: command return code
+        """
+        with self._spawn(cmd, context, launcher, procs_fd) as proc:
+            launched = isinstance(proc, LTPLaunchedProcess)
+
+            timer = None
+            if timeout:
+                timer = threading.Timer(
+                    timeout, self._on_timeout, (proc,))
+                timer.daemon = True
+                timer.start()
+
+            try:
+                for line in iter(proc.stdout.readline, b''):
+                    if not line:
+                        break
+
+                    self._read_line(line)
+
+                # wait for the test without reaping it, so its pid can't
+                # be reused before killing the processes left behind by
+                # the test
+                if launched:
+                    proc.wait()
+                else:
+                    os.waitid(
+                        os.P_PID, proc.pid, os.WEXITED | os.WNOWAIT)
+            finally:
+                if timer:
+                    timer.cancel()
+
+                self._kill_group(proc)
 
-        # PATH must be set in order to run bash scripts
-        env["PATH"] = f'{os.environ.get("PATH")}:{self._testcases_dir}'
+                if cgroup:
+                    cgroup.kill()
+
+            # reap the test reading the resources used by its processes
+            if launched:
+                returncode, self._resources = proc.reap()
+            else:
+                _, status, rusage = os.wait4(proc.pid, 0)
+                proc.returncode = decode_status(status)
+                self._resources = self._rusage(rusage)
+                returncode = proc.returncode
+
+        if cgroup and cgroup.wait():
+            self._resources["cgroup"] = cgroup.stats()
+            self._violations = cgroup.violations()
+
+        return returncode
+
+    def _run_backend(self,
+                     cmd: str,
+                     context: LTPContext,
+                     backend,
+                     timeout: float,
+                     loop=None) -> int:
+        """
+        Run the test command using a backend. LTP is supposed to be installed
+        inside the same LTPROOT on the target. When an event loop is given,
+        output is parsed while it's read, otherwise once command completed.
+        :returns: command return code
+        """
+        # backends are imported only when used, so local runs don't need
+        # libssh to be installed
+        # pylint: disable=import-outside-toplevel
+        from .backend import BackendError
+        from .backend import BackendTimeoutError
+
+        exports = [
+            f"export {key}={shlex.quote(value)}"
+            for key, value in context.env.items() if key != "PATH"
+        ]
+        exports.append(
+            f'export PATH="$PATH":{shlex.quote(context.testcases_dir)}')
+
+        script = "; ".join(exports)
+        script += f"; cd {shlex.quote(context.root_dir)} || exit 1; {cmd}"
+
+        partial = ""
+
+        def _on_stdout(data: str) -> None:
+            nonlocal partial
+
+            *lines, partial = (partial + data).split("\n")
+            for line in lines:
+                self._read_line(line + "\n")
+
+        # backends timeouts are given in seconds
+        timeout = max(1, round(timeout)) if timeout else 0
+
+        returncode = None
+        try:
+            if loop:
+                ret = loop.run_cmd(backend, script, timeout, _on_stdout)
+            else:
+                ret = backend.run_cmd(script, timeout)
+                _on_stdout(ret["stdout"])
+
+            returncode = ret["returncode"]
+        except BackendTimeoutError:
+            self._timed_out = True
+            returncode = -signal.SIGKILL
+        except BackendError as err:
+            raise LTPTestError(f"{backend.target}: {err}") from err
+
+        if partial:
+            self._read_line(partial)
+
+        return returncode
+
+    def run(self,
+            backend=None,
+            timeout: float = None,
+            cgroups=None,
+            context: LTPContext = None,
+            launcher: LTPLauncher = None,
+            loop=None) -> None:
+        """
+        Run the test. Results are updated while test is running. When test
+        times out, its processes are killed and it's reported as broken.
+        :param backend: started backend where test will run. If None, test
+            runs on the local host
+        :type backend: Backend
+        :param timeout: seconds before the test is stopped. If None, test
+            timeout is used
+        :type timeout: float
+        :param cgroups: cgroup v2 tree where the test cgroup is created when
+            test runs on the local host. If None, test runs inside the
+            runner cgroup
+        :type cgroups: CgroupTree
+        :param context: execution context of the test. If None, it's read
+            from the environment
+        :type context: LTPContext
+        :param launcher: started launcher process spawning the test when it
+            runs on the local host. If None, test is spawned by the runner
+        :type launcher: LTPLauncher
+        :param loop: started BackendLoop running the command when test runs
+            on a backend, so output is parsed while it's read. If None,
+            command runs synchronously
+        :type loop: BackendLoop
+        :raises: LTPTestError
+        """
+        if context is None:
+            context = LTPContext()
+
+        self._completed = False
 
         cmd = f'{self._command} {" ".join(self._args)}'
 
         self._logger.debug("start running command: '%s'", cmd)
 
-        # keep usage of preexec_fn trivial
-        # see warnings in https://docs.python.org/3/library/subprocess.html
-        # pylint: disable=subprocess-popen-preexec-fn
-        with subprocess.Popen(
-                cmd,
-                stdout=subprocess.PIPE,
-                stderr=subprocess.STDOUT,
-                cwd=self._root_dir,
-                env=env,
-                shell=True,
-                universal_newlines=True,
-                preexec_fn=os.setsid) as proc:
+        self._output = LTPOutput(self._spool_path)
+        self._parser = LTPParser()
+        self._set_results(self._parser.results)
+        self._target = backend.target if backend else None
+        self._timed_out = False
+        self._resources = {}
+        self._violations = {}
 
-            for line in iter(proc.stdout.readline, b''):
-                if not line:
-                    break
+        if timeout is None:
+            timeout = self._timeout
 
-                self._logger.info(line.rstrip())
-                self._stdout += line
+        start = time.monotonic()
+        try:
+            if backend:
+                returncode = self._run_backend(
+                    cmd, context, backend, timeout, loop)
+            else:
+                returncode = self._run_local(
+                    cmd, context, timeout, cgroups, launcher)
+        finally:
+            self._duration = time.monotonic() - start
+            self._output.close()
 
-            proc.wait()
+        self._completed = True
 
-            self._completed = True
+        if self._violations:
+            self._logger.warning(
+                "'%s' hit its limits: %s",
+                self._name,
+                ", ".join(f"{key} ({value})"
+                          for key, value in self._violations.items()))
 
-            match = re.search(
-                r"Summary:\n"
-                r"passed\s*(?P<passed>\d+)\n"
-                r"failed\s*(?P<failed>\d+)\n"
-                r"broken\s*(?P<broken>\d+)\n"
-                r"skipped\s*(?P<skipped>\d+)\n"
-                r"warnings\s*(?P<warnings>\d+)\n",
-                self._stdout
-            )
-
-            if match:
-                self._pass = int(match.group("passed"))
-                self._fail = int(match.group("failed"))
-                self._skip = int(match.group("skipped"))
-                self._brok = int(match.group("broken"))
-                self._skip = int(match.group("skipped"))
-                self._warn = int(match.group("warnings"))
-
-                if proc.returncode != 0:
-                    raise LTPTestError(f"return code: {proc.returncode}")
-            else:
-                # if no results are given, this is probably an
-                # old test implementation that fails when return code is != 0
-                self._logger.debug("detected an old style test implementation")
+        if self._timed_out:
+            # tests which didn't complete are broken, keeping results which
+            # have been reported before timeout
+            self._brok += 1
 
-                if proc.returncode != 0:
-                    self._fail = 1
-                else:
-                    self._pass = 1
+            raise LTPTestError(
+                f"'{self._name}' timed out after {self._duration:.1f}s")
+
+        if self._parser.summary:
+            if returncode != 0:
+                raise LTPTestError(f"return code: {returncode}")
+        else:
+            # if no results are given, this is probably an
+            # old test implementation that fails when return code is != 0
+            self._logger.debug("detected an old style test implementation")
+
+            self._set_results(LTPParser().results)
+
+            if returncode != 0:
+                self._fail = 1
+            else:
+                self._pass = 1
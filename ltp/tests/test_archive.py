@@ -0,0 +1,297 @@
+"""
+Unittest for archive module.
+"""
+import os
+import json
+import pytest
+from ltp.archive import LTPArchive
+from ltp.archive import LTPArchiveWriter
+from ltp.archive import ArchiveError
+from ltp.archive import ArchiveReporter
+from ltp.archive import archive_to_json
+from ltp.archive import json_to_archive
+from ltp.archive import build_dictionary
+from ltp.archive import is_archive
+from ltp.history import LTPHistory
+from ltp.journal import LTPJournal
+from ltp.report import export_to_json
+from ltp.session import LTPSession
+
+BANNER = "tst_test.c:1560: TINFO: Timeout per run is 0h 05m 00s\n"
+
+
+def _test(name: str, stdout: str, **kwargs) -> dict:
+    """
+    Test data as written inside JSON reports.
+    """
+    data = {
+        "name": name,
+        "passed": 1,
+        "failed": 0,
+        "warnings": 0,
+        "skipped": 0,
+        "broken": 0,
+        "duration": 0.5,
+        "stdout": stdout,
+    }
+    data.update(kwargs)
+
+    return data
+
+
+def _write(path: str, tests: list, **kwargs) -> None:
+    """
+    Write an archive containing the given tests of a single suite.
+    """
+    with LTPArchiveWriter(path, **kwargs) as writer:
+        for test in tests:
+            writer.add_test("syscalls", test)
+
+        writer.set_suite("syscalls", {"passed": len(tests)})
+        writer.close({"name": "session"})
+
+
+def test_build_dictionary():
+    """
+    Test build_dictionary function.
+    """
+    samples = [
+        (BANNER + f"mmap0{i}.c:10: TPASS: passed\n").encode()
+        for i in range(10)
+    ]
+
+    assert build_dictionary(samples) == BANNER.encode()
+    assert build_dictionary(samples, size=10) == b""
+    assert build_dictionary([]) == b""
+
+
+def test_write_read(tmpdir):
+    """
+    Test writing and reading an archive.
+    """
+    path = str(tmpdir / "results.ltpa")
+    tests = [
+        _test(f"mmap{i:02d}", BANNER * 100 + f"test {i}\n")
+        for i in range(20)
+    ]
+    tests.append(_test("empty", "", target="sut1", resources={"maxrss": 1}))
+    tests.append(_test("spooled", None, stdout_path="/tmp/spooled.log"))
+    del tests[-1]["stdout"]
+
+    _write(path, tests, dict_sample=1024)
+
+    assert is_archive(path)
+    assert not os.path.exists(f"{path}.tmp")
+
+    with LTPArchive(path) as archive:
+        assert archive.session["name"] == "session"
+        assert archive.suites[0]["passed"] == 22
+
+        entries = list(archive.tests())
+        assert [test["name"] for _, test in entries] == \
+            [test["name"] for test in tests]
+
+        suite, test = entries[3]
+        assert suite == "syscalls"
+        assert test["stdout"]["size"] == len(tests[3]["stdout"])
+        assert archive.stdout(test) == tests[3]["stdout"]
+
+        assert [archive.test_data(test) for _, test in entries] == tests
+        assert archive.stdout(entries[-1][1]) is None
+        assert not list(archive.tests("mm"))
+
+    # repeated output is compressed well
+    raw = sum(len(test.get("stdout") or "") for test in tests)
+    assert os.path.getsize(path) < raw / 20
+
+
+def test_chunks(tmpdir):
+    """
+    Test that output is split in chunks and identical chunks are stored
+    only once.
+    """
+    path = str(tmpdir / "results.ltpa")
+    stdout = "".join(f"line {i}\n" for i in range(1000))
+    tests = [
+        _test("test01", stdout),
+        _test("test02", stdout),
+        _test("test03", "è" * 500 + "x" * 1000),
+    ]
+
+    _write(path, tests, chunk_size=256)
+
+    with LTPArchive(path) as archive:
+        entries = [test for _, test in archive.tests()]
+
+        chunks = entries[0]["stdout"]["chunks"]
+        assert len(chunks) > 1
+        assert entries[1]["stdout"]["chunks"] == chunks
+
+        assert "".join(archive.iter_stdout(entries[0])) == stdout
+        assert archive.stdout(entries[2]) == tests[2]["stdout"]
+
+
+def test_bad_archives(tmpdir):
+    """
+    Test reading files which are not complete archives.
+    """
+    path = tmpdir / "results.ltpa"
+
+    with pytest.raises(ArchiveError):
+        LTPArchive(str(path))
+
+    path.write("{}")
+    assert not is_archive(str(path))
+
+    with pytest.raises(ArchiveError):
+        LTPArchive(str(path))
+
+    # archives which are not closed are not written
+    with LTPArchiveWriter(str(path)) as writer:
+        writer.add_test("syscalls", _test("mmap01", BANNER))
+
+    assert path.read() == "{}"
+
+    _write(str(path), [_test("mmap01", BANNER)])
+    with open(str(path), "rb") as data:
+        content = data.read()
+
+    with open(str(path), "wb") as data:
+        data.write(content[:-4])
+
+    with pytest.raises(ArchiveError):
+        LTPArchive(str(path))
+
+
+def test_json_to_archive(tmpdir):
+    """
+    Test conversion of a JSON report into an archive and back.
+    """
+    report = tmpdir / "report.json"
+    tests = [
+        _test(f"mmap{i:02d}", BANNER * 10 + "è \"quoted\"\n",
+              duration=1e-05 * i, resources={"utime": 0.1})
+        for i in range(50)
+    ]
+    data = {
+        "session": {
+            "name": "LTP_2023",
+            "suites": [
+                {
+                    "name": "syscalls",
+                    "tests": tests,
+                    "passed": 50,
+                    "failed": 0,
+                    "warnings": 0,
+                    "skipped": 0,
+                    "broken": 0,
+                },
+                {
+                    "name": "empty",
+                    "tests": [],
+                    "passed": 0,
+                },
+            ],
+            "passed": 50,
+            "failed": 0,
+        }
+    }
+
+    with open(str(report), "w", encoding="UTF-8") as outfile:
+        json.dump(data, outfile, indent=4)
+
+    archive = str(tmpdir / "report.ltpa")
+    json_to_archive(str(report), archive)
+
+    with LTPArchive(archive) as reader:
+        assert reader.session["passed"] == 50
+        assert len(list(reader.tests("syscalls"))) == 50
+        assert reader.suites[1]["tests"] == []
+
+    converted = str(tmpdir / "converted.json")
+    archive_to_json(archive, converted)
+
+    with open(converted, "r", encoding="UTF-8") as infile:
+        assert infile.read() == report.read()
+
+
+def test_json_to_archive_bad_args(tmpdir):
+    """
+    Test conversion of bad JSON reports.
+    """
+    report = tmpdir / "report.json"
+    archive = str(tmpdir / "report.ltpa")
+
+    report.write('{"session": {"suites": [{"tests": [')
+    with pytest.raises(ArchiveError):
+        json_to_archive(str(report), archive)
+
+    report.write('{"session": {"suites": [{"tests": []}]}}')
+    with pytest.raises(ArchiveError):
+        json_to_archive(str(report), archive)
+
+    assert not os.path.exists(archive)
+
+
+@pytest.mark.usefixtures("prepare_tmpdir")
+class TestSessionArchive:
+    """
+    Test archives of the sessions.
+    """
+
+    def test_reporter(self, tmpdir):
+        """
+        Test ArchiveReporter compared with the JSON report.
+        """
+        archive = str(tmpdir / "report.ltpa")
+
+        session = LTPSession(reporters=[ArchiveReporter(archive)])
+        session.run()
+
+        report = str(tmpdir / "report.json")
+        export_to_json(session, report)
+
+        converted = str(tmpdir / "converted.json")
+        archive_to_json(archive, converted)
+
+        with open(report, "r", encoding="UTF-8") as data:
+            expected = json.load(data)
+
+        with open(converted, "r", encoding="UTF-8") as data:
+            assert json.load(data) == expected
+
+        # history is read from the index
+        history = LTPHistory()
+        history.load(archive)
+        assert len(history) == 5
+
+    def test_reporter_resume(self, tmpdir):
+        """
+        Test ArchiveReporter storing the tests restored from the journal.
+        """
+        journal = str(tmpdir / "journal")
+
+        session = LTPSession(journal=LTPJournal(journal))
+        session.run(suites=["dirsuite0", "dirsuite1"])
+
+        archive = str(tmpdir / "report.ltpa")
+
+        session = LTPSession(
+            journal=LTPJournal(journal, resume=True),
+            reporters=[ArchiveReporter(archive)])
+        session.run()
+
+        report = str(tmpdir / "report.json")
+        export_to_json(session, report)
+
+        converted = str(tmpdir / "converted.json")
+        archive_to_json(archive, converted)
+
+        with open(report, "r", encoding="UTF-8") as data:
+            expected = json.load(data)
+
+        with open(converted, "r", encoding="UTF-8") as data:
+            assert json.load(data) == expected
+
+        with LTPArchive(archive) as reader:
+            assert len(list(reader.tests())) == 5
@@ -0,0 +1,129 @@
+"""
+Unittest for the overhead benchmark.
+"""
+import os
+import json
+import pytest
+from ltp.benchmarks.overhead import create_ltproot
+from ltp.benchmarks.overhead import run_benchmarks
+from ltp.benchmarks.overhead import compare
+from ltp.benchmarks.overhead import main
+
+
+def test_create_ltproot(tmpdir):
+    """
+    Test create_ltproot function.
+    """
+    suites = create_ltproot(str(tmpdir), 10, 100)
+
+    assert sorted(suites) == ["noop", "output", "short"]
+    assert len(suites["noop"]) == 10
+    assert len(suites["output"]) == 1
+    assert len(suites["short"]) == 50
+
+    for name in suites:
+        assert os.path.isfile(tmpdir / "runtest" / name)
+
+    assert os.access(tmpdir / "testcases" / "bin" / "output.sh", os.X_OK)
+
+
+@pytest.mark.parametrize("workers", [1, 2])
+def test_run_benchmarks(workers):
+    """
+    Test run_benchmarks function.
+    """
+    environ = dict(os.environ)
+
+    results = run_benchmarks(
+        backends=["local", "launcher", "shell"],
+        tests=2,
+        lines=100,
+        workers=workers)
+
+    assert dict(os.environ) == environ
+    assert len(results["cases"]) == 9
+    assert results["max_rss_kb"] > 0
+
+    for case in results["cases"]:
+        assert case["completed"] == case["tests"]
+        assert case["workers"] == workers
+        assert case["wall_time"] > 0
+        assert case["throughput"] > 0
+        assert case["time_per_test"] == \
+            pytest.approx(case["wall_time"] / case["tests"])
+        assert case["overhead_per_test"] == pytest.approx(
+            (case["wall_time"] - case["baseline_time"]) / case["tests"])
+
+
+def test_run_benchmarks_bad_args():
+    """
+    Test run_benchmarks function with bad arguments.
+    """
+    with pytest.raises(ValueError):
+        run_benchmarks(tests=0)
+
+    with pytest.raises(ValueError):
+        run_benchmarks(lines=-1)
+
+    with pytest.raises(ValueError):
+        run_benchmarks(workers=0)
+
+    with pytest.raises(ValueError):
+        run_benchmarks(backends=["qemu"])
+
+    with pytest.raises(ValueError):
+        run_benchmarks(backends=["ssh"], tests=1)
+
+
+def test_compare():
+    """
+    Test compare function.
+    """
+    baseline = {"cases": [
+        {"suite": "noop", "backend": "local", "workers": 1,
+         "time_per_test": 0.001, "overhead_per_test": 0.0},
+        {"suite": "short", "backend": "local", "workers": 1,
+         "time_per_test": 0.001, "overhead_per_test": -0.001},
+    ]}
+
+    results = {"cases": [
+        {"suite": "noop", "backend": "local", "workers": 1,
+         "time_per_test": 0.0011, "overhead_per_test": 0.0001},
+        {"suite": "short", "backend": "local", "workers": 1,
+         "time_per_test": 0.002, "overhead_per_test": 0.0},
+        {"suite": "noop", "backend": "shell", "workers": 1,
+         "time_per_test": 0.01, "overhead_per_test": 0.01},
+    ]}
+
+    # overhead doesn't matter, even when it's zero or negative
+    regressions = compare(results, baseline, 0.2)
+    assert len(regressions) == 1
+    assert regressions[0].startswith("short on local")
+
+
+def test_main(mocker, tmpdir):
+    """
+    Test main function writing results and comparing them.
+    """
+    output = str(tmpdir / "results.json")
+    mocker.patch("sys.argv", [
+        "overhead", "-b", "local", "-n", "2", "-l", "10", "-o", output])
+    main()
+
+    with open(output, "r", encoding="utf-8") as data:
+        results = json.load(data)
+
+    assert len(results["cases"]) == 3
+
+    # a baseline without time per test can't be compared
+    for case in results["cases"]:
+        case["time_per_test"] = 0
+
+    baseline = str(tmpdir / "baseline.json")
+    with open(baseline, "w", encoding="utf-8") as data:
+        json.dump(results, data)
+
+    mocker.patch("sys.argv", [
+        "overhead", "-b", "local", "-n", "2", "-l", "10", "-o", output,
+        "--baseline", baseline])
+    main()
@@ -0,0 +1,264 @@
+"""
+Unittest for breaker module.
+"""
+from types import SimpleNamespace
+import pytest
+from ltp.breaker import CircuitBreaker
+from ltp.breaker import TargetAbortedError
+from ltp.backend import BackendError
+from ltp.backend import ShellBackend
+from ltp.session import LTPSession
+
+
+def _test(broken: int = 0, completed: bool = True):
+    """
+    An executed test.
+    """
+    return SimpleNamespace(broken=broken, completed=completed)
+
+
+class DummyBackend:
+    """
+    Backend running the health check and counting resets.
+    """
+
+    def __init__(self, returncodes: list = None, reset_error=False) -> None:
+        self.target = "dummy"
+        self.commands = []
+        self.resets = 0
+        self._returncodes = list(returncodes or [])
+        self._reset_error = reset_error
+
+    def run_cmd(self, command: str, timeout: int) -> dict:
+        """
+        Run the health check.
+        """
+        self.commands.append((command, timeout))
+
+        returncode = self._returncodes.pop(0) if self._returncodes else 0
+        if returncode is None:
+            raise BackendError("connection lost")
+
+        return {"returncode": returncode, "stdout": ""}
+
+    def reset(self) -> None:
+        """
+        Reset target.
+        """
+        if self._reset_error:
+            raise BackendError("can't reset")
+
+        self.resets += 1
+
+
+def test_constructor_bad_args():
+    """
+    Test constructor with bad arguments.
+    """
+    with pytest.raises(ValueError):
+        CircuitBreaker(max_broken=-1)
+
+    with pytest.raises(ValueError):
+        CircuitBreaker(max_errors=-1)
+
+    with pytest.raises(ValueError):
+        CircuitBreaker(health_interval=0)
+
+    with pytest.raises(ValueError):
+        CircuitBreaker(health_timeout=0)
+
+    with pytest.raises(ValueError):
+        CircuitBreaker(action="reboot")
+
+    assert not CircuitBreaker()
+
+
+def test_max_broken():
+    """
+    Test that consecutive broken tests abort the target.
+    """
+    breaker = CircuitBreaker(max_broken=3)
+
+    for broken in [1, 1, 0, 1, 1]:
+        breaker.test_completed(_test(broken=broken))
+        breaker.check()
+
+    breaker.test_completed(_test(broken=1))
+    assert breaker.aborted() == "3 consecutive broken tests"
+
+    with pytest.raises(TargetAbortedError):
+        breaker.check()
+
+
+def test_max_errors():
+    """
+    Test that consecutive backend errors abort the target.
+    """
+    backend = DummyBackend()
+    breaker = CircuitBreaker(max_errors=2)
+
+    breaker.test_completed(_test(completed=False), backend)
+    breaker.test_completed(_test(), backend)
+    breaker.test_completed(_test(completed=False), backend)
+    breaker.check(backend)
+
+    breaker.test_completed(_test(completed=False), backend)
+    assert breaker.aborted(backend) == "2 consecutive backend errors"
+
+    # other targets are not aborted
+    breaker.check(DummyBackend())
+    breaker.check()
+
+
+def test_health_check():
+    """
+    Test that a failing health check aborts the target.
+    """
+    backend = DummyBackend(returncodes=[0, 0, 1])
+    breaker = CircuitBreaker(
+        health_cmd="touch /tmp/health",
+        health_interval=2,
+        health_timeout=10)
+
+    for _ in range(5):
+        breaker.test_completed(_test(), backend)
+
+    assert breaker.aborted(backend) is None
+    assert backend.commands == [("touch /tmp/health", 10)] * 2
+
+    breaker.test_completed(_test(), backend)
+    assert breaker.aborted(backend) == "health check failed with 1"
+
+
+def test_health_check_error():
+    """
+    Test that a health check which can't run aborts the target.
+    """
+    backend = DummyBackend(returncodes=[None])
+    breaker = CircuitBreaker(health_cmd="true")
+
+    breaker.test_completed(_test(), backend)
+    assert breaker.aborted(backend).startswith("health check error")
+
+
+def test_health_check_local():
+    """
+    Test health check on the local host.
+    """
+    breaker = CircuitBreaker(health_cmd="true")
+    breaker.test_completed(_test())
+    breaker.check()
+
+    breaker = CircuitBreaker(health_cmd="sleep 5", health_timeout=1)
+    breaker.test_completed(_test())
+    assert breaker.aborted() == "health check timed out"
+
+
+def test_reset():
+    """
+    Test that tripped targets are reset.
+    """
+    backend = DummyBackend(returncodes=[1, 0])
+    breaker = CircuitBreaker(health_cmd="true", action="reset")
+
+    # health check fails, target is reset and checked again
+    breaker.test_completed(_test(), backend)
+    assert backend.resets == 1
+    assert breaker.aborted(backend) is None
+
+    backend = DummyBackend(returncodes=[1, 1])
+    breaker = CircuitBreaker(health_cmd="true", action="reset")
+
+    breaker.test_completed(_test(), backend)
+    assert backend.resets == 1
+    assert breaker.aborted(backend) == "health check failed with 1"
+
+
+def test_reset_error():
+    """
+    Test that targets which can't be reset are aborted.
+    """
+    backend = DummyBackend(reset_error=True)
+    breaker = CircuitBreaker(max_broken=1, action="reset")
+
+    breaker.test_completed(_test(broken=1), backend)
+    assert breaker.aborted(backend) == "1 consecutive broken tests"
+
+    # local host can't be reset
+    breaker.test_completed(_test(broken=1))
+    assert breaker.aborted() == "1 consecutive broken tests"
+
+
+@pytest.mark.usefixtures("prepare_tmpdir")
+class TestSessionBreaker:
+    """
+    Test LTPSession using the circuit breaker.
+    """
+
+    @staticmethod
+    def _write_suite(tmpdir) -> None:
+        """
+        Write a suite whose tests are broken after the first one, followed
+        by a suite of failing tests.
+        """
+        tmpdir.join("runtest").join("dirsuite5").write(
+            "brok00 script.sh 1 0 0 0 0\n" +
+            "".join(f"brok{i:02d} script.sh 0 0 1 0 0\n"
+                    for i in range(1, 10)))
+        tmpdir.join("runtest").join("dirsuite6").write(
+            "fail01 script.sh 0 1 0 0 0\n")
+
+    def test_run(self, tmpdir):
+        """
+        Test that tests don't run once the local host has been aborted.
+        """
+        self._write_suite(tmpdir)
+
+        session = LTPSession(breaker=CircuitBreaker(max_broken=3))
+        session.run(suites=["dirsuite0", "dirsuite5", "dirsuite6"])
+
+        executed = [
+            test.name for suite in session.suites for test in suite.tests
+            if test.completed
+        ]
+        assert executed == ["dir01", "brok00", "brok01", "brok02", "brok03"]
+
+    def test_run_health_check(self, tmpdir):
+        """
+        Test that tests don't run once the health check failed.
+        """
+        health = tmpdir / "health"
+        health.write("")
+
+        # test breaks the target
+        tmpdir.join("runtest").join("dirsuite5").write(
+            f"dir06 rm {health}\n"
+            "dir07 script.sh 0 1 0 0 0\n")
+        tmpdir.join("runtest").join("dirsuite6").write(
+            "fail01 script.sh 0 1 0 0 0\n")
+
+        session = LTPSession(
+            breaker=CircuitBreaker(health_cmd=f"test -f {health}"))
+        session.run(suites=["dirsuite0", "dirsuite5", "dirsuite6"])
+
+        assert session.passed == 2
+        assert session.failed == 0
+
+    def test_run_backends(self, tmpdir):
+        """
+        Test that tests of an aborted target run on the other targets.
+        """
+        self._write_suite(tmpdir)
+
+        backends = [ShellBackend(), ShellBackend()]
+
+        breaker = CircuitBreaker(max_broken=20)
+        for _ in range(20):
+            breaker.test_completed(_test(broken=1), backends[0])
+
+        session = LTPSession(backends=backends, breaker=breaker)
+        session.run(suites=["dirsuite5"])
+
+        assert breaker.aborted(backends[0])
+        assert not breaker.aborted(backends[1])
+        assert all(test.completed for test in session.suites[5].tests)
@@ -0,0 +1,205 @@
+"""
+Unittest for cgroup module.
+"""
+import os
+import pytest
+from ltp.cgroup import Cgroup
+from ltp.cgroup import CgroupTree
+from ltp.cgroup import CgroupError
+
+
+def test_stats(tmpdir):
+    """
+    Test stats method reading the cgroup files.
+    """
+    tmpdir.join("cpu.stat").write(
+        "usage_usec 1500000\n"
+        "user_usec 1000000\n"
+        "system_usec 500000\n")
+    tmpdir.join("memory.peak").write("4096\n")
+    tmpdir.join("io.stat").write(
+        "8:0 rbytes=100 wbytes=200 rios=1 wios=2 dbytes=0 dios=0\n"
+        "8:16 rbytes=10 wbytes=20 rios=3 wios=4 dbytes=0 dios=0\n")
+
+    assert Cgroup(str(tmpdir)).stats() == {
+        "cpu_usage": 1.5,
+        "cpu_user": 1.0,
+        "cpu_system": 0.5,
+        "memory_peak": 4096,
+        "io_rbytes": 110,
+        "io_wbytes": 220,
+        "io_rios": 4,
+        "io_wios": 6,
+    }
+
+
+def test_stats_no_controllers(tmpdir):
+    """
+    Test stats method when controllers are not enabled.
+    """
+    assert Cgroup(str(tmpdir)).stats() == {}
+
+
+def test_tree_bad_args(tmpdir):
+    """
+    Test CgroupTree constructor with bad arguments.
+    """
+    with pytest.raises(ValueError):
+        CgroupTree(None)
+
+    with pytest.raises(ValueError):
+        CgroupTree(str(tmpdir / "missing"))
+
+
+def test_tree_not_setup(tmpdir):
+    """
+    Test that cgroups can't be created before setup.
+    """
+    with pytest.raises(CgroupError):
+        CgroupTree(str(tmpdir)).create("test")
+
+
+@pytest.mark.skipif(
+    CgroupTree.discover() is None,
+    reason="cgroup v2 is not available")
+def test_tree():
+    """
+    Test creation and removal of the tests cgroups.
+    """
+    tree = CgroupTree.discover()
+    tree.setup()
+
+    try:
+        assert os.path.isdir(tree.path)
+        assert os.path.basename(tree.path) == f"runltp-ng.{os.getpid()}"
+
+        first = tree.create("test")
+        second = tree.create("test")
+        assert first.path != second.path
+        assert os.path.isfile(os.path.join(first.path, "cgroup.procs"))
+
+        assert first.wait()
+        first.remove()
+        second.remove()
+
+        assert not os.path.isdir(first.path)
+        assert not os.path.isdir(second.path)
+    finally:
+        tree.cleanup()
+
+    assert tree.path is None
+
+
+def test_tree_bad_limits(tmpdir):
+    """
+    Test CgroupTree constructor with bad limits.
+    """
+    with pytest.raises(ValueError):
+        CgroupTree(str(tmpdir), limits={"disk": 10})
+
+    with pytest.raises(ValueError):
+        CgroupTree(str(tmpdir), limits={"memory": -1})
+
+    tree = CgroupTree(str(tmpdir), limits={"memory": 1024, "cpu": None})
+    assert tree.limits == {"memory": 1024}
+
+
+def test_tree_missing_controllers(tmpdir):
+    """
+    Test that limits can't be used without their controllers.
+    """
+    tree = CgroupTree(str(tmpdir), limits={"pids": 10})
+
+    with pytest.raises(CgroupError, match="pids"):
+        tree.setup()
+
+    assert tree.path is None
+
+
+def test_tree_move_runner(tmpdir, caplog):
+    """
+    Test that runner is moved into a leaf cgroup before enabling
+    controllers, and moved back on cleanup.
+    """
+    tmpdir.join("cgroup.type").write("domain\n")
+    tmpdir.join("cgroup.procs").write(f"1\n{os.getpid()}\n")
+    tmpdir.join("cgroup.controllers").write("cpu pids\n")
+    tmpdir.join("cgroup.subtree_control").write("cpu\n")
+
+    tree = CgroupTree(str(tmpdir))
+    tree.setup()
+
+    runner = tmpdir / f"runner.{os.getpid()}"
+    assert runner.join("cgroup.procs").read() == str(os.getpid())
+    assert tmpdir.join("cgroup.subtree_control").read() == "+pids"
+    assert "contains other processes" in caplog.text
+
+    tree.cleanup()
+
+    assert tmpdir.join("cgroup.subtree_control").read() == "-pids"
+    assert tmpdir.join("cgroup.procs").read() == str(os.getpid())
+
+
+def test_tree_unmanaged_root(tmpdir):
+    """
+    Test that runner cgroup is not modified when it's not managed.
+    """
+    tmpdir.join("cgroup.type").write("domain\n")
+    tmpdir.join("cgroup.procs").write(f"1\n{os.getpid()}\n")
+    tmpdir.join("cgroup.controllers").write("cpu pids\n")
+    tmpdir.join("cgroup.subtree_control").write("cpu\n")
+
+    tree = CgroupTree(str(tmpdir), manage_root=False)
+    tree.setup()
+
+    try:
+        assert not tmpdir.join(f"runner.{os.getpid()}").exists()
+        assert tmpdir.join("cgroup.subtree_control").read() == "cpu\n"
+        assert tmpdir.join("cgroup.procs").read() == f"1\n{os.getpid()}\n"
+    finally:
+        tree.cleanup()
+
+
+def test_apply_limits(tmpdir):
+    """
+    Test apply_limits method writing the cgroup files.
+    """
+    tmpdir.join("memory.swap.max").write("max")
+
+    cgroup = Cgroup(
+        str(tmpdir),
+        limits={"memory": 1 << 20, "cpu": 1.5, "pids": 32})
+    cgroup.apply_limits()
+
+    assert tmpdir.join("memory.max").read() == "1048576"
+    assert tmpdir.join("memory.swap.max").read() == "0"
+    assert tmpdir.join("cpu.max").read() == "150000 100000"
+    assert tmpdir.join("pids.max").read() == "32"
+
+
+def test_apply_limits_error(tmpdir):
+    """
+    Test apply_limits method when cgroup files can't be written.
+    """
+    cgroup = Cgroup(str(tmpdir / "missing"), limits={"pids": 32})
+
+    with pytest.raises(CgroupError, match="pids.max"):
+        cgroup.apply_limits()
+
+
+def test_violations(tmpdir):
+    """
+    Test violations method reading the cgroup events.
+    """
+    tmpdir.join("memory.events").write(
+        "low 0\nhigh 0\nmax 12\noom 1\noom_kill 1\n")
+    tmpdir.join("pids.events").write("max 3\n")
+    tmpdir.join("cpu.stat").write("usage_usec 10\nnr_throttled 0\n")
+
+    cgroup = Cgroup(
+        str(tmpdir),
+        limits={"memory": 1 << 20, "cpu": 1, "pids": 32})
+    assert cgroup.violations() == {"memory": 1, "pids": 3}
+
+    # only limits which have been defined are checked
+    assert Cgroup(str(tmpdir), limits={"cpu": 1}).violations() == {}
@@ -0,0 +1,272 @@
+"""
+Unittest for compare module.
+"""
+import json
+import pytest
+from ltp.archive import LTPArchiveWriter
+from ltp.compare import LTPComparison
+from ltp.compare import compare_reports
+from ltp.compare import iter_results
+from ltp.report import export_to_json
+from ltp.report import JSONLReporter
+from ltp.session import LTPSession
+
+
+def _test(name: str, status: str, duration: float = 0.1) -> dict:
+    """
+    Test data as written inside JSON reports.
+    """
+    data = {
+        "name": name,
+        "passed": 0,
+        "failed": 0,
+        "warnings": 0,
+        "skipped": 0,
+        "broken": 0,
+        "duration": duration,
+        "stdout": "tst_test.c:1560: TINFO: Timeout per run is 0h 05m 00s\n",
+    }
+    data[status] = 1
+
+    return data
+
+
+def _write_json(path: str, tests: dict) -> str:
+    """
+    Write a JSON report containing tests of the "syscalls" suite.
+    """
+    data = {
+        "session": {
+            "name": "session",
+            "suites": [{"name": "syscalls", "tests": list(tests)}],
+        }
+    }
+
+    with open(path, "w", encoding="UTF-8") as outfile:
+        json.dump(data, outfile, indent=4)
+
+    return path
+
+
+def _write_jsonl(path: str, tests: list) -> str:
+    """
+    Write a JSON lines report containing tests of the "syscalls" suite.
+    """
+    with open(path, "w", encoding="UTF-8") as outfile:
+        for test in tests:
+            outfile.write(json.dumps(dict(suite="syscalls", **test)) + "\n")
+
+    return path
+
+
+def _write_archive(path: str, tests: list) -> str:
+    """
+    Write an archive containing tests of the "syscalls" suite.
+    """
+    with LTPArchiveWriter(path) as writer:
+        for test in tests:
+            writer.add_test("syscalls", test)
+
+        writer.close({"name": "session"})
+
+    return path
+
+
+@pytest.mark.parametrize("writer", [_write_json, _write_jsonl, _write_archive])
+def test_iter_results(tmpdir, writer):
+    """
+    Test iter_results function on all reports formats.
+    """
+    path = writer(str(tmpdir / "report"), [
+        _test("mmap01", "passed", 1.0),
+        _test("mmap02", "failed"),
+        _test("mmap03", "broken"),
+        _test("mmap04", "skipped"),
+    ])
+
+    assert list(iter_results(path)) == [
+        ("syscalls", "mmap01", "passed", 1.0),
+        ("syscalls", "mmap02", "failed", 0.1),
+        ("syscalls", "mmap03", "broken", 0.1),
+        ("syscalls", "mmap04", "skipped", 0.1),
+    ]
+
+
+@pytest.mark.parametrize("writer", [_write_json, _write_jsonl])
+def test_iter_results_long_lines(tmpdir, writer, mocker):
+    """
+    Test iter_results function when tests output is longer than the
+    characters read to detect the report format.
+    """
+    mocker.patch("ltp.compare.SNIFF_SIZE", 64)
+
+    test = _test("mmap01", "passed")
+    test["stdout"] *= 10
+
+    path = str(tmpdir / "report")
+    if writer == _write_json:
+        # JSON report written on a single line
+        with open(path, "w", encoding="UTF-8") as outfile:
+            json.dump({
+                "session": {
+                    "name": "session",
+                    "suites": [{"name": "syscalls", "tests": [test]}],
+                }
+            }, outfile)
+    else:
+        writer(path, [test])
+
+    assert list(iter_results(path)) == [
+        ("syscalls", "mmap01", "passed", 0.1),
+    ]
+
+
+def test_iter_results_empty(tmpdir):
+    """
+    Test iter_results function on empty JSON lines reports.
+    """
+    path = tmpdir / "report.jsonl"
+    path.write("")
+    assert not list(iter_results(str(path)))
+
+    path.write("\n")
+    assert not list(iter_results(str(path)))
+
+
+def test_iter_results_bad_args(tmpdir):
+    """
+    Test iter_results function with bad reports.
+    """
+    with pytest.raises(ValueError):
+        list(iter_results(str(tmpdir / "missing")))
+
+    path = tmpdir / "report.json"
+    path.write('{"session": {"suites": [{"name": "syscalls", "tests": [{')
+
+    with pytest.raises(ValueError):
+        list(iter_results(str(path)))
+
+
+def test_constructor_bad_args():
+    """
+    Test LTPComparison constructor with bad arguments.
+    """
+    with pytest.raises(ValueError):
+        LTPComparison(threshold=-1)
+
+    with pytest.raises(ValueError):
+        LTPComparison(min_delta=-1)
+
+    with pytest.raises(ValueError):
+        compare_reports([], ["report.json"])
+
+    with pytest.raises(ValueError):
+        compare_reports(["report.json"], [])
+
+
+def test_compare(tmpdir):
+    """
+    Test comparison between a baseline and two reruns of a new session.
+    """
+    baseline = _write_json(str(tmpdir / "baseline.json"), [
+        _test("fixed", "failed"),
+        _test("regressed", "passed"),
+        _test("skipped", "passed"),
+        _test("flaky", "passed"),
+        _test("slow", "passed", 2.0),
+        _test("slow_short", "passed", 0.1),
+        _test("removed", "passed"),
+        _test("same", "broken", 10.0),
+    ])
+
+    new = [
+        _write_jsonl(str(tmpdir / "new1.jsonl"), [
+            _test("fixed", "passed"),
+            _test("regressed", "broken"),
+            _test("skipped", "skipped"),
+            _test("flaky", "passed"),
+            _test("slow", "passed", 4.0),
+            _test("slow_short", "passed", 0.5),
+            _test("added", "passed"),
+            _test("same", "broken", 10.0),
+        ]),
+        _write_archive(str(tmpdir / "new2.ltpa"), [
+            _test("fixed", "passed"),
+            _test("regressed", "broken"),
+            _test("skipped", "skipped"),
+            _test("flaky", "failed"),
+            _test("slow", "passed", 6.0),
+            _test("slow_short", "passed", 0.5),
+            _test("same", "broken", 10.0),
+        ]),
+    ]
+
+    results = compare_reports([baseline], new, threshold=0.5, min_delta=1)
+
+    assert results["reports"] == {"baseline": 1, "new": 2}
+    assert results["tests"] == 9
+    assert results["new_failures"] == [{
+        "test": "syscalls:regressed",
+        "baseline": "passed",
+        "new": "broken",
+    }]
+    assert results["fixes"] == [{
+        "test": "syscalls:fixed",
+        "baseline": "failed",
+        "new": "passed",
+    }]
+    assert results["changed"] == [{
+        "test": "syscalls:skipped",
+        "baseline": "passed",
+        "new": "skipped",
+    }]
+    assert results["flaky"] == [{
+        "test": "syscalls:flaky",
+        "baseline": ["passed"],
+        "new": ["passed", "failed"],
+    }]
+    assert results["runtime_regressions"] == [{
+        "test": "syscalls:slow",
+        "baseline": 2.0,
+        "new": 5.0,
+    }]
+    assert results["added"] == ["syscalls:added"]
+    assert results["removed"] == ["syscalls:removed"]
+
+
+def test_compare_many_tests(tmpdir):
+    """
+    Test comparison of big reports, which are read one test at time.
+    """
+    tests = [_test(f"test{i:05d}", "passed") for i in range(20000)]
+    baseline = _write_json(str(tmpdir / "baseline.json"), tests)
+
+    tests[1234] = _test("test01234", "failed")
+    new = _write_json(str(tmpdir / "new.json"), tests)
+
+    results = compare_reports([baseline], [new])
+
+    assert results["tests"] == 20000
+    assert [item["test"] for item in results["new_failures"]] == \
+        ["syscalls:test01234"]
+
+
+@pytest.mark.usefixtures("prepare_tmpdir")
+def test_compare_sessions(tmpdir):
+    """
+    Test comparison of reports written by sessions.
+    """
+    jsonl = str(tmpdir / "report.jsonl")
+
+    session = LTPSession(reporters=[JSONLReporter(jsonl)])
+    session.run()
+
+    report = str(tmpdir / "report.json")
+    export_to_json(session, report)
+
+    results = compare_reports([report], [jsonl])
+
+    assert results["tests"] == 5
+    for key in ["new_failures", "fixes", "changed", "flaky", "added",
+                "removed", "runtime_regressions"]:
+        assert not results[key]
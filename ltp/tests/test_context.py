@@ -0,0 +1,129 @@
+"""
+Unittest for context module.
+"""
+import os
+import stat
+import pytest
+from ltp.context import LTPContext
+from ltp.session import LTPTest
+from ltp.session import LTPSession
+
+
+def test_env(tmpdir):
+    """
+    Test that context is read from the environment once.
+    """
+    environ = {
+        "LTPROOT": str(tmpdir),
+        "TMPDIR": "/tmp",
+        "PATH": "/usr/bin",
+    }
+
+    context = LTPContext(environ)
+    environ["LTPROOT"] = "/opt/ltp"
+
+    assert context.root_dir == str(tmpdir)
+    assert context.testcases_dir == str(tmpdir / "testcases" / "bin")
+    assert context.tmp_dir == "/tmp"
+    assert context.path == f"/usr/bin:{tmpdir}/testcases/bin"
+    assert dict(context.env) == {
+        "LTPROOT": str(tmpdir),
+        "TMPDIR": "/tmp",
+        "LTP_COLORIZE_OUTPUT": "y",
+        "PATH": f"/usr/bin:{tmpdir}/testcases/bin",
+    }
+
+    with pytest.raises(TypeError):
+        context.env["PATH"] = "/bin"
+
+
+@pytest.mark.usefixtures("prepare_tmpdir")
+class TestContext:
+    """
+    Test LTPContext resolving the tests binaries.
+    """
+
+    @pytest.mark.parametrize("command, args", [
+        ("script.sh", ["1", "2"]),
+        ("./testcases/bin/script.sh", []),
+    ])
+    def test_argv(self, tmpdir, command, args):
+        """
+        Test argv of commands which are executed directly.
+        """
+        context = LTPContext()
+
+        assert context.argv(command, args) == \
+            [str(tmpdir / "testcases" / "bin" / "script.sh")] + args
+
+    @pytest.mark.parametrize("command, args", [
+        ("script.sh", ["1", ">", "/dev/null"]),
+        ("script.sh", ["$HOME"]),
+        ("script.sh", ["'a'"]),
+        ("script.sh", ["a;", "true"]),
+        ("script.sh", ["*"]),
+        ("FOO=1", ["script.sh"]),
+        ("cd", ["/"]),
+        ("exit", ["1"]),
+        ("missing", []),
+        ("./missing", []),
+    ])
+    def test_argv_shell(self, command, args):
+        """
+        Test commands which need a shell.
+        """
+        assert LTPContext().argv(command, args) is None
+
+    def test_needs_shell(self):
+        """
+        Test commands marked as executed by the shell.
+        """
+        context = LTPContext()
+        assert context.argv("script.sh", [])
+
+        context.needs_shell("script.sh")
+        assert context.argv("script.sh", []) is None
+
+    def test_run_no_interpreter(self, tmpdir):
+        """
+        Test that scripts without interpreter line run inside the shell.
+        """
+        script = tmpdir / "testcases" / "bin" / "noshebang.sh"
+        script.write("exit 0\n")
+        os.chmod(str(script), os.stat(str(script)).st_mode | stat.S_IEXEC)
+
+        context = LTPContext()
+
+        test = LTPTest("test noshebang.sh")
+        test.run(context=context)
+
+        assert test.completed
+        assert test.passed == 1
+        assert context.binary("noshebang.sh") is None
+
+    def test_run_shell(self, tmpdir):
+        """
+        Test that commands using shell syntax run inside the shell.
+        """
+        test = LTPTest(
+            "test script.sh 1 0 0 0 0 > /dev/null; echo $LTPROOT")
+        test.run(context=LTPContext())
+
+        assert test.completed
+        assert test.passed == 1
+        assert test.stdout.strip() == str(tmpdir)
+
+    def test_session_env(self, tmpdir):
+        """
+        Test that session tests run inside the session context.
+        """
+        tmpdir.join("runtest").join("dirsuite5").write(
+            "dir06 printenv LTPROOT\n"
+            "dir07 printenv TMPDIR\n")
+
+        session = LTPSession()
+        session.run(suites=["dirsuite5"])
+
+        tests = session.suites[5].tests
+        assert all(test.passed == 1 for test in tests)
+        assert [test.stdout.strip() for test in tests] == [str(tmpdir)] * 2
@@ -0,0 +1,178 @@
+"""
+Unittest for history module.
+"""
+import json
+import pytest
+from ltp.history import LTPHistory
+
+
+class DummyTest:
+    """
+    Dummy test with a name.
+    """
+
+    def __init__(self, name: str) -> None:
+        self.name = name
+
+
+class DummySuite:
+    """
+    Dummy suite with a name and its tests.
+    """
+
+    def __init__(self, name: str, tests: list) -> None:
+        self.name = name
+        self.tests = [DummyTest(test) for test in tests]
+
+
+@pytest.fixture
+def report(tmpdir):
+    """
+    JSON report containing tests durations.
+    """
+    data = {
+        "session": {
+            "name": "LTP",
+            "suites": [
+                {
+                    "name": "suite0",
+                    "tests": [
+                        {"name": "test0", "duration": 1.0},
+                        {"name": "test1", "duration": 10.0},
+                        {"name": "test2", "duration": 4.0},
+                        {"name": "test3"},
+                    ]
+                },
+                {
+                    "name": "suite1",
+                    "tests": [
+                        {"name": "test0", "duration": 7.0},
+                        {"name": "test1", "duration": 3.0},
+                    ]
+                },
+            ]
+        }
+    }
+
+    path = tmpdir.join("report.json")
+    path.write(json.dumps(data))
+
+    return str(path)
+
+
+def test_constructor_bad_args():
+    """
+    Test constructor with bad arguments.
+    """
+    with pytest.raises(ValueError):
+        LTPHistory(default=None)
+
+    with pytest.raises(ValueError):
+        LTPHistory(default=-1)
+
+
+def test_load_bad_args(tmpdir):
+    """
+    Test load method with bad arguments.
+    """
+    history = LTPHistory()
+
+    with pytest.raises(ValueError):
+        history.load(None)
+
+    with pytest.raises(ValueError):
+        history.load(str(tmpdir.join("notexisting.json")))
+
+    path = tmpdir.join("bad.json")
+    path.write("{ this is not JSON")
+
+    with pytest.raises(ValueError):
+        history.load(str(path))
+
+
+def test_duration(report):
+    """
+    Test duration method.
+    """
+    history = LTPHistory(default=2.0)
+    assert history.duration("suite0", "test0") == 2.0
+
+    history.load(report)
+
+    assert len(history) == 5
+    assert history.duration("suite0", "test0") == 1.0
+    assert history.duration("suite1", "test0") == 7.0
+    assert history.duration("suite0", "test3") == 5.0
+    assert history.duration("suite2", "test0") == 5.0
+
+
+def test_sort(report):
+    """
+    Test sort method.
+    """
+    history = LTPHistory()
+    history.load(report)
+
+    suite = DummySuite("suite0", ["test0", "test1", "test2", "test3"])
+    tests = history.sort(suite.name, suite.tests)
+
+    assert [test.name for test in tests] == \
+        ["test1", "test3", "test2", "test0"]
+
+
+def test_shard_bad_args():
+    """
+    Test shard method with bad arguments.
+    """
+    history = LTPHistory()
+    suites = [DummySuite("suite0", ["test0"])]
+
+    with pytest.raises(ValueError):
+        history.shard(suites, 0, 0)
+
+    with pytest.raises(ValueError):
+        history.shard(suites, -1, 2)
+
+    with pytest.raises(ValueError):
+        history.shard(suites, 2, 2)
+
+
+def test_shard(report):
+    """
+    Test shard method splitting tests in balanced shards.
+    """
+    history = LTPHistory()
+    history.load(report)
+
+    suites = [
+        DummySuite("suite0", ["test0", "test1", "test2", "test3"]),
+        DummySuite("suite1", ["test0", "test1"]),
+    ]
+
+    shards = [history.shard(suites, i, 2) for i in range(2)]
+
+    names = []
+    loads = []
+    for shard in shards:
+        load = 0
+        for suite, tests in shard.items():
+            for test in tests:
+                names.append((suite, test.name))
+                load += history.duration(suite, test.name)
+        loads.append(load)
+
+    assert sorted(names) == sorted(
+        (suite.name, test.name) for suite in suites for test in suite.tests)
+    assert loads == [15.0, 15.0]
+
+
+def test_shard_no_history():
+    """
+    Test shard method when history is empty.
+    """
+    history = LTPHistory()
+    suites = [DummySuite("suite0", [f"test{i}" for i in range(9)])]
+
+    sizes = [len(history.shard(suites, i, 3)["suite0"]) for i in range(3)]
+
+    assert sizes == [3, 3, 3]
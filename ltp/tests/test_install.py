@@ -2,11 +2,17 @@
 Tests for install module
 """
 import os
+import time
 import shutil
+import platform
 import pytest
 import ltp.install
 from ltp.install import main as main_run
 from ltp.install import INSTALLERS
+from ltp.install import ArtifactCache
+from ltp.install import InstallerError
+from ltp.backend import ShellBackend
+from ltp.backend import BackendError
 
 
 SUPPORTED_DISTROS = [pm.distro_id for pm in INSTALLERS]
@@ -77,3 +83,643 @@ class TestInstall:
         assert os.path.isdir(inst_dir + "/testcases")
         assert os.path.isdir(inst_dir + "/testscripts")
         assert os.path.isdir(inst_dir + "/scenario_groups")
+
+
+class TestArtifactCache:
+    """
+    Tests for ArtifactCache class.
+    """
+
+    @pytest.fixture
+    def install_dir(self, tmpdir):
+        """
+        A fake LTP installation.
+        """
+        inst_dir = tmpdir.mkdir("ltp_install")
+        (inst_dir / "runltp").write("#!/bin/sh")
+        (inst_dir.mkdir("runtest") / "syscalls").write("abort01 abort01")
+
+        return str(inst_dir)
+
+    def test_bad_args(self):
+        """
+        Test constructor with bad arguments.
+        """
+        with pytest.raises(ValueError):
+            ArtifactCache(None)
+
+    def test_key(self):
+        """
+        Test key method.
+        """
+        key = ArtifactCache.key("abcd", "x86_64", False, "/opt/ltp")
+        assert key.startswith("ltp-abcd-x86_64-")
+        assert key.endswith(".tar.gz")
+
+        assert ArtifactCache.key("abcd", "x86_64", True, "/opt/ltp") != key
+        assert ArtifactCache.key("abcd", "x86_64", False, "/ltp") != key
+        assert ArtifactCache.key("abcd", "aarch64", False, "/opt/ltp") != key
+
+    def test_fetch_missing(self, tmpdir):
+        """
+        Test fetch method when tarball has not been cached.
+        """
+        cache = ArtifactCache(str(tmpdir / "cache"))
+        assert not cache.fetch("ltp-abcd.tar.gz", str(tmpdir / "ltp"))
+        assert not os.path.isdir(tmpdir / "ltp")
+
+    def test_store_fetch(self, tmpdir, install_dir):
+        """
+        Test store and fetch methods.
+        """
+        cache = ArtifactCache(str(tmpdir / "cache"))
+        cache.store("ltp-abcd.tar.gz", install_dir)
+
+        assert os.listdir(tmpdir / "cache") == ["ltp-abcd.tar.gz"]
+
+        target = str(tmpdir / "target")
+        assert cache.fetch("ltp-abcd.tar.gz", target)
+
+        assert os.path.isfile(os.path.join(target, "runltp"))
+        with open(os.path.join(target, "runtest", "syscalls"), "r",
+                  encoding="utf-8") as data:
+            assert data.read() == "abort01 abort01"
+
+    def test_fetch_url(self, tmpdir, install_dir):
+        """
+        Test fetch method using an URL.
+        """
+        ArtifactCache(str(tmpdir / "cache")).store(
+            "ltp-abcd.tar.gz", install_dir)
+
+        cache = ArtifactCache(f"file://{tmpdir / 'cache'}")
+        target = str(tmpdir / "target")
+        assert cache.fetch("ltp-abcd.tar.gz", target)
+        assert os.path.isfile(os.path.join(target, "runltp"))
+
+        # remote caches are read only
+        cache.store("ltp-efgh.tar.gz", install_dir)
+        assert os.listdir(tmpdir / "cache") == ["ltp-abcd.tar.gz"]
+
+    def test_fetch_corrupted(self, tmpdir):
+        """
+        Test fetch method when tarball is corrupted.
+        """
+        cache_dir = tmpdir.mkdir("cache")
+        (cache_dir / "ltp-abcd.tar.gz").write("not a tarball")
+
+        cache = ArtifactCache(str(cache_dir))
+        with pytest.raises(InstallerError):
+            cache.fetch("ltp-abcd.tar.gz", str(tmpdir / "target"))
+
+
+class TestInstallSteps:
+    """
+    Tests for the installation steps, without running commands.
+    """
+
+    @pytest.fixture
+    def installer(self, mocker):
+        """
+        Installer recording the commands, instead of running them.
+        """
+        installer = ltp.install.get_installer("opensuse")
+        installer.commands = []
+
+        def run_cmd(cmd, cwd=None, raise_err=True):
+            # pylint: disable=unused-argument
+            installer.commands.append(cmd)
+
+        def get_output(cmd, cwd=None):
+            # pylint: disable=unused-argument
+            if cmd.startswith("git "):
+                return "0123456789abcdef"
+
+            # packages query failed
+            return None
+
+        mocker.patch.object(installer, "_run_cmd", side_effect=run_cmd)
+        mocker.patch.object(installer, "_get_output", side_effect=get_output)
+
+        return installer
+
+    def test_clone(self, installer, tmpdir):
+        """
+        Test that a new repository is shallow cloned.
+        """
+        repo_dir = str(tmpdir / "repo")
+        installer.install(False, "myrepo", repo_dir, str(tmpdir / "ltp"))
+
+        clone = [cmd for cmd in installer.commands if cmd.startswith("git ")]
+        assert clone == [
+            f"git clone --depth=1 --single-branch --no-tags myrepo {repo_dir}"
+        ]
+
+        cpus = len(os.sched_getaffinity(0))
+        assert f"make -j{cpus}" in installer.commands
+
+    def test_clone_existing(self, installer, tmpdir):
+        """
+        Test that an existing repository is updated.
+        """
+        repo_dir = tmpdir.mkdir("repo")
+        repo_dir.mkdir(".git")
+
+        installer.install(False, "myrepo", str(repo_dir), str(tmpdir / "ltp"))
+
+        fetch = [cmd for cmd in installer.commands if cmd.startswith("git ")]
+        assert fetch == [
+            f"git -C {repo_dir} fetch --depth=1 --no-tags myrepo HEAD",
+            f"git -C {repo_dir} checkout -q --force FETCH_HEAD",
+        ]
+
+    def test_clone_revision(self, installer, tmpdir):
+        """
+        Test that only the requested revision is fetched.
+        """
+        repo_dir = str(tmpdir / "repo")
+        installer.install(
+            False,
+            "myrepo",
+            repo_dir,
+            str(tmpdir / "ltp"),
+            revision="20230127")
+
+        fetch = [cmd for cmd in installer.commands if cmd.startswith("git ")]
+        assert fetch == [
+            f"git init -q {repo_dir}",
+            f"git -C {repo_dir} fetch --depth=1 --no-tags myrepo 20230127",
+            f"git -C {repo_dir} checkout -q --force FETCH_HEAD",
+        ]
+
+    def test_ccache(self, installer, tmpdir):
+        """
+        Test that LTP is compiled using ccache.
+        """
+        inst_dir = str(tmpdir / "ltp")
+        installer.install(
+            False,
+            "myrepo",
+            str(tmpdir / "repo"),
+            inst_dir,
+            ccache=True)
+
+        assert f"./configure --prefix={inst_dir} CC='ccache gcc'" \
+            in installer.commands
+        assert any("ccache" in cmd and "install" in cmd
+                   for cmd in installer.commands)
+
+    def test_artifacts(self, installer, tmpdir):
+        """
+        Test that a build is stored inside the artifacts directory and that
+        it's reused by the next installation.
+        """
+        cache_dir = str(tmpdir / "cache")
+        inst_dir = tmpdir / "ltp"
+
+        def make_install(cmd, cwd=None, raise_err=True):
+            # pylint: disable=unused-argument
+            installer.commands.append(cmd)
+            if cmd == "make install":
+                tmpdir.mkdir("ltp")
+                (inst_dir / "runltp").write("#!/bin/sh")
+
+        installer._run_cmd.side_effect = make_install
+
+        installer.install(
+            False,
+            "myrepo",
+            str(tmpdir / "repo"),
+            str(inst_dir),
+            artifacts=cache_dir)
+
+        assert "make install" in installer.commands
+        assert len(os.listdir(cache_dir)) == 1
+
+        shutil.rmtree(inst_dir)
+        installer.commands.clear()
+
+        installer.install(
+            False,
+            "myrepo",
+            str(tmpdir / "repo"),
+            str(inst_dir),
+            artifacts=cache_dir)
+
+        assert not any(cmd.startswith(("git ", "make"))
+                       for cmd in installer.commands)
+        assert os.path.isfile(inst_dir / "runltp")
+
+    def test_artifacts_revision(self, installer, tmpdir):
+        """
+        Test that builds of a branch are found using its commit, once git
+        has been installed.
+        """
+        cache_dir = str(tmpdir / "cache")
+        inst_dir = tmpdir / "ltp"
+
+        def make_install(cmd, cwd=None, raise_err=True):
+            # pylint: disable=unused-argument
+            installer.commands.append(cmd)
+            if cmd == "make install":
+                tmpdir.mkdir("ltp")
+                (inst_dir / "runltp").write("#!/bin/sh")
+
+        installer._run_cmd.side_effect = make_install
+
+        for _ in range(2):
+            installer.commands.clear()
+            installer.install(
+                False,
+                "myrepo",
+                str(tmpdir / "repo"),
+                str(inst_dir),
+                revision="master",
+                artifacts=cache_dir)
+
+            assert installer.commands[1] == \
+                f"{installer.install_cmd} git"
+
+        assert not any(cmd.startswith(("git ", "make"))
+                       for cmd in installer.commands)
+        assert os.listdir(cache_dir) == [ArtifactCache(cache_dir).key(
+            "0123456789abcdef", platform.machine(), False, str(inst_dir))]
+
+    def test_resolve_revision(self, installer):
+        """
+        Test that revisions are resolved into full commits.
+        """
+        commit = "a" * 40
+        assert installer._resolve_revision("myrepo", commit) == commit
+
+        installer._get_output.side_effect = lambda cmd, cwd=None: (
+            "1111\trefs/heads/20230127\n"
+            "2222\trefs/tags/20230127\n"
+            "3333\trefs/tags/20230127^{}\n")
+        assert installer._resolve_revision("myrepo", "20230127") == "3333"
+
+        installer._get_output.side_effect = lambda cmd, cwd=None: (
+            "1111\tHEAD\n")
+        assert installer._resolve_revision("myrepo") == "1111"
+
+        installer._get_output.side_effect = lambda cmd, cwd=None: None
+        assert installer._resolve_revision("myrepo", "abcd") is None
+
+    def test_build(self, installer, tmpdir):
+        """
+        Test that LTP is built without installing it and that revisions
+        are built only once.
+        """
+        cache = ArtifactCache(str(tmpdir / "cache"))
+        inst_dir = str(tmpdir / "ltp")
+
+        def make_install(cmd, cwd=None, raise_err=True):
+            # pylint: disable=unused-argument
+            installer.commands.append(cmd)
+            if cmd.startswith("make install DESTDIR="):
+                destdir = cmd.split("=", 1)[1]
+                tree = os.path.join(destdir, inst_dir.lstrip("/"))
+                os.makedirs(tree)
+                with open(os.path.join(tree, "runltp"), "w",
+                          encoding="utf-8") as data:
+                    data.write("#!/bin/sh")
+
+        installer._run_cmd.side_effect = make_install
+
+        key = installer.build(
+            False,
+            "myrepo",
+            str(tmpdir / "repo"),
+            inst_dir,
+            cache)
+
+        assert key == cache.key("0123456789abcdef",
+                                platform.machine(), False, inst_dir)
+        assert not os.path.isdir(inst_dir)
+        assert os.listdir(tmpdir / "cache") == [key]
+
+        cache.fetch(key, str(tmpdir / "target"))
+        assert os.path.isfile(tmpdir / "target" / "runltp")
+
+        installer.commands.clear()
+
+        assert installer.build(
+            False,
+            "myrepo",
+            str(tmpdir / "repo"),
+            inst_dir,
+            cache) == key
+        assert not installer.commands
+
+
+class FakeInstaller(ltp.install.OpenSUSEInstaller):
+    """
+    Installer where only packages named "installed*" are installed.
+    """
+
+    def __init__(self, metadata_dir: str = None, backend=None) -> None:
+        super().__init__(backend=backend)
+        self._metadata_dir = metadata_dir
+
+    def get_build_pkgs(self, _: bool) -> list:
+        return ["installed_gcc", "make"]
+
+    def get_runtime_pkgs(self, _: bool) -> list:
+        return ["installed_bc", "quota"]
+
+    def get_libs_pkgs(self, _: bool) -> list:
+        return ["libaio-devel"]
+
+    def get_tools_pkgs(self) -> list:
+        return ["installed_libssh", "make"]
+
+    @property
+    def query_cmd(self) -> str:
+        return 'case "$pkg" in installed*) true;; *) false;; esac'
+
+    @property
+    def metadata_dir(self) -> str:
+        return self._metadata_dir
+
+
+class TestRequirements:
+    """
+    Tests for the requirements installation.
+    """
+
+    @pytest.fixture
+    def commands(self, mocker):
+        """
+        Commands executed by the installer.
+        """
+        cmds = []
+
+        def run_cmd(_, cmd, cwd=None, raise_err=True):
+            # pylint: disable=unused-argument
+            cmds.append(cmd)
+
+        mocker.patch.object(FakeInstaller, "_run_cmd", run_cmd)
+
+        return cmds
+
+    def test_missing_pkgs(self):
+        """
+        Test that installed packages are detected.
+        """
+        installer = FakeInstaller()
+        assert installer._missing_pkgs(
+            ["installed_a", "b", "installed_c", "d e"]) == ["b", "d e"]
+
+    def test_missing_pkgs_query_error(self, mocker):
+        """
+        Test that all packages are installed when query fails.
+        """
+        installer = FakeInstaller()
+        mocker.patch.object(installer, "_get_output", return_value=None)
+
+        assert installer._missing_pkgs(["installed_a", "b"]) == \
+            ["installed_a", "b"]
+
+    def test_install_missing(self, commands):
+        """
+        Test that missing packages are installed with a single command.
+        """
+        FakeInstaller()._install_requirements(False)
+
+        assert commands == [
+            "zypper --non-interactive refresh",
+            "zypper --non-interactive --ignore-unknown install "
+            "make libaio-devel quota",
+        ]
+
+    def test_install_runtime(self, commands):
+        """
+        Test that build packages are not installed when LTP is not built.
+        """
+        FakeInstaller()._install_requirements(False, build=False)
+
+        assert commands[-1] == \
+            "zypper --non-interactive --ignore-unknown install quota make"
+
+    def test_all_installed(self, commands, mocker):
+        """
+        Test that nothing is done when packages are already installed.
+        """
+        installer = FakeInstaller()
+        mocker.patch.object(installer, "_missing_pkgs", return_value=[])
+        installer._install_requirements(False)
+
+        assert not commands
+
+    def test_metadata_fresh(self, commands, tmpdir):
+        """
+        Test that cache is not refreshed when metadata are fresh.
+        """
+        metadata = tmpdir.mkdir("metadata")
+        metadata.mkdir("repo-oss")
+
+        FakeInstaller(str(metadata))._install_requirements(False)
+
+        assert len(commands) == 1
+        assert "install" in commands[0]
+
+    def test_metadata_old(self, commands, tmpdir):
+        """
+        Test that cache is refreshed when metadata are old.
+        """
+        metadata = tmpdir.mkdir("metadata")
+        repo = metadata.mkdir("repo-oss")
+
+        old = time.time() - FakeInstaller.METADATA_MAX_AGE - 60
+        os.utime(repo, (old, old))
+        os.utime(metadata, (old, old))
+
+        FakeInstaller(str(metadata))._install_requirements(False)
+
+        assert commands[0] == "zypper --non-interactive refresh"
+
+    def test_metadata_backend(self, tmpdir):
+        """
+        Test that metadata age is read on the backend.
+        """
+        metadata = tmpdir.mkdir("metadata")
+        repo = metadata.mkdir("repo-oss")
+
+        installer = FakeInstaller(str(metadata), backend=ShellBackend())
+        assert installer._metadata_fresh()
+
+        old = time.time() - FakeInstaller.METADATA_MAX_AGE - 60
+        os.utime(repo, (old, old))
+        os.utime(metadata, (old, old))
+
+        assert not installer._metadata_fresh()
+        assert not FakeInstaller(
+            str(tmpdir / "missing"),
+            backend=ShellBackend())._metadata_fresh()
+
+
+class TargetBackend(ShellBackend):
+    """
+    A shell backend for a named target.
+    """
+
+    def __init__(self, name: str, fail: bool = False) -> None:
+        super().__init__()
+        self._name = name
+        self._fail = fail
+        self.stopped = False
+
+    @property
+    def target(self) -> str:
+        return self._name
+
+    def start(self) -> None:
+        if self._fail:
+            raise BackendError(f"Can't connect to {self._name}")
+
+    def stop(self, _: int = 0) -> None:
+        self.stopped = True
+
+
+class TestBackend:
+    """
+    Tests for the installation on backends.
+    """
+
+    @pytest.fixture
+    def tree(self, tmpdir):
+        """
+        A LTP tarball inside the cache.
+        """
+        inst_dir = tmpdir.mkdir("build")
+        (inst_dir / "runltp").write("#!/bin/sh")
+        (inst_dir.mkdir("runtest") / "syscalls").write("abort01 abort01")
+
+        cache = ArtifactCache(str(tmpdir / "cache"))
+        cache.store("ltp-abcd.tar.gz", str(inst_dir))
+
+        return cache, "ltp-abcd.tar.gz"
+
+    def test_commands(self, tmpdir):
+        """
+        Test that commands are executed by the backend.
+        """
+        installer = ltp.install.get_installer(
+            "opensuse",
+            backend=ShellBackend())
+
+        assert installer.backend
+        assert installer is not ltp.install.get_installer("opensuse")
+
+        installer._run_cmd("touch myfile", str(tmpdir))
+        assert os.path.isfile(tmpdir / "myfile")
+
+        with pytest.raises(InstallerError):
+            installer._run_cmd("false")
+
+        installer._run_cmd("false", raise_err=False)
+
+        assert installer._get_output("echo hello") == "hello"
+        assert installer._get_output("false") is None
+        assert installer.machine == platform.machine()
+
+    def test_get_distro(self):
+        """
+        Test get_distro function on a backend.
+        """
+        assert ltp.install.get_distro(ShellBackend()) == \
+            ltp.install.get_distro()
+
+    def test_install_prebuilt(self, mocker, tmpdir, tree):
+        """
+        Test install_prebuilt method streaming the tarball to the backend.
+        """
+        cache, key = tree
+        installer = ltp.install.get_installer(
+            "opensuse",
+            backend=ShellBackend())
+        mocker.patch.object(installer, "_install_requirements")
+
+        target = str(tmpdir / "target")
+        installer.install_prebuilt(False, cache, key, target)
+
+        installer._install_requirements.assert_called_once_with(
+            False, build=False)
+        assert os.path.isfile(os.path.join(target, "runltp"))
+        assert os.path.isfile(os.path.join(target, "runtest", "syscalls"))
+
+        with pytest.raises(InstallerError):
+            installer.install_prebuilt(False, cache, "ltp-efgh.tar.gz", target)
+
+    def test_install_targets(self, mocker, tmpdir, tree):
+        """
+        Test install_targets function installing on many targets.
+        """
+        cache, key = tree
+
+        def build(m32_support, url, repo_dir, install_dir, cache_dst,
+                  **kwargs):
+            # pylint: disable=unused-argument
+            with cache.open(key) as src:
+                with open(os.path.join(cache_dst.location, key), "wb") as dst:
+                    shutil.copyfileobj(src, dst)
+
+            return key
+
+        mocker.patch.object(ltp.install.Installer, "build", side_effect=build)
+        mocker.patch.object(ltp.install.Installer, "_install_requirements")
+
+        backends = [TargetBackend(f"sut{i}") for i in range(4)]
+        inst_dir = str(tmpdir / "ltp")
+
+        ltp.install.install_targets(
+            backends,
+            False,
+            "myrepo",
+            str(tmpdir / "repo"),
+            inst_dir)
+
+        assert ltp.install.Installer.build.call_count == 1
+        assert ltp.install.Installer._install_requirements.call_count == 4
+        assert all(backend.stopped for backend in backends)
+        assert os.path.isfile(os.path.join(inst_dir, "runltp"))
+
+    def test_install_targets_error(self, mocker, tmpdir, tree):
+        """
+        Test install_targets function when some targets fail.
+        """
+        cache, key = tree
+        mocker.patch.object(ltp.install.Installer, "build", return_value=key)
+        mocker.patch.object(ltp.install.Installer, "_install_requirements")
+
+        backends = [
+            TargetBackend("sut0"),
+            TargetBackend("sut1", fail=True),
+        ]
+
+        with pytest.raises(InstallerError, match="sut1"):
+            ltp.install.install_targets(
+                backends,
+                False,
+                "myrepo",
+                str(tmpdir / "repo"),
+                str(tmpdir / "ltp"),
+                artifacts=cache.location)
+
+        assert os.path.isfile(tmpdir / "ltp" / "runltp")
+
+    def test_install_targets_bad_args(self, tmpdir):
+        """
+        Test install_targets function with bad arguments.
+        """
+        with pytest.raises(ValueError):
+            ltp.install.install_targets(
+                [], False, "myrepo", str(tmpdir / "repo"), "/opt/ltp")
+
+        with pytest.raises(ValueError):
+            ltp.install.install_targets(
+                [TargetBackend("sut0")],
+                False,
+                "myrepo",
+                str(tmpdir / "repo"),
+                "ltp")
@@ -0,0 +1,103 @@
+"""
+Unittest for journal module.
+"""
+import json
+import pytest
+from ltp.session import LTPSession
+from ltp.journal import LTPJournal
+
+
+@pytest.mark.usefixtures("prepare_tmpdir")
+class TestLTPJournal:
+    """
+    Test the LTPJournal class.
+    """
+
+    def test_constructor_bad_args(self):
+        """
+        Test constructor with bad arguments.
+        """
+        with pytest.raises(ValueError):
+            LTPJournal(None)
+
+    def test_resume_missing(self, tmpdir):
+        """
+        Test resume when journal doesn't exist.
+        """
+        journal = LTPJournal(str(tmpdir.join("journal")), resume=True)
+        assert not journal.results
+
+    def test_journal(self, tmpdir):
+        """
+        Test journal written by a session.
+        """
+        path = tmpdir.join("journal")
+        journal = LTPJournal(str(path))
+
+        session = LTPSession(journal=journal)
+        session.run()
+
+        lines = path.read().splitlines()
+        assert len(lines) == 5
+
+        journal = LTPJournal(str(path), resume=True)
+        assert len(journal.results) == 5
+        assert journal.results[("dirsuite0", "dir01")]["passed"] == 1
+
+    def test_resume(self, tmpdir):
+        """
+        Test resume of an interrupted session.
+        """
+        path = tmpdir.join("journal")
+
+        session = LTPSession(journal=LTPJournal(str(path)))
+        session.run(suites=["dirsuite0", "dirsuite1"])
+
+        # last line has been partially written when session was interrupted
+        path.write('{"suite": "dirsuite2", "na', mode="a")
+
+        journal = LTPJournal(str(path), resume=True)
+        assert len(journal.results) == 2
+
+        session = LTPSession(journal=journal)
+        session.run()
+
+        assert session.completed
+        assert session.passed == 1
+        assert session.failed == 1
+        assert session.skipped == 1
+        assert session.broken == 1
+        assert session.warnings == 1
+
+        for suite in session.suites:
+            assert suite.completed
+            for test in suite.tests:
+                assert test.completed
+
+        restored = session.suites[0].tests[0]
+        assert restored.stdout.endswith("passed   1\nfailed   0\n"
+                                        "broken   0\nskipped  0\n"
+                                        "warnings 0\n")
+
+        tests = [json.loads(line) for line in path.read().splitlines()]
+        names = [test["name"] for test in tests]
+        assert names == [f"dir0{i}" for i in range(1, 6)]
+
+    def test_resume_skip(self, tmpdir, mocker):
+        """
+        Test resume when all tests already have results.
+        """
+        path = tmpdir.join("journal")
+
+        session = LTPSession(journal=LTPJournal(str(path)))
+        session.run()
+
+        run = mocker.patch("ltp.session.LTPTest.run")
+
+        session = LTPSession(journal=LTPJournal(str(path), resume=True))
+        session.run()
+
+        assert not run.called
+        assert session.passed == 1
+        assert session.failed == 1
+        assert len(path.read().splitlines()) == 5
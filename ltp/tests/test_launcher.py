@@ -0,0 +1,185 @@
+"""
+Unittest for launcher module.
+"""
+import os
+import stat
+import pytest
+from ltp.launcher import LTPLauncher
+from ltp.launcher import LauncherError
+from ltp.launcher import decode_status
+from ltp.launcher import _spawn
+from ltp.session import LTPTest
+from ltp.session import LTPTestError
+from ltp.session import LTPSession
+from ltp.context import LTPContext
+
+
+@pytest.fixture
+def launcher():
+    """
+    Started launcher process.
+    """
+    obj = LTPLauncher()
+    obj.start()
+
+    yield obj
+
+    obj.stop()
+
+
+def test_start_stop():
+    """
+    Test start and stop methods.
+    """
+    obj = LTPLauncher()
+    assert not obj.is_running
+
+    with pytest.raises(LauncherError):
+        obj.spawn(["/bin/true"], "/", {})
+
+    obj.start()
+    assert obj.is_running
+
+    obj.stop()
+    assert not obj.is_running
+
+
+def test_spawn(launcher, tmpdir):
+    """
+    Test spawn method.
+    """
+    with launcher.spawn(
+            ["/bin/sh", "-c", "echo $FOO; pwd; ps -o pgid= -p $$; exit 3"],
+            str(tmpdir),
+            {"FOO": "bar", "PATH": os.defpath}) as proc:
+        stdout = proc.stdout.read().split()
+
+        proc.wait()
+        returncode, rusage = proc.reap()
+
+    assert stdout[:2] == ["bar", str(tmpdir)]
+    assert returncode == 3
+    assert proc.returncode == 3
+    assert "maxrss" in rusage
+
+    # process runs inside its own session
+    if len(stdout) > 2:
+        assert int(stdout[2]) == proc.pid
+
+
+def test_spawn_error(launcher):
+    """
+    Test spawn method when binary can't be executed.
+    """
+    with pytest.raises(OSError):
+        launcher.spawn(["/missing"], "/", {})
+
+    # launcher keeps working after errors
+    with launcher.spawn(["/bin/true"], "/", {}) as proc:
+        proc.wait()
+        assert proc.reap()[0] == 0
+
+
+def test_spawn_fork(tmpdir, monkeypatch):
+    """
+    Test that processes are forked when posix_spawn is not available.
+    """
+    monkeypatch.delattr(os, "posix_spawn", raising=False)
+
+    read_fd, write_fd = os.pipe()
+    try:
+        pid = _spawn({
+            "argv": ["/bin/sh", "-c", "pwd; exit 3"],
+            "cwd": str(tmpdir),
+            "env": {"PATH": os.defpath},
+        }, write_fd, None)
+    finally:
+        os.close(write_fd)
+
+    with os.fdopen(read_fd, "r") as stdout:
+        assert stdout.read().strip() == str(tmpdir)
+
+    _, status = os.waitpid(pid, 0)
+    assert decode_status(status) == 3
+
+
+def test_decode_status():
+    """
+    Test decode_status function on exited and killed processes.
+    """
+    for cmd, returncode in [("exit 0", 0), ("exit 5", 5), ("kill $$", -15)]:
+        pid = os.fork()
+        if pid == 0:
+            os.execv("/bin/sh", ["/bin/sh", "-c", cmd])
+
+        _, status = os.waitpid(pid, 0)
+        assert decode_status(status) == returncode
+
+
+@pytest.mark.usefixtures("prepare_tmpdir")
+class TestSessionLauncher:
+    """
+    Test LTPSession spawning tests from the launcher.
+    """
+
+    def test_run(self, launcher):
+        """
+        Test run method using the launcher.
+        """
+        session = LTPSession(launcher=launcher)
+        session.run(workers=2)
+
+        assert session.completed
+        assert session.passed == 1
+        assert session.failed == 1
+        assert session.skipped == 1
+        assert session.broken == 1
+        assert session.warnings == 1
+
+        for suite in session.suites:
+            for test in suite.tests:
+                assert "maxrss" in test.resources
+
+    def test_run_shell(self, launcher, tmpdir):
+        """
+        Test tests needing a shell and scripts without interpreter line.
+        """
+        script = tmpdir / "testcases" / "bin" / "noshebang.sh"
+        script.write("exit 0\n")
+        os.chmod(str(script), os.stat(str(script)).st_mode | stat.S_IEXEC)
+
+        context = LTPContext()
+
+        test = LTPTest("test noshebang.sh")
+        test.run(context=context, launcher=launcher)
+        assert test.passed == 1
+        assert context.binary("noshebang.sh") is None
+
+        test = LTPTest("test echo $LTPROOT")
+        test.run(context=context, launcher=launcher)
+        assert test.stdout.strip() == str(tmpdir)
+
+    def test_run_timeout(self, launcher):
+        """
+        Test that tests spawned by the launcher are killed on timeout.
+        """
+        test = LTPTest("test sleep 10", timeout=0.5)
+
+        with pytest.raises(LTPTestError):
+            test.run(launcher=launcher)
+
+        assert test.broken == 1
+        assert test.duration < 5
+
+    def test_run_stopped(self):
+        """
+        Test that tests are spawned by the runner when launcher stopped.
+        """
+        obj = LTPLauncher()
+        obj.start()
+        obj.stop()
+
+        test = LTPTest("test script.sh 1 0 0 0 0")
+        test.run(launcher=obj)
+
+        assert test.passed == 1
@@ -0,0 +1,311 @@
+"""
+Unittest for logsink module.
+"""
+import os
+import time
+import logging
+import pytest
+from ltp.logsink import LogSink
+from ltp.logsink import OutputFilter
+from ltp.logsink import BulkFileHandler
+from ltp.logsink import OUTPUT_LOGGER
+
+
+class ListHandler(logging.Handler):
+    """
+    Console-like handler storing the records messages.
+    """
+
+    def __init__(self, delay: float = 0) -> None:
+        super().__init__()
+        self.messages = []
+        self._delay = delay
+
+    def emit(self, record: logging.LogRecord) -> None:
+        if self._delay:
+            time.sleep(self._delay)
+
+        self.messages.append(record.getMessage())
+
+
+def mock_test(name: str):
+    """
+    Return a completed test having the given name.
+    """
+    return type("Test", (), {"name": name})()
+
+
+def _output_record(test: str, msg: str, created: float = None):
+    """
+    Return a record of the tests stdout.
+    """
+    return logging.makeLogRecord({
+        "name": OUTPUT_LOGGER,
+        "msg": msg,
+        "test": test,
+        "created": created or time.time(),
+    })
+
+
+@pytest.fixture
+def logger():
+    """
+    A logger with a console handler, which is removed after test.
+    """
+    obj = logging.getLogger("ltp.sinktest")
+    obj.setLevel(logging.DEBUG)
+
+    handler = ListHandler()
+    obj.addHandler(handler)
+
+    yield obj
+
+    obj.removeHandler(handler)
+
+
+@pytest.fixture
+def root_file(tmpdir):
+    """
+    A bulk file handler of the root logger, which logs everything as in
+    logger.json. Handler is removed after test.
+    """
+    handler = BulkFileHandler(str(tmpdir / "debug.log"), encoding="utf8")
+    handler.setLevel(logging.DEBUG)
+
+    root = logging.getLogger()
+    level = root.level
+    root.setLevel(logging.DEBUG)
+    root.addHandler(handler)
+
+    yield handler
+
+    root.removeHandler(handler)
+    root.setLevel(level)
+    handler.close()
+
+
+def test_bulk_file_handler(tmpdir):
+    """
+    Test that BulkFileHandler writes records on sync only.
+    """
+    path = str(tmpdir / "debug.log")
+    handler = BulkFileHandler(path)
+
+    for i in range(10):
+        handler.emit(logging.makeLogRecord({"msg": f"line{i}"}))
+
+    assert os.path.getsize(path) == 0
+
+    handler.sync()
+    with open(path, "r", encoding="utf-8") as data:
+        assert data.read().split() == [f"line{i}" for i in range(10)]
+
+    handler.emit(logging.makeLogRecord({"msg": "last"}))
+    handler.close()
+
+    with open(path, "r", encoding="utf-8") as data:
+        assert data.read().split()[-1] == "last"
+
+
+def test_output_filter():
+    """
+    Test that OutputFilter filters the tests stdout only.
+    """
+    output_filter = OutputFilter()
+    assert output_filter.filter(_output_record("abort01", "hello"))
+
+    output_filter.configure(enabled=False)
+    assert not output_filter.filter(_output_record("abort01", "hello"))
+    assert output_filter.filter(
+        logging.makeLogRecord({"name": "ltp.test", "msg": "hello"}))
+
+
+def test_output_filter_patterns():
+    """
+    Test that OutputFilter shows the tests matching the patterns.
+    """
+    output_filter = OutputFilter()
+    output_filter.configure(patterns=["abort*", "chdir01"])
+
+    assert output_filter.filter(_output_record("abort01", "hello"))
+    assert output_filter.filter(_output_record("chdir01", "hello"))
+    assert not output_filter.filter(_output_record("chdir02", "hello"))
+
+
+def test_output_filter_rate():
+    """
+    Test that OutputFilter limits the lines shown for each test.
+    """
+    output_filter = OutputFilter()
+    output_filter.configure(rate=3)
+
+    now = int(time.time())
+
+    shown = [
+        output_filter.filter(_output_record("abort01", "hello", now))
+        for _ in range(5)
+    ]
+    assert shown == [True, True, True, False, False]
+
+    # tests have their own rate
+    assert output_filter.filter(_output_record("chdir01", "hello", now))
+
+    # rate is reset every second
+    assert output_filter.filter(_output_record("abort01", "hello", now + 1))
+
+
+def test_output_filter_bad_args():
+    """
+    Test OutputFilter configure method with bad arguments.
+    """
+    with pytest.raises(ValueError):
+        OutputFilter().configure(rate=-1)
+
+
+def test_sink_routing(logger, root_file):
+    """
+    Test that records reach the handlers of their loggers only.
+    """
+    console = logger.handlers[0]
+
+    sink = LogSink()
+    sink.start()
+    try:
+        assert not logger.handlers
+
+        logger.info("console")
+        logging.getLogger("ltp.sinktest.child").info("child")
+        logging.getLogger("ltp.sinkother").info("other")
+    finally:
+        sink.stop()
+
+    assert logger.handlers == [console]
+    assert root_file in logging.getLogger().handlers
+    assert console.messages == ["console", "child"]
+
+    with open(root_file.baseFilename, "r", encoding="utf-8") as data:
+        lines = data.read().split()
+
+    assert lines == ["console", "child", "other"]
+
+
+def test_sink_output(logger, root_file):
+    """
+    Test that tests stdout is filtered on console only.
+    """
+    console = logger.handlers[0]
+    stdout_logger = logging.getLogger(OUTPUT_LOGGER)
+
+    # tests stdout reaches the console through ltp.sinktest
+    logger.removeHandler(console)
+    logging.getLogger("ltp.test").addHandler(console)
+
+    sink = LogSink()
+    sink.output_filter.configure(patterns=["abort01"])
+    sink.start()
+    try:
+        stdout_logger.info("line1", extra={"test": "abort01"})
+        stdout_logger.info("line2", extra={"test": "chdir01"})
+    finally:
+        sink.stop()
+        logging.getLogger("ltp.test").removeHandler(console)
+        logger.addHandler(console)
+
+    assert console.messages == ["line1"]
+
+    with open(root_file.baseFilename, "r", encoding="utf-8") as data:
+        assert data.read().split() == ["line1", "line2"]
+
+
+def test_sink_non_blocking(logger):
+    """
+    Test that logging doesn't wait for slow handlers.
+    """
+    console = logger.handlers[0]
+    logger.removeHandler(console)
+
+    slow = ListHandler(delay=0.05)
+    logger.addHandler(slow)
+
+    sink = LogSink()
+    sink.start()
+    try:
+        start = time.time()
+        for i in range(20):
+            logger.info("line%d", i)
+
+        assert time.time() - start < 0.5
+    finally:
+        sink.stop()
+        logger.removeHandler(slow)
+        logger.addHandler(console)
+
+    assert slow.messages == [f"line{i}" for i in range(20)]
+
+
+def test_output_filter_flush():
+    """
+    Test that OutputFilter shows the dropped lines when tests complete.
+    """
+    output_filter = OutputFilter()
+    output_filter.configure(rate=1)
+
+    now = int(time.time())
+    for test in ["abort01", "chdir01"]:
+        for _ in range(3):
+            output_filter.filter(_output_record(test, "hello", now))
+
+    handler = ListHandler()
+    test_logger = logging.getLogger("ltp.test")
+    level = test_logger.level
+    test_logger.setLevel(logging.INFO)
+    test_logger.addHandler(handler)
+    try:
+        output_filter.test_completed(None, mock_test("abort01"))
+        assert handler.messages == ["2 lines of abort01 have not been shown"]
+
+        # rate of the completed test is reset
+        assert output_filter.filter(_output_record("abort01", "hello", now))
+
+        handler.messages.clear()
+        output_filter.stop()
+        assert handler.messages == ["2 lines of chdir01 have not been shown"]
+
+        handler.messages.clear()
+        output_filter.flush()
+        assert not handler.messages
+    finally:
+        test_logger.removeHandler(handler)
+        test_logger.setLevel(level)
+
+
+def test_sink_overflow(logger):
+    """
+    Test that records are dropped and counted when queue is full.
+    """
+    console = logger.handlers[0]
+    logger.removeHandler(console)
+
+    slow = ListHandler(delay=0.05)
+    logger.addHandler(slow)
+
+    with pytest.raises(ValueError):
+        LogSink(max_records=0)
+
+    sink = LogSink(max_records=2)
+    sink.start()
+    try:
+        start = time.time()
+        for i in range(20):
+            logger.info("line%d", i)
+
+        assert time.time() - start < 0.5
+    finally:
+        sink.stop()
+        logger.removeHandler(slow)
+        logger.addHandler(console)
+
+    # drops are reported on the records of ltp.main
+    assert sink.dropped > 0
+    assert len(slow.messages) < 20
+    assert slow.messages[0] == "line0"
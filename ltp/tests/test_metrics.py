@@ -0,0 +1,323 @@
+"""
+Unittest for metrics module.
+"""
+import json
+import time
+import socket
+import threading
+import urllib.request
+from types import SimpleNamespace
+import pytest
+from ltp.metrics import LTPProgress
+from ltp.metrics import MetricsServer
+from ltp.metrics import to_prometheus
+from ltp.history import LTPHistory
+from ltp.session import LTPSession
+
+
+def _test(name: str, **results):
+    """
+    A completed test with the given results.
+    """
+    data = dict(
+        name=name,
+        passed=0,
+        failed=0,
+        broken=0,
+        skipped=0,
+        timed_out=False,
+        duration=1.0,
+        target=None)
+    data.update(results)
+
+    return SimpleNamespace(**data)
+
+
+SUITE = SimpleNamespace(name="suite")
+
+
+class TestLTPProgress:
+    """
+    Test the LTPProgress class.
+    """
+
+    def test_counters(self):
+        """
+        Test tests counters.
+        """
+        progress = LTPProgress()
+        progress.start([("suite", f"test{i}") for i in range(5)])
+
+        tests = [
+            _test("test0", passed=1),
+            _test("test1", failed=1, passed=1),
+            _test("test2", broken=1),
+            _test("test3", skipped=1),
+            _test("test4", timed_out=True, target="ssh"),
+        ]
+
+        for test in tests:
+            progress.test_started(SUITE, test)
+            progress.test_completed(SUITE, test)
+
+        snapshot = progress.snapshot()
+        assert snapshot["running"]
+        assert snapshot["total"] == 5
+        assert snapshot["done"] == 5
+        assert snapshot["remaining"] == 0
+        assert snapshot["eta"] == 0
+        assert snapshot["statuses"] == {
+            "passed": 1, "failed": 1, "broken": 2, "skipped": 1}
+        assert snapshot["targets"] == {"local": 4, "ssh": 1}
+        assert snapshot["last_completed"] is not None
+
+        progress.stop()
+        assert not progress.snapshot()["running"]
+
+    def test_restored(self):
+        """
+        Test tests restored instead of running.
+        """
+        progress = LTPProgress()
+        progress.start([("suite", "test0")])
+        progress.test_restored(SUITE, _test("test1", passed=1))
+
+        snapshot = progress.snapshot()
+        assert snapshot["total"] == 1
+        assert snapshot["done"] == 0
+        assert snapshot["restored"] == 1
+        assert snapshot["statuses"]["passed"] == 1
+        assert snapshot["targets"] == {"local": 1}
+
+        lines = to_prometheus(snapshot).splitlines()
+        assert "ltp_tests_restored_total 1" in lines
+
+    def test_workers(self):
+        """
+        Test workers state.
+        """
+        progress = LTPProgress()
+        progress.start([("suite", "test0")])
+
+        test = _test("test0", passed=1)
+        backend = SimpleNamespace(target="host")
+        progress.test_started(SUITE, test, backend)
+
+        name = threading.current_thread().name
+
+        worker = progress.snapshot()["workers"][name]
+        assert worker["target"] == "host"
+        assert worker["suite"] == "suite"
+        assert worker["test"] == "test0"
+        assert worker["elapsed"] >= 0
+
+        progress.test_completed(SUITE, test)
+
+        worker = progress.snapshot()["workers"][name]
+        assert worker["test"] is None
+        assert worker["elapsed"] == 0
+
+    def test_eta(self):
+        """
+        Test ETA estimated from the completed tests durations.
+        """
+        progress = LTPProgress()
+        progress.start([("suite", f"test{i}") for i in range(5)], slots=2)
+
+        assert progress.snapshot()["eta"] is None
+
+        test = _test("test0", passed=1, duration=2.0)
+        progress.test_started(SUITE, test)
+        progress.test_completed(SUITE, test)
+
+        assert progress.snapshot()["eta"] == pytest.approx(4.0)
+
+    def test_eta_history(self, tmpdir):
+        """
+        Test ETA estimated from history.
+        """
+        report = tmpdir / "report.json"
+        report.write(json.dumps({"session": {"suites": [{
+            "name": "suite",
+            "tests": [
+                {"name": "test0", "duration": 10},
+                {"name": "test1", "duration": 20},
+            ]
+        }]}}))
+
+        history = LTPHistory()
+        history.load(str(report))
+
+        progress = LTPProgress()
+        progress.start([("suite", "test0"), ("suite", "test1")],
+                       history=history)
+
+        assert progress.snapshot()["eta"] == pytest.approx(30.0)
+
+        # running tests only count their remaining time
+        progress.test_started(SUITE, _test("test1"))
+        assert progress.snapshot()["eta"] < 30.0
+
+
+def test_to_prometheus():
+    """
+    Test to_prometheus function.
+    """
+    progress = LTPProgress()
+    progress.start([("suite", "test0"), ("suite", "test1")])
+    progress.test_started(SUITE, _test('test"0'))
+
+    text = to_prometheus(progress.snapshot())
+    lines = text.splitlines()
+
+    assert "# TYPE ltp_tests_total gauge" in lines
+    assert "ltp_tests_total 2" in lines
+    assert "ltp_tests_remaining 2" in lines
+    assert "ltp_session_running 1" in lines
+    assert "ltp_session_eta_seconds NaN" in lines
+    assert 'ltp_tests_completed_total{status="passed"} 0' in lines
+
+    name = threading.current_thread().name
+    assert f'ltp_worker_busy{{worker="{name}",target="local"}} 1' in lines
+    assert any(
+        line.startswith(
+            f'ltp_worker_test_seconds{{worker="{name}",target="local",'
+            'suite="suite",test="test\\"0"} ')
+        for line in lines)
+
+
+class TestMetricsServer:
+    """
+    Test the MetricsServer class.
+    """
+
+    def test_constructor_bad_args(self):
+        """
+        Test constructor with bad arguments.
+        """
+        with pytest.raises(ValueError):
+            MetricsServer(None, port=0)
+
+        with pytest.raises(ValueError):
+            MetricsServer(LTPProgress())
+
+        with pytest.raises(ValueError):
+            MetricsServer(LTPProgress(), port=70000)
+
+    def test_port(self):
+        """
+        Test metrics served on a TCP port.
+        """
+        progress = LTPProgress()
+        progress.start([("suite", "test0")])
+
+        server = MetricsServer(progress, port=0)
+        server.start()
+        try:
+            endpoint = server.endpoint
+            assert endpoint.startswith("http://127.0.0.1:")
+
+            with urllib.request.urlopen(f"{endpoint}/metrics") as data:
+                assert data.headers["Content-Type"].startswith("text/plain")
+                assert "ltp_tests_total 1" in data.read().decode()
+
+            with urllib.request.urlopen(f"{endpoint}/progress") as data:
+                assert json.loads(data.read())["total"] == 1
+        finally:
+            server.stop()
+
+        assert server.endpoint is None
+
+    def test_socket(self, tmpdir):
+        """
+        Test metrics served on a Unix socket.
+        """
+        path = str(tmpdir / "metrics.sock")
+
+        server = MetricsServer(LTPProgress(), socket_path=path)
+        server.start()
+        try:
+            assert server.endpoint == path
+
+            with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+                sock.connect(path)
+                sock.sendall(b"GET /metrics HTTP/1.0\r\n\r\n")
+
+                reply = b""
+                while True:
+                    data = sock.recv(4096)
+                    if not data:
+                        break
+                    reply += data
+
+            assert reply.startswith(b"HTTP/1.0 200")
+            assert b"ltp_tests_total 0" in reply
+        finally:
+            server.stop()
+
+        assert not (tmpdir / "metrics.sock").check()
+
+
+@pytest.mark.usefixtures("prepare_tmpdir")
+class TestSessionProgress:
+    """
+    Test the progress of LTPSession.
+    """
+
+    def test_run(self):
+        """
+        Test progress once session completed.
+        """
+        session = LTPSession()
+        session.run(workers=2)
+
+        snapshot = session.progress.snapshot()
+        assert not snapshot["running"]
+        assert snapshot["total"] == 5
+        assert snapshot["done"] == 5
+        assert snapshot["remaining"] == 0
+        assert snapshot["statuses"] == {
+            "passed": 2, "failed": 1, "broken": 1, "skipped": 1}
+        assert snapshot["targets"] == {"local": 5}
+
+        for name, worker in snapshot["workers"].items():
+            assert name.startswith("worker_")
+            assert worker["test"] is None
+
+    def test_run_live(self, tmpdir):
+        """
+        Test progress while session is running.
+        """
+        tmpdir.join("runtest").join("dirsuite5").write(
+            "sleep01 sleep 0.5\n"
+            "sleep02 sleep 0.5\n")
+
+        session = LTPSession()
+
+        thread = threading.Thread(
+            target=session.run,
+            kwargs={"suites": ["dirsuite5"]})
+        thread.start()
+
+        try:
+            snapshot = None
+            deadline = time.monotonic() + 5
+            while time.monotonic() < deadline:
+                snapshot = session.progress.snapshot()
+                if any(worker["test"]
+                       for worker in snapshot["workers"].values()):
+                    break
+
+                time.sleep(0.01)
+
+            assert snapshot["running"]
+            assert snapshot["total"] == 2
+            assert snapshot["remaining"] > 0
+
+            worker = list(snapshot["workers"].values())[0]
+            assert worker["suite"] == "dirsuite5"
+            assert worker["test"] in ["sleep01", "sleep02"]
+        finally:
+            thread.join()
+
+        assert session.progress.snapshot()["done"] == 2
@@ -0,0 +1,85 @@
+"""
+Unittest for output module.
+"""
+import os
+import pytest
+from ltp.output import LTPOutput
+
+
+def test_constructor_bad_args():
+    """
+    Test constructor with bad arguments.
+    """
+    with pytest.raises(ValueError):
+        LTPOutput(tail_size=0)
+
+
+def test_memory():
+    """
+    Test output kept in memory.
+    """
+    output = LTPOutput()
+    output.write("line0\n")
+    output.write("")
+    output.write("line1\n")
+    output.close()
+
+    assert output.path is None
+    assert output.size == 12
+    assert output.tail == "line0\nline1\n"
+    assert output.read() == "line0\nline1\n"
+
+
+def test_spool(tmpdir):
+    """
+    Test output spooled into a file.
+    """
+    path = str(tmpdir / "spool" / "test.log")
+    output = LTPOutput(path, tail_size=10)
+
+    lines = [f"line{i:04d}\n" for i in range(1000)]
+    for line in lines:
+        output.write(line)
+
+    assert output.read() == "".join(lines)
+
+    output.close()
+
+    assert output.path == path
+    assert os.path.isfile(path)
+    assert output.size == len("".join(lines))
+    assert output.tail == "".join(lines[-2:])
+    assert output.read() == "".join(lines)
+
+
+def test_spool_tail(tmpdir):
+    """
+    Test the size of the tail when output is spooled into a file.
+    """
+    output = LTPOutput(str(tmpdir / "test.log"), tail_size=25)
+
+    for i in range(100):
+        output.write(f"line{i:04d}\n")
+
+    output.close()
+
+    assert output.tail == "line0097\nline0098\nline0099\n"
+
+    output = LTPOutput(str(tmpdir / "test.log"), tail_size=8)
+    output.write("a" * 100)
+    output.close()
+
+    assert output.tail == "a" * 100
+
+
+def test_spool_empty(tmpdir):
+    """
+    Test output spooled into a file when nothing has been written.
+    """
+    path = str(tmpdir / "test.log")
+    output = LTPOutput(path)
+    output.close()
+
+    assert not os.path.isfile(path)
+    assert output.tail == ""
+    assert output.read() == ""
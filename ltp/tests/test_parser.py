@@ -0,0 +1,116 @@
+"""
+Unittest for parser module.
+"""
+from ltp.parser import LTPParser
+
+
+SUMMARY = [
+    "Summary:\n",
+    "passed   3\n",
+    "failed   2\n",
+    "broken   1\n",
+    "skipped  4\n",
+    "warnings 5\n",
+]
+
+
+def test_empty():
+    """
+    Test parser when nothing has been parsed.
+    """
+    parser = LTPParser()
+
+    assert not parser.summary
+    assert parser.results == {
+        "passed": 0,
+        "failed": 0,
+        "broken": 0,
+        "skipped": 0,
+        "warnings": 0,
+    }
+
+
+def test_tags():
+    """
+    Test parser when results tags are given.
+    """
+    parser = LTPParser()
+
+    assert parser.feed("tst_test.c:1234: TPASS: test passed\n")
+    assert parser.feed("tst_test.c:1234: TPASS: test passed\n")
+    assert parser.feed("tst_test.c:1234: TFAIL: test failed\n")
+    assert parser.feed("tst_test.c:1234: TBROK: test broken\n")
+    assert parser.feed("tst_test.c:1234: TCONF: not supported\n")
+    assert parser.feed("tst_test.c:1234: TWARN: warning\n")
+    assert parser.feed("mytest01    1  TPASS  :  old library\n")
+    assert not parser.feed("tst_test.c:1234: TINFO: got TFAIL\n")
+    assert not parser.feed("this is not a TPASS_LINE\n")
+    assert not parser.feed("\n")
+
+    assert not parser.summary
+    assert parser.results == {
+        "passed": 3,
+        "failed": 1,
+        "broken": 1,
+        "skipped": 1,
+        "warnings": 1,
+    }
+
+
+def test_colors():
+    """
+    Test parser when output is colorized.
+    """
+    parser = LTPParser()
+
+    assert parser.feed("tst_test.c:1234: \x1b[1;32mTPASS: \x1b[0mpassed\n")
+    assert parser.feed("tst_test.c:1234: \x1b[1;31mTFAIL: \x1b[0mfailed\n")
+
+    assert parser.results["passed"] == 1
+    assert parser.results["failed"] == 1
+
+
+def test_summary():
+    """
+    Test parser when summary is given.
+    """
+    parser = LTPParser()
+
+    parser.feed("tst_test.c:1234: TPASS: test passed\n")
+
+    for line in SUMMARY[:-1]:
+        assert not parser.feed(line)
+        assert not parser.summary
+
+    assert parser.feed(SUMMARY[-1])
+    assert parser.summary
+    assert parser.results == {
+        "passed": 3,
+        "failed": 2,
+        "broken": 1,
+        "skipped": 4,
+        "warnings": 5,
+    }
+
+    # results don't change after summary
+    assert not parser.feed("tst_test.c:1234: TPASS: test passed\n")
+    assert parser.results["passed"] == 3
+
+
+def test_summary_incomplete():
+    """
+    Test parser when summary block is interrupted.
+    """
+    parser = LTPParser()
+
+    for line in SUMMARY[:3]:
+        parser.feed(line)
+
+    assert parser.feed("tst_test.c:1234: TFAIL: test failed\n")
+
+    for line in SUMMARY[3:]:
+        parser.feed(line)
+
+    assert not parser.summary
+    assert parser.results["failed"] == 1
+    assert parser.results["passed"] == 0
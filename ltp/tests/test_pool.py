@@ -0,0 +1,339 @@
+"""
+Unittest for BackendPool class.
+"""
+import time
+import signal
+import asyncio
+import threading
+import pytest
+from ltp.backend import Backend
+from ltp.backend import BackendError
+from ltp.backend import BackendPool
+from ltp.backend import ShellBackend
+
+
+class BrokenBackend(Backend):
+    """
+    Backend which can't be started.
+    """
+
+    def __init__(self) -> None:
+        self.stopped = False
+
+    @property
+    def name(self) -> str:
+        return "broken"
+
+    def start(self) -> None:
+        raise BackendError("can't start")
+
+    def stop(self, timeout: int = 0) -> None:
+        self.stopped = True
+
+
+def test_constructor_bad_args():
+    """
+    Test constructor with bad arguments.
+    """
+    with pytest.raises(ValueError):
+        BackendPool(None, 1)
+
+    with pytest.raises(ValueError):
+        BackendPool(ShellBackend, 0)
+
+
+def test_name():
+    """
+    Test name property.
+    """
+    pool = BackendPool(ShellBackend, 2)
+    assert pool.name == "shell"
+    assert pool.size == 2
+    assert len(pool.backends) == 2
+
+
+def test_start_error():
+    """
+    Test start method when a backend can't be started.
+    """
+    pool = BackendPool(BrokenBackend, 2)
+
+    with pytest.raises(BackendError, match="can't start"):
+        pool.start()
+
+    for backend in pool.backends:
+        assert backend.stopped
+
+
+def test_run_cmd():
+    """
+    Test run_cmd method.
+    """
+    pool = BackendPool(ShellBackend, 2)
+    pool.start()
+
+    ret = pool.run_cmd("echo -n 'hello'", 1)
+    assert ret["command"] == "echo -n 'hello'"
+    assert ret["returncode"] == 0
+    assert ret["stdout"] == "hello"
+    assert ret["timeout"] == 1
+
+
+def test_run_cmd_parallel():
+    """
+    Test run_cmd method when multiple commands are executed at the same time.
+    """
+    pool = BackendPool(ShellBackend, 4)
+    pool.start()
+
+    results = []
+
+    def _run():
+        results.append(pool.run_cmd("sleep 1", 10))
+
+    threads = [threading.Thread(target=_run) for _ in range(4)]
+
+    start = time.time()
+    for thread in threads:
+        thread.start()
+
+    for thread in threads:
+        thread.join()
+    elapsed = time.time() - start
+
+    assert elapsed < 3
+    assert len(results) == 4
+    for ret in results:
+        assert ret["returncode"] == 0
+
+
+def test_run_cmd_async():
+    """
+    Test run_cmd_async method when more commands than backends are running.
+    """
+    pool = BackendPool(ShellBackend, 2)
+    pool.start()
+
+    async def _run():
+        return await asyncio.gather(*[
+            pool.run_cmd_async(f"echo -n {i}", 10)
+            for i in range(6)
+        ])
+
+    results = asyncio.run(_run())
+
+    for i, ret in enumerate(results):
+        assert ret["returncode"] == 0
+        assert ret["stdout"] == str(i)
+
+
+def test_checkout():
+    """
+    Test checkout method.
+    """
+    pool = BackendPool(ShellBackend, 1)
+
+    with pool.checkout() as backend:
+        assert backend in pool.backends
+
+        with pytest.raises(BackendError):
+            with pool.checkout(timeout=0.1):
+                pass
+
+    with pool.checkout(timeout=0.1) as backend:
+        assert backend in pool.backends
+
+
+def test_stop():
+    """
+    Test stop method while commands are running.
+    """
+    pool = BackendPool(ShellBackend, 2)
+    pool.start()
+
+    results = []
+
+    def _run():
+        results.append(pool.run_cmd("sleep 10", 20))
+
+    thread = threading.Thread(target=_run, daemon=True)
+    thread.start()
+
+    time.sleep(0.5)
+    pool.stop()
+
+    thread.join()
+
+    assert results[0]["returncode"] == -signal.SIGTERM
+
+
+class CrashingBackend(ShellBackend):
+    """
+    Backend which crashes when running the "crash" command.
+    """
+
+    started = 0
+
+    def start(self) -> None:
+        CrashingBackend.started += 1
+        self.crashed = False
+        super().start()
+
+    def _run_cmd_impl(self, command: str, timeout: int) -> dict:
+        if self.crashed:
+            raise BackendError("backend is not running")
+
+        if command == "crash":
+            self.crashed = True
+            raise BackendError("backend crashed")
+
+        return super()._run_cmd_impl(command, timeout)
+
+    async def _run_cmd_async_impl(
+            self,
+            command: str,
+            timeout: int,
+            stdout_callback: callable) -> dict:
+        return self._run_cmd_impl(command, timeout)
+
+
+def _wait_size(pool, size):
+    """
+    Wait until pool contains size backends.
+    """
+    start = time.time()
+    while pool.size != size:
+        assert time.time() - start < 5
+        time.sleep(0.01)
+
+
+def test_recycle():
+    """
+    Test that crashed backends are replaced by new ones.
+    """
+    CrashingBackend.started = 0
+
+    pool = BackendPool(CrashingBackend, 2, recycle=True)
+    pool.start()
+
+    crashed = None
+    with pytest.raises(BackendError, match="crashed"):
+        with pool.checkout() as backend:
+            crashed = backend
+            backend.run_cmd("crash", 1)
+
+    _wait_size(pool, 2)
+    assert crashed not in pool.backends
+    assert CrashingBackend.started == 3
+
+    for _ in range(4):
+        assert pool.run_cmd("echo -n ciao", 1)["stdout"] == "ciao"
+
+    pool.stop()
+
+
+def test_recycle_async():
+    """
+    Test that crashed backends are replaced when running async commands.
+    """
+    pool = BackendPool(CrashingBackend, 1, recycle=True)
+    pool.start()
+
+    with pytest.raises(BackendError):
+        asyncio.run(pool.run_cmd_async("crash", 1))
+
+    ret = asyncio.run(pool.run_cmd_async("echo -n ciao", 1))
+    assert ret["stdout"] == "ciao"
+
+    pool.stop()
+
+
+def test_recycle_disabled():
+    """
+    Test that failed backends are kept when recycling is disabled.
+    """
+    pool = BackendPool(CrashingBackend, 1)
+    pool.start()
+
+    backend = pool.backends[0]
+
+    with pytest.raises(BackendError, match="crashed"):
+        pool.run_cmd("crash", 1)
+
+    with pytest.raises(BackendError, match="not running"):
+        pool.run_cmd("echo", 1)
+
+    assert pool.backends == [backend]
+
+
+def test_recycle_exhausted():
+    """
+    Test that commands fail when no backends can be recycled.
+    """
+    started = []
+
+    def _factory():
+        backend = CrashingBackend() if not started else BrokenBackend()
+        started.append(backend)
+        return backend
+
+    pool = BackendPool(_factory, 1, recycle=True, retries=2)
+    pool.start()
+
+    with pytest.raises(BackendError, match="crashed"):
+        pool.run_cmd("crash", 1)
+
+    with pytest.raises(BackendError, match="No backends left"):
+        pool.run_cmd("echo", 1)
+
+    # first backend and two retries
+    assert len(started) == 3
+
+
+class ResettableBackend(ShellBackend):
+    """
+    Shell backend counting its resets.
+    """
+
+    def __init__(self) -> None:
+        super().__init__()
+        self.resets = 0
+
+    def reset(self) -> None:
+        self.resets += 1
+
+
+def test_reset():
+    """
+    Test reset method waiting for running commands.
+    """
+    pool = BackendPool(ResettableBackend, 2)
+    pool.start()
+    try:
+        thread = threading.Thread(
+            target=pool.run_cmd, args=("sleep 0.5", 10))
+        thread.start()
+        time.sleep(0.1)
+
+        start = time.time()
+        pool.reset()
+        assert time.time() - start >= 0.3
+
+        thread.join()
+
+        for backend in pool.backends:
+            assert backend.resets == 1
+
+        assert pool.run_cmd("true", 10)["returncode"] == 0
+    finally:
+        pool.stop()
+
+
+def test_reset_not_supported():
+    """
+    Test reset method when backends can't be reset.
+    """
+    pool = BackendPool(ShellBackend, 2)
+
+    with pytest.raises(BackendError):
+        pool.reset()
@@ -0,0 +1,513 @@
+"""
+Unittest for qemu module.
+"""
+import os
+import re
+import json
+import time
+import shutil
+import socket
+import asyncio
+import threading
+import subprocess
+import pytest
+from ltp.qemu import QemuVM
+from ltp.qemu import QMPClient
+from ltp.qemu import QemuConsole
+from ltp.qemu import QemuError
+from ltp.qemu import QemuTimeoutError
+from ltp.backend import QemuBackend
+from ltp.backend import BackendError
+from ltp.backend import BackendTimeoutError
+
+
+@pytest.fixture
+def console():
+    """
+    Console connected to a shell running on the host.
+    """
+    sock, remote = socket.socketpair()
+    proc = subprocess.Popen(
+        ["sh"],
+        stdin=remote,
+        stdout=remote,
+        stderr=remote)
+    remote.close()
+
+    yield QemuConsole(sock)
+
+    sock.close()
+    proc.kill()
+    proc.wait()
+
+
+class FakeVM:
+    """
+    VM running commands on a host shell console.
+    """
+
+    def __init__(self, console) -> None:
+        self.console = console
+        self.tainted = "0"
+        self.snapshots = []
+        self.restored = 0
+
+    def execute(self, command, timeout=0, stdout_callback=None,
+                tainted=False):
+        if command == "cat /proc/sys/kernel/tainted":
+            return 0, self.tainted + "\n"
+
+        ret = self.console.execute(command, timeout, stdout_callback)
+        if tainted:
+            ret += (self.tainted,)
+
+        return ret
+
+    def savevm(self, name):
+        self.snapshots.append(name)
+
+    def loadvm(self, name, timeout=60):
+        assert name in self.snapshots
+        self.restored += 1
+        self.console.sync()
+
+    def start(self):
+        pass
+
+    def login(self, **_):
+        pass
+
+    def stop(self, timeout=0):
+        pass
+
+    def force_stop(self):
+        pass
+
+
+@pytest.fixture
+def backend(console):
+    """
+    Function creating a started Qemu backend running commands on the host.
+    """
+    def _create(**kwargs):
+        backend = QemuBackend(image="image.qcow2", **kwargs)
+        backend._vm = FakeVM(console)
+        backend.start()
+        return backend
+
+    return _create
+
+
+def test_vm_bad_args():
+    """
+    Test QemuVM constructor with bad arguments.
+    """
+    with pytest.raises(ValueError):
+        QemuVM()
+
+    with pytest.raises(ValueError):
+        QemuVM(image="image.qcow2", console="usb")
+
+
+def test_vm_command_serial():
+    """
+    Test Qemu command line using serial console.
+    """
+    vm = QemuVM(image="image.qcow2", memory="1G", smp=4)
+    cmd = vm.command("/tmp/qmp.sock", "/tmp/console.sock")
+
+    assert cmd[0] == "qemu-system-x86_64"
+    assert "-snapshot" in cmd
+    assert cmd[cmd.index("-m") + 1] == "1G"
+    assert cmd[cmd.index("-smp") + 1] == "4"
+    assert cmd[cmd.index("-serial") + 1] == "chardev:ltpcon"
+    assert "file=image.qcow2" in cmd[cmd.index("-drive") + 1]
+    assert cmd[cmd.index("-qmp") + 1].startswith("unix:/tmp/qmp.sock,")
+    assert "path=/tmp/console.sock" in cmd[cmd.index("-chardev") + 1]
+    assert "-kernel" not in cmd
+
+
+def test_vm_command_virtio():
+    """
+    Test Qemu command line using virtio console and kernel.
+    """
+    vm = QemuVM(
+        image="image.qcow2",
+        qemu="qemu-system-aarch64",
+        console="virtio",
+        kernel="bzImage",
+        options=["-cpu", "host"])
+    cmd = vm.command("/tmp/qmp.sock", "/tmp/console.sock")
+
+    assert cmd[0] == "qemu-system-aarch64"
+    assert cmd[cmd.index("-serial") + 1] == "none"
+    assert "virtconsole,chardev=ltpcon" in cmd
+    assert cmd[cmd.index("-kernel") + 1] == "bzImage"
+    assert "console=hvc0" in cmd[cmd.index("-append") + 1]
+    assert cmd[-2:] == ["-cpu", "host"]
+
+
+def _qmp_server(path, replies):
+    """
+    Start a QMP server answering with the given replies and return the
+    list where received requests are stored.
+    """
+    server = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    server.bind(path)
+    server.listen(1)
+
+    requests = []
+
+    def _serve():
+        conn, _ = server.accept()
+        server.close()
+
+        with conn, conn.makefile("rb") as data:
+            conn.sendall(b'{"QMP": {"version": {}}}\n')
+
+            for reply in replies:
+                line = data.readline()
+                if not line:
+                    break
+
+                requests.append(json.loads(line))
+                conn.sendall(json.dumps(reply).encode() + b"\n")
+
+    thread = threading.Thread(target=_serve, daemon=True)
+    thread.start()
+
+    return requests
+
+
+def test_qmp_execute(tmpdir):
+    """
+    Test QMP commands execution, skipping events.
+    """
+    path = str(tmpdir / "qmp.sock")
+    requests = _qmp_server(path, [
+        {"return": {}},
+        {"return": "done"},
+        {"error": {"class": "GenericError", "desc": "failure"}},
+    ])
+
+    qmp = QMPClient(path, timeout=5)
+    qmp.connect()
+
+    try:
+        assert qmp.execute("query-status", {"x": 1}) == "done"
+
+        with pytest.raises(QemuError, match="failure"):
+            qmp.execute("quit")
+    finally:
+        qmp.close()
+
+    assert requests == [
+        {"execute": "qmp_capabilities"},
+        {"execute": "query-status", "arguments": {"x": 1}},
+        {"execute": "quit"},
+    ]
+
+
+def test_qmp_human_monitor_error(tmpdir):
+    """
+    Test that errors printed by the human monitor are raised.
+    """
+    path = str(tmpdir / "qmp.sock")
+    requests = _qmp_server(path, [
+        {"return": {}},
+        {"return": ""},
+        {"return": "Error: Device 'virtio0' is writable but does not "
+         "support snapshots\r\n"},
+    ])
+
+    qmp = QMPClient(path, timeout=5)
+    qmp.connect()
+
+    try:
+        qmp.human_monitor_command("savevm ltp_clean")
+
+        with pytest.raises(QemuError, match="does not support"):
+            qmp.human_monitor_command("loadvm ltp_clean")
+    finally:
+        qmp.close()
+
+    assert requests[1]["arguments"] == {"command-line": "savevm ltp_clean"}
+
+
+def test_qmp_not_connected(tmpdir):
+    """
+    Test QMP connection failures.
+    """
+    qmp = QMPClient(str(tmpdir / "qmp.sock"))
+
+    with pytest.raises(QemuError):
+        qmp.execute("quit")
+
+    with pytest.raises(QemuError):
+        qmp.connect()
+
+
+def test_console_execute(console):
+    """
+    Test commands execution on console.
+    """
+    console.sync()
+
+    assert console.execute("echo ciao") == (0, "ciao\n")
+    assert console.execute("printf ciao; exit 3") == (3, "ciao")
+    assert console.execute("echo error >&2") == (0, "error\n")
+
+    # commands can't read from console
+    assert console.execute("cat") == (0, "")
+
+    # tainted flags don't change the command exit status
+    with open("/proc/sys/kernel/tainted", "r") as data:
+        tainted = data.read().strip()
+
+    assert console.execute("echo ciao; exit 3", tainted=True) == \
+        (3, "ciao\n", tainted)
+
+    with pytest.raises(ValueError):
+        console.execute("")
+
+
+def test_console_stdout_callback(console):
+    """
+    Test that stdout is given to the callback while command is running.
+    """
+    console.sync()
+
+    chunks = []
+    retcode, stdout = console.execute(
+        "seq 1 10000",
+        stdout_callback=chunks.append)
+
+    assert retcode == 0
+    assert "".join(chunks) == stdout
+    assert stdout == "".join(f"{i}\n" for i in range(1, 10001))
+
+    # the first chunk ends in the middle of a multibyte character, since
+    # the last 256 bytes are kept until sentinel is read
+    chunks.clear()
+    retcode, stdout = console.execute(
+        "printf '%0300d\\303\\250%0255d' 0 0; sleep 0.5",
+        stdout_callback=chunks.append)
+
+    assert retcode == 0
+    assert "".join(chunks) == stdout
+    assert stdout == "0" * 300 + "\u00e8" + "0" * 255
+
+
+def test_console_timeout(console):
+    """
+    Test commands timeout on console.
+    """
+    console.sync()
+
+    start = time.monotonic()
+    with pytest.raises(QemuTimeoutError):
+        console.execute("sleep 2", timeout=0.2)
+
+    assert time.monotonic() - start < 1
+
+    # console is usable again once command completed
+    console.sync(timeout=5)
+    assert console.execute("echo ciao") == (0, "ciao\n")
+
+
+def test_backend_bad_reset():
+    """
+    Test QemuBackend with a bad reset policy.
+    """
+    with pytest.raises(ValueError):
+        QemuBackend(image="image.qcow2", reset="sometimes")
+
+
+def test_backend_run_cmd(backend):
+    """
+    Test run_cmd method.
+    """
+    qemu = backend()
+    assert qemu.name == "qemu"
+    assert qemu.target == "qemu:image.qcow2"
+    assert qemu.vm.snapshots == [QemuBackend.SNAPSHOT]
+
+    ret = qemu.run_cmd("echo ciao; false", 10)
+    assert ret["returncode"] == 1
+    assert ret["stdout"] == "ciao\n"
+    assert ret["timeout"] == 10
+
+    # default policy restores only tainted kernels
+    assert qemu.vm.restored == 0
+
+
+@pytest.mark.parametrize(
+    "reset, tainted, retcode, restored",
+    [
+        ("taint", "0", 0, 0),
+        ("taint", "4096", 0, 1),
+        ("failure", "0", 0, 0),
+        ("failure", "0", 1, 1),
+        ("failure", "4096", 0, 1),
+        ("always", "0", 0, 1),
+        ("never", "4096", 1, 0),
+    ]
+)
+def test_backend_reset(backend, reset, tainted, retcode, restored):
+    """
+    Test when VM is restored using reset policies.
+    """
+    qemu = backend(reset=reset)
+    qemu.vm.tainted = tainted
+
+    qemu.run_cmd(f"exit {retcode}", 10)
+    assert qemu.vm.restored == restored
+
+
+def test_backend_timeout(backend):
+    """
+    Test that VM is restored after a timeout.
+    """
+    qemu = backend(reset="never")
+
+    with pytest.raises(BackendTimeoutError):
+        qemu.run_cmd("sleep 2", 1)
+
+    assert qemu.vm.restored == 1
+
+
+def test_backend_not_started():
+    """
+    Test run_cmd before starting the backend.
+    """
+    with pytest.raises(BackendError):
+        QemuBackend(image="image.qcow2").run_cmd("ls", 10)
+
+
+def test_backend_run_cmd_async(backend):
+    """
+    Test run_cmd_async method.
+    """
+    qemu = backend()
+    chunks = []
+
+    ret = asyncio.run(qemu.run_cmd_async("seq 1 3", 10, chunks.append))
+    assert ret["returncode"] == 0
+    assert ret["stdout"] == "1\n2\n3\n"
+    assert "".join(chunks) == ret["stdout"]
+
+
+@pytest.mark.skipif(
+    not os.environ.get("QEMU_IMAGE") or
+    not shutil.which("qemu-system-x86_64"),
+    reason="QEMU_IMAGE and qemu-system-x86_64 are needed")
+def test_backend_vm():
+    """
+    Test snapshot restore on a real VM. QEMU_IMAGE must be a qcow2 image
+    with a root login on the serial console and QEMU_PASSWORD its password.
+    """
+    qemu = QemuBackend(
+        image=os.environ["QEMU_IMAGE"],
+        password=os.environ.get("QEMU_PASSWORD", None),
+        reset="always")
+    qemu.start()
+
+    try:
+        ret = qemu.run_cmd("touch /ltp_test; ls /ltp_test", 30)
+        assert ret["returncode"] == 0
+
+        start = time.monotonic()
+        ret = qemu.run_cmd("ls /ltp_test", 30)
+        assert ret["returncode"] != 0
+        assert time.monotonic() - start < 30
+
+        assert re.match(r"\d+", qemu.run_cmd("uname -r", 30)["stdout"])
+    finally:
+        qemu.stop()
+
+
+def test_vm_command_overlay():
+    """
+    Test Qemu command line using a qcow2 overlay.
+    """
+    vm = QemuVM(image="image.raw", overlay=True)
+    cmd = vm.command("/tmp/qmp.sock", "/tmp/console.sock", "/tmp/ov.qcow2")
+
+    assert "-snapshot" not in cmd
+    assert cmd[cmd.index("-drive") + 1].startswith(
+        "file=/tmp/ov.qcow2,format=qcow2,")
+
+
+def test_vm_create_overlay(tmpdir):
+    """
+    Test that overlays are backed by the VM image.
+    """
+    log = tmpdir / "qemu-img.log"
+    qemu_img = tmpdir / "qemu-img"
+    qemu_img.write(
+        "#!/bin/sh\n"
+        f"echo \"$@\" >> {log}\n"
+        "[ \"$1\" = info ] && echo '{\"format\": \"raw\"}'\n"
+        "exit 0\n")
+    os.chmod(str(qemu_img), 0o755)
+
+    vm = QemuVM(image="image.raw", overlay=True, qemu_img=str(qemu_img))
+    vm._create_overlay("/tmp/ov.qcow2")
+
+    lines = log.read().splitlines()
+    image = os.path.abspath("image.raw")
+    assert lines[0] == f"info --output=json {image}"
+    assert lines[1] == \
+        f"create -q -f qcow2 -b {image} -F raw /tmp/ov.qcow2"
+
+
+def test_vm_create_overlay_error(tmpdir):
+    """
+    Test overlay creation errors.
+    """
+    qemu_img = tmpdir / "qemu-img"
+    qemu_img.write("#!/bin/sh\necho 'no such image' >&2\nexit 1\n")
+    os.chmod(str(qemu_img), 0o755)
+
+    vm = QemuVM(image="image.raw", overlay=True, qemu_img=str(qemu_img))
+    with pytest.raises(QemuError, match="no such image"):
+        vm._create_overlay("/tmp/ov.qcow2")
+
+
+def test_vm_start_error(tmpdir):
+    """
+    Test that Qemu stderr is reported when it exits during boot.
+    """
+    qemu = tmpdir / "qemu"
+    qemu.write("#!/bin/sh\necho 'could not open disk image' >&2\nexit 1\n")
+    os.chmod(str(qemu), 0o755)
+
+    vm = QemuVM(image="image.raw", qemu=str(qemu))
+    with pytest.raises(QemuError, match="could not open disk image"):
+        vm.start(timeout=10)
+
+    assert not vm.running
+
+
+def test_vm_login_no_timeout():
+    """
+    Test login method when no timeout is given.
+    """
+    class _Console:
+        def __init__(self):
+            self.written = []
+
+        def write(self, data):
+            self.written.append(data)
+
+        def read_until(self, matcher, deadline=None, callback=None):
+            assert deadline is not None
+
+        def sync(self, timeout=10):
+            assert timeout is None
+
+    vm = QemuVM(image="image.raw")
+    vm._console = _Console()
+    vm.login(user="root", timeout=0)
+
+    assert vm._console.written[:2] == ["\n", "root\n"]
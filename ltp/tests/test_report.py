@@ -2,9 +2,24 @@
 Unittest for report module.
 """
 import json
+import xml.etree.ElementTree as ET
 import pytest
+from ltp.journal import LTPJournal
 from ltp.session import LTPSession
 from ltp.report import export_to_json
+from ltp.report import JSONLReporter
+from ltp.report import JUnitReporter
+
+
+def _check_durations(data):
+    """
+    Check tests durations and resources, then remove them from the report
+    data.
+    """
+    for suite in data["session"]["suites"]:
+        for test in suite["tests"]:
+            assert test.pop("duration") >= 0
+            assert test.pop("resources")["maxrss"] > 0
 
 
 @pytest.fixture
@@ -37,6 +52,8 @@ def test_export_to_json_session_run(tmpdir, stdout_msg):
     with open(str(reportfile), "r") as report:
         data = json.load(report)
 
+    _check_durations(data)
+
     assert data["session"]["name"] is not None
     assert data["session"]["passed"] == 1
     assert data["session"]["failed"] == 1
@@ -158,6 +175,8 @@ def test_export_to_json_session_run_scenario(tmpdir, stdout_msg):
     with open(str(reportfile), "r") as report:
         data = json.load(report)
 
+    _check_durations(data)
+
     assert data["session"]["name"] is not None
     assert data["session"]["passed"] == 1
     assert data["session"]["failed"] == 1
@@ -222,6 +241,8 @@ def test_export_to_json_session_run_single(tmpdir, stdout_msg):
     with open(str(reportfile), "r") as report:
         data = json.load(report)
 
+    _check_durations(data)
+
     assert data["session"]["name"] is not None
     assert data["session"]["passed"] == 1
     assert data["session"]["failed"] == 0
@@ -249,3 +270,176 @@ def test_export_to_json_session_run_single(tmpdir, stdout_msg):
             }
         ]
     } in data["session"]["suites"]
+
+
+@pytest.mark.usefixtures("prepare_tmpdir")
+def test_export_to_json_spooled(tmpdir):
+    """
+    Test export_to_json function when tests stdout is bigger than the
+    maximum size and it's spooled.
+    """
+    reportfile = tmpdir.join("report.json")
+
+    session = LTPSession(spool_dir=str(tmpdir.join("spool")))
+    session.run(suites=["dirsuite0"])
+
+    export_to_json(session, str(reportfile), max_stdout=10)
+
+    data = None
+    with open(str(reportfile), "r") as report:
+        data = json.load(report)
+
+    test = data["session"]["suites"][0]["tests"][0]
+    assert "stdout" not in test
+    assert test["stdout_path"] == session.suites[0].tests[0].stdout_path
+
+
+@pytest.mark.usefixtures("prepare_tmpdir")
+def test_jsonl_reporter(tmpdir, stdout_msg):
+    """
+    Test JSONLReporter writing tests while they are completed.
+    """
+    reportfile = tmpdir.join("report.jsonl")
+    reporter = JSONLReporter(str(reportfile))
+
+    session = LTPSession(reporters=[reporter])
+    session.run()
+
+    lines = reportfile.read().splitlines()
+    assert len(lines) == 5
+
+    tests = [json.loads(line) for line in lines]
+    for test in tests:
+        assert test.pop("duration") >= 0
+        assert test.pop("resources")["maxrss"] > 0
+
+    assert {
+        "suite": "dirsuite0",
+        "name": "dir01",
+        "passed": 1,
+        "failed": 0,
+        "warnings": 0,
+        "broken": 0,
+        "skipped": 0,
+        "stdout": stdout_msg(1, 0, 0, 0, 0),
+    } in tests
+
+
+@pytest.mark.usefixtures("prepare_tmpdir")
+def test_junit_reporter(tmpdir):
+    """
+    Test JUnitReporter writing tests while they are completed.
+    """
+    reportfile = tmpdir.join("report.xml")
+    reporter = JUnitReporter(str(reportfile))
+
+    session = LTPSession(reporters=[reporter])
+    session.run()
+
+    root = ET.parse(str(reportfile)).getroot()
+    assert root.tag == "testsuites"
+    assert root.get("name") == session.name
+
+    suites = root.findall("testsuite")
+    assert [suite.get("name") for suite in suites] == \
+        [f"dirsuite{i}" for i in range(5)]
+
+    cases = {case.get("name"): case for case in root.iter("testcase")}
+    assert len(cases) == 5
+    assert cases["dir01"].get("classname") == "dirsuite0"
+    assert float(cases["dir01"].get("time")) >= 0
+    assert "passed   1" in cases["dir01"].find("system-out").text
+    assert cases["dir02"].find("failure") is not None
+    assert cases["dir03"].find("skipped") is not None
+    assert cases["dir04"].find("error") is not None
+
+
+@pytest.mark.usefixtures("prepare_tmpdir")
+def test_reporter_resume(tmpdir):
+    """
+    Test that reporters contain the tests of the planned suites which have
+    been restored from the journal.
+    """
+    journal = str(tmpdir.join("journal"))
+
+    session = LTPSession(journal=LTPJournal(journal))
+    session.run(suites=["dirsuite0", "dirsuite1"])
+
+    jsonl = tmpdir.join("report.jsonl")
+    junit = tmpdir.join("report.xml")
+
+    session = LTPSession(
+        journal=LTPJournal(journal, resume=True),
+        reporters=[JSONLReporter(str(jsonl)), JUnitReporter(str(junit))])
+    session.run(suites=["dirsuite0", "dirsuite2"])
+
+    tests = [json.loads(line) for line in jsonl.read().splitlines()]
+    assert [(test["suite"], test["name"]) for test in tests] == [
+        ("dirsuite0", "dir01"),
+        ("dirsuite2", "dir03"),
+    ]
+
+    root = ET.parse(str(junit)).getroot()
+    assert [case.get("name") for case in root.iter("testcase")] == \
+        ["dir01", "dir03"]
+
+    assert session.progress.snapshot()["restored"] == 1
+
+
+@pytest.mark.usefixtures("prepare_tmpdir")
+@pytest.mark.parametrize("reporter_class", [JSONLReporter, JUnitReporter])
+def test_reporter_incremental(tmpdir, reporter_class):
+    """
+    Test reporters when report is read before session is completed.
+    """
+    reportfile = tmpdir.join("report")
+    reporter = reporter_class(str(reportfile), max_stdout=10)
+
+    session = LTPSession(spool_dir=str(tmpdir.join("spool")))
+    suite = session.suites[0]
+
+    reporter.start(session)
+    try:
+        for test in suite.tests:
+            test.run()
+            reporter.test_completed(suite, test)
+
+            data = reportfile.read()
+            assert test.stdout_path in data
+
+            if reporter_class is JUnitReporter:
+                ET.fromstring(data)
+            else:
+                for line in data.splitlines():
+                    assert "stdout" not in json.loads(line)
+    finally:
+        reporter.stop()
+
+
+@pytest.mark.usefixtures("prepare_tmpdir")
+def test_reporter_violations(tmpdir):
+    """
+    Test that limits hit by tests are reported apart from their results.
+    """
+    session = LTPSession()
+    suite = session.suites[0]
+    test = suite.tests[0]
+    test.restore({"passed": 1, "violations": {"memory": 1, "pids": 2}})
+
+    jsonl = JSONLReporter(str(tmpdir.join("report.jsonl")))
+    junit = JUnitReporter(str(tmpdir.join("report.xml")))
+
+    for reporter in [jsonl, junit]:
+        reporter.start(session)
+        reporter.test_completed(suite, test)
+        reporter.stop()
+
+    data = json.loads(tmpdir.join("report.jsonl").read())
+    assert data["passed"] == 1
+    assert data["violations"] == {"memory": 1, "pids": 2}
+
+    root = ET.parse(str(tmpdir.join("report.xml"))).getroot()
+    props = {
+        prop.get("name"): prop.get("value") for prop in root.iter("property")
+    }
+    assert props["violations"] == "memory=1 pids=2"
@@ -0,0 +1,225 @@
+"""
+Unittest for resultcache module.
+"""
+import gzip
+import json
+import pytest
+from ltp.resultcache import LTPResultCache
+from ltp.resultcache import kernel_config_hash
+from ltp.resultcache import affected_suites
+from ltp.report import JSONLReporter
+from ltp.session import LTPSession
+
+
+def test_kernel_config_hash(tmpdir):
+    """
+    Test kernel_config_hash function.
+    """
+    config = tmpdir / "config"
+    config.write("CONFIG_64BIT=y\n")
+
+    compressed = tmpdir / "config.gz"
+    with gzip.open(str(compressed), "wb") as data:
+        data.write(b"CONFIG_64BIT=y\n")
+
+    digest = kernel_config_hash(path=str(config))
+    assert digest
+    assert kernel_config_hash(path=str(compressed)) == digest
+    assert kernel_config_hash(path=str(tmpdir / "missing")) == ""
+
+
+def test_affected_suites():
+    """
+    Test affected_suites function.
+    """
+    mapping = {
+        "mm/*": ["mm"],
+        "fs/ext4/*": ["fs", "fs_ext4"],
+        "fs/*": ["fs"],
+    }
+
+    assert affected_suites(mapping, []) == []
+    assert affected_suites(mapping, ["mm/mmap.c"]) == ["mm"]
+    assert affected_suites(mapping, ["mm/mmap.c", "fs/ext4/inode.c"]) == \
+        ["fs", "fs_ext4", "mm"]
+
+    # unknown changes can affect any suite
+    assert affected_suites(mapping, ["mm/mmap.c", "net/core.c"]) is None
+
+    with pytest.raises(ValueError):
+        affected_suites(None, [])
+
+
+def test_constructor_bad_args():
+    """
+    Test constructor with bad arguments.
+    """
+    with pytest.raises(ValueError):
+        LTPResultCache(None)
+
+
+def test_load_corrupted(tmpdir):
+    """
+    Test that a corrupted cache is empty.
+    """
+    path = tmpdir / "cache.json"
+    path.write("{")
+
+    assert not len(LTPResultCache(str(path)))
+
+
+def _run(path: str, **kwargs) -> LTPSession:
+    """
+    Run all the suites using the results cache.
+    """
+    session = LTPSession(result_cache=LTPResultCache(path, **kwargs))
+    session.run()
+
+    assert session.completed
+    assert session.passed == 1
+    assert session.failed == 1
+    assert session.skipped == 1
+    assert session.broken == 1
+    assert session.warnings == 1
+
+    for suite in session.suites:
+        for test in suite.tests:
+            assert test.completed
+
+    return session
+
+
+@pytest.mark.usefixtures("prepare_tmpdir")
+class TestSessionCache:
+    """
+    Test LTPSession using the results cache.
+    """
+
+    def test_reuse(self, tmpdir):
+        """
+        Test that unchanged tests reuse their results.
+        """
+        path = str(tmpdir / "cache.json")
+
+        session = _run(path, release="6.1.0")
+        assert session.progress.snapshot()["done"] == 5
+        assert len(LTPResultCache(path)) == 5
+
+        session = _run(path, release="6.1.0")
+        assert session.progress.snapshot()["total"] == 0
+        assert session.progress.snapshot()["restored"] == 5
+
+    def test_kernel_changed(self, tmpdir):
+        """
+        Test that tests run again on a different kernel.
+        """
+        path = str(tmpdir / "cache.json")
+
+        _run(path, release="6.1.0")
+
+        session = _run(path, release="6.1.1")
+        assert session.progress.snapshot()["done"] == 5
+
+    def test_kernel_changed_affected(self, tmpdir):
+        """
+        Test that only the affected suites run again on a different kernel.
+        """
+        path = str(tmpdir / "cache.json")
+
+        _run(path, release="6.1.0")
+
+        session = _run(path, release="6.1.1", affected=["dirsuite0"])
+        assert session.progress.snapshot()["done"] == 1
+        assert session.progress.snapshot()["restored"] == 4
+        assert session.suites[0].tests[0].name == "dir01"
+
+        session = _run(path, release="6.1.2", affected=[])
+        assert session.progress.snapshot()["total"] == 0
+
+    def test_binary_changed(self, tmpdir):
+        """
+        Test that tests run again when their binary changed.
+        """
+        path = str(tmpdir / "cache.json")
+
+        _run(path, release="6.1.0")
+
+        script = tmpdir / "testcases" / "bin" / "script.sh"
+        script.write(script.read() + "\n# changed\n")
+
+        session = _run(path, release="6.1.0", affected=[])
+        assert session.progress.snapshot()["done"] == 5
+
+    def test_args_changed(self, tmpdir):
+        """
+        Test that tests run again when their arguments changed.
+        """
+        path = str(tmpdir / "cache.json")
+
+        _run(path, release="6.1.0")
+
+        # same results, different arguments
+        tmpdir.join("runtest").join("dirsuite0").write(
+            "dir01 script.sh 1 0 0 0 0 \n")
+        tmpdir.join("runtest").join("dirsuite1").write(
+            "dir02 script.sh 0 1 0 0 0 0")
+
+        session = _run(path, release="6.1.0")
+        assert session.progress.snapshot()["done"] == 1
+
+        with open(path, "r", encoding="utf-8") as data:
+            cache = json.load(data)
+
+        assert cache["suites"]["dirsuite1"]["dir02"]["release"] == "6.1.0"
+
+    def test_spooled_stdout(self, tmpdir):
+        """
+        Test that big spooled stdout is stored inside the cache, since
+        spool files are overwritten by the next sessions.
+        """
+        path = str(tmpdir / "cache.json")
+        spool_dir = str(tmpdir.mkdir("spool"))
+
+        session = LTPSession(
+            spool_dir=spool_dir,
+            result_cache=LTPResultCache(path, max_stdout=10))
+        session.run()
+
+        stdout = session.suites[0].tests[0].stdout
+        assert len(stdout) > 10
+
+        with open(path, "r", encoding="utf-8") as data:
+            cache = json.load(data)
+
+        result = cache["suites"]["dirsuite0"]["dir01"]["result"]
+        assert "stdout_path" not in result
+        assert result["stdout"] == stdout[-10:]
+
+        session = LTPSession(
+            spool_dir=spool_dir,
+            result_cache=LTPResultCache(path, max_stdout=10))
+        session.run()
+
+        assert session.progress.snapshot()["total"] == 0
+        assert session.suites[0].tests[0].stdout == stdout[-10:]
+
+    def test_reporters(self, tmpdir):
+        """
+        Test that tests reused from cache are sent to the reporters.
+        """
+        path = str(tmpdir / "cache.json")
+        _run(path, release="6.1.0")
+
+        report = tmpdir / "report.jsonl"
+
+        session = LTPSession(
+            result_cache=LTPResultCache(path, release="6.1.0"),
+            reporters=[JSONLReporter(str(report))])
+        session.run()
+
+        lines = report.read().splitlines()
+        assert len(lines) == 5
+        snapshot = session.progress.snapshot()
+        assert snapshot["restored"] == 5
+        assert snapshot["statuses"] == {
+            "passed": 2, "failed": 1, "broken": 1, "skipped": 1}
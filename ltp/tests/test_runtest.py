@@ -1,8 +1,10 @@
 """
 Unit tests for metadata implementations.
 """
+import os
 import pytest
 from ltp.metadata import RuntestMetadata
+from ltp.metadata import MetadataError
 
 
 @pytest.mark.usefixtures("prepare_tmpdir")
@@ -57,3 +59,85 @@ class TestRuntestMetadata:
             "command": "script.sh",
             "arguments":  ['1', '0', '0', '0', '0']
         }]
+
+    def test_read_missing(self, tmpdir):
+        """
+        Test read_test and read_suite methods when items are not available.
+        """
+        meta = RuntestMetadata(str(tmpdir) + "/runtest")
+
+        assert meta.has_test("dir01")
+        assert not meta.has_test("dir10")
+        assert meta.has_suite("dirsuite0")
+        assert not meta.has_suite("dirsuite10")
+
+        with pytest.raises(ValueError):
+            meta.read_test("dir10")
+
+        with pytest.raises(ValueError):
+            meta.read_suite("dirsuite10")
+
+    def test_bad_declaration(self, tmpdir):
+        """
+        Test constructor when a test declaration is not valid.
+        """
+        tmpdir.join("runtest").join("dirsuite5").write("dir06\n")
+
+        with pytest.raises(MetadataError):
+            RuntestMetadata(str(tmpdir) + "/runtest")
+
+    def test_cache(self, tmpdir, mocker):
+        """
+        Test metadata cache when runtest files are not modified.
+        """
+        cache_file = str(tmpdir.join("cache").join("runtest.json"))
+
+        RuntestMetadata(str(tmpdir) + "/runtest", cache_file=cache_file)
+        assert os.path.isfile(cache_file)
+
+        mocker.patch.object(
+            RuntestMetadata,
+            "_parse_suite",
+            side_effect=AssertionError("runtest files have been parsed"))
+
+        meta = RuntestMetadata(str(tmpdir) + "/runtest", cache_file=cache_file)
+
+        assert len(meta.available_suites) == 5
+        assert meta.read_suite("dirsuite0")["tests"] == [{
+            "name": "dir01",
+            "command": "script.sh",
+            "arguments":  ['1', '0', '0', '0', '0']
+        }]
+
+    def test_cache_outdated(self, tmpdir):
+        """
+        Test metadata cache when runtest files are modified.
+        """
+        cache_file = str(tmpdir.join("runtest.json"))
+
+        RuntestMetadata(str(tmpdir) + "/runtest", cache_file=cache_file)
+
+        tmpdir.join("runtest").join("dirsuite0").write(
+            "dir01 script.sh 1 0 0 0 0\n"
+            "dir06 script.sh 0 0 0 0 0\n")
+        tmpdir.join("runtest").join("dirsuite5").write(
+            "dir07 script.sh 0 0 0 0 0\n")
+
+        meta = RuntestMetadata(str(tmpdir) + "/runtest", cache_file=cache_file)
+
+        assert len(meta.available_suites) == 6
+        assert meta.has_test("dir06")
+        assert meta.has_test("dir07")
+
+    def test_cache_corrupted(self, tmpdir):
+        """
+        Test metadata cache when cache file is not valid.
+        """
+        cache_file = tmpdir.join("runtest.json")
+        cache_file.write("{ this is not JSON")
+
+        meta = RuntestMetadata(
+            str(tmpdir) + "/runtest",
+            cache_file=str(cache_file))
+
+        assert len(meta.available_suites) == 5
@@ -0,0 +1,239 @@
+"""
+Unittest for scheduler module.
+"""
+import time
+import threading
+import pytest
+from ltp.scheduler import LTPScheduler
+from ltp.breaker import TargetAbortedError
+
+
+class DummyTest:
+    """
+    Dummy test used to track running tests.
+    """
+
+    def __init__(self, name: str, exclusive: bool = False) -> None:
+        self.name = name
+        self.exclusive = exclusive
+
+
+class DummyBackend:
+    """
+    Dummy backend running tests with a specific speed.
+    """
+
+    def __init__(self, name: str, duration: float = 0.05) -> None:
+        self.name = name
+        self.duration = duration
+
+
+class Tracker:
+    """
+    Track the number of tests running at the same time on each target.
+    """
+
+    def __init__(self, duration: float = 0.2) -> None:
+        self._lock = threading.Lock()
+        self._duration = duration
+        self.running = {}
+        self.max_running = 0
+        self.overlaps = []
+        self.executed = []
+        self.targets = {}
+
+    def __call__(self, test, backend) -> None:
+        name = backend.name if backend else None
+        duration = backend.duration if backend else self._duration
+
+        with self._lock:
+            self.running[name] = self.running.get(name, 0) + 1
+            self.max_running = max(self.max_running, self.running[name])
+            if test.exclusive and self.running[name] > 1:
+                self.overlaps.append(test.name)
+
+        time.sleep(duration)
+
+        with self._lock:
+            if test.exclusive and self.running[name] > 1:
+                self.overlaps.append(test.name)
+            self.running[name] -= 1
+            self.executed.append(test.name)
+            self.targets.setdefault(name, []).append(test.name)
+
+
+def test_constructor_bad_args():
+    """
+    Test constructor with bad arguments.
+    """
+    with pytest.raises(ValueError):
+        LTPScheduler(0)
+
+    with pytest.raises(ValueError):
+        LTPScheduler(-1)
+
+
+def test_run_serial():
+    """
+    Test run method with one worker.
+    """
+    tests = [DummyTest(f"test{i}") for i in range(4)]
+    tracker = Tracker(duration=0)
+
+    LTPScheduler().run(tests, tracker)
+
+    assert tracker.max_running == 1
+    assert tracker.executed == [test.name for test in tests]
+
+
+def test_run_parallel():
+    """
+    Test run method with multiple workers.
+    """
+    tests = [DummyTest(f"test{i}") for i in range(8)]
+    tracker = Tracker()
+
+    start = time.time()
+    LTPScheduler(4).run(tests, tracker)
+    elapsed = time.time() - start
+
+    assert tracker.max_running == 4
+    assert sorted(tracker.executed) == sorted(test.name for test in tests)
+    assert elapsed < 8 * 0.2
+
+
+def test_run_exclusive():
+    """
+    Test run method when exclusive tests are scheduled.
+    """
+    tests = [DummyTest(f"test{i}") for i in range(4)]
+    tests.insert(2, DummyTest("exclusive0", exclusive=True))
+    tests.append(DummyTest("exclusive1", exclusive=True))
+    tracker = Tracker()
+
+    LTPScheduler(4).run(tests, tracker)
+
+    assert not tracker.overlaps
+    assert len(tracker.executed) == 6
+    assert tracker.executed.index("exclusive0") == 2
+    assert tracker.executed[-1] == "exclusive1"
+
+
+def test_run_error():
+    """
+    Test run method when a test raises an exception.
+    """
+    def _runner(test, _):
+        if test.name == "test2":
+            raise RuntimeError("test error")
+
+    tests = [DummyTest(f"test{i}") for i in range(4)]
+
+    with pytest.raises(RuntimeError, match="test error"):
+        LTPScheduler(2).run(tests, _runner)
+
+
+def test_run_targets():
+    """
+    Test run method sharding tests across multiple targets.
+    """
+    backends = [DummyBackend("target0"), DummyBackend("target1")]
+    tests = [DummyTest(f"test{i}") for i in range(10)]
+    tracker = Tracker()
+
+    scheduler = LTPScheduler(2, backends=backends)
+    assert scheduler.backends == backends
+
+    scheduler.run(tests, tracker)
+
+    assert tracker.max_running == 2
+    assert sorted(tracker.executed) == sorted(test.name for test in tests)
+    assert tracker.targets["target0"]
+    assert tracker.targets["target1"]
+
+
+def test_run_targets_stealing():
+    """
+    Test run method when a fast target steals tests from a slow one.
+    """
+    backends = [DummyBackend("slow", 0.5), DummyBackend("fast", 0.01)]
+    tests = [DummyTest(f"test{i}") for i in range(20)]
+    tracker = Tracker()
+
+    start = time.time()
+    LTPScheduler(backends=backends).run(tests, tracker)
+    elapsed = time.time() - start
+
+    assert sorted(tracker.executed) == sorted(test.name for test in tests)
+    assert len(tracker.targets["fast"]) > len(tracker.targets["slow"])
+    assert elapsed < 10 * 0.5
+
+
+def test_run_targets_exclusive():
+    """
+    Test run method running exclusive tests on multiple targets.
+    """
+    backends = [DummyBackend("target0"), DummyBackend("target1")]
+    tests = [
+        DummyTest(f"test{i}", exclusive=(i % 3 == 0))
+        for i in range(12)
+    ]
+    tracker = Tracker()
+
+    LTPScheduler(4, backends=backends).run(tests, tracker)
+
+    assert not tracker.overlaps
+    assert sorted(tracker.executed) == sorted(test.name for test in tests)
+
+
+def test_run_targets_error():
+    """
+    Test run method when a test raises an exception on a target.
+    """
+    def _runner(test, _):
+        if test.name == "test2":
+            raise RuntimeError("test error")
+
+    backends = [DummyBackend("target0"), DummyBackend("target1")]
+    tests = [DummyTest(f"test{i}") for i in range(4)]
+
+    with pytest.raises(RuntimeError, match="test error"):
+        LTPScheduler(2, backends=backends).run(tests, _runner)
+
+
+def test_run_targets_aborted():
+    """
+    Test run method when a target has been aborted.
+    """
+    backends = [DummyBackend("target0"), DummyBackend("target1", 0.01)]
+    tests = [DummyTest(f"test{i}") for i in range(10)]
+    tracker = Tracker()
+
+    def _runner(test, backend):
+        if backend.name == "target0":
+            raise TargetAbortedError("target0 is broken")
+
+        tracker(test, backend)
+
+    scheduler = LTPScheduler(2, backends=backends)
+    scheduler.run(tests, _runner)
+
+    assert sorted(tracker.executed) == sorted(test.name for test in tests)
+
+    # aborted targets don't receive tests anymore
+    scheduler.run(tests[:2], _runner)
+    assert len(tracker.executed) == 12
+
+
+def test_run_targets_all_aborted():
+    """
+    Test run method when all targets have been aborted.
+    """
+    def _runner(test, backend):
+        raise TargetAbortedError(f"{backend.name} is broken")
+
+    backends = [DummyBackend("target0"), DummyBackend("target1")]
+    tests = [DummyTest(f"test{i}") for i in range(4)]
+
+    with pytest.raises(TargetAbortedError):
+        LTPScheduler(2, backends=backends).run(tests, _runner)
@@ -0,0 +1,198 @@
+"""
+Unittest for selection module.
+"""
+import time
+import pytest
+from ltp.selection import LTPSelection
+from ltp.session import LTPSession
+
+
+def test_empty():
+    """
+    Test that empty selection selects everything.
+    """
+    selection = LTPSelection()
+
+    assert not selection
+    assert selection.match("syscalls", "mmap01")
+
+
+@pytest.mark.parametrize("pattern, suite, test, expected", [
+    ("mmap01", "syscalls", "mmap01", True),
+    ("mmap01", "syscalls", "mmap02", False),
+    ("mmap*", "syscalls", "mmap02", True),
+    ("mmap?", "syscalls", "mmap02", False),
+    ("mmap[0-9][0-9]", "syscalls", "mmap02", True),
+    ("syscalls:mmap01", "syscalls", "mmap01", True),
+    ("syscalls:mmap01", "mm", "mmap01", False),
+    ("sys*:mmap*", "syscalls", "mmap01", True),
+    ("sys*:mmap*", "mm", "mmap01", False),
+    ("re:mmap\\d+", "syscalls", "mmap01", True),
+    ("re:mmap\\d+", "syscalls", "mmap", False),
+    ("re:mmap", "syscalls", "mmap01", False),
+])
+def test_include(pattern, suite, test, expected):
+    """
+    Test include patterns.
+    """
+    selection = LTPSelection(include=[pattern])
+
+    assert selection
+    assert selection.match(suite, test) == expected
+
+
+def test_exclude():
+    """
+    Test exclude patterns.
+    """
+    selection = LTPSelection(include=["mmap*"], exclude=["mmap1*"])
+
+    assert selection.match("syscalls", "mmap01")
+    assert not selection.match("syscalls", "mmap10")
+    assert not selection.match("syscalls", "abort01")
+
+    selection = LTPSelection(exclude=["re:.*01", "abort02"])
+    assert not selection.match("syscalls", "mmap01")
+    assert not selection.match("syscalls", "abort02")
+    assert selection.match("syscalls", "abort03")
+
+
+def test_skip_file(tmpdir):
+    """
+    Test skip file.
+    """
+    skip_file = tmpdir / "skip"
+    skip_file.write(
+        "# tests crashing the kernel\n"
+        "\n"
+        "mmap01\n"
+        "  fs:read*  \n")
+
+    selection = LTPSelection(skip_file=str(skip_file))
+    assert not selection.match("syscalls", "mmap01")
+    assert not selection.match("fs", "read02")
+    assert selection.match("syscalls", "read02")
+    assert selection.match("syscalls", "# tests crashing the kernel")
+
+
+def test_bad_args(tmpdir):
+    """
+    Test selection with bad arguments.
+    """
+    with pytest.raises(ValueError):
+        LTPSelection(include=["re:mmap("])
+
+    with pytest.raises(ValueError):
+        LTPSelection(skip_file=str(tmpdir / "missing"))
+
+
+def test_filter():
+    """
+    Test filter keeping the tests order.
+    """
+    class _Test:
+        def __init__(self, name):
+            self.name = name
+
+    tests = [_Test(f"test{i:02d}") for i in range(20)]
+    selection = LTPSelection(include=["test1*", "test03"])
+
+    assert [test.name for test in selection.filter("suite", tests)] == \
+        ["test03"] + [f"test{i}" for i in range(10, 20)]
+
+
+def test_many_patterns():
+    """
+    Test that many patterns match many tests quickly.
+    """
+    selection = LTPSelection(
+        include=[f"test{i}*" for i in range(1000)] +
+        [f"suite:name{i}" for i in range(1000)],
+        exclude=[f"test{i}" for i in range(0, 10000, 2)])
+
+    start = time.monotonic()
+    selected = sum(
+        1 for i in range(10000) if selection.match("suite", f"test{i}"))
+
+    assert selected == 5000
+    assert time.monotonic() - start < 5
+
+
+@pytest.mark.usefixtures("prepare_tmpdir")
+class TestSessionSelection:
+    """
+    Test LTPSession using tests selection.
+    """
+
+    @staticmethod
+    def _executed(session) -> list:
+        """
+        Names of the tests which have been executed.
+        """
+        return sorted(
+            test.name for suite in session.suites for test in suite.tests
+            if test.completed)
+
+    def test_run(self, tmpdir):
+        """
+        Test run method with a selection.
+        """
+        tmpdir.join("runtest").join("dirsuite5").write(
+            "dir06 script.sh 1 0 0 0 0\n"
+            "dir07 script.sh 1 0 0 0 0\n"
+            "dir08 script.sh 1 0 0 0 0\n")
+
+        session = LTPSession(selection=LTPSelection(
+            include=["dir0[1-3]", "dirsuite5:*"],
+            exclude=["dir07"]))
+        suites = session.run()
+
+        assert [suite.name for suite in suites if suite.completed] == \
+            ["dirsuite0", "dirsuite1", "dirsuite2", "dirsuite5"]
+        assert self._executed(session) == \
+            ["dir01", "dir02", "dir03", "dir06", "dir08"]
+
+    def test_run_shard(self):
+        """
+        Test that only selected tests are split in shards.
+        """
+        executed = []
+        for index in range(2):
+            session = LTPSession(
+                shard=(index, 2),
+                selection=LTPSelection(include=["dir01", "dir02"]))
+            session.run()
+
+            executed.append(self._executed(session))
+
+        assert sorted(executed) == [["dir01"], ["dir02"]]
+
+    def test_scenarios(self, tmpdir):
+        """
+        Test scenarios property and custom scenario files.
+        """
+        tmpdir.join("scenario_groups").join("custom").write(
+            "# a custom scenario\n"
+            "dirsuite3\n"
+            "\n"
+            "dirsuite4\n")
+
+        session = LTPSession()
+        assert session.scenarios == ["custom", "default", "network"]
+
+        suites = session.run_scenario("custom")
+        assert [suite.name for suite in suites] == ["dirsuite3", "dirsuite4"]
+        assert session.broken == 1
+        assert session.warnings == 1
+
+    def test_scenario_bad_args(self):
+        """
+        Test scenarios which are not inside scenario_groups.
+        """
+        session = LTPSession()
+
+        with pytest.raises(ValueError):
+            session.suites_from_scenario("missing")
+
+        with pytest.raises(ValueError):
+            session.suites_from_scenario("../runtest/dirsuite0")
@@ -1,8 +1,16 @@
 """
 Tests for the session module.
 """
+import os
+import json
+import time
 import logging
+import threading
 import pytest
+from ltp.scheduler import LTPScheduler
+from ltp.backend import ShellBackend
+from ltp.history import LTPHistory
+from ltp.cgroup import CgroupTree
 from ltp.session import LTPTest, LTPSuite, LTPSession, LTPTestError
 
 
@@ -59,6 +67,18 @@ class TestLTPTest:
         msgs = [x.message for x in caplog.records]
         assert "testcases" in msgs
 
+    def test_run_duration(self):
+        """
+        Test run method measuring the test duration.
+        """
+        test = LTPTest("dir01 sleep 0.2")
+        assert test.duration == 0
+
+        test.run()
+
+        assert test.completed
+        assert 0.2 <= test.duration < 2
+
     def test_run_pass(self, caplog):
         """
         Test run method with TPASS.
@@ -180,6 +200,81 @@ class TestLTPTest:
         msgs = [x.message for x in caplog.records]
         assert str(tmpdir) in msgs
 
+    def test_run_live_results(self, tmpdir):
+        """
+        Test run method updating results while test is running.
+        """
+        script = tmpdir / "live.sh"
+        script.write(
+            'echo "test.c:10: TPASS: passed"\n'
+            'echo "test.c:11: TFAIL: failed"\n'
+            'sleep 1\n'
+            'echo "Summary:"\n'
+            'echo "passed   1"\n'
+            'echo "failed   1"\n'
+            'echo "broken   0"\n'
+            'echo "skipped  0"\n'
+            'echo "warnings 0"\n')
+
+        test = LTPTest(f"live01 sh {script}")
+        thread = threading.Thread(target=test.run, daemon=True)
+        thread.start()
+
+        start = time.time()
+        while test.failed == 0 and time.time() - start < 5:
+            time.sleep(0.05)
+
+        assert not test.completed
+        assert test.passed == 1
+        assert test.failed == 1
+
+        thread.join()
+
+        assert test.completed
+        assert test.passed == 1
+        assert test.failed == 1
+
+    def test_run_backend(self, tmpdir):
+        """
+        Test run method using a backend.
+        """
+        test = LTPTest("mytest01 script.sh 0 1 0 0 0; echo -n $LTPROOT")
+        test.run(ShellBackend())
+
+        assert test.completed
+        assert test.target == "shell"
+        assert test.passed == 0
+        assert test.failed == 1
+        assert test.stdout.endswith(f"warnings 0\n{tmpdir}")
+
+    def test_run_backend_oldtest(self):
+        """
+        Test run method using a backend when old test is failing.
+        """
+        test = LTPTest("dir01 exit 100")
+        test.run(ShellBackend())
+
+        assert test.completed
+        assert test.passed == 0
+        assert test.failed == 1
+
+    def test_run_spool(self, tmpdir):
+        """
+        Test run method when stdout is spooled into a file.
+        """
+        spool_dir = str(tmpdir / "spool")
+        test = LTPTest("mytest01 script.sh 1 0 0 0 0", spool_dir=spool_dir)
+        test.run()
+
+        assert test.completed
+        assert test.passed == 1
+        assert test.stdout_path == os.path.join(spool_dir, "mytest01.log")
+
+        with open(test.stdout_path, "r") as data:
+            assert data.read() == test.stdout
+
+        assert "Summary:" in test.stdout
+
     def test_run_exception(self, caplog):
         """
         Test run method when raising LTPTestError.
@@ -191,6 +286,146 @@ class TestLTPTest:
 
             assert test.completed
 
+    def test_run_timeout(self):
+        """
+        Test run method when test times out.
+        """
+        test = LTPTest("dir01 script.sh 1 0 0 0 0; sleep 10 & sleep 10",
+                       timeout=1)
+        assert test.timeout == 1
+
+        start = time.time()
+        with pytest.raises(LTPTestError, match="timed out"):
+            test.run()
+
+        assert time.time() - start < 5
+        assert test.completed
+        assert test.timed_out
+        assert test.passed == 1
+        assert test.broken == 1
+
+    def test_run_timeout_oldtest(self):
+        """
+        Test run method when an old test times out.
+        """
+        test = LTPTest("dir01 sleep 10")
+
+        with pytest.raises(LTPTestError, match="timed out"):
+            test.run(timeout=0.5)
+
+        assert test.completed
+        assert test.timed_out
+        assert test.passed == 0
+        assert test.failed == 0
+        assert test.broken == 1
+
+    def test_run_timeout_backend(self):
+        """
+        Test run method when test times out on a backend.
+        """
+        test = LTPTest("dir01 sleep 10", timeout=1)
+
+        start = time.time()
+        with pytest.raises(LTPTestError, match="timed out"):
+            test.run(ShellBackend())
+
+        assert time.time() - start < 5
+        assert test.timed_out
+        assert test.broken == 1
+
+    def test_run_reap(self, tmpdir):
+        """
+        Test run method killing processes left behind by the test.
+        """
+        pidfile = tmpdir.join("pid")
+        test = LTPTest(f"dir01 sleep 10 > /dev/null & echo $! > {pidfile}")
+        test.run()
+
+        assert test.completed
+        assert test.passed == 1
+
+        pid = int(pidfile.read())
+        stat = f"/proc/{pid}/stat"
+
+        # killed process can be a zombie, if nobody reaped it yet
+        state = None
+        for _ in range(100):
+            if not os.path.isfile(stat):
+                break
+
+            with open(stat, "r") as data:
+                state = data.read().split()[2]
+
+            if state == "Z":
+                break
+
+            time.sleep(0.01)
+
+        assert state in [None, "Z"]
+
+    def test_run_resources(self):
+        """
+        Test that resources used by the test are collected.
+        """
+        test = LTPTest(
+            "dir01 sh -c 'i=0; while [ $i -lt 100000 ]; do i=$((i+1)); done'")
+        test.run()
+
+        resources = test.resources
+        assert resources["utime"] + resources["stime"] > 0
+        assert resources["maxrss"] > 0
+        assert resources["nvcsw"] + resources["nivcsw"] >= 0
+        assert "cgroup" not in resources
+
+        test.run(ShellBackend())
+        assert test.resources == {}
+
+    @pytest.mark.skipif(
+        CgroupTree.discover() is None,
+        reason="cgroup v2 is not available")
+    def test_run_cgroup(self, tmpdir):
+        """
+        Test run method inside a cgroup, killing processes which left the
+        test process group.
+        """
+        cgroups = CgroupTree.discover()
+        cgroups.setup()
+
+        pidfile = tmpdir.join("pid")
+        try:
+            test = LTPTest(
+                "dir01 setsid sleep 10 > /dev/null & "
+                f"echo $! > {pidfile}; cat /proc/self/cgroup")
+            test.run(cgroups=cgroups)
+
+            assert f"{os.path.basename(cgroups.path)}/dir01." in test.stdout
+            assert test.resources["cgroup"]["cpu_usage"] >= 0
+            # test cgroup has been removed
+            assert not [
+                name for name in os.listdir(cgroups.path)
+                if name.startswith("dir01.")
+            ]
+
+            # process has been killed, even if it's not in the test group
+            stat = f"/proc/{int(pidfile.read())}/stat"
+            if os.path.isfile(stat):
+                with open(stat, "r") as data:
+                    assert data.read().split()[2] == "Z"
+        finally:
+            cgroups.cleanup()
+
+    def test_run_cgroup_limits_error(self, tmpdir):
+        """
+        Test that tests don't run when their limits can't be applied.
+        """
+        cgroups = CgroupTree(str(tmpdir), limits={"memory": 1 << 20})
+
+        test = LTPTest("dir01 echo ciao")
+        with pytest.raises(LTPTestError, match="limits"):
+            test.run(cgroups=cgroups)
+
+        assert not test.completed
+
     def test_run_oldtest_fail(self):
         """
         Test run method when old test is failing.
@@ -273,6 +508,60 @@ class TestLTPSuite:
         for test in suite.tests:
             assert test.completed
 
+    def test_constructor_exclusive(self, tmpdir):
+        """
+        Test constructor with exclusive tests.
+        """
+        suitefile = tmpdir.join("dirsuite")
+        suitefile.write("dir01 ls -l\n\ndir02 ls -a")
+
+        suite = LTPSuite(suitefile, exclusive=["dir02"])
+        assert not suite.tests[0].exclusive
+        assert suite.tests[1].exclusive
+
+        suite = LTPSuite(suitefile, exclusive=["dirsuite"])
+        assert suite.tests[0].exclusive
+        assert suite.tests[1].exclusive
+
+    def test_run_timeout(self, tmpdir):
+        """
+        Test run method when tests time out.
+        """
+        suitefile = tmpdir.join("dirsuite")
+        suitefile.write("dir01 sleep 0.1\ndir02 sleep 10")
+
+        suite = LTPSuite(suitefile, timeout=1)
+        suite.run()
+
+        assert suite.completed
+        assert suite.passed == 1
+        assert suite.broken == 1
+        assert not suite.tests[0].timed_out
+        assert suite.tests[1].timed_out
+
+    def test_run_workers(self, tmpdir):
+        """
+        Test run method using multiple workers.
+        """
+        suitefile = tmpdir.join("dirsuite")
+        suitefile.write(
+            "sleep01 sleep 1\n"
+            "sleep02 sleep 1\n"
+            "sleep03 sleep 1\n"
+            "sleep04 sleep 1\n")
+        suite = LTPSuite(suitefile)
+
+        start = time.time()
+        suite.run(LTPScheduler(4))
+        elapsed = time.time() - start
+
+        assert elapsed < 3
+        assert suite.completed
+        assert suite.passed == 4
+
+        for test in suite.tests:
+            assert test.completed
+
 
 @pytest.mark.usefixtures("prepare_tmpdir")
 class TestLTPSession:
@@ -292,6 +581,22 @@ class TestLTPSession:
         session.suites[3].name == "dirsuite3"
         session.suites[4].name == "dirsuite4"
 
+    def test_constructor_cache(self, tmpdir):
+        """
+        Test constructor when runtest metadata are cached.
+        """
+        cache_file = tmpdir.join("cache.json")
+
+        session = LTPSession(cache_file=str(cache_file))
+        assert cache_file.check(file=True)
+
+        session = LTPSession(cache_file=str(cache_file))
+        assert [suite.name for suite in session.suites] == \
+            [f"dirsuite{i}" for i in range(5)]
+
+        session.run(suites=["dirsuite0"])
+        assert session.passed == 1
+
     def test_run_all(self, caplog):
         """
         Test run method with empty scenario.
@@ -313,6 +618,191 @@ class TestLTPSession:
             for test in session.suites[i].tests:
                 assert test.completed
 
+    def test_run_all_workers(self):
+        """
+        Test run method using multiple workers.
+        """
+        session = LTPSession(exclusive=["dirsuite1", "dir03"])
+        session.run(workers=4)
+
+        assert session.completed
+        assert session.passed == 1
+        assert session.failed == 1
+        assert session.skipped == 1
+        assert session.broken == 1
+        assert session.warnings == 1
+
+        for suite in session.suites:
+            assert suite.completed
+            for test in suite.tests:
+                assert test.completed
+                assert test.exclusive == (test.name in ["dir02", "dir03"])
+
+    def test_run_suites_no_barrier(self, tmpdir):
+        """
+        Test that workers start the tests of the next suite while the
+        slowest test of the previous suite is still running.
+        """
+        tmpdir.join("runtest").join("dirsuite5").write("slow01 sleep 2\n")
+        tmpdir.join("runtest").join("dirsuite6").write("slow02 sleep 2\n")
+
+        session = LTPSession()
+
+        start = time.time()
+        session.run(suites=["dirsuite5", "dirsuite6"], workers=2)
+
+        # suites run at the same time on the two workers
+        assert time.time() - start < 3.5
+        assert session.completed
+        assert session.passed == 2
+        assert session.suites[5].completed
+        assert session.suites[6].completed
+
+    def test_run_backends(self):
+        """
+        Test run method sharding tests across multiple backends.
+        """
+        session = LTPSession(backends=[ShellBackend(), ShellBackend()])
+        session.run()
+
+        assert session.completed
+        assert session.passed == 1
+        assert session.failed == 1
+        assert session.skipped == 1
+        assert session.broken == 1
+        assert session.warnings == 1
+
+        for suite in session.suites:
+            assert suite.completed
+            for test in suite.tests:
+                assert test.completed
+                assert test.target == "shell"
+
+    def test_constructor_bad_shard(self):
+        """
+        Test constructor with bad shards.
+        """
+        with pytest.raises(ValueError):
+            LTPSession(shard=(0, 0))
+
+        with pytest.raises(ValueError):
+            LTPSession(shard=(-1, 2))
+
+        with pytest.raises(ValueError):
+            LTPSession(shard=(2, 2))
+
+    def test_run_shard(self):
+        """
+        Test run method when only a shard of tests runs.
+        """
+        executed = []
+        for index in range(2):
+            session = LTPSession(shard=(index, 2))
+            session.run()
+
+            assert session.completed
+
+            for suite in session.suites:
+                for test in suite.tests:
+                    if test.completed:
+                        executed.append(test.name)
+
+        assert sorted(executed) == [f"dir0{i}" for i in range(1, 6)]
+
+    def test_run_history(self, tmpdir, caplog):
+        """
+        Test run method when tests are sorted by history durations.
+        """
+        tmpdir.join("runtest").join("dirsuite5").write(
+            "short echo short\n"
+            "long echo long\n"
+            "medium echo medium\n")
+
+        report = tmpdir.join("history.json")
+        report.write(json.dumps({
+            "session": {
+                "suites": [
+                    {
+                        "name": "dirsuite5",
+                        "tests": [
+                            {"name": "short", "duration": 1},
+                            {"name": "long", "duration": 10},
+                            {"name": "medium", "duration": 5},
+                        ]
+                    }
+                ]
+            }
+        }))
+
+        history = LTPHistory()
+        history.load(str(report))
+
+        caplog.set_level(logging.INFO)
+
+        session = LTPSession(history=history)
+        session.run(suites=["dirsuite5"])
+
+        outputs = [
+            record.message for record in caplog.records
+            if record.message in ["short", "medium", "long"]
+        ]
+
+        assert outputs == ["long", "medium", "short"]
+
+    def test_run_session_timeout(self, tmpdir):
+        """
+        Test run method when session times out.
+        """
+        tmpdir.join("runtest").join("dirsuite5").write(
+            "sleep01 sleep 1\n"
+            "sleep02 sleep 10\n"
+            "sleep03 sleep 1\n")
+        tmpdir.join("runtest").join("dirsuite6").write("dir06 sleep 0\n")
+
+        session = LTPSession(session_timeout=2)
+
+        start = time.time()
+        session.run(suites=["dirsuite5", "dirsuite6"])
+
+        assert time.time() - start < 5
+        assert session.completed
+        assert session.passed == 1
+        assert session.broken == 1
+
+        tests = session.suites[5].tests
+        assert tests[0].completed
+        assert tests[1].completed
+        assert tests[1].timed_out
+        assert not tests[2].completed
+        assert not session.suites[6].completed
+
+    def test_run_cgroup_limits_error(self, tmpdir):
+        """
+        Test that session doesn't run when limits can't be applied.
+        """
+        cgroups = CgroupTree(str(tmpdir), limits={"pids": 10})
+        session = LTPSession(cgroups=cgroups)
+
+        with pytest.raises(LTPTestError, match="pids"):
+            session.run(suites=["dirsuite0"])
+
+    def test_run_spool(self, tmpdir):
+        """
+        Test run method when tests output is spooled.
+        """
+        spool_dir = str(tmpdir / "spool")
+        session = LTPSession(spool_dir=spool_dir)
+        session.run()
+
+        assert session.completed
+
+        for suite in session.suites:
+            for test in suite.tests:
+                assert test.stdout_path == os.path.join(
+                    spool_dir, session.name, suite.name, f"{test.name}.log")
+                assert os.path.isfile(test.stdout_path)
+                assert "Summary:" in test.stdout
+
     def test_run_scenario_bad_args(self):
         """
         Test run_scenario method with bad arguments.
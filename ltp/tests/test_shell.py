@@ -1,10 +1,16 @@
 """
 Unittest for shell module.
 """
+import io
 import time
 import signal
+import asyncio
 import threading
+import pytest
 from ltp.backend import ShellBackend
+from ltp.backend import BackendLoop
+from ltp.backend import BackendError
+from ltp.backend import BackendTimeoutError
 
 
 def test_name():
@@ -87,6 +93,26 @@ def test_stop():
     assert ret["timeout"] == 20
 
 
+def test_run_cmd_timeout():
+    """
+    Test run_cmd method when command times out.
+    """
+    start = time.time()
+    with pytest.raises(BackendTimeoutError):
+        ShellBackend().run_cmd("sleep 10 & sleep 10", 1)
+
+    assert time.time() - start < 5
+
+
+def test_run_cmd_no_timeout():
+    """
+    Test run_cmd method when timeout is 0.
+    """
+    ret = ShellBackend().run_cmd("sleep 0.5; echo -n 'hello'", 0)
+    assert ret["returncode"] == 0
+    assert ret["stdout"] == "hello"
+
+
 def test_force_stop():
     """
     Test force_stop method.
@@ -115,3 +141,167 @@ def test_force_stop():
     assert ret["returncode"] == -signal.SIGKILL
     assert ret["stdout"] == ""
     assert ret["timeout"] == 20
+
+
+def test_run_cmd_async():
+    """
+    Test run_cmd_async method.
+    """
+    ret = asyncio.run(ShellBackend().run_cmd_async("echo -n 'hello'", 1))
+    assert ret["command"] == "echo -n 'hello'"
+    assert ret["returncode"] == 0
+    assert ret["stdout"] == "hello"
+    assert ret["timeout"] == 1
+
+
+def test_run_cmd_async_callback():
+    """
+    Test run_cmd_async method with stdout callback.
+    """
+    chunks = []
+
+    ret = asyncio.run(ShellBackend().run_cmd_async(
+        "echo 'line0'; sleep 0.5; echo 'line1'; exit 3",
+        5,
+        chunks.append))
+
+    assert ret["returncode"] == 3
+    assert ret["stdout"] == "line0\nline1\n"
+    assert chunks == ["line0\n", "line1\n"]
+
+
+def test_run_cmd_async_parallel():
+    """
+    Test run_cmd_async method running multiple commands at the same time.
+    """
+    shell = ShellBackend()
+
+    async def _run():
+        return await asyncio.gather(*[
+            shell.run_cmd_async(f"sleep 1; echo -n {i}", 10)
+            for i in range(8)
+        ])
+
+    start = time.time()
+    results = asyncio.run(_run())
+    elapsed = time.time() - start
+
+    assert elapsed < 3
+    for i, ret in enumerate(results):
+        assert ret["returncode"] == 0
+        assert ret["stdout"] == str(i)
+
+
+def test_run_cmd_async_timeout():
+    """
+    Test run_cmd_async method when command times out.
+    """
+    with pytest.raises(BackendTimeoutError):
+        asyncio.run(ShellBackend().run_cmd_async("sleep 10", 1))
+
+
+def test_backend_loop():
+    """
+    Test BackendLoop running commands of many threads on the same loop.
+    """
+    shell = ShellBackend()
+    results = {}
+
+    with pytest.raises(BackendError):
+        BackendLoop().run_cmd(shell, "true", 1)
+
+    with BackendLoop(workers=4) as loop:
+        assert loop.is_running
+
+        def _run(i):
+            chunks = []
+            ret = loop.run_cmd(shell, f"sleep 1; echo -n {i}", 10,
+                               chunks.append)
+            results[i] = (ret["stdout"], chunks)
+
+        threads = [threading.Thread(target=_run, args=(i,))
+                   for i in range(8)]
+
+        start = time.time()
+        for thread in threads:
+            thread.start()
+
+        for thread in threads:
+            thread.join()
+
+        assert time.time() - start < 3
+
+        with pytest.raises(BackendTimeoutError):
+            loop.run_cmd(shell, "sleep 10", 1)
+
+    assert not loop.is_running
+    assert results == {i: (str(i), [str(i)]) for i in range(8)}
+
+
+def test_backend_loop_stop():
+    """
+    Test BackendLoop stop method, with and without executor workers.
+    """
+    for workers in [None, 2]:
+        loop = BackendLoop(workers=workers)
+        loop.start()
+        loop.stop()
+        assert not loop.is_running
+
+        # loop can be started again
+        loop.start()
+        assert loop.is_running
+        loop.stop()
+
+
+def test_stop_async():
+    """
+    Test stop method while running asynchronous commands.
+    """
+    shell = ShellBackend()
+
+    async def _run():
+        task = asyncio.ensure_future(shell.run_cmd_async("sleep 10", 20))
+        await asyncio.sleep(0.5)
+        shell.stop()
+        return await task
+
+    ret = asyncio.run(_run())
+
+    assert ret["returncode"] == -signal.SIGTERM
+    assert ret["stdout"] == ""
+
+
+def test_run_cmd_input():
+    """
+    Test run_cmd_input method.
+    """
+    data = b"x" * 1000000
+
+    ret = ShellBackend().run_cmd_input("wc -c", io.BytesIO(data), 10)
+    assert ret["command"] == "wc -c"
+    assert ret["returncode"] == 0
+    assert ret["stdout"].strip() == "1000000"
+    assert ret["timeout"] == 10
+
+
+def test_run_cmd_input_unread():
+    """
+    Test run_cmd_input method when command doesn't read its input.
+    """
+    ret = ShellBackend().run_cmd_input(
+        "echo -n done", io.BytesIO(b"x" * 1000000), 10)
+    assert ret["returncode"] == 0
+    assert ret["stdout"] == "done"
+
+
+def test_run_cmd_input_timeout():
+    """
+    Test run_cmd_input method when command times out.
+    """
+    start = time.time()
+
+    with pytest.raises(BackendTimeoutError):
+        ShellBackend().run_cmd_input("sleep 10", io.BytesIO(b"x" * 1000000), 1)
+
+    assert time.time() - start < 5
@@ -3,6 +3,7 @@ Unittest for ssh module.
 """
 import os
 import time
+import asyncio
 import socket
 import threading
 import subprocess
@@ -10,6 +11,8 @@ import logging
 import pytest
 from ltp.backend import SSHBackend
 from ltp.backend import BackendError
+from ltp.backend import BackendTimeoutError
+from ltp.backend import BackendPool
 
 
 class OpenSSHServer:
@@ -302,3 +305,249 @@ def test_connection_user_password(config):
     assert ret["stdout"] == "this is not a test\n"
     assert ret["returncode"] == 0
     assert ret["timeout"] == 1
+
+
+@pytest.mark.usefixtures("ssh_server")
+def test_connection_persistent(config):
+    """
+    Test multiple commands executed inside a persistent remote shell.
+    """
+    client = SSHBackend(
+        host=config.hostname,
+        port=config.port,
+        user=config.user,
+        key_file=config.user_key,
+        persistent=True)
+
+    client.start()
+    try:
+        for i in range(10):
+            ret = client.run_cmd(f"echo 'this is test {i}'", 1)
+            assert ret["stdout"] == f"this is test {i}\n"
+            assert ret["returncode"] == 0
+
+        ret = client.run_cmd("echo -n 'no newline'", 1)
+        assert ret["stdout"] == "no newline"
+        assert ret["returncode"] == 0
+
+        ret = client.run_cmd("exit 3", 1)
+        assert ret["stdout"] == ""
+        assert ret["returncode"] == 3
+
+        ret = client.run_cmd("echo 'error' >&2; false", 1)
+        assert ret["stdout"] == "error\n"
+        assert ret["returncode"] == 1
+
+        ret = client.run_cmd("export MYVAR=1; cd /", 1)
+        assert ret["returncode"] == 0
+
+        ret = client.run_cmd("echo -n $MYVAR", 1)
+        assert ret["stdout"] == ""
+    finally:
+        client.stop()
+
+
+@pytest.mark.usefixtures("ssh_server")
+@pytest.mark.parametrize("persistent", [False, True])
+@pytest.mark.parametrize("buffer_size", [3, 65536])
+def test_large_output(config, persistent, buffer_size):
+    """
+    Test commands printing a large output, multibyte characters and NUL
+    bytes using different read buffer sizes.
+    """
+    client = SSHBackend(
+        host=config.hostname,
+        port=config.port,
+        user=config.user,
+        key_file=config.user_key,
+        persistent=persistent,
+        buffer_size=buffer_size)
+
+    client.start()
+    try:
+        ret = client.run_cmd("seq 1 100000", 10)
+        assert ret["returncode"] == 0
+        assert ret["stdout"] == "".join(f"{i}\n" for i in range(1, 100001))
+
+        ret = client.run_cmd("printf 'a\\0b'; printf '\\342\\202\\254'", 1)
+        assert ret["returncode"] == 0
+        assert ret["stdout"] == "a\0b€"
+    finally:
+        client.stop()
+
+
+@pytest.mark.usefixtures("ssh_server")
+def test_pool(config):
+    """
+    Test a pool of SSH sessions running commands at the same time.
+    """
+    pool = BackendPool(
+        lambda: SSHBackend(
+            host=config.hostname,
+            port=config.port,
+            user=config.user,
+            key_file=config.user_key),
+        size=4)
+
+    pool.start()
+    try:
+        results = []
+
+        def _run():
+            results.append(pool.run_cmd("sleep 1; echo -n 'done'", 10))
+
+        threads = [threading.Thread(target=_run) for _ in range(4)]
+
+        start = time.time()
+        for thread in threads:
+            thread.start()
+
+        for thread in threads:
+            thread.join()
+        elapsed = time.time() - start
+
+        assert elapsed < 3
+        assert len(results) == 4
+        for ret in results:
+            assert ret["returncode"] == 0
+            assert ret["stdout"] == "done"
+    finally:
+        pool.stop()
+
+
+@pytest.mark.usefixtures("ssh_server")
+def test_run_cmd_async(config):
+    """
+    Test multiple asynchronous commands running on the same SSH session.
+    """
+    client = SSHBackend(
+        host=config.hostname,
+        port=config.port,
+        user=config.user,
+        key_file=config.user_key)
+
+    chunks = []
+
+    async def _run():
+        return await asyncio.gather(*[
+            client.run_cmd_async(
+                f"sleep 1; echo 'test {i}'", 10, chunks.append)
+            for i in range(4)
+        ])
+
+    client.start()
+    try:
+        start = time.time()
+        results = asyncio.run(_run())
+        elapsed = time.time() - start
+
+        assert elapsed < 3
+        for i, ret in enumerate(results):
+            assert ret["returncode"] == 0
+            assert ret["stdout"] == f"test {i}\n"
+
+        assert sorted(chunks) == [f"test {i}\n" for i in range(4)]
+
+        with pytest.raises(BackendTimeoutError):
+            asyncio.run(client.run_cmd_async("sleep 10", 1))
+    finally:
+        client.stop()
+
+
+@pytest.mark.usefixtures("ssh_server")
+@pytest.mark.parametrize("persistent", [False, True])
+def test_run_cmd_timeout(config, persistent):
+    """
+    Test run_cmd method timeouts, which are the same for all the
+    execution modes.
+    """
+    client = SSHBackend(
+        host=config.hostname,
+        port=config.port,
+        user=config.user,
+        key_file=config.user_key,
+        persistent=persistent)
+
+    client.start()
+    try:
+        ret = client.run_cmd("sleep 2; echo -n 'done'", 0)
+        assert ret["returncode"] == 0
+        assert ret["stdout"] == "done"
+
+        start = time.time()
+        with pytest.raises(BackendTimeoutError):
+            client.run_cmd("echo 'start'; sleep 10", 1)
+
+        assert time.time() - start < 5
+    finally:
+        client.stop()
+
+
+@pytest.mark.usefixtures("ssh_server")
+@pytest.mark.parametrize("persistent", [False, True])
+def test_run_cmd_timeout_kill(config, persistent, tmpdir):
+    """
+    Test that processes of commands which timed out are killed.
+    """
+    pidfile = tmpdir / "pid"
+
+    client = SSHBackend(
+        host=config.hostname,
+        port=config.port,
+        user=config.user,
+        key_file=config.user_key,
+        persistent=persistent)
+
+    client.start()
+    try:
+        with pytest.raises(BackendTimeoutError):
+            client.run_cmd(f"sleep 10 & echo $! > {pidfile}; wait", 1)
+
+        stat = f"/proc/{int(pidfile.read())}/stat"
+
+        # killed process can be a zombie, if nobody reaped it yet
+        state = None
+        for _ in range(100):
+            try:
+                with open(stat, "r", encoding="UTF-8") as data:
+                    state = data.read().rpartition(")")[2].split()[0]
+            except FileNotFoundError:
+                state = None
+                break
+
+            if state == "Z":
+                break
+
+            time.sleep(0.05)
+
+        assert state in [None, "Z"]
+    finally:
+        client.stop()
+
+
+@pytest.mark.usefixtures("ssh_server")
+@pytest.mark.parametrize("persistent", [False, True])
+def test_run_cmd_input(config, persistent, tmpdir):
+    """
+    Test run_cmd_input method streaming data larger than the buffer.
+    """
+    client = SSHBackend(
+        host=config.hostname,
+        port=config.port,
+        user=config.user,
+        key_file=config.user_key,
+        persistent=persistent,
+        buffer_size=1024)
+
+    data = tmpdir / "data"
+    data.write("x" * 100000)
+
+    client.start()
+    try:
+        with open(str(data), "rb") as stdin:
+            ret = client.run_cmd_input("wc -c", stdin, 10)
+
+        assert ret["returncode"] == 0
+        assert ret["stdout"].strip() == "100000"
+    finally:
+        client.stop()